@@ -2,6 +2,10 @@
 #include "shape.h"
 #include "MainWindow.h"
 #include "TextEditDialog.h"
+#include "TraceRecorder.h"
+#include "SceneRenderer.h"
+#include "RenderThread.h"
+#include "ProgressiveRenderer.h"
 #include <QPainter>
 #include <QMenu>
 #include <QFile>
@@ -21,13 +25,20 @@
 #include <QCheckBox>
 #include <QPushButton>
 #include <QInputDialog>
+#include <QScreen>
+#include <QRandomGenerator>
+#include <QSet>
+#include <algorithm>
+#include <QScrollArea>
+#include <QTextCursor>
+#include <QTextDocument>
 CanvasWidget::CanvasWidget(QWidget* parent)
     : QWidget(parent),
     showGrid(true),
-    m_canvasColor(Qt::white)  // ʼɫΪɫ// Ĭʾ
+    m_canvasColor(Qt::white)  // 初始化背景色为白色// 默认显示网格
 {
     createNewCanvas(800, 600);
-    setEditorState(SelectState); // ʽóʼ״̬
+    setEditorState(SelectState); // 显式设置初始状态
 
     QAction* copyAction = new QAction("Copy", this);
     copyAction->setShortcut(QKeySequence::Copy);
@@ -46,6 +57,16 @@ CanvasWidget::CanvasWidget(QWidget* parent)
     connect(deleteAction, &QAction::triggered, this, &CanvasWidget::deleteShape);
 
     this->addActions({ copyAction, pasteAction, cutAction, deleteAction });
+
+    // 鼠标移动按显示帧节拍合并处理
+    m_inputClock.start();
+    m_frameTimer.setSingleShot(true);
+    m_frameTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_frameTimer, &QTimer::timeout, this, &CanvasWidget::flushPendingMove);
+
+    // 交互停止一段时间后重绘高质量画面
+    m_idleTimer.setSingleShot(true);
+    connect(&m_idleTimer, &QTimer::timeout, this, &CanvasWidget::interactionIdle);
 }
 
 void CanvasWidget::createNewCanvas(int width, int height)
@@ -54,235 +75,619 @@ void CanvasWidget::createNewCanvas(int width, int height)
     clearCanvas();
 }
 
+void CanvasWidget::growToFit(const QRectF& bounds)
+{
+    const int w = qBound(width(), qCeil(bounds.right()) + 20, 10000);
+    const int h = qBound(height(), qCeil(bounds.bottom()) + 20, 10000);
+    if (w != width() || h != height()) {
+        resizeCanvas(w, h);
+    }
+}
+
 void CanvasWidget::resizeCanvas(int width, int height)
 {
     canvasImage = QImage(width, height, QImage::Format_ARGB32);
     setFixedSize(width, height);
-    update();
+    noteContentChange();
+    sceneChanged();
 }
 
 void CanvasWidget::clearCanvas()
 {
     canvasImage.fill(Qt::white);
-    update();
+    noteContentChange();
+    sceneChanged();
 }
 
 void CanvasWidget::paintEvent(QPaintEvent* event) {
-    Q_UNUSED(event);
+    TRACE_SCOPE("CanvasWidget::paintEvent");
     QPainter painter(this);
 
-    // 1. ȻƱɫ
-    painter.fillRect(rect(), m_canvasColor);
+    // 拖动图形时：贴上缓存的静态层，只重绘被拖动的图形
+    quint64 frameRevision = m_sceneRevision;
+    const bool layered = paintLayers(painter);
 
-    // 2. ߣײ㣩
-    if (showGrid) {
-        drawGrid(painter);
+    // 后台渲染：提交最新快照，只贴上已完成的一帧
+    if (layered) {
+        // 已合成
+    }
+    else if (m_renderThread) {
+        if (m_submittedRevision != m_sceneRevision) {
+            submitScene();
+        }
+        // 总是贴上最近完成的一帧（即使落后于当前场景或尺寸不同），新帧完成后再次重绘；
+        // 界面线程不做整幅绘制
+        QImage frame = m_renderThread->latestFrame(&frameRevision);
+        if (frameRevision < m_minFrameRevision && m_dragComposite.size() == size()) {
+            // 拖动结束后的新帧未完成：继续贴松开时合成的画面
+            painter.drawImage(0, 0, m_dragComposite);
+            frameRevision = m_minFrameRevision - 1; // 内容即松开前的最后一版
+        }
+        else if (!frame.isNull()) {
+            if (frame.size() != size()) {
+                painter.fillRect(rect(), m_canvasColor);
+            }
+            painter.drawImage(0, 0, frame);
+            if (frameRevision >= m_minFrameRevision) {
+                m_dragComposite = QImage();
+            }
+        }
+        else {
+            // 第一帧尚未完成：只画背景和网格
+            painter.fillRect(rect(), m_canvasColor);
+            if (showGrid) {
+                drawGrid(painter);
+            }
+            frameRevision = 0;
+        }
+    }
+    else if (m_progressive) {
+        // 渐进渲染：场景变化后重新开始，之后由定时器逐级细化
+        if (m_progressRevision != m_sceneRevision) {
+            QList<Shape*> source = m_zOrder.list();
+            if (isDrawing && currentShape) {
+                source.append(currentShape);
+            }
+            m_progressive->restart(source, size(), m_canvasColor, showGrid, renderOptions());
+            m_progressRevision = m_sceneRevision;
+        }
+        painter.drawImage(0, 0, m_progressive->frame());
     }
 
-    // 3. ͼΣߣ
-    drawShapes(painter);
+    if (!layered && m_renderMode == DirectRender) {
+        frameRevision = m_sceneRevision;
 
-    // 4. ƵǰڴͼΣϲ㣩
-    if (isDrawing && currentShape) {
-        currentShape->draw(&painter);
+        // 1. 先绘制背景（白色）
+        painter.fillRect(rect(), m_canvasColor);
+
+        // 2. 绘制网格线（最底层）
+        if (showGrid) {
+            drawGrid(painter);
+        }
+
+        // 3. 绘制所有图形（覆盖网格线）
+        drawShapes(painter, event->rect());
+
+        // 4. 绘制当前正在创建的图形（最上层）
+        if (isDrawing && currentShape) {
+            currentShape->draw(&painter);
+        }
+    }
+
+    // 5. 查找结果高亮（总是在界面线程画在最上层）
+    if (!m_matches.isEmpty()) {
+        drawMatches(painter, event->rect());
+    }
+
+    // 6. 多选和组的选框
+    if (!m_selection.isEmpty()) {
+        drawSelectionFrames(painter);
+    }
+
+    // 7. 拖动时的对齐参考线
+    if (!m_snapGuides.isEmpty()) {
+        drawSnapGuides(painter);
+    }
+
+    // 8. 统计输入到画面的延迟（等包含该输入的一帧显示出来）
+    if (m_latencyProbeNs >= 0 && frameRevision >= m_latencyProbeRevision) {
+        qint64 latency = m_inputClock.nsecsElapsed() - m_latencyProbeNs;
+        m_latencyProbeNs = -1;
+        TraceRecorder::instance().recordCounter("input latency (us)", latency / 1000);
+        if (m_dragActive) {
+            ++m_dragFrames;
+            m_dragLatencySumNs += latency;
+            m_dragLatencyMaxNs = qMax(m_dragLatencyMaxNs, latency);
+        }
     }
 }
 
-// 
+// 新增：网格绘制
 void CanvasWidget::drawGrid(QPainter& painter)
 {
-    painter.setPen(QPen(Qt::lightGray, 1, Qt::DotLine));
-    for (int x = 0; x < width(); x += 20) {
-        painter.drawLine(x, 0, x, height());
+    SceneRenderer::drawGrid(painter, size());
+}
+
+void CanvasWidget::sceneChanged() {
+    m_renderCopiesStale = true;
+    invalidateScene();
+}
+
+void CanvasWidget::invalidateScene() {
+    if (m_batchDepth > 0) {
+        m_batchChanged = true; // 提交时统一处理
+        return;
     }
-    for (int y = 0; y < height(); y += 20) {
-        painter.drawLine(0, y, width(), y);
+    ++m_sceneRevision;
+    m_layersValid = false;
+    if (m_progressive) {
+        m_progressive->cancel(); // 中止旧场景的细化，图形可能已被修改或删除
     }
+    update();
 }
 
-// ɼ
-void CanvasWidget::setGridVisible(bool visible)
-{
-    if (showGrid != visible) {
-        showGrid = visible;
-        update();  // ػ
+void CanvasWidget::sceneChanged(const QRectF& dirty) {
+    m_renderCopiesStale = true;
+    if (m_batchDepth > 0) {
+        m_batchChanged = true;
+        return;
+    }
+    ++m_sceneRevision;
+    m_layersValid = false;
+    if (m_progressive) {
+        m_progressive->cancel();
     }
+    update(dirty.toAlignedRect());
 }
 
-bool CanvasWidget::saveToFile(const QString& fileName) {
-    QFile file(fileName);
-    if (!file.open(QIODevice::WriteOnly)) {
-        qWarning() << "Failed to open file for writing:" << fileName
-            << "Error:" << file.errorString();
-        return false;
+void CanvasWidget::noteContentChange(const QRectF& dirty) {
+    if (dirty.isNull()) {
+        m_snapIndexDirty = true; // 整体变化
     }
+    if (m_batchDepth > 0) {
+        if (dirty.isNull()) {
+            m_batchContentAll = true;
+        }
+        else {
+            m_batchContent |= dirty;
+        }
+        return;
+    }
+    emit contentChanged(dirty);
+}
 
-    QDataStream out(&file);
-    out.setVersion(QDataStream::Qt_5_15);
+void CanvasWidget::setRenderMode(RenderMode mode) {
+    if (m_renderMode == mode) return;
+    m_renderMode = mode;
 
-    // ļͷʶͰ汾
-    out << quint32(0x464C4F57); // ļͷʶ "FLOW"
-    out << qint16(2);          // 汾2
+    delete m_renderThread;
+    m_renderThread = nullptr;
+    delete m_progressive;
+    m_progressive = nullptr;
 
-    // Ϣ
-    out << qint32(width()) << qint32(height());
-    out << showGrid;
+    if (mode == ThreadedRender) {
+        m_renderThread = new RenderThread(this);
+        connect(m_renderThread, &RenderThread::frameReady, this, [this]() { update(); });
+    }
+    else if (mode == ProgressiveRender) {
+        m_progressive = new ProgressiveRenderer(this);
+        connect(m_progressive, &ProgressiveRenderer::frameUpdated, this, [this]() { update(); });
+    }
+    m_submittedRevision = 0;
+    m_progressRevision = 0;
+    m_layersValid = false;
+    m_layersPending = false;
+    m_dragComposite = QImage();
+    m_renderCopies.clear();
+    m_renderCopiesStale = true;
+    m_dirtyCopies.clear();
+    update();
+}
+
+void CanvasWidget::setInteractionQuality(const InteractionQuality& quality) {
+    m_quality = quality;
+    if (!m_quality.enabled && m_interacting) {
+        interactionIdle();
+    }
+}
 
-    // ͼ
-    out << qint32(shapes.size());
+void CanvasWidget::noteInteraction() {
+    if (!m_quality.enabled || m_zOrder.size() < m_quality.minShapes) return;
+    m_interacting = true;
+    m_idleTimer.start(m_quality.idleMs);
+}
 
-    // ÿͼ
-    for (Shape* shape : shapes) {
-        // ͼ
-        out << qint32(shape->type);
+void CanvasWidget::interactionIdle() {
+    m_idleTimer.stop();
+    m_interacting = false;
+    if (m_layerShape) return; // 分层拖动时静态层本来就是完整画质
+    sceneChanged(); // 以完整画质重新渲染
+}
 
-        // 
-        out << shape->boundingRect;
-        out << shape->getRotation();
-        out << shape->getRotationCenter();
-        out << shape->zValue();
+void CanvasWidget::liveShapeChanged() {
+    // 只有拖动或正在绘制的图形变化，下次提交快照时只重新复制它们
+    if (m_renderThread) {
+        if (selectedShape) m_dirtyCopies.insert(selectedShape);
+        for (const Shape* shape : m_selection) m_dirtyCopies.insert(shape);
+        if (isDrawing && currentShape) m_dirtyCopies.insert(currentShape);
+    }
+    if (!m_layerShape) {
+        invalidateScene();
+        return;
+    }
+    // 只有被拖动的图形变化，静态层保持有效
+    ++m_sceneRevision;
+    update();
+}
 
-        // 
-        QPen pen = shape->pen();
-        out << pen.color();
-        out << pen.width();
-        out << qint32(pen.style());
+void CanvasWidget::beginLayeredDrag() {
+    m_layerShape = selectedShape;
+    m_layersValid = false;
+    m_dragComposite = QImage();
+    update();
+}
 
-        // 
-        QBrush brush = shape->brush();
-        out << brush.color();
-        out << qint32(brush.style());
+void CanvasWidget::endLayeredDrag() {
+    m_layerArmed = false;
+    if (!m_layerShape) return;
 
-        // ı
-        out << shape->text();
-        out << shape->textFont();
-        out << shape->textColor();
+    // 渲染线程最近的一帧还是拖动前的画面，不能再贴；新帧完成前贴松开时的合成画面
+    if (m_renderThread && m_layerShape == selectedShape && m_layersValid && !m_layersPending) {
+        m_dragComposite = QImage(size(), QImage::Format_ARGB32_Premultiplied);
+        QPainter painter(&m_dragComposite);
+        paintLayers(painter);
     }
+    m_layerShape = nullptr;
+    m_layersPending = false;
+    m_aboveLayer = QImage();
+    sceneChanged(); // 回到常规渲染路径
+    m_minFrameRevision = m_sceneRevision;
+}
 
-    if (out.status() != QDataStream::Ok) {
-        qWarning() << "Error during writing";
-        file.remove();
-        return false;
+void CanvasWidget::buildLayers() {
+    TRACE_SCOPE("CanvasWidget::buildLayers");
+    if (!m_zOrder.contains(m_layerShape)) return;
+
+    // 后台渲染时由渲染线程按快照生成分层，界面线程不做整幅绘制
+    if (m_renderThread) {
+        submitScene(m_layerShape);
+        m_layersRevision = m_sceneRevision;
+        m_layersPending = true;
+        m_layersValid = true;
+        return;
     }
 
-    file.close();
-    return true;
+    // 下层：背景、网格和被拖动图形之下的所有图形（复用 canvasImage）
+    if (canvasImage.size() != size() || canvasImage.format() != QImage::Format_ARGB32_Premultiplied) {
+        canvasImage = QImage(size(), QImage::Format_ARGB32_Premultiplied);
+    }
+    canvasImage.fill(m_canvasColor);
+    {
+        QPainter painter(&canvasImage);
+        if (showGrid) {
+            drawGrid(painter);
+        }
+        SceneRenderer::drawShapesBatched(painter, m_zOrder.shapesBelow(m_layerShape));
+    }
+
+    // 上层：被拖动图形之上的图形，透明背景
+    const QList<Shape*> above = m_zOrder.shapesAbove(m_layerShape);
+    if (above.isEmpty()) {
+        m_aboveLayer = QImage();
+    }
+    else {
+        if (m_aboveLayer.size() != size()) {
+            m_aboveLayer = QImage(size(), QImage::Format_ARGB32_Premultiplied);
+        }
+        m_aboveLayer.fill(Qt::transparent);
+        QPainter painter(&m_aboveLayer);
+        SceneRenderer::drawShapesBatched(painter, above);
+    }
+    m_layersValid = true;
 }
 
-bool CanvasWidget::loadFromFile(const QString& fileName) {
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly)) {
-        qWarning() << "Failed to open file for reading:" << fileName
-            << "Error:" << file.errorString();
-        return false;
+bool CanvasWidget::paintLayers(QPainter& painter) {
+    // 选中的图形被删除或替换后不再分层
+    if (!m_layerShape || m_layerShape != selectedShape) return false;
+    if (!m_layersValid) {
+        buildLayers();
+        if (!m_layersValid) return false;
+    }
+    if (m_layersPending) {
+        if (!m_renderThread->latestLayers(m_layersRevision, &canvasImage, &m_aboveLayer)) {
+            // 分层完成前（通常只有一两帧）贴上最近一帧，被拖动的图形画在最上面
+            const QImage frame = m_renderThread->latestFrame();
+            if (frame.size() == size()) {
+                painter.drawImage(0, 0, frame);
+            }
+            else {
+                painter.fillRect(rect(), m_canvasColor); // 不提交整帧，以免顶掉信箱里的分层快照
+            }
+            QList<Shape*> live;
+            live.append(m_layerShape);
+            SceneRenderer::drawShapes(painter, live, renderOptions());
+            return true;
+        }
+        m_layersPending = false;
     }
 
-    QDataStream in(&file);
-    in.setVersion(QDataStream::Qt_5_15);
+    painter.drawImage(0, 0, canvasImage);
+    QList<Shape*> live;
+    live.append(m_layerShape);
+    SceneRenderer::drawShapes(painter, live, renderOptions());
+    if (!m_aboveLayer.isNull()) {
+        painter.drawImage(0, 0, m_aboveLayer);
+    }
+    return true;
+}
 
-    // ֤ļͷ
-    quint32 magic;
-    qint16 version;
-    in >> magic >> version;
+RenderOptions CanvasWidget::renderOptions() const {
+    RenderOptions options;
+    if (m_interacting) {
+        options.antialiasing = !m_quality.disableAntialiasing;
+        options.hairlines = m_quality.hairlines;
+        options.placeholderText = m_quality.placeholderText;
+    }
+    return options;
+}
 
-    if (magic != 0x464C4F57 || (version != 1 && version != 2)) {
-        qWarning() << "Invalid file format";
-        return false;
+void CanvasWidget::submitScene(const Shape* live) {
+    TRACE_SCOPE("CanvasWidget::submitScene");
+    RenderScene* scene = new RenderScene;
+    scene->revision = m_sceneRevision;
+    scene->size = size();
+    scene->background = m_canvasColor;
+    scene->showGrid = showGrid;
+    scene->options = live ? RenderOptions() : renderOptions(); // 静态层总是完整画质
+
+    const QList<Shape*>& order = m_zOrder.list();
+    Shape* drawing = isDrawing ? currentShape : nullptr;
+    if (m_renderCopiesStale || drawing != m_submittedDrawing || order != m_submittedOrder) {
+        // 顺序变了或任意图形可能变化：逐个比较，只复制有变化的图形，其余沿用上一份副本
+        QList<Shape*> source = order;
+        if (drawing) {
+            source.append(drawing);
+        }
+        m_submittedOrder = order;
+        m_submittedDrawing = drawing;
+        m_submittedShapes.clear();
+        m_submittedOwners.clear();
+        m_submittedIndex.clear();
+        m_submittedShapes.reserve(source.size());
+        m_submittedOwners.reserve(source.size());
+        m_submittedIndex.reserve(source.size());
+        for (const Shape* shape : source) {
+            QSharedPointer<Shape>& copy = m_renderCopies[shape];
+            if (!copy || !copy->rendersSameAs(*shape)) {
+                copy.reset(shape->clone());
+                copy->worldTransform(); // 预先建立变换缓存，渲染线程只读
+            }
+            m_submittedIndex.insert(shape, m_submittedShapes.size());
+            m_submittedOwners.append(copy);
+            m_submittedShapes.append(copy.data());
+        }
+        m_groupSnapshot = m_groups.snapshot(source);
+        m_groupSnapshotRevision = m_groups.revision();
+    }
+    else {
+        // 顺序不变：只重新复制标记为变化的图形
+        for (const Shape* shape : m_dirtyCopies) {
+            const int index = m_submittedIndex.value(shape, -1);
+            if (index < 0) continue;
+            QSharedPointer<Shape>& copy = m_renderCopies[shape];
+            copy.reset(shape->clone());
+            copy->worldTransform();
+            m_submittedOwners[index] = copy;
+            m_submittedShapes[index] = copy.data();
+        }
+        if (m_groupSnapshotRevision != m_groups.revision()) {
+            QList<Shape*> source = order;
+            if (drawing) {
+                source.append(drawing);
+            }
+            m_groupSnapshot = m_groups.snapshot(source);
+            m_groupSnapshotRevision = m_groups.revision();
+        }
+        else if (!m_groups.isEmpty()) {
+            m_groups.updateSnapshotBounds(&m_groupSnapshot); // 只刷新组的外框，O(组数)
+        }
+    }
+    m_renderCopiesStale = false;
+    m_dirtyCopies.clear();
+
+    // 与上一份快照共享数据，之后修改时才复制
+    scene->shapes = m_submittedShapes;
+    scene->owners = m_submittedOwners;
+    scene->groups = m_groupSnapshot;
+    if (live) {
+        scene->liveIndex = m_submittedIndex.value(live, -1);
     }
 
-    // ȡߴ
-    qint32 width, height;
-    in >> width >> height;
-    in >> showGrid;
+    m_renderThread->submit(scene);
+    if (!live) {
+        m_submittedRevision = m_sceneRevision;
+    }
+}
 
-    // ֤ߴ
-    if (width <= 0 || height <= 0 || width > 10000 || height > 10000) {
-        qWarning() << "Invalid canvas size";
-        return false;
+// 新增：设置网格可见性
+void CanvasWidget::setGridVisible(bool visible)
+{
+    if (showGrid != visible) {
+        showGrid = visible;
+        sceneChanged();  // 触发重绘
     }
+}
 
-    // »
-    resizeCanvas(width, height);
-    clearCanvas();
-    setGridVisible(showGrid);
-
-    // 汾2ͼݼ
-    if (version >= 2) {
-        qint32 shapeCount;
-        in >> shapeCount;
-
-        for (int i = 0; i < shapeCount; ++i) {
-            qint32 type;
-            in >> type;
-
-            Shape* shape = nullptr;
-            QRectF rect;
-            qreal rotation;
-            QPointF rotationCenter;
-            int zValue;
-
-            // ȡ
-            in >> rect >> rotation >> rotationCenter >> zValue;
-
-            // ͼ
-            switch (type) {
-            case ShapeType_Rectangle:
-                shape = new Rectangle(rect);
-                break;
-            case ShapeType_Ellipse:
-                shape = new Ellipse(rect);
-                break;
-            default:
-                qWarning() << "Unknown shape type:" << type;
-                continue;
-            }
+bool CanvasWidget::saveToFile(const QString& fileName) {
+    TRACE_SCOPE_CAT("CanvasWidget::saveToFile", "io");
+    FlowDocument document = toDocument();
+    document.thumbnail = FlowDocument::renderThumbnail(m_zOrder.list(), size(), m_canvasColor);
+    return document.save(fileName);
+}
 
-            // ñ任
-            shape->setRotation(rotation);
-            shape->setRotationCenter(rotationCenter);
-            shape->setZValue(zValue);
+FlowDocument CanvasWidget::toDocument() const {
+    FlowDocument document;
+    document.canvasSize = size();
+    document.showGrid = showGrid;
+    document.selectedId = selectedShapeId();
+    const QList<Shape*>& shapes = m_zOrder.list();
+    document.shapes.reserve(shapes.size());
+    for (const Shape* shape : shapes) {
+        document.shapes.append(ShapeRecord::fromShape(shape));
+    }
+    document.groups = m_groups.toRecords();
+    return document;
+}
 
-            // ȡ
-            QColor penColor;
-            int penWidth;
-            qint32 penStyle;
-            in >> penColor >> penWidth >> penStyle;
-            shape->setPen(QPen(penColor, penWidth, static_cast<Qt::PenStyle>(penStyle)));
+int CanvasWidget::applyDelta(const FlowDocument& base, const FlowDocument& document, const FlowDiff& diff) {
+    TRACE_SCOPE("CanvasWidget::applyDelta");
+    bool fullRepaint = false;
+    if (document.canvasSize != size()) {
+        resizeCanvas(document.canvasSize.width(), document.canvasSize.height());
+        fullRepaint = true;
+    }
+    if (document.showGrid != showGrid) {
+        setGridVisible(document.showGrid);
+        fullRepaint = true;
+    }
 
-            // ȡ
-            QColor brushColor;
-            qint32 brushStyle;
-            in >> brushColor >> brushStyle;
-            shape->setBrush(QBrush(brushColor, static_cast<Qt::BrushStyle>(brushStyle)));
+    // base 是解析开始时的快照，其间被用户删除的图形按ID查不到，直接跳过
+    m_snapIndexDirty = true; // 外部修改可能涉及大量图形，下次拖动时重建
+    QRectF dirty;
+    int changed = 0;
+    QVector<Shape*> shapeForNew(document.shapes.size(), nullptr);
+
+    // 1. 删除
+    for (int i : diff.removed) {
+        Shape* shape = shapeById(base.shapes[i].id);
+        if (!shape) continue;
+        if (shape == m_layerShape) {
+            endLayeredDrag();
+        }
+        if (shape == selectedShape) {
+            selectedShape = nullptr;
+            currentHandle = -1;
+            emit selectionChanged(false);
+        }
+        dirty |= shape->visualBounds();
+        removeShape(shape);
+        delete shape;
+        ++changed;
+    }
+
+    // 2. 修改（matched 按新文件顺序排列，旧下标不递增说明图层顺序变了）
+    bool ordered = true;
+    int lastOld = -1;
+    for (const FlowDiff::Match& match : diff.matched) {
+        Shape* shape = shapeById(base.shapes[match.oldIndex].id);
+        if (!shape) continue;
+        shapeForNew[match.newIndex] = shape;
+        if (match.oldIndex < lastOld) ordered = false;
+        lastOld = match.oldIndex;
+
+        // 按几何/文字配上的图形采用新文件的ID，下次重载可直接按ID配对
+        const ShapeRecord& record = document.shapes[match.newIndex];
+        if (record.id != 0 && record.id != shape->id() && !m_shapeIndex.contains(record.id)) {
+            m_shapeIndex.remove(shape->id());
+            shape->setId(record.id);
+            m_shapeIndex.insert(shape->id(), shape);
+        }
+        if (match.changes) {
+            dirty |= shape->visualBounds();
+            record.applyTo(shape);
+            if (match.changes & FlowDiff::Relabelled) {
+                m_textIndex.insert(shape);
+            }
+            dirty |= shape->visualBounds();
+            ++changed;
+        }
+    }
 
-            // ȡı
-            QString text;
-            QFont textFont;
-            QColor textColor;
-            in >> text >> textFont >> textColor;
-            shape->setText(text, textFont, textColor);
+    // 3. 新增（先放在最上层）
+    const int lastMatched = diff.matched.isEmpty() ? -1 : diff.matched.last().newIndex;
+    for (int j : diff.added) {
+        Shape* shape = document.shapes[j].createShape();
+        if (!shape) continue;
+        addShape(shape);
+        shapeForNew[j] = shape;
+        dirty |= shape->visualBounds();
+        ++changed;
+        if (j < lastMatched) ordered = false;
+    }
 
-            shapes.append(shape);
+    // 4. 图层顺序变化时按新文件重排，其间用户新加的图形留在最上层
+    if (!ordered) {
+        const QList<Shape*> previous = m_zOrder.list();
+        QSet<Shape*> placed;
+        m_zOrder.clear();
+        for (Shape* shape : shapeForNew) {
+            if (shape && !placed.contains(shape)) {
+                m_zOrder.append(shape);
+                placed.insert(shape);
+            }
         }
+        for (Shape* shape : previous) {
+            if (!placed.contains(shape)) {
+                m_zOrder.append(shape);
+            }
+        }
+        fullRepaint = true;
     }
 
-    file.close();
-    update();
+    if (changed > 0) {
+        refreshMatches();
+        m_groups.invalidateAll();
+    }
+    // 分组变化时按新文件重建（选框随之更新）
+    if (document.groups != base.groups) {
+        m_groups.fromRecords(document.groups, m_shapeIndex);
+        update();
+    }
+    if (fullRepaint) {
+        noteContentChange();
+        sceneChanged();
+    }
+    else if (changed > 0) {
+        noteContentChange(dirty);
+        sceneChanged(dirty);
+    }
+    return changed;
+}
+
+bool CanvasWidget::loadFromFile(const QString& fileName) {
+    TRACE_SCOPE_CAT("CanvasWidget::loadFromFile", "io");
+    FlowDocument document;
+    if (!document.load(fileName)) {
+        return false;
+    }
+
+    // 创建新画布
+    beginBatch();
+    resizeCanvas(document.canvasSize.width(), document.canvasSize.height());
+    clearCanvas();
+    clearShapes();
+    setGridVisible(document.showGrid);
+
+    addShapes(document.shapes);
+    m_groups.fromRecords(document.groups, m_shapeIndex);
+    selectShapeById(document.selectedId);
+    commitBatch();
     return true;
 }
 
 QImage CanvasWidget::toImage() const {
-    // 뻭ͬСQImage
+    TRACE_SCOPE("CanvasWidget::toImage");
+    // 创建与画布相同大小的QImage
     QImage image(size(), QImage::Format_ARGB32);
-    image.fill(m_canvasColor);  // ɫ
+    image.fill(m_canvasColor);  // 白色背景
 
-    // ʹQPainterݻƵQImage
+    // 使用QPainter将内容绘制到QImage
     QPainter painter(&image);
 
-    // 1. Ʊ
+    // 1. 绘制背景
     painter.fillRect(rect(), Qt::white);
 
-    // 2. Ҫ
+    // 2. 绘制网格（如果需要）
     if (showGrid) {
         painter.setPen(QPen(Qt::lightGray, 1, Qt::DotLine));
         for (int x = 0; x < width(); x += 20) {
@@ -293,50 +698,74 @@ QImage CanvasWidget::toImage() const {
         }
     }
 
-    // 3. ͼ
-    for (Shape* shape : shapes) {
-        // painter״̬
+    // 3. 绘制所有图形
+    for (Shape* shape : m_zOrder.list()) {
+        // 保存painter状态
         painter.save();
 
-        // Ӧͼα任
+        // 应用图形变换
         QPointF center = shape->boundingRect.center();
         painter.translate(center);
         painter.rotate(qRadiansToDegrees(shape->getRotation()));
         painter.translate(-center);
 
-        // ͼ
+        // 绘制图形
         shape->draw(&painter);
 
-        // ָpainter״̬
+        // 恢复painter状态
         painter.restore();
     }
 
     return image;
 }
 
-// ͼλƷ
-void CanvasWidget::drawShapes(QPainter& painter) {
-    // zֵСƣȻƵ棩
-    for (Shape* shape : shapes) {
-        shape->draw(&painter);
+QList<Shape*> CanvasWidget::shapesIn(const QRectF& area) const {
+    // 未分组的图形查网格，组按外框层次遍历，不相交的组连同后代一次跳过
+    QList<Shape*> shapes;
+    m_groups.query(area, &shapes);
+    // 单独选中的组内图形带控制点，可能超出组的外框
+    if (selectedShape && m_groups.groupOf(selectedShape) && !shapes.contains(selectedShape)
+        && selectedShape->visualBounds().intersects(area)) {
+        shapes.append(selectedShape);
+    }
+    std::sort(shapes.begin(), shapes.end(), [](const Shape* a, const Shape* b) {
+        return ZOrderIndex::isAbove(b, a);
+    });
+    return shapes;
+}
+
+// 新增图形绘制方法
+void CanvasWidget::drawShapes(QPainter& painter, const QRect& area) {
+    // 按z值从小到大绘制（先绘制的在下面），相邻的同样式图形合并绘制
+    if (area.isNull() || area.contains(rect())) {
+        SceneRenderer::drawShapesBatched(painter, m_zOrder.list(), renderOptions());
+    }
+    else {
+        TRACE_SCOPE("CanvasWidget::cullShapes");
+        SceneRenderer::drawShapesBatched(painter, shapesIn(area), renderOptions());
     }
 
-    // ǰڻƵͼ
+    // 当前正在绘制的图形在最上面
     if (isDrawing && currentShape) {
         currentShape->draw(&painter);
     }
 }
 
 void CanvasWidget::mousePressEvent(QMouseEvent * e) {
+    TRACE_SCOPE_CAT("CanvasWidget::mousePressEvent", "input");
     if (e->button() == Qt::MiddleButton ||
-        (e->button() == Qt::RightButton && !selectedShape)) {
+        (e->button() == Qt::RightButton && !selectedShape && m_selection.isEmpty())) {
         m_isPanning = true;
         m_lastPanPoint = e->pos();
         setCursor(Qt::ClosedHandCursor);
         e->accept();
         return;
     }
+    flushPendingMove();
     lastMousePos = e->pos();
+    if (e->button() == Qt::LeftButton) {
+        beginDragStats();
+    }
 
     switch (currentState) {
     case InsertState:
@@ -344,42 +773,135 @@ void CanvasWidget::mousePressEvent(QMouseEvent * e) {
         break;
     case SelectState:
         handleSelectPress(e);
+        if (e->button() == Qt::LeftButton && selectedShape) {
+            m_layerArmed = true; // 单击不分层，第一次真正移动时再开始
+            beginSnapping();
+        }
         break;
     case DragState:
-        // ͼ϶߼
+        // 视图拖动逻辑
         break;
     }
 }
 
 void CanvasWidget::mouseMoveEvent(QMouseEvent* e) {
-    
+    TRACE_SCOPE_CAT("CanvasWidget::mouseMoveEvent", "input");
     if (m_isPanning) {
         QPoint delta = e->pos() - m_lastPanPoint;
         m_viewOffset += delta / m_scaleFactor;
         m_lastPanPoint = e->pos();
-        update();
+        noteInteraction();
+        sceneChanged();
         e->accept();
         return;
     }
-    QPointF delta = e->pos() - lastMousePos;
-    lastMousePos = e->pos();
+
+    // 只记录最新位置，变换和重绘按帧节拍统一处理
+    queuePendingMove(e);
+}
+
+int CanvasWidget::frameIntervalMs() const {
+    QScreen* s = screen();
+    qreal hz = s ? s->refreshRate() : 60.0;
+    if (hz < 1.0) hz = 60.0;
+    return qMax(1, qRound(1000.0 / hz));
+}
+
+void CanvasWidget::queuePendingMove(QMouseEvent* e) {
+    qint64 now = m_inputClock.nsecsElapsed();
+    if (!m_hasPendingMove) {
+        m_hasPendingMove = true;
+        m_pendingSinceNs = now;
+        m_coalescedMoves = 0;
+    }
+    m_pendingMovePos = e->pos();
+    m_pendingModifiers = e->modifiers();
+    ++m_coalescedMoves;
+    if (m_dragActive) {
+        ++m_dragEvents;
+    }
+
+    // 距上次处理不足一帧时，等到下一帧再处理
+    if (!m_frameTimer.isActive()) {
+        int sinceLastMs = int((now - m_lastFlushNs) / 1000000);
+        m_frameTimer.start(qMax(0, frameIntervalMs() - sinceLastMs));
+    }
+}
+
+void CanvasWidget::flushPendingMove() {
+    if (!m_hasPendingMove) return;
+    TRACE_SCOPE_CAT("CanvasWidget::flushPendingMove", "input");
+
+    m_hasPendingMove = false;
+    m_frameTimer.stop();
+    m_lastFlushNs = m_inputClock.nsecsElapsed();
+    m_latencyProbeNs = m_pendingSinceNs;
+    TraceRecorder::instance().recordCounter("coalesced mouse moves", m_coalescedMoves);
+
+    QPointF pos = m_pendingMovePos;
+    QPointF delta = pos - lastMousePos;
+    lastMousePos = pos;
+    if (m_dragActive) {
+        noteInteraction();
+    }
 
     switch (currentState) {
     case InsertState:
-        handleInsertMove(e);
+        handleInsertMove(pos);
         break;
-    case SelectState:
-        handleSelectMove(e, delta);
+    case SelectState: {
+        if (m_layerArmed && delta != QPointF()) {
+            m_layerArmed = false;
+            if (selectedShape) {
+                beginLayeredDrag();
+            }
+        }
+        const QRectF before = selectionBounds();
+        handleSelectMove(pos, m_pendingModifiers, delta);
+        const QRectF after = selectionBounds();
+        if (after != before) {
+            noteContentChange(before | after);
+            m_selectionMoved = true;
+        }
         break;
+    }
     case DragState:
-        // ͼ϶߼
+        // 视图拖动逻辑
         break;
     }
-    update();
+    liveShapeChanged();
+    m_latencyProbeRevision = m_sceneRevision;
+}
+
+void CanvasWidget::beginDragStats() {
+    m_dragActive = true;
+    m_dragCpuStartUs = TraceRecorder::processCpuTimeUs();
+    m_dragWallStartNs = m_inputClock.nsecsElapsed();
+    m_dragFrames = 0;
+    m_dragEvents = 0;
+    m_dragLatencySumNs = 0;
+    m_dragLatencyMaxNs = 0;
+}
+
+void CanvasWidget::endDragStats() {
+    if (!m_dragActive) return;
+    m_dragActive = false;
+    // 汇总只写入trace（录制时），不再输出到调试日志
+    TraceRecorder& recorder = TraceRecorder::instance();
+    if (m_dragFrames == 0 || !recorder.isEnabled()) return;
+
+    qint64 wallUs = (m_inputClock.nsecsElapsed() - m_dragWallStartNs) / 1000;
+    qint64 cpuUs = TraceRecorder::processCpuTimeUs() - m_dragCpuStartUs;
+    int cpuPercent = wallUs > 0 ? int(cpuUs * 100 / wallUs) : 0;
+    recorder.recordCounter("drag CPU (%)", cpuPercent);
+    recorder.recordCounter("drag events", m_dragEvents);
+    recorder.recordCounter("drag frames", m_dragFrames);
+    recorder.recordCounter("drag avg latency (us)", m_dragLatencySumNs / m_dragFrames / 1000);
+    recorder.recordCounter("drag max latency (us)", m_dragLatencyMaxNs / 1000);
 }
 
 void CanvasWidget::mouseReleaseEvent(QMouseEvent* e) {
-    
+    TRACE_SCOPE_CAT("CanvasWidget::mouseReleaseEvent", "input");
     if ((e->button() == Qt::MiddleButton ||
         e->button() == Qt::RightButton) && m_isPanning) {
         m_isPanning = false;
@@ -387,6 +909,14 @@ void CanvasWidget::mouseReleaseEvent(QMouseEvent* e) {
         e->accept();
         return;
     }
+    // 先应用最后一次移动，避免丢失终点位置
+    flushPendingMove();
+    if (e->button() == Qt::LeftButton) {
+        endDragStats();
+        endLayeredDrag();
+        endSnapping();
+    }
+
     switch (currentState) {
     case InsertState:
         handleInsertRelease(e);
@@ -395,37 +925,38 @@ void CanvasWidget::mouseReleaseEvent(QMouseEvent* e) {
         handleSelectRelease(e);
         break;
     case DragState:
-        // ͼ϶߼
+        // 视图拖动逻辑
         break;
     }
 }
 
 void CanvasWidget::handleInsertPress(QMouseEvent* e) {
     if (e->button() == Qt::LeftButton) {
-        startDrawingShape(e->pos());  // Ϊͳһ
+        startDrawingShape(e->pos());  // 改为调用统一方法
     }
 }
 
-void CanvasWidget::handleInsertMove(QMouseEvent* e) {
+void CanvasWidget::handleInsertMove(const QPointF& pos) {
     if (isDrawing) {
-        continueDrawingShape(e->pos());  // Ϊͳһ
+        continueDrawingShape(pos);  // 改为调用统一方法
     }
 }
 
 void CanvasWidget::handleInsertRelease(QMouseEvent* e) {
     if (e->button() == Qt::LeftButton && isDrawing && currentShape) {
-        // ȷͼδﵽСЧߴ
+        // 确保图形达到最小有效尺寸
         if (currentShape->boundingRect.width() > 10 && currentShape->boundingRect.height() > 10) {
-            shapes.append(currentShape);
+            noteContentChange(currentShape->visualBounds());
+            addShape(currentShape);
             currentShape = nullptr;
             isDrawing = false;
-            update();
+            sceneChanged();
 
-            // Զлѡģʽѡ
+            // 自动切换回选择模式（可选）
             setEditorState(SelectState);
         }
         else {
-            // ɾСͼ
+            // 删除过小的图形
             delete currentShape;
             currentShape = nullptr;
             isDrawing = false;
@@ -435,117 +966,199 @@ void CanvasWidget::handleInsertRelease(QMouseEvent* e) {
 
 void CanvasWidget::handleSelectPress(QMouseEvent* e) {
     if (e->button() == Qt::LeftButton) {
-        clearSelection();
+        TRACE_SCOPE_CAT("hitTest", "input");
+        const QPointF pos = e->pos();
+        const QRectF probe(pos - QPointF(0.5, 0.5), QSizeF(1, 1));
+        startPos = pos;
+
+        // 组或多选的缩放、旋转控制点
+        if (!m_selection.isEmpty() && !(e->modifiers() & Qt::ControlModifier)) {
+            const QRectF frame = selectionFrame();
+            for (int i = 0; i < Shape::HANDLE_COUNT; ++i) {
+                const QPointF d = pos - frameHandle(frame, i);
+                if (QPointF::dotProduct(d, d) < 10 * 10) {
+                    beginSelectionTransform(frame, i);
+                    return;
+                }
+            }
+        }
 
-        // zֵӴС飨ӵ棩
-        for (int i = shapes.size() - 1; i >= 0; --i) {
-            Shape* shape = shapes[i];
+        // 取z值最大的命中（最后添加的在最上面）：未分组的图形从网格中取出附近的，
+        // 检查控制点和本身；组内图形只能整组选中，按外框层次遍历，外框不含该点的
+        // 组连同子组一次跳过
+        Shape* hit = nullptr;
+        int hitHandle = -1;
+        auto consider = [&](Shape* shape, bool handles) {
+            if (hit && !ZOrderIndex::isAbove(shape, hit)) return;
             int handleIndex;
-            if (shape->checkHandleHit(e->pos(), handleIndex)) {
-                selectedShape = shape;
-                selectedShape->setSelected(true);
-                currentHandle = handleIndex;
-                startPos = e->pos();
-                return;
+            if (handles && shape->checkHandleHit(pos, handleIndex)) {
+                hit = shape;
+                hitHandle = handleIndex;
             }
-
-            if (shape->contains(e->pos())) {
-                selectedShape = shape;
-                selectedShape->setSelected(true);
-                currentHandle = -1;
-                startPos = e->pos();
-                return;
+            else if (shape->contains(pos)) {
+                hit = shape;
+                hitHandle = -1;
             }
+        };
+        if (selectedShape && m_groups.groupOf(selectedShape)) {
+            consider(selectedShape, true); // 单独选中的组内图形（如查找定位到的）可以拉伸
+        }
+        QList<Shape*> candidates;
+        m_groups.queryLoose(probe, &candidates);
+        for (Shape* shape : candidates) {
+            consider(shape, true);
+        }
+        candidates.clear();
+        m_groups.queryGroups(probe, &candidates);
+        for (Shape* shape : candidates) {
+            consider(shape, false);
+        }
+
+        if (e->modifiers() & Qt::ControlModifier) {
+            toggleSelection(hit);
+            return;
+        }
+        // 点在已选中的组或多选上：保持选择，一起拖动
+        if (hit && m_selection.contains(hit)) {
+            currentHandle = -1;
+            return;
+        }
+
+        Shape* previous = selectedShape;
+        clearSelection();
+        if (!hit) return;
+        // 组内图形整组选中（已单独选中的组内图形除外，如查找定位到的图形）
+        ShapeGroup* root = m_groups.rootOf(hit);
+        if (root && hit != previous) {
+            GroupTree::collectShapes(root, &m_selection);
+            return;
         }
+        selectedShape = hit;
+        selectedShape->setSelected(true);
+        currentHandle = hitHandle;
     }
 }
 
 void CanvasWidget::moveShapeUp() {
     if (!selectedShape) return;
 
-    int index = shapes.indexOf(selectedShape);
-    if (index < shapes.size() - 1) {
-        shapes.move(index, index + 1);
-        updateZValues();
-        update();
+    if (m_zOrder.raise(selectedShape)) {
+        noteContentChange(selectedShape->visualBounds());
+        sceneChanged();
     }
 }
 
 void CanvasWidget::moveShapeDown() {
     if (!selectedShape) return;
 
-    int index = shapes.indexOf(selectedShape);
-    if (index > 0) {
-        shapes.move(index, index - 1);
-        updateZValues();
-        update();
+    if (m_zOrder.lower(selectedShape)) {
+        noteContentChange(selectedShape->visualBounds());
+        sceneChanged();
     }
 }
 
 void CanvasWidget::moveShapeToTop() {
+    if (!selectedShape && !m_selection.isEmpty()) {
+        m_zOrder.moveToTop(m_selection); // 保持组内的相对顺序
+        noteContentChange(selectionBounds());
+        sceneChanged();
+        return;
+    }
     if (!selectedShape) return;
 
-    int index = shapes.indexOf(selectedShape);
-    if (index < shapes.size() - 1) {
-        shapes.move(index, shapes.size() - 1);
-        updateZValues();
-        update();
+    if (m_zOrder.moveToTop(selectedShape)) {
+        noteContentChange(selectedShape->visualBounds());
+        sceneChanged();
     }
 }
 
 void CanvasWidget::moveShapeToBottom() {
+    if (!selectedShape && !m_selection.isEmpty()) {
+        m_zOrder.moveToBottom(m_selection);
+        noteContentChange(selectionBounds());
+        sceneChanged();
+        return;
+    }
     if (!selectedShape) return;
 
-    int index = shapes.indexOf(selectedShape);
-    if (index > 0) {
-        shapes.move(index, 0);
-        updateZValues();
-        update();
+    if (m_zOrder.moveToBottom(selectedShape)) {
+        noteContentChange(selectedShape->visualBounds());
+        sceneChanged();
     }
 }
 
-void CanvasWidget::updateZValues() {
-    for (int i = 0; i < shapes.size(); ++i) {
-        shapes[i]->setZValue(i);
+// 拉伸控制点移动的边
+static Qt::Edges handleEdges(int handle) {
+    switch (handle) {
+    case 0: return Qt::LeftEdge | Qt::TopEdge;
+    case 1: return Qt::RightEdge | Qt::TopEdge;
+    case 2: return Qt::RightEdge | Qt::BottomEdge;
+    case 3: return Qt::LeftEdge | Qt::BottomEdge;
+    case 4: return Qt::TopEdge;
+    case 5: return Qt::RightEdge;
+    case 6: return Qt::BottomEdge;
+    case 7: return Qt::LeftEdge;
     }
+    return Qt::Edges();
 }
 
-void CanvasWidget::handleSelectMove(QMouseEvent* e, const QPointF& delta) {
-    if (!selectedShape) return;
+// 只修改图形和分组缓存；重绘由 flushPendingMove 中的 liveShapeChanged() 负责，
+// 分层拖动时不能使静态层失效
+void CanvasWidget::handleSelectMove(const QPointF& pos, Qt::KeyboardModifiers modifiers, const QPointF& delta) {
+    m_snapGuides.clear();
+    if (!selectedShape) {
+        if (m_selection.isEmpty()) return;
+        if (!m_transformStart.isEmpty()) {
+            transformSelection(pos, modifiers);
+            return;
+        }
+        // 组和多选整体平移
+        const QTransform offset = QTransform::fromTranslate(delta.x(), delta.y());
+        for (Shape* shape : m_selection) {
+            shape->applyTransform(offset);
+            m_groups.shapeChanged(shape);
+        }
+        return;
+    }
 
     if (currentHandle == -1) {
-        // ƶ߼䣩
-        QTransform transform;
-        transform.translate(delta.x(), delta.y());
-        selectedShape->applyTransform(transform);
+        if (!snappingEnabled(modifiers)) {
+            selectedShape->applyTransform(QTransform::fromTranslate(delta.x(), delta.y()));
+        }
+        else {
+            // 按相对按下位置的总位移计算，吸附修正不会累积
+            TRACE_SCOPE_CAT("snap", "input");
+            QRectF target = m_dragStartRect.translated(pos - startPos);
+            const SnapIndex::Result snap = m_snapIndex.snapMove(target, selectedShape, snapOptions());
+            target.translate(snap.offset);
+            m_snapGuides = snap.guides;
+            const QPointF offset = target.topLeft() - SnapIndex::sceneBounds(selectedShape).topLeft();
+            selectedShape->applyTransform(QTransform::fromTranslate(offset.x(), offset.y()));
+        }
     }
     else {
         QRectF newRect = selectedShape->boundingRect;
         QPointF center = newRect.center();
 
         if (currentHandle == 8) {
-            // תƵ㣨ԭ15Ȳ߼
-            qreal newAngle = std::atan2(e->pos().y() - center.y(),
-                e->pos().x() - center.x());
-            if (e->modifiers() & Qt::ShiftModifier) {
+            // 旋转控制点（保持原15度步进逻辑）
+            qreal newAngle = std::atan2(pos.y() - center.y(),
+                pos.x() - center.x());
+            if (modifiers & Qt::ShiftModifier) {
                 const qreal step = 15.0 * M_PI / 180.0;
                 newAngle = qRound(newAngle / step) * step;
             }
             selectedShape->setRotation(newAngle);
         }
         else {
-            // === ߼ ===
-            QTransform inverseTransform;
-            inverseTransform.translate(center.x(), center.y());
-            inverseTransform.rotate(-qRadiansToDegrees(selectedShape->getRotation()));
-            inverseTransform.translate(-center.x(), -center.y());
-            QPointF localPos = inverseTransform.map(e->pos());
-
-            // ԭʼ޸ǰȡ
+            // === 修正后的拉伸逻辑 ===
+            QPointF localPos = selectedShape->inverseTransform().map(pos); // 缓存的逆变换
+
+            // 保存原始比例（在修改前获取）
             const qreal originalRatio = selectedShape->boundingRect.width() /
                 selectedShape->boundingRect.height();
 
-            // ݿƵ¾
+            // 根据控制点更新矩形
             switch (currentHandle) {
             case 0: newRect.setTopLeft(localPos); break;
             case 1: newRect.setTopRight(localPos); break;
@@ -557,9 +1170,9 @@ void CanvasWidget::handleSelectMove(QMouseEvent* e, const QPointF& delta) {
             case 7: newRect.setLeft(localPos.x()); break;
             }
 
-            // ShiftΪѡ
-            if (e->modifiers() & Qt::ShiftModifier) {
-                // ģʽ1ǵʱǿ/Բ
+            // Shift键行为选择
+            if (modifiers & Qt::ShiftModifier) {
+                // 模式1：角点控制时强制正方形/正圆
                 if (currentHandle <= 3) {
                     QPointF anchor;
                     switch (currentHandle) {
@@ -572,7 +1185,7 @@ void CanvasWidget::handleSelectMove(QMouseEvent* e, const QPointF& delta) {
                     qreal dx = localPos.x() - anchor.x();
                     qreal dy = localPos.y() - anchor.y();
 
-                    // ѡȡ򣬱ԭʼ
+                    // 选取主导方向，保持原始比例
                     if (qAbs(dx) > qAbs(dy * originalRatio)) {
                         dy = dx / originalRatio;
                     }
@@ -589,21 +1202,32 @@ void CanvasWidget::handleSelectMove(QMouseEvent* e, const QPointF& delta) {
                     case 3: newRect.setBottomLeft(adjustedPos); break;
                     }
                 }
-                // ģʽ2еʱԭʼ
+                // 模式2：边线中点控制时锁定原始比例
                 else {
-                    if (currentHandle == 4 || currentHandle == 6) { // ±
+                    if (currentHandle == 4 || currentHandle == 6) { // 上下边
                         newRect.setWidth(newRect.height() * originalRatio);
                     }
-                    else { // ұ
+                    else { // 左右边
                         newRect.setHeight(newRect.width() / originalRatio);
                     }
                 }
             }
+            // 未旋转时局部坐标即场景坐标，吸附拖动的边（保持比例时不吸附）
+            else if (snappingEnabled(modifiers) && qFuzzyIsNull(selectedShape->getRotation())) {
+                TRACE_SCOPE_CAT("snap", "input");
+                const Qt::Edges edges = handleEdges(currentHandle);
+                const SnapIndex::Result snap = m_snapIndex.snapResize(newRect, edges, selectedShape, snapOptions());
+                if (edges & Qt::LeftEdge) newRect.setLeft(newRect.left() + snap.offset.x());
+                if (edges & Qt::RightEdge) newRect.setRight(newRect.right() + snap.offset.x());
+                if (edges & Qt::TopEdge) newRect.setTop(newRect.top() + snap.offset.y());
+                if (edges & Qt::BottomEdge) newRect.setBottom(newRect.bottom() + snap.offset.y());
+                m_snapGuides = snap.guides;
+            }
 
             selectedShape->boundingRect = newRect;
         }
     }
-    update();
+    m_groups.shapeChanged(selectedShape);
 }
 
 void CanvasWidget::startDrawingShape(const QPointF& pos) {
@@ -614,15 +1238,14 @@ void CanvasWidget::startDrawingShape(const QPointF& pos) {
     case ShapeType_Rectangle:
         currentShape = new Rectangle(QRectF(pos, QSizeF(0, 0)));
         break;
-    case ShapeType_Ellipse:  // ޸
+    case ShapeType_Ellipse:  // 修改
         currentShape = new Ellipse(QRectF(pos, QSizeF(0, 0)));
         break;
     }
     if (auto mw = qobject_cast<MainWindow*>(window())) {
-        currentShape->setPen(mw->initialPen());   // MainWindowӷʷ
+        currentShape->setPen(mw->initialPen());   // 需在MainWindow添加访问方法
         currentShape->setBrush(mw->initialBrush());
     }
-    currentShape->setZValue(shapes.size()); // ͼϲ
 }
 
 void CanvasWidget::continueDrawingShape(const QPointF& pos) {
@@ -631,7 +1254,7 @@ void CanvasWidget::continueDrawingShape(const QPointF& pos) {
     qreal width = pos.x() - startPos.x();
     qreal height = pos.y() - startPos.y();
 
-    // סShiftʱԲ/
+    // 按住Shift键时保持正圆/正方形
     if (QApplication::keyboardModifiers() & Qt::ShiftModifier) {
         qreal size = qMax(qAbs(width), qAbs(height));
         width = width < 0 ? -size : size;
@@ -644,7 +1267,7 @@ void CanvasWidget::continueDrawingShape(const QPointF& pos) {
 void CanvasWidget::finishDrawingShape() {
     if (!currentShape) return;
 
-    shapes.append(currentShape);
+    addShape(currentShape); // 新图形在最上层
     currentShape = nullptr;
     isDrawing = false;
 }
@@ -653,25 +1276,34 @@ void CanvasWidget::contextMenuEvent(QContextMenuEvent* event) {
     QMenu menu(this);
 
     if (selectedShape) {
-        // Բ˵
+        // 属性菜单
         QMenu* propertiesMenu = menu.addMenu("Attribute");
         propertiesMenu->addAction("Line setting", this, &CanvasWidget::editLineProperties);
         propertiesMenu->addAction("Fill setting", this, &CanvasWidget::editFillProperties);
 
-        // ͼ˵
+        // 图层操作菜单
         QMenu* layerMenu = menu.addMenu("Layer");
         layerMenu->addAction("Bring to Front", this, &CanvasWidget::moveShapeToTop);
         layerMenu->addAction("Bring Forward", this, &CanvasWidget::moveShapeUp);
         layerMenu->addAction("Send Backward", this, &CanvasWidget::moveShapeDown);
         layerMenu->addAction("Send to Back", this, &CanvasWidget::moveShapeToBottom);
 
-        // ༭
+        // 编辑操作
         menu.addAction("Copy", this, &CanvasWidget::copyShape);
         menu.addAction("Cut", this, &CanvasWidget::cutShape);
         menu.addAction("Delete", this, &CanvasWidget::deleteShape);
     }
+    else if (!m_selection.isEmpty()) {
+        // 组或多选
+        menu.addAction("Group", this, &CanvasWidget::groupSelection);
+        menu.addAction("Ungroup", this, &CanvasWidget::ungroupSelection);
+        QMenu* layerMenu = menu.addMenu("Layer");
+        layerMenu->addAction("Bring to Front", this, &CanvasWidget::moveShapeToTop);
+        layerMenu->addAction("Send to Back", this, &CanvasWidget::moveShapeToBottom);
+        menu.addAction("Delete", this, &CanvasWidget::deleteShape);
+    }
 
-    // ճʼտ
+    // 粘贴始终可用
     QAction* pasteAction = menu.addAction("Paste", this, &CanvasWidget::pasteShape);
     pasteAction->setEnabled(m_copiedShape != nullptr);
 
@@ -684,35 +1316,35 @@ void CanvasWidget::editLineProperties() {
     QDialog dialog(this);
     QFormLayout layout(&dialog);
 
-    // ȡǰԣȷʹø
+    // 获取当前属性（确保使用副本）
     QPen currentPen = selectedShape->pen();
     QColor currentColor = currentPen.color();
 
-    // ɫѡť
+    // 颜色选择按钮
     QPushButton colorBtn("Choose Color");
     colorBtn.setStyleSheet(QString("background-color: %1;").arg(currentColor.name()));
 
-    // ߿
+    // 线宽设置
     QSpinBox widthSpin;
     widthSpin.setRange(1, 20);
     widthSpin.setValue(currentPen.width());
 
-    // 
+    // 线型设置
     QComboBox styleCombo;
     styleCombo.addItem("Solid", static_cast<int>(Qt::SolidLine));
     styleCombo.addItem("Dash", static_cast<int>(Qt::DashLine));
     styleCombo.setCurrentIndex(styleCombo.findData(static_cast<int>(currentPen.style())));
 
-    // ť飨ؼ޸뱣ΪԱֲ
+    // 按钮组（关键修复：必须保存为成员变量或局部变量）
     QDialogButtonBox btnBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
 
-    // 
+    // 布局
     layout.addRow("Color:", &colorBtn);
     layout.addRow("Width:", &widthSpin);
     layout.addRow("Style:", &styleCombo);
     layout.addRow(&btnBox);
 
-    // ɫť
+    // 颜色按钮点击
     connect(&colorBtn, &QPushButton::clicked, [&]() {
         QColor newColor = QColorDialog::getColor(currentColor, &dialog);
         if (newColor.isValid()) {
@@ -721,21 +1353,24 @@ void CanvasWidget::editLineProperties() {
         }
         });
 
-    // ؼ޸ȷӰťźţʹaccepted()źţ
+    // 关键修复：正确连接按钮信号（使用accepted()信号）
     connect(&btnBox, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
     connect(&btnBox, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
 
-    // ִжԻ
+    // 执行对话框
     if (dialog.exec() == QDialog::Accepted) {
-        // Ӧ޸
+        // 应用修改
         currentPen.setColor(currentColor);
         currentPen.setWidth(widthSpin.value());
         currentPen.setStyle(static_cast<Qt::PenStyle>(styleCombo.currentData().toInt()));
 
+        const QRectF before = selectedShape->visualBounds(); // 线宽变小时旧边框也要擦掉
         selectedShape->setPen(currentPen);
-        update(); // ǿػ
+        m_groups.shapeChanged(selectedShape); // 线宽影响组的外框
+        noteContentChange(before | selectedShape->visualBounds());
+        sceneChanged(); // 强制重绘
 
-        qDebug() << "Line properties updated:" << currentPen; // 
+        qDebug() << "Line properties updated:" << currentPen; // 调试输出
     }
 }
 
@@ -745,44 +1380,44 @@ void CanvasWidget::editFillProperties() {
     QDialog dialog(this);
     QFormLayout layout(&dialog);
 
-    // ȡǰ
+    // 获取当前属性
     QBrush currentBrush = selectedShape->brush();
     bool noFill = (currentBrush.style() == Qt::NoBrush);
     QColor currentColor = noFill ? Qt::black : currentBrush.color();
 
-    // ɫѡť
+    // 颜色选择按钮
     QPushButton colorButton("Select Color");
     if (!noFill) {
         colorButton.setStyleSheet(QString("background-color: %1").arg(currentColor.name()));
     }
     colorButton.setEnabled(!noFill);
 
-    // 临ѡ
+    // 无填充复选框
     QCheckBox noFillCheckbox("No fill");
     noFillCheckbox.setChecked(noFill);
 
-    // ͸Ȼ
+    // 透明度滑块
     QSlider alphaSlider(Qt::Horizontal);
     alphaSlider.setRange(0, 255);
     alphaSlider.setValue(noFill ? 255 : currentColor.alpha());
     alphaSlider.setEnabled(!noFill);
 
-    // ť飨ؼ޸ȷźţ
+    // 按钮组（关键修复：必须正确连接信号）
     QDialogButtonBox buttons(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
 
-    // 
+    // 布局
     layout.addRow("Color:", &colorButton);
     layout.addRow(&noFillCheckbox);
     layout.addRow("Opacity:", &alphaSlider);
     layout.addRow(&buttons);
 
-    // ѡ״̬仯
+    // 复选框状态变化
     connect(&noFillCheckbox, &QCheckBox::stateChanged, [&](int state) {
         bool enabled = (state == Qt::Unchecked);
         colorButton.setEnabled(enabled);
         alphaSlider.setEnabled(enabled);
 
-        // °ťɫʾ
+        // 更新按钮颜色显示
         if (enabled) {
             colorButton.setStyleSheet(QString("background-color: %1").arg(currentColor.name()));
         }
@@ -791,7 +1426,7 @@ void CanvasWidget::editFillProperties() {
         }
         });
 
-    // ɫť
+    // 颜色按钮点击
     connect(&colorButton, &QPushButton::clicked, [&]() {
         QColor newColor = QColorDialog::getColor(currentColor, &dialog,
             "Select Fill Color",
@@ -803,11 +1438,11 @@ void CanvasWidget::editFillProperties() {
         }
         });
 
-    // ؼ޸ȷӰťź
+    // 关键修复：正确连接按钮信号
     connect(&buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
     connect(&buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
 
-    // ִжԻ
+    // 执行对话框
     if (dialog.exec() == QDialog::Accepted) {
         QBrush newBrush;
 
@@ -820,72 +1455,88 @@ void CanvasWidget::editFillProperties() {
         }
 
         selectedShape->setBrush(newBrush);
-        update();
+        noteContentChange(selectedShape->visualBounds());
+        sceneChanged();
 
         qDebug() << "Fill properties updated:" << newBrush;
     }
 }
 
 void CanvasWidget::cutShape() {
+    if (!selectedShape) return; // 组和多选暂不支持复制
     copyShape();
     if (m_copiedShape) {
-        deleteShape(); // ɾԭͼ
+        deleteShape(); // 删除原图形
     }
 }
 
 void CanvasWidget::deleteShape() {
+    if (!selectedShape && !m_selection.isEmpty()) {
+        // 删除整组或多选
+        noteContentChange(selectionBounds());
+        const QList<Shape*> doomed = m_selection;
+        m_selection.clear();
+        for (Shape* shape : doomed) {
+            removeShape(shape);
+            delete shape;
+        }
+        sceneChanged();
+        emit selectionChanged(false);
+        return;
+    }
     if (!selectedShape) return;
 
-    // ʹָȫʹQSharedPointer
-    shapes.removeOne(selectedShape); // Qt5.4+ ֧
+    // 使用智能指针更安全（如果使用QSharedPointer）
+    noteContentChange(selectedShape->visualBounds());
+    removeShape(selectedShape);
 
-    // ȷظɾ
+    // 确保不会重复删除
     Shape* toDelete = selectedShape;
     selectedShape = nullptr;
 
     delete toDelete;
-    update();
+    sceneChanged();
 
-    emit selectionChanged(false); // ֪ͨѡ״̬仯
+    emit selectionChanged(false); // 通知选择状态变化
 }
 
 void CanvasWidget::copyShape() {
     if (!selectedShape) return;
 
-    // ͼ
+    // 清理旧图形
     if (m_copiedShape) {
         delete m_copiedShape;
         m_copiedShape = nullptr;
     }
 
-    // 
+    // 深拷贝
     m_copiedShape = selectedShape->clone();
 }
 
 void CanvasWidget::pasteShape() {
     if (!m_copiedShape) return;
 
-    // 
-    Shape* pasted = m_copiedShape->clone();
-    pasted->setZValue(shapes.size()); // ͼϲ
-    // ճλãλûĬƫƣ
+    // 创建副本，设置粘贴位置（鼠标位置或默认偏移）
+    QVector<ShapeRecord> records(1, ShapeRecord::fromShape(m_copiedShape));
     QPointF pastePos = lastMousePos.isNull() ?
         QPointF(50, 50) :
         lastMousePos - m_copiedShape->boundingRect.center();
+    records[0].rect.translate(pastePos);
 
-    pasted->moveBy(pastePos);
-    shapes.append(pasted);
+    beginBatch();
+    const QList<Shape*> pasted = addShapes(records); // 新图形在最上层，与原图形ID冲突时重新分配
 
-    // ѡճͼ
+    // 选中新粘贴的图形
     clearSelection();
-    selectedShape = pasted;
-    selectedShape->setSelected(true);
-
-    update();
+    if (!pasted.isEmpty()) {
+        selectedShape = pasted.first();
+        selectedShape->setSelected(true);
+    }
+    commitBatch();
 }
 
 void CanvasWidget::setEditorState(EditorState state) {
-    // ǰһ״̬Ĳ
+    // 清除前一个状态的残留
     if (currentState == InsertState && state != InsertState) {
         if (currentShape) {
             delete currentShape;
@@ -894,14 +1545,144 @@ void CanvasWidget::setEditorState(EditorState state) {
         isDrawing = false;
     }
 
-    currentState = state; // ״̬
-    updateCursor();       // ¹
-    update();            // ػ
+    currentState = state; // 更新状态
+    updateCursor();       // 更新光标
+    sceneChanged();            // 触发重绘
 }
 
 void CanvasWidget::setCurrentShapeType(ShapeType type) {
     currentShapeType = type;
-    setEditorState(InsertState); // Զлģʽ
+    setEditorState(InsertState); // 自动切换到插入模式
+}
+
+void CanvasWidget::registerShape(Shape* shape) {
+    // 随机64位ID，跨文件引用时也不易冲突
+    while (shape->id() == 0 || m_shapeIndex.contains(shape->id())) {
+        shape->setId(QRandomGenerator::global()->generate64());
+    }
+    m_shapeIndex.insert(shape->id(), shape);
+    m_textIndex.insert(shape);
+    m_groups.addShape(shape);
+}
+
+void CanvasWidget::addShape(Shape* shape) {
+    registerShape(shape);
+    m_zOrder.append(shape);
+    updateSnapIndex(QList<Shape*>() << shape);
+}
+
+void CanvasWidget::beginBatch() {
+    ++m_batchDepth;
+}
+
+QList<Shape*> CanvasWidget::addShapes(const QVector<ShapeRecord>& records) {
+    TRACE_SCOPE("CanvasWidget::addShapes");
+    beginBatch();
+    QList<Shape*> created;
+    created.reserve(records.size());
+    m_shapeIndex.reserve(m_shapeIndex.size() + records.size());
+    m_snapIndexDirty = true; // 批量新增，下次拖动时重建
+    QRectF dirty;
+    for (const ShapeRecord& record : records) {
+        if (Shape* shape = record.createShape()) {
+            registerShape(shape);
+            created.append(shape);
+            dirty |= shape->visualBounds();
+        }
+    }
+    if (!created.isEmpty()) {
+        noteContentChange(dirty);
+    }
+    m_zOrder.append(created); // 一次分配z键
+    sceneChanged();
+    commitBatch();
+    return created;
+}
+
+void CanvasWidget::commitBatch() {
+    if (m_batchDepth == 0) return; // 未配对的提交
+    if (--m_batchDepth > 0) return;
+    if (m_batchContentAll || !m_batchContent.isNull()) {
+        const QRectF dirty = m_batchContentAll ? QRectF() : m_batchContent;
+        m_batchContentAll = false;
+        m_batchContent = QRectF();
+        emit contentChanged(dirty);
+    }
+    if (!m_batchChanged) return;
+    m_batchChanged = false;
+    sceneChanged(); // 图层缓存、渲染快照都在下一次绘制时重建一次
+}
+
+void CanvasWidget::removeShape(Shape* shape) {
+    m_shapeIndex.remove(shape->id());
+    m_zOrder.remove(shape);
+    m_textIndex.remove(shape);
+    m_groups.removeShape(shape);
+    if (!m_snapIndexDirty) {
+        m_snapIndex.remove(shape);
+    }
+    if (!m_selection.isEmpty()) {
+        m_selection.removeOne(shape);
+        m_transformStart.clear(); // 中断正在进行的缩放或旋转
+    }
+    m_renderCopies.remove(shape);
+    m_dirtyCopies.remove(shape);
+    const int match = m_matches.indexOf(shape);
+    if (match >= 0) {
+        m_matches.remove(match);
+        if (m_currentMatch >= match) --m_currentMatch;
+        emit findResultsChanged();
+    }
+}
+
+void CanvasWidget::clearShapes() {
+    const bool hadSelection = selectedShape != nullptr || !m_selection.isEmpty();
+    selectedShape = nullptr;
+    m_selection.clear();
+    currentHandle = -1;
+    m_groups.clear();
+    qDeleteAll(m_zOrder.list());
+    m_zOrder.clear();
+    m_shapeIndex.clear();
+    m_textIndex.clear();
+    m_renderCopies.clear();
+    m_dirtyCopies.clear();
+    noteContentChange();
+    if (!m_matches.isEmpty()) {
+        m_matches.clear();
+        m_currentMatch = -1;
+        emit findResultsChanged();
+    }
+    if (hadSelection) {
+        emit selectionChanged(false);
+    }
+}
+
+bool CanvasWidget::selectShapeById(quint64 id) {
+    Shape* shape = shapeById(id);
+    if (!shape) {
+        if (selectedShape || !m_selection.isEmpty()) {
+            clearSelection();
+            emit selectionChanged(false);
+        }
+        return false;
+    }
+    if (selectedShape) {
+        selectedShape->setSelected(false);
+    }
+    m_selection.clear();
+    selectedShape = shape;
+    selectedShape->setSelected(true);
+    currentHandle = -1;
+    sceneChanged();
+    emit selectionChanged(true);
+    return true;
+}
+
+bool CanvasWidget::revealShape(quint64 id) {
+    if (!selectShapeById(id)) return false;
+    ensureVisible(selectedShape->visualBounds());
+    return true;
 }
 
 void CanvasWidget::clearSelection() {
@@ -909,14 +1690,297 @@ void CanvasWidget::clearSelection() {
         selectedShape->setSelected(false);
         selectedShape = nullptr;
     }
+    m_selection.clear();
     currentHandle = -1;
+    sceneChanged();
+}
+
+void CanvasWidget::toggleSelection(Shape* shape) {
+    if (!shape) return;
+    // 单选转为多选（单独选中的组内图形换成整组）
+    if (selectedShape) {
+        Shape* previous = selectedShape;
+        previous->setSelected(false);
+        selectedShape = nullptr;
+        if (ShapeGroup* root = m_groups.rootOf(previous)) {
+            GroupTree::collectShapes(root, &m_selection);
+        }
+        else {
+            m_selection.append(previous);
+        }
+    }
+    currentHandle = -1;
+
+    QList<Shape*> item;
+    if (ShapeGroup* root = m_groups.rootOf(shape)) {
+        GroupTree::collectShapes(root, &item);
+    }
+    else {
+        item.append(shape);
+    }
+    if (m_selection.contains(shape)) {
+        const QSet<Shape*> removed(item.begin(), item.end());
+        m_selection.erase(std::remove_if(m_selection.begin(), m_selection.end(),
+            [&removed](Shape* s) { return removed.contains(s); }), m_selection.end());
+    }
+    else {
+        m_selection.append(item);
+    }
+
+    // 只剩一个未分组的图形时回到单选（可拉伸、旋转）
+    if (m_selection.size() == 1 && !m_groups.groupOf(m_selection.first())) {
+        selectedShape = m_selection.takeFirst();
+        selectedShape->setSelected(true);
+    }
+    sceneChanged();
+    emit selectionChanged(selectedShape || !m_selection.isEmpty());
+}
+
+QVector<ShapeGroup*> CanvasWidget::selectedRoots(QVector<Shape*>* looseShapes) const {
+    QVector<ShapeGroup*> roots;
+    QSet<ShapeGroup*> seen;
+    for (Shape* shape : m_selection) {
+        ShapeGroup* root = m_groups.rootOf(shape);
+        if (!root) {
+            if (looseShapes) looseShapes->append(shape);
+        }
+        else if (!seen.contains(root)) {
+            seen.insert(root);
+            roots.append(root);
+        }
+    }
+    return roots;
+}
+
+QRectF CanvasWidget::selectionBounds() const {
+    if (selectedShape) {
+        return selectedShape->visualBounds();
+    }
+    QRectF bounds;
+    for (const Shape* shape : m_selection) {
+        bounds |= shape->visualBounds();
+    }
+    if (!m_selection.isEmpty()) {
+        // 选框的控制点
+        const QRectF frame = selectionFrame();
+        bounds |= frame.adjusted(-8, -8 - GROUP_ROTATE_OFFSET, 8, 8);
+    }
+    return bounds;
+}
+
+QRectF CanvasWidget::selectionFrame() const {
+    QRectF frame;
+    for (const Shape* shape : m_selection) {
+        frame |= SnapIndex::sceneBounds(shape);
+    }
+    return frame;
+}
+
+QPointF CanvasWidget::frameHandle(const QRectF& frame, int handle) {
+    // 与 Shape::getControlHandles 的顺序相同，第9个为旋转控制点
+    const QPointF c = frame.center();
+    switch (handle) {
+    case 0: return frame.topLeft();
+    case 1: return frame.topRight();
+    case 2: return frame.bottomRight();
+    case 3: return frame.bottomLeft();
+    case 4: return QPointF(c.x(), frame.top());
+    case 5: return QPointF(frame.right(), c.y());
+    case 6: return QPointF(c.x(), frame.bottom());
+    case 7: return QPointF(frame.left(), c.y());
+    }
+    return QPointF(c.x(), frame.top() - GROUP_ROTATE_OFFSET);
+}
+
+void CanvasWidget::beginSelectionTransform(const QRectF& frame, int handle) {
+    currentHandle = handle;
+    m_transformFrame = frame;
+    m_transformStart.clear();
+    m_transformStart.reserve(m_selection.size());
+    for (Shape* shape : m_selection) {
+        TransformStart start;
+        start.shape = shape;
+        start.rect = shape->boundingRect;
+        start.rotation = shape->getRotation();
+        m_transformStart.append(start);
+    }
+}
+
+void CanvasWidget::transformSelection(const QPointF& pos, Qt::KeyboardModifiers modifiers) {
+    const QRectF& frame = m_transformFrame;
+    const QPointF center = frame.center();
+
+    if (currentHandle == 8) {
+        // 绕选框中心旋转：各图形的中心随之旋转，自身角度加上相同的角度
+        const QPointF handle = frameHandle(frame, 8);
+        qreal angle = std::atan2(pos.y() - center.y(), pos.x() - center.x())
+            - std::atan2(handle.y() - center.y(), handle.x() - center.x());
+        if (modifiers & Qt::ShiftModifier) {
+            const qreal step = 15.0 * M_PI / 180.0;
+            angle = qRound(angle / step) * step;
+        }
+        QTransform rotation;
+        rotation.translate(center.x(), center.y());
+        rotation.rotateRadians(angle);
+        rotation.translate(-center.x(), -center.y());
+        for (const TransformStart& start : m_transformStart) {
+            QRectF rect = start.rect;
+            rect.moveCenter(rotation.map(start.rect.center()));
+            start.shape->boundingRect = rect;
+            start.shape->setRotation(start.rotation + angle);
+            m_groups.shapeChanged(start.shape);
+        }
+        return;
+    }
+
+    // 拉伸选框：按控制点移动对应的边，Shift时角点保持比例
+    QRectF target = frame;
+    const Qt::Edges edges = handleEdges(currentHandle);
+    if (edges & Qt::LeftEdge) target.setLeft(pos.x());
+    if (edges & Qt::RightEdge) target.setRight(pos.x());
+    if (edges & Qt::TopEdge) target.setTop(pos.y());
+    if (edges & Qt::BottomEdge) target.setBottom(pos.y());
+    if (target.width() < 1 || target.height() < 1 || frame.width() < 1 || frame.height() < 1) {
+        return; // 不允许翻转或压扁
+    }
+    qreal sx = target.width() / frame.width();
+    qreal sy = target.height() / frame.height();
+    if ((modifiers & Qt::ShiftModifier) && currentHandle <= 3) {
+        const qreal s = qMax(sx, sy);
+        sx = sy = s;
+        const QSizeF size(frame.width() * s, frame.height() * s);
+        // 对角固定
+        switch (currentHandle) {
+        case 0: target = QRectF(frame.bottomRight() - QPointF(size.width(), size.height()), size); break;
+        case 1: target = QRectF(QPointF(frame.left(), frame.bottom() - size.height()), size); break;
+        case 2: target = QRectF(frame.topLeft(), size); break;
+        case 3: target = QRectF(QPointF(frame.right() - size.width(), frame.top()), size); break;
+        }
+    }
+
+    for (const TransformStart& start : m_transformStart) {
+        const QPointF c = start.rect.center();
+        const QPointF newCenter(target.left() + (c.x() - frame.left()) * sx,
+            target.top() + (c.y() - frame.top()) * sy);
+        // 旋转过的图形按其局部轴方向上的缩放量改变宽高（不引入错切）
+        const qreal cosA = std::cos(start.rotation);
+        const qreal sinA = std::sin(start.rotation);
+        const qreal scaleW = std::sqrt(sx * cosA * sx * cosA + sy * sinA * sy * sinA);
+        const qreal scaleH = std::sqrt(sx * sinA * sx * sinA + sy * cosA * sy * cosA);
+        QRectF rect(QPointF(), QSizeF(start.rect.width() * scaleW, start.rect.height() * scaleH));
+        rect.moveCenter(newCenter);
+        start.shape->boundingRect = rect;
+        m_groups.shapeChanged(start.shape);
+    }
+}
+
+bool CanvasWidget::groupSelection() {
+    QVector<Shape*> shapes;
+    const QVector<ShapeGroup*> groups = selectedRoots(&shapes);
+    if (!m_groups.create(shapes, groups)) return false;
+    update(); // 各自的选框合为一个
+    return true;
+}
+
+bool CanvasWidget::ungroupSelection() {
+    const QVector<ShapeGroup*> groups = selectedRoots();
+    if (groups.isEmpty()) return false;
+    for (ShapeGroup* group : groups) {
+        m_groups.dissolve(group);
+    }
+    // 解散后若只剩一个图形，回到单选
+    if (m_selection.size() == 1 && !m_groups.groupOf(m_selection.first())) {
+        selectedShape = m_selection.takeFirst();
+        selectedShape->setSelected(true);
+        sceneChanged();
+        return true;
+    }
+    update();
+    return true;
+}
+
+void CanvasWidget::drawSelectionFrames(QPainter& painter)
+{
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    painter.setPen(QPen(QColor(0, 0, 255, 150), 1, Qt::DashLine));
+    painter.setBrush(Qt::NoBrush);
+    QVector<Shape*> looseShapes;
+    for (const ShapeGroup* group : selectedRoots(&looseShapes)) {
+        painter.drawRect(m_groups.bounds(group).adjusted(-3, -3, 3, 3));
+    }
+    for (const Shape* shape : looseShapes) {
+        painter.drawPolygon(shape->worldTransform().map(QPolygonF(shape->boundingRect.adjusted(-3, -3, 3, 3))));
+    }
+
+    // 整体缩放、旋转的控制点（样式与单个图形的相同）
+    const QRectF frame = selectionFrame();
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setPen(QPen(Qt::white, 2));
+    for (int i = 0; i < Shape::HANDLE_COUNT; ++i) {
+        painter.setBrush(i == 8 ? Qt::green : Qt::red);
+        painter.drawEllipse(frameHandle(frame, i), 6, 6);
+    }
+    painter.restore();
+}
+
+bool CanvasWidget::snappingEnabled(Qt::KeyboardModifiers modifiers) const {
+    return (m_snapToGrid || m_snapToShapes) && !(modifiers & Qt::AltModifier);
+}
+
+SnapOptions CanvasWidget::snapOptions() const {
+    SnapOptions options;
+    options.gridSize = m_snapToGrid ? SceneRenderer::GRID_SIZE : 0;
+    options.shapes = m_snapToShapes;
+    return options;
+}
+
+void CanvasWidget::beginSnapping() {
+    m_dragStartRect = SnapIndex::sceneBounds(selectedShape);
+    m_snapGuides.clear();
+    // 被拖动的图形在查询时跳过，拖动过程中不必更新；编辑后的第一次拖动才重建
+    if (m_snapToShapes && m_snapIndexDirty) {
+        m_snapIndex.rebuild(m_zOrder.list());
+        m_snapIndexDirty = false;
+    }
+}
+
+void CanvasWidget::endSnapping() {
+    if (m_snapGuides.isEmpty()) return;
+    m_snapGuides.clear();
     update();
 }
 
+void CanvasWidget::drawSnapGuides(QPainter& painter)
+{
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    painter.setPen(QPen(QColor(230, 0, 120), 0)); // 细线
+    painter.drawLines(m_snapGuides);
+    painter.restore();
+}
+
 void CanvasWidget::handleSelectRelease(QMouseEvent* e) {
-    Q_UNUSED(e);
-    // ͷźĴ߼
-    // ȷϱ任״̬
+    if (e->button() != Qt::LeftButton) return;
+    if (!m_transformStart.isEmpty()) {
+        m_transformStart.clear();
+        currentHandle = -1;
+    }
+    if (m_selectionMoved) {
+        m_selectionMoved = false;
+        updateSnapIndex(selectedShape ? QList<Shape*>() << selectedShape : m_selection);
+    }
+}
+
+void CanvasWidget::updateSnapIndex(const QList<Shape*>& shapes) {
+    if (m_snapIndexDirty) return; // 下次拖动时整体重建
+    if (shapes.size() > SNAP_UPDATE_LIMIT) {
+        m_snapIndexDirty = true;
+        return;
+    }
+    for (const Shape* shape : shapes) {
+        m_snapIndex.update(shape);
+    }
 }
 
 void CanvasWidget::updateCursor() {
@@ -934,20 +1998,22 @@ void CanvasWidget::updateCursor() {
 }
 
 void CanvasWidget::mouseDoubleClickEvent(QMouseEvent* e) {
+    TRACE_SCOPE_CAT("CanvasWidget::mouseDoubleClickEvent", "input");
     if (currentState != SelectState) return;
 
-    for (Shape* shape : shapes) {
+    for (Shape* shape : m_zOrder.list()) {
         if (shape->contains(e->pos())) {
             TextEditDialog dialog(this);
-            dialog.setText(shape->text());
+            dialog.setLabel(shape->label());
 
             if (dialog.exec() == QDialog::Accepted) {
-                shape->setText(
-                    dialog.getText(),
+                shape->setLabel(
+                    dialog.getLabel(),
                     dialog.getFont(),
                     dialog.getColor()
                 );
-                update();
+                labelChanged(shape);
+                sceneChanged();
             }
             return;
         }
@@ -958,28 +2024,36 @@ void CanvasWidget::setCanvasColor(const QColor& color)
 {
     if (m_canvasColor != color) {
         m_canvasColor = color;
-        update();  // ػ
+        noteContentChange();
+        sceneChanged();  // 触发重绘
     }
 }
 
 void CanvasWidget::wheelEvent(QWheelEvent* event)
 {
-    // Ctrl+֣
+    TRACE_SCOPE_CAT("CanvasWidget::wheelEvent", "input");
+    // Ctrl+滚轮：缩放
     if (event->modifiers() & Qt::ControlModifier) {
         qreal zoomFactor = 1.0 + (event->angleDelta().y() > 0 ? 0.1 : -0.1);
         applyZoom(zoomFactor, event->position().toPoint());
         event->accept();
     }
-    // ֱ֣ͨ
+    // 放在滚动区域中时交给滚动区域滚动
+    else if (enclosingScrollArea()) {
+        event->ignore();
+    }
+    // 普通滚轮：垂直滚动
     else if (event->angleDelta().y() != 0) {
         m_viewOffset.ry() -= event->angleDelta().y() * 0.2;
-        update();
+        noteInteraction();
+        sceneChanged();
         event->accept();
     }
-    // ˮƽ֣ĳЩ֧֣
+    // 水平滚轮（某些鼠标支持）
     else if (event->angleDelta().x() != 0) {
         m_viewOffset.rx() -= event->angleDelta().x() * 0.2;
-        update();
+        noteInteraction();
+        sceneChanged();
         event->accept();
     }
 }
@@ -988,7 +2062,7 @@ void CanvasWidget::applyZoom(qreal factor, const QPoint& mousePos)
 {
     QPointF scenePosBefore = mapToScene(mousePos);
 
-    // ŷΧ (0.1x - 10x)
+    // 限制缩放范围 (0.1x - 10x)
     qreal newScale = qBound(0.1, m_scaleFactor * factor, 10.0);
     if (qFuzzyCompare(newScale, m_scaleFactor))
         return;
@@ -998,7 +2072,8 @@ void CanvasWidget::applyZoom(qreal factor, const QPoint& mousePos)
     QPointF scenePosAfter = mapToScene(mousePos);
     m_viewOffset += scenePosAfter - scenePosBefore;
 
-    update();
+    noteInteraction();
+    sceneChanged();
 }
 
 QPointF CanvasWidget::mapToScene(const QPoint& viewPoint) const
@@ -1006,12 +2081,181 @@ QPointF CanvasWidget::mapToScene(const QPoint& viewPoint) const
     return (QPointF(viewPoint) - m_viewOffset) / m_scaleFactor;
 }
 
+QScrollArea* CanvasWidget::enclosingScrollArea() const
+{
+    for (QWidget* parent = parentWidget(); parent; parent = parent->parentWidget()) {
+        if (QScrollArea* area = qobject_cast<QScrollArea*>(parent)) {
+            return area;
+        }
+    }
+    return nullptr;
+}
+
 void CanvasWidget::ensureVisible(const QRectF& rect)
 {
-    // Զͼȷָɼ
-    QRectF visibleRect(-m_viewOffset / m_scaleFactor, size() / m_scaleFactor);
-    if (!visibleRect.contains(rect)) {
-        m_viewOffset = -rect.topLeft() * m_scaleFactor;
+    // 画布放在滚动区域中：把区域中心滚动到视口中心（靠近边缘时尽量靠中）
+    if (QScrollArea* area = enclosingScrollArea()) {
+        const QPoint center = mapTo(area->widget(), rect.center().toPoint());
+        area->ensureVisible(center.x(), center.y(),
+            area->viewport()->width() / 2, area->viewport()->height() / 2);
+        return;
+    }
+
+    // 没有滚动区域时调整视图偏移
+    const QPointF offset = QPointF(width(), height()) / 2 - rect.center() * m_scaleFactor;
+    if (offset != m_viewOffset) {
+        m_viewOffset = offset;
+        sceneChanged();
+    }
+}
+//=== 查找替换 ===//
+
+int CanvasWidget::findText(const QString& text, Qt::CaseSensitivity cs)
+{
+    if (text.isEmpty()) {
+        clearFind();
+        return 0;
+    }
+    m_findText = text;
+    m_findCase = cs;
+    m_currentMatch = -1;
+    m_matches.clear();
+    refreshMatches();
+    return m_matches.size();
+}
+
+void CanvasWidget::refreshMatches()
+{
+    if (m_findText.isEmpty()) return;
+    Shape* current = m_currentMatch >= 0 && m_currentMatch < m_matches.size() ? m_matches[m_currentMatch] : nullptr;
+
+    m_matches = m_textIndex.find(m_findText, m_findCase);
+    std::sort(m_matches.begin(), m_matches.end(), [](const Shape* a, const Shape* b) {
+        const QRectF& ra = a->boundingRect;
+        const QRectF& rb = b->boundingRect;
+        return ra.top() != rb.top() ? ra.top() < rb.top() : ra.left() < rb.left();
+    });
+    m_currentMatch = current ? m_matches.indexOf(current) : -1;
+    update(); // 高亮画在场景之上，不需要重建场景
+    emit findResultsChanged();
+}
+
+bool CanvasWidget::findNext(bool backward)
+{
+    if (m_matches.isEmpty()) return false;
+    const int count = m_matches.size();
+    if (m_currentMatch < 0) {
+        m_currentMatch = backward ? count - 1 : 0;
+    }
+    else {
+        m_currentMatch = (m_currentMatch + (backward ? count - 1 : 1)) % count;
+    }
+
+    revealShape(m_matches[m_currentMatch]->id());
+    emit findResultsChanged();
+    return true;
+}
+
+int CanvasWidget::replaceInLabel(Shape* shape, const QString& replacement)
+{
+    const QString text = shape->label().text();
+    QVector<int> positions;
+    for (int pos = TextIndex::indexIn(text, m_findText, 0, m_findCase); pos >= 0;
+        pos = TextIndex::indexIn(text, m_findText, pos + m_findText.size(), m_findCase)) {
+        positions.append(pos);
+    }
+    if (positions.isEmpty()) return 0;
+
+    // 在文档中从后往前替换，新文字沿用被替换处的格式
+    const QRectF before = shape->visualBounds();
+    QTextDocument document;
+    shape->label().toDocument(&document);
+    QTextCursor cursor(&document);
+    for (int i = positions.size() - 1; i >= 0; --i) {
+        cursor.setPosition(positions[i]);
+        cursor.setPosition(positions[i] + m_findText.size(), QTextCursor::KeepAnchor);
+        cursor.insertText(replacement);
+    }
+    shape->setLabel(RichLabel::fromDocument(&document), shape->textFont(), shape->textColor());
+    // 同 labelChanged()，匹配结果由调用者替换完后统一刷新
+    m_textIndex.insert(shape);
+    m_groups.shapeChanged(shape); // 组的外框包含标签
+    noteContentChange(before | shape->visualBounds());
+    return positions.size();
+}
+
+int CanvasWidget::replaceCurrent(const QString& replacement)
+{
+    if (m_currentMatch < 0 || m_currentMatch >= m_matches.size()) {
+        findNext();
+        return 0;
+    }
+    const int position = m_currentMatch;
+    Shape* shape = m_matches[position];
+    const QRectF before = shape->visualBounds();
+    const int replaced = replaceInLabel(shape, replacement);
+    sceneChanged(before | shape->visualBounds());
+    refreshMatches();
+
+    // 替换后不再匹配的图形已从结果中移除，下一个结果移到了原来的位置
+    if (m_currentMatch < 0) {
+        m_currentMatch = position - 1;
+    }
+    findNext();
+    return replaced;
+}
+
+int CanvasWidget::replaceAll(const QString& replacement)
+{
+    TRACE_SCOPE("CanvasWidget::replaceAll");
+    int replaced = 0;
+    beginBatch();
+    const QVector<Shape*> matches = m_matches;
+    for (Shape* shape : matches) {
+        replaced += replaceInLabel(shape, replacement);
+    }
+    refreshMatches();
+    sceneChanged();
+    commitBatch();
+    return replaced;
+}
+
+void CanvasWidget::clearFind()
+{
+    m_findText.clear();
+    m_currentMatch = -1;
+    if (!m_matches.isEmpty()) {
+        m_matches.clear();
         update();
     }
-}
\ No newline at end of file
+    emit findResultsChanged();
+}
+
+void CanvasWidget::labelChanged(Shape* shape)
+{
+    m_textIndex.insert(shape);
+    m_groups.shapeChanged(shape); // 组的外框包含标签
+    refreshMatches();
+}
+
+void CanvasWidget::drawMatches(QPainter& painter, const QRect& area)
+{
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(QColor(255, 200, 0, 80));
+    const QRectF visible(area);
+    for (Shape* shape : m_matches) {
+        if (!shape->visualBounds().intersects(visible)) continue;
+        painter.drawPolygon(shape->worldTransform().map(QPolygonF(shape->boundingRect.adjusted(-3, -3, 3, 3))));
+    }
+
+    // 当前结果加描边
+    if (m_currentMatch >= 0 && m_currentMatch < m_matches.size()) {
+        Shape* shape = m_matches[m_currentMatch];
+        painter.setPen(QPen(QColor(255, 140, 0), 2));
+        painter.setBrush(Qt::NoBrush);
+        painter.drawPolygon(shape->worldTransform().map(QPolygonF(shape->boundingRect.adjusted(-4, -4, 4, 4))));
+    }
+    painter.restore();
+}
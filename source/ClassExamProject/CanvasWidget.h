@@ -4,56 +4,134 @@
 #include <QWidget>
 #include <QImage>
 #include <QList>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+#include <QElapsedTimer>
 #include "shape.h"
+#include "SceneRenderer.h"
+#include "ZOrderIndex.h"
+#include "TextIndex.h"
+#include "SnapIndex.h"
+#include "ShapeGroup.h"
+#include "FlowDocument.h"
+#include "FlowDiff.h"
+
+class RenderThread;
+class QScrollArea;
+class ProgressiveRenderer;
 
 /**
- * ༭״̬ö
+ * 编辑器工作状态枚举
  */
 enum EditorState {
-    InsertState,    // ͼβģʽ
-    SelectState,    // ѡ/༭ģʽ
-    DragState       // ϶ģʽ
+    InsertState,    // 图形插入模式
+    SelectState,    // 选择/编辑模式
+    DragState       // 画布拖动模式
+};
+
+/**
+ * 场景渲染方式
+ */
+enum RenderMode {
+    DirectRender,   // 在paintEvent中直接绘制
+    ThreadedRender, // 后台线程绘制，paintEvent只贴图
+    ProgressiveRender // 分时渐进绘制（先粗略后精细）
+};
+
+/**
+ * 交互（平移、缩放、拖动）期间的画质降级设置
+ */
+struct InteractionQuality {
+    bool enabled = true;              // 交互时降低画质
+    int idleMs = 150;                 // 停止操作多久后重绘高质量画面
+    int minShapes = 0;                // 图形数达到该值才降级
+    bool disableAntialiasing = true;  // 关闭抗锯齿
+    bool hairlines = true;            // 边框画成细实线
+    bool placeholderText = true;      // 文字用占位色块代替
 };
 
 class CanvasWidget : public QWidget {
     Q_OBJECT
 
 public:
-    //===  ===//
+    //=== 构造与基础控制 ===//
     explicit CanvasWidget(QWidget* parent = nullptr);
 
     CanvasWidget::~CanvasWidget() {
-        // ͼб
-        qDeleteAll(shapes);
-        shapes.clear();
+        // 先停止渲染线程和渐进渲染
+        delete m_renderThread;
+        m_renderThread = nullptr;
+        delete m_progressive;
+        m_progressive = nullptr;
+
+        // 清理图形列表
+        qDeleteAll(m_zOrder.list());
+        m_zOrder.clear();
+        m_shapeIndex.clear();
 
-        // 
+        // 清理剪贴板
         if (m_copiedShape) {
             delete m_copiedShape;
             m_copiedShape = nullptr;
         }
     }
 
-    //=== ״̬ ===//
-    void setEditorState(EditorState state);      // ñ༭״̬
-    void setCurrentShapeType(ShapeType type);    // õǰͼ
+    //=== 状态控制 ===//
+    void setEditorState(EditorState state);      // 设置编辑器状态
+    void setCurrentShapeType(ShapeType type);    // 设置当前绘制图形类型
 
-    //===  ===//
-    void createNewCanvas(int width, int height); // »
-    bool saveToFile(const QString& fileName);    // 浽ļ
-    bool loadFromFile(const QString& fileName);  // ļ
-    void clearCanvas();                          // ջ
-    void setGridVisible(bool visible);           // ʾ
+    //=== 画布操作 ===//
+    void createNewCanvas(int width, int height); // 创建新画布
+    void growToFit(const QRectF& bounds);        // 画布扩大到能容纳给定区域（不超过10000）
+    bool saveToFile(const QString& fileName);    // 保存到文件
+    bool loadFromFile(const QString& fileName);  // 从文件加载
+    FlowDocument toDocument() const;             // 当前场景的文件数据
+    int applyDelta(const FlowDocument& base, const FlowDocument& document, const FlowDiff& diff); // 只更新变化的图形，返回变化数
+
+    //=== 批量构建 ===//
+    void beginBatch();                           // 开始批量修改，推迟重绘（可嵌套）
+    QList<Shape*> addShapes(const QVector<ShapeRecord>& records); // 按顺序加到最上层，返回创建的图形
+    void commitBatch();                          // 结束批量修改，统一重绘一次
+    void clearCanvas();                          // 清空画布
+    void setGridVisible(bool visible);           // 网格显示控制
     
     void setSelectedShape(Shape* shape);
     void mouseDoubleClickEvent(QMouseEvent* e);
-    QImage toImage() const;  // תΪQImage
+    QImage toImage() const;  // 新增：将画布转换为QImage
     void setCanvasColor(const QColor& color);
+    QColor canvasColor() const { return m_canvasColor; }
+    const QList<Shape*>& shapeList() const { return m_zOrder.list(); } // 按z顺序（供导出使用）
+    QList<Shape*> shapesIn(const QRectF& area) const; // 可能与区域相交的图形，按z顺序
+    Shape* shapeById(quint64 id) const { return m_shapeIndex.value(id, nullptr); }
+    quint64 selectedShapeId() const { return selectedShape ? selectedShape->id() : 0; }
+    bool selectShapeById(quint64 id);            // 按ID选中图形
+    bool revealShape(quint64 id);                // 选中并居中显示
+    void setRenderMode(RenderMode mode);         // 切换渲染方式
+    RenderMode renderMode() const { return m_renderMode; }
+    void setInteractionQuality(const InteractionQuality& quality);
+    InteractionQuality interactionQuality() const { return m_quality; }
+    void ensureVisible(const QRectF& rect);      // 滚动视图使区域居中
+    void setSnapToGrid(bool enabled) { m_snapToGrid = enabled; }
+    bool snapToGrid() const { return m_snapToGrid; }
+    void setSnapToShapes(bool enabled) { m_snapToShapes = enabled; }
+    bool snapToShapes() const { return m_snapToShapes; }
+
+    //=== 查找替换 ===//
+    int findText(const QString& text, Qt::CaseSensitivity cs = Qt::CaseInsensitive); // 高亮标签含该文字的图形，返回个数
+    bool findNext(bool backward = false);        // 选中并居中显示下一个结果
+    int replaceCurrent(const QString& replacement); // 替换当前结果中的匹配并跳到下一个，返回替换处数
+    int replaceAll(const QString& replacement);  // 替换所有结果中的匹配，返回替换处数
+    void clearFind();                            // 取消查找高亮
+    int matchCount() const { return m_matches.size(); }
+    int currentMatchIndex() const { return m_currentMatch; }
 signals:
-    void selectionChanged(bool hasSelection);    // ѡ״̬仯ź
+    void selectionChanged(bool hasSelection);    // 选择状态变化信号
+    void findResultsChanged();                   // 查找结果变化（标签被修改、图形被删除等）
+    void contentChanged(const QRectF& dirty);    // 图形内容变化的区域，空矩形表示整个场景（供小地图增量更新）
 
 protected:
-    //=== Qt¼д ===//
+    //=== Qt事件重写 ===//
     //void keyPressEvent(QKeyEvent* event) override;
     void paintEvent(QPaintEvent* event) override;
     void mousePressEvent(QMouseEvent* event) override;
@@ -68,69 +146,198 @@ private:
     bool m_isPanning = false;
     QPointF m_viewOffset;
     void applyZoom(qreal factor, const QPoint& mousePos);
-    void ensureVisible(const QRectF& rect);
     QPointF mapToScene(const QPoint& viewPoint) const;
+    QScrollArea* enclosingScrollArea() const;   // 画布所在的滚动区域，没有时返回nullptr
+
+    Shape* m_clipboard = nullptr;  // 用于存储复制/剪切的图形
+    //=== 图形数据 ===//
+    ZOrderIndex m_zOrder;            // 所有图形对象（按图层顺序）
+    QHash<quint64, Shape*> m_shapeIndex; // ID到图形的索引
+    TextIndex m_textIndex;           // 标签文字索引
+    GroupTree m_groups;              // 分组（带缓存外框的层次树）
+    QList<Shape*> m_selection;       // 多选或选中组时的所有图形（此时 selectedShape 为空，也不画控制点）
+    int m_batchDepth = 0;            // beginBatch 嵌套层数
+    bool m_batchChanged = false;     // 批量修改期间场景有变化
+    QRectF m_batchContent;           // 批量修改期间图形内容变化的区域
+    bool m_batchContentAll = false;  // 批量修改期间整个场景都变了
+    Shape* currentShape = nullptr;   // 当前正在创建的图形
+    Shape* selectedShape = nullptr;  // 当前选中的图形
+    Shape* m_copiedShape = nullptr; // 剪贴板图形
+    QPointF m_pasteOffset{ 10, 10 }; // 粘贴偏移量
 
-    Shape* m_clipboard = nullptr;  // ڴ洢/еͼ
-    //=== ͼ ===//
-    QList<Shape*> shapes;            // ͼζ
-    Shape* currentShape = nullptr;   // ǰڴͼ
-    Shape* selectedShape = nullptr;  // ǰѡеͼ
-    Shape* m_copiedShape = nullptr; // ͼ
-    QPointF m_pasteOffset{ 10, 10 }; // ճƫ
-
-    //=== ״̬ ===//
-    EditorState currentState = SelectState;      // ǰ༭״̬
-    ShapeType currentShapeType = ShapeType_Rectangle; // ǰͼ
-    bool showGrid = true;            // Ƿʾ
-    QImage canvasImage;              // ײͼ
-
-    //=== ״̬ ===//
-    QPointF startPos;                // ʼλ
-    QPointF lastMousePos;            // һλ
-    QPointF fixedCorner;             // ̶
-    bool isDrawing = false;          // Ƿڻ
-    int currentHandle = -1;          // ǰĿƵ
-    Shape::TransformState transformStartState; // 任ʼ״̬
-
-    //=== Ʒ ===//
-    void resizeCanvas(int width, int height);    // ߴ
-    void drawGrid(QPainter& painter);            // 
-    void drawShapes(QPainter& painter);          // ͼ
-    void clearSelection();                       // ǰѡ
-
-    //=== ¼ ===//
-    // ģʽ
+    //=== 绘制状态 ===//
+    EditorState currentState = SelectState;      // 当前编辑器状态
+    ShapeType currentShapeType = ShapeType_Rectangle; // 当前图形类型
+    bool showGrid = true;            // 是否显示网格
+    QImage canvasImage;              // 画布底层图像（拖动时缓存被拖动图形之下的内容）
+
+    //=== 交互状态 ===//
+    QPointF startPos;                // 鼠标起始位置
+    QPointF lastMousePos;            // 鼠标上一位置
+    QPointF fixedCorner;             // 拉伸操作固定角坐标
+    bool isDrawing = false;          // 是否正在绘制
+    int currentHandle = -1;          // 当前操作的控制点索引
+    Shape::TransformState transformStartState; // 变换开始状态
+
+    //=== 鼠标移动合并（每帧最多处理一次） ===//
+    QTimer m_frameTimer;             // 帧节拍定时器
+    QElapsedTimer m_inputClock;      // 输入延迟计时
+    bool m_hasPendingMove = false;   // 是否有未处理的移动
+    QPointF m_pendingMovePos;        // 最新的鼠标位置
+    Qt::KeyboardModifiers m_pendingModifiers;
+    qint64 m_pendingSinceNs = 0;     // 最早未处理事件的到达时间
+    qint64 m_lastFlushNs = 0;        // 上次应用移动的时间
+    qint64 m_latencyProbeNs = -1;    // 待本帧绘制完成后统计的输入时间
+    int m_coalescedMoves = 0;        // 本帧合并的事件数
+    quint64 m_latencyProbeRevision = 0; // 包含该输入的场景版本
+
+    // 拖动统计（输入到画面延迟、CPU占用）
+    bool m_dragActive = false;
+    qint64 m_dragCpuStartUs = 0;
+    qint64 m_dragWallStartNs = 0;
+    int m_dragFrames = 0;
+    int m_dragEvents = 0;
+    qint64 m_dragLatencySumNs = 0;
+    qint64 m_dragLatencyMaxNs = 0;
+
+    int frameIntervalMs() const;                 // 显示器刷新间隔
+    void queuePendingMove(QMouseEvent* e);
+    void flushPendingMove();                     // 应用最新的鼠标位置
+    void beginDragStats();
+    void endDragStats();
+
+    //=== 后台渲染 ===//
+    RenderMode m_renderMode = DirectRender;
+    RenderThread* m_renderThread = nullptr;
+    quint64 m_sceneRevision = 1;     // 每次场景变化递增
+    quint64 m_submittedRevision = 0; // 已提交给渲染线程的版本
+    quint64 m_minFrameRevision = 0;  // 可以直接贴上的最旧帧版本
+    QHash<const Shape*, QSharedPointer<Shape> > m_renderCopies; // 最近提交的渲染副本，图形未变化时直接复用
+    // 上次提交的快照内容，顺序不变时只替换变化图形的副本
+    QList<Shape*> m_submittedOrder;  // 与 z 顺序列表共享数据，未修改时 O(1) 比较
+    const Shape* m_submittedDrawing = nullptr;   // 正在绘制的图形（追加在最后）
+    QList<Shape*> m_submittedShapes;
+    QVector<QSharedPointer<Shape> > m_submittedOwners;
+    QHash<const Shape*, int> m_submittedIndex;   // 图形在快照中的下标
+    GroupSnapshot m_groupSnapshot;
+    quint64 m_groupSnapshotRevision = 0;
+    bool m_renderCopiesStale = true; // 任意图形都可能变化，下次提交时逐个比较
+    QSet<const Shape*> m_dirtyCopies;            // 否则只有这些图形变化（拖动、绘制中）
+    ProgressiveRenderer* m_progressive = nullptr;
+    quint64 m_progressRevision = 0;  // 渐进渲染对应的版本
+    void sceneChanged();                         // 标记场景变化并请求重绘
+    void invalidateScene();                      // 递增版本、使缓存的画面失效并请求重绘
+    void sceneChanged(const QRectF& dirty);      // 只重绘变化的区域
+    void noteContentChange(const QRectF& dirty = QRectF()); // 通知图形内容变化（批量修改时合并到提交）
+
+    //=== 交互画质 ===//
+    InteractionQuality m_quality;
+    bool m_interacting = false;      // 正在交互，使用低画质
+    QTimer m_idleTimer;              // 交互停止后恢复高画质
+    void noteInteraction();                      // 记录一次交互输入
+    void interactionIdle();
+    RenderOptions renderOptions() const;         // 当前帧的绘制选项
+
+    //=== 分层合成（拖动图形时） ===//
+    bool m_layerArmed = false;       // 按下了选中的图形，第一次真正移动时开始分层
+    Shape* m_layerShape = nullptr;   // 正在拖动的图形，其余图形缓存为静态层
+    bool m_layersValid = false;
+    bool m_layersPending = false;    // 分层已提交给渲染线程，尚未完成
+    quint64 m_layersRevision = 0;    // 提交分层时的场景版本
+    QImage m_aboveLayer;             // 被拖动图形之上的图形（透明背景）
+    QImage m_dragComposite;          // 松开时合成的画面，渲染线程的新帧完成前继续贴它
+    void liveShapeChanged();                     // 只有被拖动的图形变化
+    void beginLayeredDrag();
+    void endLayeredDrag();
+    void buildLayers();
+    bool paintLayers(QPainter& painter);         // 合成静态层和被拖动图形
+    void submitScene(const Shape* live = nullptr); // 创建快照并提交（给定图形时只渲染它上下的分层）
+
+    //=== 查找替换 ===//
+    QString m_findText;              // 当前查找的文字，空表示未在查找
+    Qt::CaseSensitivity m_findCase = Qt::CaseInsensitive;
+    QVector<Shape*> m_matches;       // 查找结果，按阅读顺序（从上到下、从左到右）
+    int m_currentMatch = -1;         // 当前结果的下标
+    void labelChanged(Shape* shape);             // 重新索引标签并刷新查找结果
+    void refreshMatches();                       // 重新查找（保持当前结果）
+    int replaceInLabel(Shape* shape, const QString& replacement);
+    void drawMatches(QPainter& painter, const QRect& area); // 高亮查找结果
+
+    //=== 对齐吸附 ===//
+    SnapIndex m_snapIndex;           // 其他图形的边和中线（少量变化局部更新，批量变化后按需重建）
+    bool m_snapIndexDirty = true;    // 批量变化后，索引需要在下次拖动时重建
+    bool m_selectionMoved = false;   // 本次拖动移动或变换了选中的图形，松开时更新索引
+    bool m_snapToGrid = false;
+    bool m_snapToShapes = true;
+    QRectF m_dragStartRect;          // 按下时被拖动图形的外框
+    QVector<QLineF> m_snapGuides;    // 当前的参考线
+    bool snappingEnabled(Qt::KeyboardModifiers modifiers) const; // 按住Alt时临时关闭
+    SnapOptions snapOptions() const;
+    void beginSnapping();
+    void endSnapping();
+    void updateSnapIndex(const QList<Shape*>& shapes); // 图形移动后只更新它们的边，数量多时改为重建
+    void drawSnapGuides(QPainter& painter);
+
+    //=== 绘制方法 ===//
+    void resizeCanvas(int width, int height);    // 调整画布尺寸
+    void drawGrid(QPainter& painter);            // 绘制网格
+    void drawShapes(QPainter& painter, const QRect& area = QRect()); // 绘制所有图形（给定区域时跳过区域外的图形和组）
+    void clearSelection();                       // 清除当前选择
+    void toggleSelection(Shape* shape);          // Ctrl+点击：图形（或它所在的整组）加入或移出选择
+    QVector<ShapeGroup*> selectedRoots(QVector<Shape*>* looseShapes = nullptr) const; // 选择中的顶层组和未分组图形
+    QRectF selectionBounds() const;              // 选中图形占据的区域
+    void drawSelectionFrames(QPainter& painter); // 多选和组的选框
+
+    //=== 组和多选的缩放、旋转 ===//
+    struct TransformStart {
+        Shape* shape;
+        QRectF rect;      // 按下时的外框
+        qreal rotation;   // 按下时的角度
+    };
+    static const int GROUP_ROTATE_OFFSET = 20;   // 旋转控制点到选框上边的距离
+    static const int SNAP_UPDATE_LIMIT = 64;     // 超过这么多图形同时变化时重建吸附索引
+    QRectF m_transformFrame;                     // 按下时的选框
+    QVector<TransformStart> m_transformStart;    // 非空表示正在缩放或旋转
+    QRectF selectionFrame() const;               // 选中图形的合并外框（不含边框）
+    static QPointF frameHandle(const QRectF& frame, int handle);
+    void beginSelectionTransform(const QRectF& frame, int handle);
+    void transformSelection(const QPointF& pos, Qt::KeyboardModifiers modifiers);
+
+    //=== 事件处理 ===//
+    // 插入模式
     void startDrawingShape(const QPointF& pos);
     void continueDrawingShape(const QPointF& pos);
     void finishDrawingShape();
     void handleInsertPress(QMouseEvent* e);
-    void handleInsertMove(QMouseEvent* e);
+    void handleInsertMove(const QPointF& pos);
     void handleInsertRelease(QMouseEvent* e);
 
-    // ѡģʽ
+    // 选择模式
     void handleSelectPress(QMouseEvent* e);
-    void handleSelectMove(QMouseEvent* e, const QPointF& delta);
+    void handleSelectMove(const QPointF& pos, Qt::KeyboardModifiers modifiers, const QPointF& delta);
     void handleSelectRelease(QMouseEvent* e);
-    void updateCursor();                         // ʽ
-
-    //=== ༭ ===//
-    void copyShape();    // ͼ
-    void cutShape();     // ͼ
-    void deleteShape();  // ɾͼ
-    void pasteShape();   // ճͼ
-    //ͼ
-    void updateZValues(); //Zֵ
+    void updateCursor();                         // 更新鼠标样式
 
-    QColor m_canvasColor;  // һ
+    //=== 编辑操作 ===//
+    void copyShape();    // 复制图形
+    void cutShape();     // 剪切图形
+    void deleteShape();  // 删除图形
+    void pasteShape();   // 粘贴图形
+    void addShape(Shape* shape);     // 加入图层顶端，ID缺失或重复时重新分配
+    void registerShape(Shape* shape); // 分配ID并加入ID索引
+    void removeShape(Shape* shape);  // 从索引中移除（不删除对象）
+    void clearShapes();              // 删除所有图形
+    QColor m_canvasColor;  // 添加这一行
 public slots:
-    void moveShapeUp();    // һ
-    void moveShapeDown();  // һ
-    void moveShapeToTop(); // ڶ
-    void moveShapeToBottom(); // ڵײ
+    void moveShapeUp();    // 上移一层
+    void moveShapeDown();  // 下移一层
+    void moveShapeToTop(); // 置于顶层
+    void moveShapeToBottom(); // 置于底层
+    bool groupSelection();    // 把选中的图形和组合成一组
+    bool ungroupSelection();  // 解散选中的组（只解散一层）
  
 private slots:
-    //=== Ա༭ ===//
+    //=== 属性编辑 ===//
     void editLineProperties();
     void editFillProperties();
 };
@@ -0,0 +1,252 @@
+﻿#include "FileBrowserDialog.h"
+#include "TraceRecorder.h"
+#include <QRunnable>
+#include <QListWidget>
+#include <QLabel>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QDialogButtonBox>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDir>
+#include <QHash>
+#include <QPixmap>
+#include <QPainter>
+
+namespace {
+
+// 本次运行中为旧文件生成的缩略图，文件修改后失效（只在界面线程访问）
+struct GeneratedThumbnail {
+    qint64 modified = 0;
+    int shapeCount = 0;
+    QImage image;
+};
+QHash<QString, GeneratedThumbnail> generatedThumbnails;
+
+QPixmap placeholderIcon() {
+    QPixmap pixmap(FlowDocument::THUMBNAIL_WIDTH, FlowDocument::THUMBNAIL_HEIGHT);
+    pixmap.fill(QColor(235, 235, 235));
+    return pixmap;
+}
+
+// 缩略图放在固定大小的画框中居中
+QPixmap framedIcon(const QImage& image) {
+    QPixmap pixmap = placeholderIcon();
+    QPainter painter(&pixmap);
+    const QRect target(QPoint((pixmap.width() - image.width()) / 2, (pixmap.height() - image.height()) / 2), image.size());
+    painter.drawImage(target, image);
+    painter.setPen(Qt::gray);
+    painter.drawRect(target.adjusted(0, 0, -1, -1));
+    return pixmap;
+}
+
+} // namespace
+
+//=== 后台任务 ===//
+
+class FileBrowserDialog::HeaderTask : public QRunnable {
+public:
+    HeaderTask(FileBrowserDialog* owner, int generation, int row, const QString& fileName)
+        : m_owner(owner), m_generation(generation), m_row(row), m_fileName(fileName) {}
+
+    void run() override {
+        if (m_owner->m_generation.loadAcquire() != m_generation) return;
+        TRACE_SCOPE_CAT("FileBrowserDialog::readHeader", "io");
+        FlowSummary summary;
+        const bool ok = FlowDocument::readHeader(m_fileName, &summary);
+        QImage thumbnail;
+        if (ok && !summary.thumbnail.isEmpty()) {
+            thumbnail.loadFromData(summary.thumbnail, "PNG"); // 解码也在工作线程完成
+        }
+
+        // 回到界面线程；对话框析构前会等待线程池结束
+        FileBrowserDialog* owner = m_owner;
+        const int generation = m_generation;
+        const int row = m_row;
+        QMetaObject::invokeMethod(owner, [owner, generation, row, ok, summary, thumbnail]() {
+            owner->headerRead(generation, row, ok, summary, thumbnail);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    FileBrowserDialog* m_owner;
+    int m_generation;
+    int m_row;
+    QString m_fileName;
+};
+
+class FileBrowserDialog::ThumbnailTask : public QRunnable {
+public:
+    ThumbnailTask(FileBrowserDialog* owner, int generation, int row, const QString& fileName)
+        : m_owner(owner), m_generation(generation), m_row(row), m_fileName(fileName) {}
+
+    void run() override {
+        if (m_owner->m_generation.loadAcquire() != m_generation) return;
+        TRACE_SCOPE_CAT("FileBrowserDialog::generateThumbnail", "io");
+        FlowDocument document;
+        if (!document.load(m_fileName)) return;
+        QImage thumbnail;
+        thumbnail.loadFromData(document.renderThumbnail(), "PNG");
+
+        FileBrowserDialog* owner = m_owner;
+        const int generation = m_generation;
+        const int row = m_row;
+        const int shapeCount = document.shapes.size();
+        QMetaObject::invokeMethod(owner, [owner, generation, row, shapeCount, thumbnail]() {
+            owner->thumbnailReady(generation, row, shapeCount, thumbnail);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    FileBrowserDialog* m_owner;
+    int m_generation;
+    int m_row;
+    QString m_fileName;
+};
+
+//=== 对话框 ===//
+
+FileBrowserDialog::FileBrowserDialog(QWidget* parent)
+    : QDialog(parent)
+{
+    setWindowTitle("Browse Flowcharts");
+    resize(760, 520);
+    m_thumbnailPool.setMaxThreadCount(1);
+
+    m_directoryLabel = new QLabel(this);
+    QPushButton* folderButton = new QPushButton("Choose Folder...", this);
+    m_list = new QListWidget(this);
+    m_list->setViewMode(QListView::IconMode);
+    m_list->setIconSize(QSize(FlowDocument::THUMBNAIL_WIDTH, FlowDocument::THUMBNAIL_HEIGHT));
+    m_list->setGridSize(QSize(FlowDocument::THUMBNAIL_WIDTH + 24, FlowDocument::THUMBNAIL_HEIGHT + 56));
+    m_list->setResizeMode(QListView::Adjust);
+    m_list->setMovement(QListView::Static);
+    m_list->setUniformItemSizes(true);
+    m_list->setWordWrap(true);
+    m_status = new QLabel(this);
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Open | QDialogButtonBox::Cancel, this);
+
+    QHBoxLayout* folderRow = new QHBoxLayout;
+    folderRow->addWidget(m_directoryLabel, 1);
+    folderRow->addWidget(folderButton);
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addLayout(folderRow);
+    layout->addWidget(m_list, 1);
+    layout->addWidget(m_status);
+    layout->addWidget(buttons);
+
+    connect(folderButton, &QPushButton::clicked, this, &FileBrowserDialog::chooseFolder);
+    connect(m_list, &QListWidget::itemActivated, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+}
+
+FileBrowserDialog::~FileBrowserDialog()
+{
+    cancelTasks();
+    m_headerPool.waitForDone();
+    m_thumbnailPool.waitForDone();
+}
+
+void FileBrowserDialog::cancelTasks()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_headerPool.clear();      // 尚未开始的任务直接丢弃
+    m_thumbnailPool.clear();
+}
+
+void FileBrowserDialog::chooseFolder()
+{
+    const QString directory = QFileDialog::getExistingDirectory(this, "Choose Folder", m_directory);
+    if (!directory.isEmpty()) {
+        setDirectory(directory);
+    }
+}
+
+void FileBrowserDialog::setDirectory(const QString& directory)
+{
+    cancelTasks();
+    m_directory = QDir(directory).absolutePath();
+    m_directoryLabel->setText(m_directory);
+    m_list->clear();
+
+    QDir dir(m_directory);
+    const QStringList names = dir.entryList(QStringList() << "*.flow" << "*.flow.json", QDir::Files, QDir::Name);
+    m_files.clear();
+    m_canvasSizes.fill(QSize(), names.size());
+    const QIcon placeholder(placeholderIcon());
+    for (const QString& name : names) {
+        m_files.append(dir.filePath(name));
+        QListWidgetItem* item = new QListWidgetItem(placeholder, name, m_list);
+        item->setToolTip(dir.filePath(name));
+    }
+
+    // 列表先全部显示出来，文件头读完一个补一个
+    const int generation = m_generation.loadAcquire();
+    m_pending = m_files.size();
+    for (int row = 0; row < m_files.size(); ++row) {
+        m_headerPool.start(new HeaderTask(this, generation, row, m_files[row]));
+    }
+    m_status->setText(QString("%1 files").arg(m_files.size()));
+    if (m_list->count() > 0) {
+        m_list->setCurrentRow(0);
+    }
+}
+
+QString FileBrowserDialog::selectedFile() const
+{
+    const int row = m_list->currentRow();
+    return row >= 0 && row < m_files.size() ? m_files[row] : QString();
+}
+
+void FileBrowserDialog::setItemInfo(int row, const QSize& canvasSize, int shapeCount)
+{
+    QListWidgetItem* item = m_list->item(row);
+    const QString name = QFileInfo(m_files[row]).fileName();
+    const QString shapes = shapeCount >= 0 ? QString("%1 shapes").arg(shapeCount) : QString("? shapes");
+    item->setText(QString("%1\n%2, %3x%4").arg(name, shapes).arg(canvasSize.width()).arg(canvasSize.height()));
+}
+
+void FileBrowserDialog::headerRead(int generation, int row, bool ok, const FlowSummary& summary, const QImage& thumbnail)
+{
+    if (generation != m_generation.loadAcquire()) return;
+    if (--m_pending == 0) {
+        m_status->setText(QString("%1 files").arg(m_files.size()));
+    }
+    if (!ok) {
+        m_list->item(row)->setText(QFileInfo(m_files[row]).fileName() + "\n(unreadable)");
+        return;
+    }
+    m_canvasSizes[row] = summary.canvasSize;
+    setItemInfo(row, summary.canvasSize, summary.shapeCount);
+    if (!thumbnail.isNull()) {
+        m_list->item(row)->setIcon(framedIcon(thumbnail));
+        return;
+    }
+
+    // 旧文件没有缩略图：用本次运行中生成过的，否则排队在后台生成
+    const QString& fileName = m_files[row];
+    const qint64 modified = QFileInfo(fileName).lastModified().toMSecsSinceEpoch();
+    auto cached = generatedThumbnails.constFind(fileName);
+    if (cached != generatedThumbnails.constEnd() && cached->modified == modified) {
+        setItemInfo(row, summary.canvasSize, cached->shapeCount);
+        m_list->item(row)->setIcon(framedIcon(cached->image));
+        return;
+    }
+    m_thumbnailPool.start(new ThumbnailTask(this, generation, row, fileName));
+}
+
+void FileBrowserDialog::thumbnailReady(int generation, int row, int shapeCount, const QImage& thumbnail)
+{
+    if (generation != m_generation.loadAcquire() || thumbnail.isNull()) return;
+    GeneratedThumbnail generated;
+    generated.modified = QFileInfo(m_files[row]).lastModified().toMSecsSinceEpoch();
+    generated.shapeCount = shapeCount;
+    generated.image = thumbnail;
+    generatedThumbnails.insert(m_files[row], generated);
+
+    setItemInfo(row, m_canvasSizes[row], shapeCount);
+    m_list->item(row)->setIcon(framedIcon(thumbnail));
+}
@@ -0,0 +1,56 @@
+﻿#ifndef FILEBROWSERDIALOG_H
+#define FILEBROWSERDIALOG_H
+
+#include <QDialog>
+#include <QStringList>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QImage>
+#include "FlowDocument.h"
+
+class QListWidget;
+class QLabel;
+
+/**
+ * 带预览的打开文件对话框
+ * 多个线程并行只读各文件的文件头（缩略图、图形数、画布尺寸），读完一个显示一个；
+ * 没有缩略图的旧文件在单独的后台线程中完整加载并生成缩略图（本次运行内缓存）。
+ */
+class FileBrowserDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit FileBrowserDialog(QWidget* parent = nullptr);
+    ~FileBrowserDialog();
+
+    void setDirectory(const QString& directory);
+    QString selectedFile() const;
+
+private slots:
+    void chooseFolder();
+
+private:
+    class HeaderTask;
+    class ThumbnailTask;
+    friend class HeaderTask;
+    friend class ThumbnailTask;
+
+    void headerRead(int generation, int row, bool ok, const FlowSummary& summary, const QImage& thumbnail);
+    void thumbnailReady(int generation, int row, int shapeCount, const QImage& thumbnail);
+    void setItemInfo(int row, const QSize& canvasSize, int shapeCount);
+    void cancelTasks();
+
+    QListWidget* m_list;
+    QLabel* m_directoryLabel;
+    QLabel* m_status;
+    QString m_directory;
+    QStringList m_files;
+    QVector<QSize> m_canvasSizes;  // 与 m_files 对应
+    QThreadPool m_headerPool;      // 并行读文件头
+    QThreadPool m_thumbnailPool;   // 单线程，为旧文件生成缩略图
+    QAtomicInt m_generation;       // 切换目录或关闭时递增，丢弃旧结果
+    int m_pending = 0;             // 尚未读完的文件头
+};
+
+#endif // FILEBROWSERDIALOG_H
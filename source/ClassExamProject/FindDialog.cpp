@@ -0,0 +1,114 @@
+﻿#include "FindDialog.h"
+#include "CanvasWidget.h"
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QLabel>
+#include <QPushButton>
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QElapsedTimer>
+
+FindDialog::FindDialog(CanvasWidget* canvas, QWidget* parent)
+    : QDialog(parent), m_canvas(canvas)
+{
+    setWindowTitle("Find and Replace");
+    m_findEdit = new QLineEdit(this);
+    m_replaceEdit = new QLineEdit(this);
+    m_caseBox = new QCheckBox("Match case", this);
+    m_status = new QLabel(this);
+
+    QPushButton* nextButton = new QPushButton("Find Next", this);
+    QPushButton* previousButton = new QPushButton("Find Previous", this);
+    QPushButton* replaceButton = new QPushButton("Replace", this);
+    QPushButton* replaceAllButton = new QPushButton("Replace All", this);
+    nextButton->setDefault(true);
+
+    QHBoxLayout* buttons = new QHBoxLayout;
+    buttons->addWidget(previousButton);
+    buttons->addWidget(nextButton);
+    buttons->addWidget(replaceButton);
+    buttons->addWidget(replaceAllButton);
+
+    QFormLayout* layout = new QFormLayout(this);
+    layout->addRow("Find:", m_findEdit);
+    layout->addRow("Replace with:", m_replaceEdit);
+    layout->addRow(m_caseBox);
+    layout->addRow(buttons);
+    layout->addRow(m_status);
+
+    // 输入即查找（索引查询不随图形数增长，不需要延迟）
+    connect(m_findEdit, &QLineEdit::textChanged, this, &FindDialog::search);
+    connect(m_caseBox, &QCheckBox::toggled, this, &FindDialog::search);
+    connect(nextButton, &QPushButton::clicked, this, &FindDialog::findNext);
+    connect(previousButton, &QPushButton::clicked, this, &FindDialog::findPrevious);
+    connect(replaceButton, &QPushButton::clicked, this, &FindDialog::replace);
+    connect(replaceAllButton, &QPushButton::clicked, this, &FindDialog::replaceAll);
+    connect(m_canvas, &CanvasWidget::findResultsChanged, this, &FindDialog::updateStatus);
+}
+
+void FindDialog::showFind(bool replace)
+{
+    show();
+    raise();
+    activateWindow();
+    QLineEdit* edit = replace && !m_findEdit->text().isEmpty() ? m_replaceEdit : m_findEdit;
+    edit->setFocus();
+    edit->selectAll();
+    search(); // 关闭时已取消高亮，重新打开时恢复
+}
+
+void FindDialog::search()
+{
+    QElapsedTimer timer;
+    timer.start();
+    m_canvas->findText(m_findEdit->text(), m_caseBox->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive);
+    m_lastQueryMs = timer.nsecsElapsed() / 1e6;
+    updateStatus();
+}
+
+void FindDialog::findNext()
+{
+    if (!isVisible()) {
+        showFind(false);
+    }
+    m_canvas->findNext();
+}
+
+void FindDialog::findPrevious()
+{
+    if (!isVisible()) {
+        showFind(false);
+    }
+    m_canvas->findNext(true);
+}
+
+void FindDialog::replace()
+{
+    m_canvas->replaceCurrent(m_replaceEdit->text());
+}
+
+void FindDialog::replaceAll()
+{
+    const int replaced = m_canvas->replaceAll(m_replaceEdit->text());
+    m_status->setText(QString("Replaced %1 occurrence(s)").arg(replaced));
+}
+
+void FindDialog::updateStatus()
+{
+    if (m_findEdit->text().isEmpty()) {
+        m_status->clear();
+        return;
+    }
+    const int count = m_canvas->matchCount();
+    const int current = m_canvas->currentMatchIndex();
+    QString text = count == 0 ? QString("No matches")
+        : current >= 0 ? QString("%1 of %2 shapes").arg(current + 1).arg(count)
+        : QString("%1 shapes").arg(count);
+    m_status->setText(text + QString(" (%1 ms)").arg(m_lastQueryMs, 0, 'f', 2));
+}
+
+void FindDialog::hideEvent(QHideEvent* event)
+{
+    m_canvas->clearFind();
+    QDialog::hideEvent(event);
+}
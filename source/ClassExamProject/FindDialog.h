@@ -0,0 +1,45 @@
+﻿#ifndef FINDDIALOG_H
+#define FINDDIALOG_H
+
+#include <QDialog>
+
+class CanvasWidget;
+class QLineEdit;
+class QCheckBox;
+class QLabel;
+
+/**
+ * 查找/替换对话框（非模态）
+ * 输入时即时查找并高亮，关闭时取消高亮。
+ */
+class FindDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit FindDialog(CanvasWidget* canvas, QWidget* parent = nullptr);
+    void showFind(bool replace);   // 显示并聚焦查找框，replace为true时聚焦替换框
+
+public slots:
+    void findNext();
+    void findPrevious();
+
+private slots:
+    void search();
+    void replace();
+    void replaceAll();
+    void updateStatus();
+
+protected:
+    void hideEvent(QHideEvent* event) override;
+
+private:
+    CanvasWidget* m_canvas;
+    QLineEdit* m_findEdit;
+    QLineEdit* m_replaceEdit;
+    QCheckBox* m_caseBox;
+    QLabel* m_status;
+    double m_lastQueryMs = 0;  // 最近一次查询耗时
+};
+
+#endif // FINDDIALOG_H
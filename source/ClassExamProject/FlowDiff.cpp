@@ -0,0 +1,388 @@
+﻿#include "FlowDiff.h"
+#include "shape.h"
+#include "TraceRecorder.h"
+#include <QHash>
+#include <QMultiHash>
+#include <QTextStream>
+#include <QElapsedTimer>
+
+namespace {
+
+// 配对时的几何比较取整到像素，角度取整到0.01弧度
+struct GeometryKey {
+    int x, y, w, h, angle;
+    explicit GeometryKey(const ShapeRecord& r)
+        : x(qRound(r.rect.x())), y(qRound(r.rect.y())),
+        w(qRound(r.rect.width())), h(qRound(r.rect.height())),
+        angle(qRound(r.rotation * 100)) {}
+    bool operator==(const GeometryKey& o) const {
+        return x == o.x && y == o.y && w == o.w && h == o.h && angle == o.angle;
+    }
+};
+
+enum MatchPass { ExactPass, TextPass, GeometryPass };
+
+bool hasKey(MatchPass pass, const ShapeRecord& r) {
+    return pass != TextPass || !r.label.isEmpty();
+}
+
+uint passKey(MatchPass pass, const ShapeRecord& r) {
+    uint h = qHash(r.type);
+    if (pass != TextPass) {
+        const GeometryKey g(r);
+        h = qHash(g.x, h);
+        h = qHash(g.y, h);
+        h = qHash(g.w, h);
+        h = qHash(g.h, h);
+        h = qHash(g.angle, h);
+    }
+    if (pass != GeometryPass) {
+        h = qHash(r.label.text(), h);
+    }
+    return h;
+}
+
+// 哈希相同后再核对一次，排除碰撞
+bool passEqual(MatchPass pass, const ShapeRecord& a, const ShapeRecord& b) {
+    if (a.type != b.type) return false;
+    if (pass != TextPass && !(GeometryKey(a) == GeometryKey(b))) return false;
+    if (pass != GeometryPass && a.label.text() != b.label.text()) return false;
+    return true;
+}
+
+QString typeName(qint32 type) {
+    switch (type) {
+    case ShapeType_Rectangle: return "Rectangle";
+    case ShapeType_Ellipse: return "Ellipse";
+    default: return QString("Shape(%1)").arg(type);
+    }
+}
+
+QString describe(const ShapeRecord& r) {
+    QString text = r.label.text().left(32);
+    text.replace('\n', ' ');
+    QString line = QString("%1 #%2 at (%3, %4) %5x%6")
+        .arg(typeName(r.type)).arg(r.id, 16, 16, QChar('0'))
+        .arg(r.rect.x()).arg(r.rect.y()).arg(r.rect.width()).arg(r.rect.height());
+    if (!text.isEmpty()) {
+        line += QString(" \"%1\"").arg(text);
+    }
+    return line;
+}
+
+QString changeNames(int changes) {
+    QStringList names;
+    if (changes & FlowDiff::Moved) names << "moved";
+    if (changes & FlowDiff::Restyled) names << "restyled";
+    if (changes & FlowDiff::Relabelled) names << "relabelled";
+    return names.join(", ");
+}
+
+void copyGeometry(ShapeRecord& to, const ShapeRecord& from) {
+    to.type = from.type;
+    to.rect = from.rect;
+    to.rotation = from.rotation;
+    to.rotationCenter = from.rotationCenter;
+}
+
+void copyStyle(ShapeRecord& to, const ShapeRecord& from) {
+    to.pen = from.pen;
+    to.brush = from.brush;
+    to.textFont = from.textFont;
+    to.textColor = from.textColor;
+}
+
+// 单个图形的三方合并，按几何、样式、标签三个方面分别取舍
+ShapeRecord mergeRecord(const ShapeRecord& base, const ShapeRecord& ours, const ShapeRecord& theirs,
+    QStringList* conflicts) {
+    ShapeRecord merged = ours;
+    const int oursChanges = FlowDiff::changesBetween(base, ours);
+    const int theirsChanges = FlowDiff::changesBetween(base, theirs);
+    const int bothChanges = FlowDiff::changesBetween(ours, theirs);
+
+    const FlowDiff::ChangeFlag aspects[] = { FlowDiff::Moved, FlowDiff::Restyled, FlowDiff::Relabelled };
+    for (FlowDiff::ChangeFlag aspect : aspects) {
+        if (!(theirsChanges & aspect)) continue;
+        if (!(oursChanges & aspect)) {
+            if (aspect == FlowDiff::Moved) copyGeometry(merged, theirs);
+            else if (aspect == FlowDiff::Restyled) copyStyle(merged, theirs);
+            else merged.label = theirs.label;
+        }
+        else if ((bothChanges & aspect) && conflicts) {
+            conflicts->append(QString("%1: %2 on both sides, kept ours")
+                .arg(describe(ours)).arg(changeNames(aspect)));
+        }
+    }
+    return merged;
+}
+
+} // namespace
+
+int FlowDiff::changesBetween(const ShapeRecord& from, const ShapeRecord& to) {
+    int changes = 0;
+    if (!from.sameGeometry(to)) changes |= Moved;
+    if (!from.sameStyle(to)) changes |= Restyled;
+    if (!from.sameLabel(to)) changes |= Relabelled;
+    return changes;
+}
+
+QVector<int> FlowDiff::matchShapes(const QVector<ShapeRecord>& from, const QVector<ShapeRecord>& to) {
+    TRACE_SCOPE_CAT("FlowDiff::matchShapes", "io");
+    QVector<int> fromForTo(to.size(), -1);
+    QVector<bool> fromUsed(from.size(), false);
+
+    // 1. 按持久ID配对
+    QHash<quint64, int> byId;
+    byId.reserve(from.size());
+    for (int i = 0; i < from.size(); ++i) {
+        if (from[i].id != 0 && !byId.contains(from[i].id)) {
+            byId.insert(from[i].id, i);
+        }
+    }
+    for (int j = 0; j < to.size(); ++j) {
+        const int i = to[j].id != 0 ? byId.value(to[j].id, -1) : -1;
+        if (i >= 0 && !fromUsed[i] && from[i].type == to[j].type) {
+            fromForTo[j] = i;
+            fromUsed[i] = true;
+        }
+    }
+
+    // 2. 剩余图形按内容哈希分桶配对，配上的从桶中移除
+    const MatchPass passes[] = { ExactPass, TextPass, GeometryPass };
+    for (MatchPass pass : passes) {
+        QMultiHash<uint, int> buckets;
+        for (int i = from.size() - 1; i >= 0; --i) {  // 倒序插入，同键时先取到靠前的
+            if (!fromUsed[i] && hasKey(pass, from[i])) {
+                buckets.insert(passKey(pass, from[i]), i);
+            }
+        }
+        if (buckets.isEmpty()) break;
+
+        for (int j = 0; j < to.size(); ++j) {
+            if (fromForTo[j] >= 0 || !hasKey(pass, to[j])) continue;
+            const uint key = passKey(pass, to[j]);
+            for (QMultiHash<uint, int>::iterator it = buckets.find(key); it != buckets.end() && it.key() == key; ++it) {
+                if (passEqual(pass, from[it.value()], to[j])) {
+                    fromForTo[j] = it.value();
+                    fromUsed[it.value()] = true;
+                    buckets.erase(it);
+                    break;
+                }
+            }
+        }
+    }
+    return fromForTo;
+}
+
+FlowDiff FlowDiff::compare(const FlowDocument& from, const FlowDocument& to) {
+    TRACE_SCOPE_CAT("FlowDiff::compare", "io");
+    FlowDiff diff;
+    const QVector<int> fromForTo = matchShapes(from.shapes, to.shapes);
+    QVector<bool> fromMatched(from.shapes.size(), false);
+    for (int j = 0; j < to.shapes.size(); ++j) {
+        const int i = fromForTo[j];
+        if (i < 0) {
+            diff.added.append(j);
+            continue;
+        }
+        fromMatched[i] = true;
+        Match match = { i, j, changesBetween(from.shapes[i], to.shapes[j]) };
+        diff.matched.append(match);
+    }
+    for (int i = 0; i < from.shapes.size(); ++i) {
+        if (!fromMatched[i]) diff.removed.append(i);
+    }
+    return diff;
+}
+
+int FlowDiff::count(ChangeFlag flag) const {
+    int n = 0;
+    for (const Match& match : matched) {
+        if (match.changes & flag) ++n;
+    }
+    return n;
+}
+
+bool FlowDiff::isEmpty() const {
+    if (!added.isEmpty() || !removed.isEmpty()) return false;
+    for (const Match& match : matched) {
+        if (match.changes) return false;
+    }
+    return true;
+}
+
+QString FlowDiff::summary() const {
+    return QString("%1 added, %2 removed, %3 moved, %4 restyled, %5 relabelled")
+        .arg(added.size()).arg(removed.size())
+        .arg(count(Moved)).arg(count(Restyled)).arg(count(Relabelled));
+}
+
+QString FlowDiff::report(const FlowDocument& from, const FlowDocument& to) const {
+    QString text;
+    QTextStream stream(&text);
+    if (from.canvasSize != to.canvasSize) {
+        stream << "* canvas " << from.canvasSize.width() << "x" << from.canvasSize.height()
+            << " -> " << to.canvasSize.width() << "x" << to.canvasSize.height() << "\n";
+    }
+    for (int i : removed) {
+        stream << "- " << describe(from.shapes[i]) << "\n";
+    }
+    for (int j : added) {
+        stream << "+ " << describe(to.shapes[j]) << "\n";
+    }
+    for (const Match& match : matched) {
+        if (!match.changes) continue;
+        const ShapeRecord& a = from.shapes[match.oldIndex];
+        const ShapeRecord& b = to.shapes[match.newIndex];
+        stream << "~ " << describe(a) << ": " << changeNames(match.changes);
+        if ((match.changes & Moved) && a.rect != b.rect) {
+            stream << " -> (" << b.rect.x() << ", " << b.rect.y() << ") "
+                << b.rect.width() << "x" << b.rect.height();
+        }
+        stream << "\n";
+    }
+    stream << summary() << "\n";
+    stream.flush();
+    return text;
+}
+
+bool FlowDiff::merge(const FlowDocument& base, const FlowDocument& ours, const FlowDocument& theirs,
+    FlowDocument* result, QStringList* conflicts) {
+    TRACE_SCOPE_CAT("FlowDiff::merge", "io");
+    const int conflictsBefore = conflicts ? conflicts->size() : 0;
+    QStringList localConflicts;
+    if (!conflicts) conflicts = &localConflicts;
+
+    const QVector<int> baseForOurs = matchShapes(base.shapes, ours.shapes);
+    const QVector<int> baseForTheirs = matchShapes(base.shapes, theirs.shapes);
+    QVector<int> oursForBase(base.shapes.size(), -1);
+    QVector<int> theirsForBase(base.shapes.size(), -1);
+    for (int j = 0; j < ours.shapes.size(); ++j) {
+        if (baseForOurs[j] >= 0) oursForBase[baseForOurs[j]] = j;
+    }
+    for (int t = 0; t < theirs.shapes.size(); ++t) {
+        if (baseForTheirs[t] >= 0) theirsForBase[baseForTheirs[t]] = t;
+    }
+
+    // 画布属性：只有对方改了才取对方的
+    result->canvasSize = ours.canvasSize == base.canvasSize ? theirs.canvasSize : ours.canvasSize;
+    result->showGrid = ours.showGrid == base.showGrid ? theirs.showGrid : ours.showGrid;
+    result->selectedId = ours.selectedId;
+    result->shapes.clear();
+    result->shapes.reserve(qMax(ours.shapes.size(), theirs.shapes.size()));
+
+    // 1. 以我方的图层顺序为准
+    QVector<int> resultForTheirs(theirs.shapes.size(), -1);
+    QHash<quint64, int> oursAddedIds;
+    for (int j = 0; j < ours.shapes.size(); ++j) {
+        const ShapeRecord& mine = ours.shapes[j];
+        const int b = baseForOurs[j];
+        if (b < 0) {
+            oursAddedIds.insert(mine.id, result->shapes.size());
+            result->shapes.append(mine);
+            continue;
+        }
+        const int t = theirsForBase[b];
+        if (t < 0) {
+            // 对方已删除：我方未改则删除，否则保留我方并记冲突
+            if (changesBetween(base.shapes[b], mine) == 0) continue;
+            conflicts->append(QString("%1: deleted in theirs but changed in ours, kept ours").arg(describe(mine)));
+            result->shapes.append(mine);
+            continue;
+        }
+        resultForTheirs[t] = result->shapes.size();
+        result->shapes.append(mergeRecord(base.shapes[b], mine, theirs.shapes[t], conflicts));
+    }
+
+    // 2. 对方新增的图形（以及我方删除、对方修改过的图形）插在对方顺序中前一个已有图形之后
+    QHash<int, QVector<ShapeRecord> > insertAfter;  // 结果下标（-1为最底层） -> 插入的图形
+    int anchor = -1;
+    for (int t = 0; t < theirs.shapes.size(); ++t) {
+        if (resultForTheirs[t] >= 0) {
+            anchor = resultForTheirs[t];
+            continue;
+        }
+        const ShapeRecord& other = theirs.shapes[t];
+        const int b = baseForTheirs[t];
+        if (b >= 0) {
+            // 我方已删除：对方未改则删除
+            if (changesBetween(base.shapes[b], other) == 0) continue;
+            conflicts->append(QString("%1: deleted in ours but changed in theirs, kept theirs").arg(describe(other)));
+        }
+        else if (oursAddedIds.contains(other.id)) {
+            // 两边新增了同一个ID
+            const ShapeRecord& mine = result->shapes[oursAddedIds.value(other.id)];
+            if (changesBetween(mine, other) != 0) {
+                conflicts->append(QString("%1: added on both sides with different content, kept ours").arg(describe(mine)));
+            }
+            continue;
+        }
+        insertAfter[anchor].append(other);
+    }
+
+    if (!insertAfter.isEmpty()) {
+        QVector<ShapeRecord> merged;
+        merged.reserve(result->shapes.size() + insertAfter.size());
+        merged += insertAfter.value(-1);
+        for (int i = 0; i < result->shapes.size(); ++i) {
+            merged.append(result->shapes[i]);
+            if (insertAfter.contains(i)) merged += insertAfter.value(i);
+        }
+        result->shapes.swap(merged);
+    }
+
+    // 3. 分组整体取一方：只有对方改了才取对方的，再去掉合并后已不存在的图形
+    result->groups = ours.groups == base.groups ? theirs.groups : ours.groups;
+    result->pruneGroups();
+    return conflicts->size() == conflictsBefore;
+}
+
+bool FlowDiff::isCommandLine(const QStringList& arguments) {
+    return arguments.size() > 1 && (arguments[1] == "--diff" || arguments[1] == "--merge");
+}
+
+int FlowDiff::runCommandLine(const QStringList& arguments) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    QElapsedTimer timer;
+    timer.start();
+
+    if (arguments.size() == 4 && arguments[1] == "--diff") {
+        FlowDocument from, to;
+        if (!from.load(arguments[2]) || !to.load(arguments[3])) {
+            err << "Failed to read input files\n";
+            return 2;
+        }
+        const FlowDiff diff = compare(from, to);
+        out << diff.report(from, to);
+        err << "Compared " << from.shapes.size() << " / " << to.shapes.size()
+            << " shapes in " << timer.elapsed() << " ms\n";
+        return diff.isEmpty() ? 0 : 1;
+    }
+
+    if (arguments.size() == 7 && arguments[1] == "--merge" && arguments[5] == "-o") {
+        FlowDocument base, ours, theirs;
+        if (!base.load(arguments[2]) || !ours.load(arguments[3]) || !theirs.load(arguments[4])) {
+            err << "Failed to read input files\n";
+            return 2;
+        }
+        FlowDocument result;
+        QStringList conflicts;
+        const bool clean = merge(base, ours, theirs, &result, &conflicts);
+        result.thumbnail = result.renderThumbnail();
+        if (!result.save(arguments[6])) {
+            err << "Failed to write " << arguments[6] << "\n";
+            return 2;
+        }
+        for (const QString& conflict : conflicts) {
+            out << "CONFLICT " << conflict << "\n";
+        }
+        err << "Merged " << result.shapes.size() << " shapes in " << timer.elapsed() << " ms\n";
+        return clean ? 0 : 1;
+    }
+
+    err << "Usage:\n"
+        << "  " << arguments.value(0) << " --diff <old.flow> <new.flow>\n"
+        << "  " << arguments.value(0) << " --merge <base.flow> <ours.flow> <theirs.flow> -o <out.flow>\n";
+    return 2;
+}
@@ -0,0 +1,49 @@
+﻿#ifndef FLOWDIFF_H
+#define FLOWDIFF_H
+
+#include <QVector>
+#include <QStringList>
+#include "FlowDocument.h"
+
+/**
+ * .flow 文件的结构化比较与三方合并
+ * 图形先按持久ID配对，剩余的依次按（类型+几何+文字）、（类型+文字）、
+ * （类型+几何）的哈希分桶配对，几何取整到像素，全程线性时间，不做两两比较。
+ */
+class FlowDiff {
+public:
+    enum ChangeFlag {
+        Moved = 0x1,       // 位置、大小或角度变化
+        Restyled = 0x2,    // 线条、填充、字体或文字颜色变化
+        Relabelled = 0x4   // 标签内容变化
+    };
+    struct Match {
+        int oldIndex;
+        int newIndex;
+        int changes;       // ChangeFlag 组合，0表示未变化
+    };
+
+    QVector<int> removed;  // 旧文件中的下标
+    QVector<int> added;    // 新文件中的下标
+    QVector<Match> matched;
+
+    static FlowDiff compare(const FlowDocument& from, const FlowDocument& to);
+    static QVector<int> matchShapes(const QVector<ShapeRecord>& from, const QVector<ShapeRecord>& to); // 新下标 -> 旧下标，-1为新增
+    static int changesBetween(const ShapeRecord& from, const ShapeRecord& to);
+
+    int count(ChangeFlag flag) const;
+    bool isEmpty() const;
+    QString summary() const;
+    QString report(const FlowDocument& from, const FlowDocument& to) const;  // 每个变化一行
+
+    // 三方合并：两边都改了同一方面时保留我方并记录冲突，返回是否无冲突
+    static bool merge(const FlowDocument& base, const FlowDocument& ours, const FlowDocument& theirs,
+        FlowDocument* result, QStringList* conflicts);
+
+    // 命令行入口：--diff <旧> <新>，--merge <祖先> <我方> <对方> -o <输出>
+    // 返回值 0 无差异/无冲突，1 有差异/有冲突，2 出错
+    static bool isCommandLine(const QStringList& arguments);
+    static int runCommandLine(const QStringList& arguments);
+};
+
+#endif // FLOWDIFF_H
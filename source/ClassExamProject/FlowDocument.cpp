@@ -0,0 +1,582 @@
+﻿#include "FlowDocument.h"
+#include "shape.h"
+#include "TraceRecorder.h"
+#include "FlowJson.h"
+#include <QFile>
+#include <QDataStream>
+#include <QHash>
+#include <QSet>
+#include <QDebug>
+#include <QTextDocumentFragment>
+#include "SceneRenderer.h"
+#include <QBuffer>
+#include <QImage>
+#include <QPainter>
+#include <algorithm>
+#include <numeric>
+
+ShapeRecord ShapeRecord::fromShape(const Shape* shape) {
+    ShapeRecord record;
+    record.id = shape->id();
+    record.type = qint32(shape->type);
+    record.rect = shape->boundingRect;
+    record.rotation = shape->getRotation();
+    record.rotationCenter = shape->getRotationCenter();
+    record.pen = shape->pen();
+    record.brush = shape->brush();
+    record.label = shape->label();
+    record.textFont = shape->textFont();
+    record.textColor = shape->textColor();
+    return record;
+}
+
+Shape* ShapeRecord::createShape() const {
+    Shape* shape = nullptr;
+    switch (type) {
+    case ShapeType_Rectangle:
+        shape = new Rectangle(rect);
+        break;
+    case ShapeType_Ellipse:
+        shape = new Ellipse(rect);
+        break;
+    default:
+        qWarning() << "Unknown shape type:" << type;
+        return nullptr;
+    }
+    shape->setId(id);
+    shape->setRotation(rotation);
+    shape->setRotationCenter(rotationCenter);
+    shape->setPen(pen);
+    shape->setBrush(brush);
+    shape->setLabel(label, textFont, textColor);
+    return shape;
+}
+
+void ShapeRecord::applyTo(Shape* shape) const {
+    shape->boundingRect = rect;
+    shape->setRotation(rotation);
+    shape->setRotationCenter(rotationCenter);
+    shape->setPen(pen);
+    shape->setBrush(brush);
+    // 标签不变时不重新分析，保留文字缓存
+    if (shape->label() != label || shape->textFont() != textFont || shape->textColor() != textColor) {
+        shape->setLabel(label, textFont, textColor);
+    }
+}
+
+bool ShapeRecord::sameGeometry(const ShapeRecord& other) const {
+    return type == other.type && rect == other.rect
+        && qFuzzyCompare(1 + rotation, 1 + other.rotation)
+        && rotationCenter == other.rotationCenter;
+}
+
+bool ShapeRecord::sameStyle(const ShapeRecord& other) const {
+    return pen == other.pen && brush == other.brush
+        && textFont == other.textFont && textColor == other.textColor;
+}
+
+bool FlowDocument::read(QIODevice* device) {
+    TRACE_SCOPE_CAT("FlowDocument::read", "io");
+    QDataStream in(device);
+    in.setVersion(QDataStream::Qt_5_15);
+
+    // 验证文件头
+    quint32 magic;
+    in >> magic >> version;
+    if (magic != MAGIC || version < 1 || version > VERSION) {
+        qWarning() << "Invalid file format";
+        return false;
+    }
+
+    // 读取画布尺寸
+    qint32 width, height;
+    in >> width >> height;
+    in >> showGrid;
+
+    // 简单验证尺寸合理性
+    if (width <= 0 || height <= 0 || width > 10000 || height > 10000) {
+        qWarning() << "Invalid canvas size";
+        return false;
+    }
+    canvasSize = QSize(width, height);
+
+    // 版本5：文件头中的图形数和缩略图（供文件浏览器只读文件头）
+    thumbnail.clear();
+    if (version >= 5) {
+        qint32 headerShapeCount;
+        in >> headerShapeCount >> thumbnail;
+    }
+
+    // 版本4：保存时选中的图形
+    selectedId = 0;
+    if (version >= 4) {
+        in >> selectedId;
+    }
+
+    // 版本3：标签格式表，映射到全局共享格式表
+    QVector<int> formatIndex;
+    if (version >= 3) {
+        qint32 formatCount;
+        in >> formatCount;
+        if (formatCount < 0 || in.status() != QDataStream::Ok) {
+            qWarning() << "Invalid format table";
+            return false;
+        }
+        for (int i = 0; i < formatCount; ++i) {
+            QTextFormat format;
+            in >> format;
+            formatIndex.append(RichLabel::internFormat(format.toCharFormat()));
+        }
+    }
+
+    // 版本2新增的图形数据
+    shapes.clear();
+    if (version >= 2) {
+        qint32 shapeCount;
+        in >> shapeCount;
+        if (shapeCount < 0 || in.status() != QDataStream::Ok) {
+            qWarning() << "Invalid shape count";
+            return false;
+        }
+        shapes.reserve(shapeCount);
+
+        for (int i = 0; i < shapeCount && in.status() == QDataStream::Ok; ++i) {
+            ShapeRecord record;
+            in >> record.type;
+            if (version >= 4) {
+                in >> record.id; // 旧版本文件没有ID，加入画布时分配
+            }
+
+            int zValue; // 文件按图层顺序保存，读取后不再使用
+            in >> record.rect >> record.rotation >> record.rotationCenter >> zValue;
+
+            // 线条属性
+            QColor penColor;
+            int penWidth;
+            qint32 penStyle;
+            in >> penColor >> penWidth >> penStyle;
+            record.pen = QPen(penColor, penWidth, static_cast<Qt::PenStyle>(penStyle));
+
+            // 填充属性
+            QColor brushColor;
+            qint32 brushStyle;
+            in >> brushColor >> brushStyle;
+            record.brush = QBrush(brushColor, static_cast<Qt::BrushStyle>(brushStyle));
+
+            // 文本内容（版本2为HTML，读取时转换为紧凑格式）
+            QString text;
+            in >> text;
+            if (version >= 3) {
+                qint32 runCount;
+                in >> runCount;
+                QVector<RichLabel::Run> runs;
+                for (int r = 0; r < runCount && in.status() == QDataStream::Ok; ++r) {
+                    RichLabel::Run run;
+                    in >> run.start >> run.length >> run.format;
+                    run.format = run.format >= 0 && run.format < formatIndex.size() ? formatIndex[run.format] : -1;
+                    runs.append(run);
+                }
+                record.label = RichLabel(text, runs);
+            }
+            else {
+                record.label = RichLabel::fromHtml(text);
+            }
+            in >> record.textFont >> record.textColor;
+
+            // 未知类型的图形跳过（数据已完整读出）
+            if (record.type != ShapeType_Rectangle && record.type != ShapeType_Ellipse) {
+                qWarning() << "Unknown shape type:" << record.type;
+                continue;
+            }
+            shapes.append(record);
+        }
+    }
+
+    // 版本6：分组表
+    groups.clear();
+    if (version >= 6 && in.status() == QDataStream::Ok) {
+        qint32 groupCount;
+        in >> groupCount;
+        if (groupCount < 0 || in.status() != QDataStream::Ok) {
+            qWarning() << "Invalid group count";
+            return false;
+        }
+        groups.reserve(groupCount);
+        for (int i = 0; i < groupCount && in.status() == QDataStream::Ok; ++i) {
+            GroupRecord group;
+            in >> group.id >> group.parentId >> group.shapeIds;
+            groups.append(group);
+        }
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "Error during reading";
+        return false;
+    }
+    return true;
+}
+
+bool FlowDocument::write(QIODevice* device) const {
+    TRACE_SCOPE_CAT("FlowDocument::write", "io");
+    QDataStream out(device);
+    out.setVersion(QDataStream::Qt_5_15);
+
+    // 文件头标识和版本号
+    out << quint32(MAGIC);
+    out << qint16(VERSION);    // 版本6：图形之后是分组表
+
+    // 画布基本信息
+    out << qint32(canvasSize.width()) << qint32(canvasSize.height());
+    out << showGrid;
+    out << qint32(shapes.size()) << thumbnail; // 版本5：文件头摘要
+    out << selectedId;
+
+    // 标签格式表：只写入用到的格式，按文件内顺序重新编号
+    QHash<int, int> formatIndex;
+    QVector<int> usedFormats;
+    for (const ShapeRecord& record : shapes) {
+        for (const RichLabel::Run& run : record.label.runs()) {
+            if (!formatIndex.contains(run.format)) {
+                formatIndex.insert(run.format, usedFormats.size());
+                usedFormats.append(run.format);
+            }
+        }
+    }
+    out << qint32(usedFormats.size());
+    for (int format : usedFormats) {
+        out << static_cast<const QTextFormat&>(RichLabel::format(format));
+    }
+
+    // 图形数量
+    out << qint32(shapes.size());
+
+    // 每个图形（z值写入图层序号，与旧版本文件一致）
+    qint32 zValue = 0;
+    for (const ShapeRecord& record : shapes) {
+        out << record.type;
+        out << record.id;
+
+        // 基本属性
+        out << record.rect;
+        out << record.rotation;
+        out << record.rotationCenter;
+        out << zValue++;
+
+        // 线条属性
+        out << record.pen.color();
+        out << record.pen.width();
+        out << qint32(record.pen.style());
+
+        // 填充属性
+        out << record.brush.color();
+        out << qint32(record.brush.style());
+
+        // 文本内容
+        out << record.label.text();
+        out << qint32(record.label.runs().size());
+        for (const RichLabel::Run& run : record.label.runs()) {
+            out << run.start << run.length << qint32(formatIndex.value(run.format));
+        }
+        out << record.textFont;
+        out << record.textColor;
+    }
+
+    // 分组表（版本6）
+    out << qint32(groups.size());
+    for (const GroupRecord& group : groups) {
+        out << group.id << group.parentId << group.shapeIds;
+    }
+
+    if (out.status() != QDataStream::Ok) {
+        qWarning() << "Error during writing";
+        return false;
+    }
+    return true;
+}
+
+bool FlowDocument::load(const QString& fileName) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open file for reading:" << fileName
+            << "Error:" << file.errorString();
+        return false;
+    }
+    // 以 '{' 开头的是JSON变体，否则按二进制格式读取
+    char first = 0;
+    while (file.peek(&first, 1) == 1 && QChar::isSpace(uchar(first))) {
+        file.getChar(&first);
+    }
+    return first == '{' ? readJson(&file) : read(&file);
+}
+
+bool FlowDocument::save(const QString& fileName) const {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open file for writing:" << fileName
+            << "Error:" << file.errorString();
+        return false;
+    }
+    if (!(isJsonFileName(fileName) ? writeJson(&file) : write(&file))) {
+        file.remove();
+        return false;
+    }
+    file.close();
+    return true;
+}
+
+bool FlowDocument::isJsonFileName(const QString& fileName) {
+    return fileName.endsWith(".json", Qt::CaseInsensitive);
+}
+
+bool FlowDocument::readJson(QIODevice* device) {
+    FlowJsonReader reader(device);
+    shapes.clear();
+    groups.clear();
+    thumbnail.clear();
+    version = VERSION;
+    if (!reader.readHeader(this)) {
+        return false;
+    }
+    ShapeRecord record;
+    QVector<double> zs;
+    bool ordered = true;
+    while (reader.readShape(&record)) {
+        if (!zs.isEmpty() && reader.z() < zs.last()) ordered = false;
+        zs.append(reader.z());
+        shapes.append(record);
+    }
+    if (!ordered) {
+        // "z" 与数组顺序不一致（手工编辑的文件），按 "z" 稳定排序
+        QVector<int> order(shapes.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&zs](int a, int b) { return zs[a] < zs[b]; });
+        QVector<ShapeRecord> sorted;
+        sorted.reserve(shapes.size());
+        for (int index : order) {
+            sorted.append(shapes[index]);
+        }
+        shapes = sorted;
+    }
+    return !reader.hasError();
+}
+
+bool FlowDocument::writeJson(QIODevice* device) const {
+    FlowJsonWriter writer(device);
+    if (!writer.begin(canvasSize, showGrid, selectedId, shapes.size(), thumbnail)) {
+        return false;
+    }
+    for (const ShapeRecord& record : shapes) {
+        if (!writer.writeShape(record)) {
+            return false;
+        }
+    }
+    return writer.finish(groups);
+}
+
+void FlowDocument::pruneGroups() {
+    QSet<quint64> shapeIds;
+    shapeIds.reserve(shapes.size());
+    for (const ShapeRecord& record : shapes) {
+        shapeIds.insert(record.id);
+    }
+    // 父组在前，倒序处理时子组先于父组，删掉的空子组不再计入父组
+    QHash<quint64, int> childCount;
+    QVector<bool> keep(groups.size(), false);
+    for (int i = groups.size() - 1; i >= 0; --i) {
+        GroupRecord& group = groups[i];
+        QVector<quint64> members;
+        for (quint64 id : group.shapeIds) {
+            if (shapeIds.contains(id)) members.append(id);
+        }
+        group.shapeIds = members;
+        keep[i] = !members.isEmpty() || childCount.value(group.id) > 0;
+        if (keep[i] && group.parentId != 0) {
+            ++childCount[group.parentId];
+        }
+    }
+    QVector<GroupRecord> kept;
+    for (int i = 0; i < groups.size(); ++i) {
+        if (keep[i]) kept.append(groups[i]);
+    }
+    groups = kept;
+}
+
+bool FlowDocument::scan(const QString& fileName, FlowSummary* summary) {
+    TRACE_SCOPE_CAT("FlowDocument::scan", "io");
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    *summary = FlowSummary();
+
+    char first = 0;
+    while (file.peek(&first, 1) == 1 && QChar::isSpace(uchar(first))) {
+        file.getChar(&first);
+    }
+    if (first == '{') {
+        // JSON变体逐个图形读取
+        FlowDocument header;
+        FlowJsonReader reader(&file);
+        if (!reader.readHeader(&header)) return false;
+        summary->canvasSize = header.canvasSize;
+        ShapeRecord record;
+        while (reader.readShape(&record)) {
+            ++summary->shapeCount;
+            if (!record.label.isEmpty()) {
+                summary->ids.append(record.id);
+                summary->labels.append(record.label.text());
+            }
+        }
+        return !reader.hasError();
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_15);
+    quint32 magic;
+    qint16 fileVersion;
+    in >> magic >> fileVersion;
+    if (magic != MAGIC || fileVersion < 1 || fileVersion > VERSION) {
+        return false;
+    }
+    qint32 width, height;
+    bool grid;
+    in >> width >> height >> grid;
+    summary->canvasSize = QSize(width, height);
+    if (fileVersion >= 5) {
+        qint32 headerShapeCount;
+        in >> headerShapeCount >> summary->thumbnail;
+    }
+    if (fileVersion >= 4) {
+        quint64 selected;
+        in >> selected;
+    }
+    if (fileVersion >= 3) {
+        // 格式表长度不定，只能逐个读出后丢弃（不加入全局格式表）
+        qint32 formatCount;
+        in >> formatCount;
+        QTextFormat format;
+        for (int i = 0; i < formatCount && in.status() == QDataStream::Ok; ++i) {
+            in >> format;
+        }
+    }
+    if (fileVersion < 2) {
+        return in.status() == QDataStream::Ok;
+    }
+
+    // 定长字段：矩形(4个double) 角度 旋转中心(2个double) z序号 线条颜色 线宽 线型 填充颜色 填充样式
+    // QColor 序列化为 1字节规格 + 5个quint16
+    const int COLOR_BYTES = 1 + 5 * 2;
+    const int FIXED_BYTES = 4 * 8 + 8 + 2 * 8 + 4 + COLOR_BYTES + 4 + 4 + COLOR_BYTES + 4;
+    qint32 shapeCount;
+    in >> shapeCount;
+    QFont font; // 字体序列化长度不定，读到同一个临时对象中
+    for (int i = 0; i < shapeCount && in.status() == QDataStream::Ok; ++i) {
+        qint32 type;
+        quint64 id = 0;
+        in >> type;
+        if (fileVersion >= 4) {
+            in >> id;
+        }
+        in.skipRawData(FIXED_BYTES);
+        QString text;
+        in >> text;
+        if (fileVersion >= 3) {
+            qint32 runCount;
+            in >> runCount;
+            if (runCount < 0) return false;
+            in.skipRawData(runCount * 3 * 4);
+        }
+        else {
+            text = QTextDocumentFragment::fromHtml(text).toPlainText();
+        }
+        in >> font;
+        in.skipRawData(COLOR_BYTES);
+
+        ++summary->shapeCount;
+        if (!text.isEmpty()) {
+            summary->ids.append(id);
+            summary->labels.append(text);
+        }
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+bool FlowDocument::readHeader(const QString& fileName, FlowSummary* summary) {
+    TRACE_SCOPE_CAT("FlowDocument::readHeader", "io");
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    *summary = FlowSummary();
+    summary->shapeCount = -1;
+
+    char first = 0;
+    while (file.peek(&first, 1) == 1 && QChar::isSpace(uchar(first))) {
+        file.getChar(&first);
+    }
+    if (first == '{') {
+        // JSON变体的摘要写在 "shapes" 数组之前
+        FlowDocument header;
+        FlowJsonReader reader(&file);
+        if (!reader.readHeader(&header)) return false;
+        summary->canvasSize = header.canvasSize;
+        summary->shapeCount = reader.shapeCount();
+        summary->thumbnail = header.thumbnail;
+        return true;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_15);
+    quint32 magic;
+    qint16 fileVersion;
+    qint32 width, height;
+    bool grid;
+    in >> magic >> fileVersion;
+    if (magic != MAGIC || fileVersion < 1 || fileVersion > VERSION) {
+        return false;
+    }
+    in >> width >> height >> grid;
+    summary->canvasSize = QSize(width, height);
+    if (fileVersion >= 5) {
+        qint32 shapeCount;
+        in >> shapeCount >> summary->thumbnail;
+        summary->shapeCount = shapeCount;
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+QByteArray FlowDocument::renderThumbnail(const QList<Shape*>& shapes, const QSize& canvasSize,
+    const QColor& background) {
+    TRACE_SCOPE("FlowDocument::renderThumbnail");
+    if (canvasSize.isEmpty()) return QByteArray();
+    const QSize size = canvasSize.scaled(THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT, Qt::KeepAspectRatio).expandedTo(QSize(1, 1));
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(background);
+    {
+        QPainter painter(&image);
+        painter.scale(qreal(size.width()) / canvasSize.width(), qreal(size.height()) / canvasSize.height());
+        // 缩小后文字不可读，用占位色块代替
+        RenderOptions options;
+        options.placeholderText = true;
+        options.controlHandles = false;
+        SceneRenderer::drawShapesBatched(painter, shapes, options);
+    }
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+    return png;
+}
+
+QByteArray FlowDocument::renderThumbnail() const {
+    QList<Shape*> created;
+    created.reserve(shapes.size());
+    for (const ShapeRecord& record : shapes) {
+        if (Shape* shape = record.createShape()) {
+            created.append(shape);
+        }
+    }
+    const QByteArray png = renderThumbnail(created, canvasSize);
+    qDeleteAll(created);
+    return png;
+}
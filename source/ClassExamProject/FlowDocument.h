@@ -0,0 +1,106 @@
+﻿#ifndef FLOWDOCUMENT_H
+#define FLOWDOCUMENT_H
+
+#include <QVector>
+#include <QRectF>
+#include <QSize>
+#include <QPen>
+#include <QBrush>
+#include <QFont>
+#include <QColor>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include "RichLabel.h"
+
+class Shape;
+class QIODevice;
+
+/**
+ * 单个图形在文件中的数据（不依赖画布，可在任意线程读写）
+ */
+struct ShapeRecord {
+    quint64 id = 0;
+    qint32 type = 0;
+    QRectF rect;
+    qreal rotation = 0;
+    QPointF rotationCenter;
+    QPen pen;
+    QBrush brush;
+    RichLabel label;
+    QFont textFont;
+    QColor textColor;
+
+    static ShapeRecord fromShape(const Shape* shape);
+    Shape* createShape() const;            // 未知类型返回nullptr
+    void applyTo(Shape* shape) const;      // 更新已有图形（不改类型和ID）
+
+    bool sameGeometry(const ShapeRecord& other) const;
+    bool sameStyle(const ShapeRecord& other) const;
+    bool sameLabel(const ShapeRecord& other) const { return label == other.label; }
+};
+
+/**
+ * 图形分组在文件中的数据（版本6起）
+ */
+struct GroupRecord {
+    quint64 id = 0;
+    quint64 parentId = 0;        // 0 表示顶层组
+    QVector<quint64> shapeIds;   // 直接成员图形的ID
+
+    bool operator==(const GroupRecord& other) const {
+        return id == other.id && parentId == other.parentId && shapeIds == other.shapeIds;
+    }
+};
+
+/**
+ * .flow 文件的摘要（只含检索用的信息）
+ */
+struct FlowSummary {
+    QSize canvasSize;
+    int shapeCount = 0;
+    QVector<quint64> ids;      // 有标签的图形的ID（旧版本文件为0）
+    QStringList labels;        // 与ids一一对应的标签纯文本
+    QByteArray thumbnail;      // 文件头中的缩略图（PNG，版本5起，旧文件为空）
+};
+
+/**
+ * .flow 文件内容：画布信息 + 按z顺序排列的图形
+ * 读写与画布分离，供加载/保存、比较合并和后台解析共用。
+ */
+class FlowDocument {
+public:
+    enum { MAGIC = 0x464C4F57, VERSION = 6 };  // "FLOW"，当前写入的版本
+    enum { THUMBNAIL_WIDTH = 160, THUMBNAIL_HEIGHT = 120 };
+
+    QSize canvasSize;
+    bool showGrid = true;
+    quint64 selectedId = 0;        // 保存时选中的图形（版本4起）
+    QByteArray thumbnail;          // 预览图PNG，写在文件头中（版本5起，可为空）
+    QVector<ShapeRecord> shapes;   // 按z从小到大
+    QVector<GroupRecord> groups;   // 分组，父组在子组之前（版本6起）
+    qint16 version = VERSION;      // 读取到的文件版本
+
+    bool read(QIODevice* device);
+    bool write(QIODevice* device) const;
+    bool readJson(QIODevice* device);        // JSON变体，见 FlowJson.h
+    bool writeJson(QIODevice* device) const;
+    bool load(const QString& fileName);      // 自动识别二进制/JSON
+    bool save(const QString& fileName) const; // 文件名以 .json 结尾时写JSON
+
+    static bool isJsonFileName(const QString& fileName);
+    void pruneGroups();                      // 去掉已不存在的图形和因此变空的组
+
+    // 只读文件头：画布尺寸、图形数和缩略图，不读图形（版本5以前的文件图形数为-1、无缩略图）
+    static bool readHeader(const QString& fileName, FlowSummary* summary);
+
+    // 缩略图：按比例缩小到 THUMBNAIL_WIDTH×THUMBNAIL_HEIGHT 以内，返回PNG数据（可在任意线程调用）
+    static QByteArray renderThumbnail(const QList<Shape*>& shapes, const QSize& canvasSize,
+        const QColor& background = Qt::white);
+    QByteArray renderThumbnail() const;    // 由图形记录临时创建图形绘制
+
+    // 只读快速扫描：只取画布尺寸、图形ID和标签文字，几何、颜色和格式直接跳过（可在任意线程调用）
+    static bool scan(const QString& fileName, FlowSummary* summary);
+};
+
+#endif // FLOWDOCUMENT_H
@@ -0,0 +1,379 @@
+﻿#include "FlowJson.h"
+#include "JsonStreamReader.h"
+#include "shape.h"
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QDebug>
+
+namespace {
+
+const char* const PEN_STYLES[] = { "none", "solid", "dash", "dot", "dashdot", "dashdotdot" };
+const char* const BRUSH_STYLES[] = { "none", "solid" };
+
+QString typeName(qint32 type) {
+    switch (type) {
+    case ShapeType_Rectangle: return "rectangle";
+    case ShapeType_Ellipse: return "ellipse";
+    default: return QString::number(type);
+    }
+}
+
+qint32 typeFromJson(const QJsonValue& value) {
+    const QString name = value.toString();
+    if (name == "rectangle") return ShapeType_Rectangle;
+    if (name == "ellipse") return ShapeType_Ellipse;
+    return value.isDouble() ? value.toInt() : name.toInt();
+}
+
+// 样式：常用的写名字，其余写数字；读取时两种都接受
+template <int N>
+QJsonValue styleToJson(int style, const char* const (&names)[N]) {
+    return style >= 0 && style < N ? QJsonValue(QString(names[style])) : QJsonValue(style);
+}
+
+template <int N>
+int styleFromJson(const QJsonValue& value, const char* const (&names)[N], int fallback) {
+    if (value.isDouble()) return value.toInt();
+    const QString name = value.toString();
+    for (int i = 0; i < N; ++i) {
+        if (name == names[i]) return i;
+    }
+    return fallback;
+}
+
+QString colorToJson(const QColor& color) {
+    return color.name(QColor::HexArgb);
+}
+
+QColor colorFromJson(const QJsonValue& value, const QColor& fallback) {
+    const QColor color(value.toString());
+    return color.isValid() ? color : fallback;
+}
+
+QJsonArray pointToJson(const QPointF& point) {
+    return QJsonArray{ point.x(), point.y() };
+}
+
+// 字体：常用属性总是写出，其余只在不是默认值时写出
+QJsonObject fontToJson(const QFont& font) {
+    QJsonObject object;
+    object.insert("family", font.family());
+    if (!font.styleName().isEmpty()) object.insert("styleName", font.styleName());
+    if (font.pointSizeF() > 0) object.insert("size", font.pointSizeF());
+    else object.insert("pixelSize", font.pixelSize());
+    object.insert("weight", font.weight());
+    object.insert("italic", font.italic());
+    if (font.style() == QFont::StyleOblique) object.insert("oblique", true);
+    object.insert("underline", font.underline());
+    object.insert("strikeOut", font.strikeOut());
+    if (font.overline()) object.insert("overline", true);
+    if (font.fixedPitch()) object.insert("fixedPitch", true);
+    if (!font.kerning()) object.insert("kerning", false);
+    if (font.stretch() != QFont::AnyStretch) object.insert("stretch", font.stretch());
+    if (font.capitalization() != QFont::MixedCase) object.insert("capitalization", int(font.capitalization()));
+    if (font.resolve() & QFont::LetterSpacingResolved) { // 未设置时取值不可靠（可能为0%）
+        object.insert("letterSpacing", font.letterSpacing());
+        object.insert("letterSpacingType", font.letterSpacingType() == QFont::PercentageSpacing ? "percent" : "absolute");
+    }
+    if (font.wordSpacing() != 0) object.insert("wordSpacing", font.wordSpacing());
+    if (font.styleHint() != QFont::AnyStyle) object.insert("styleHint", int(font.styleHint()));
+    return object;
+}
+
+QFont fontFromJson(const QJsonObject& object) {
+    QFont font(object.value("family").toString("Arial"));
+    if (object.contains("styleName")) font.setStyleName(object.value("styleName").toString());
+    if (object.contains("pixelSize")) font.setPixelSize(object.value("pixelSize").toInt(12));
+    else font.setPointSizeF(object.value("size").toDouble(12));
+    font.setWeight(object.value("weight").toInt(QFont::Normal));
+    font.setItalic(object.value("italic").toBool());
+    if (object.value("oblique").toBool()) font.setStyle(QFont::StyleOblique);
+    font.setUnderline(object.value("underline").toBool());
+    font.setStrikeOut(object.value("strikeOut").toBool());
+    font.setOverline(object.value("overline").toBool());
+    font.setFixedPitch(object.value("fixedPitch").toBool());
+    font.setKerning(object.value("kerning").toBool(true));
+    if (object.contains("stretch")) font.setStretch(object.value("stretch").toInt());
+    if (object.contains("capitalization")) {
+        font.setCapitalization(static_cast<QFont::Capitalization>(object.value("capitalization").toInt()));
+    }
+    if (object.contains("letterSpacing")) {
+        const bool percent = object.value("letterSpacingType").toString("percent") == "percent";
+        font.setLetterSpacing(percent ? QFont::PercentageSpacing : QFont::AbsoluteSpacing,
+            object.value("letterSpacing").toDouble(percent ? 100 : 0));
+    }
+    if (object.contains("wordSpacing")) font.setWordSpacing(object.value("wordSpacing").toDouble());
+    if (object.contains("styleHint")) font.setStyleHint(static_cast<QFont::StyleHint>(object.value("styleHint").toInt()));
+    return font;
+}
+
+// 区段格式只写标签编辑器会设置的字符属性
+QJsonObject formatToJson(const QTextCharFormat& format) {
+    QJsonObject object;
+    if (format.hasProperty(QTextFormat::FontFamily)) object.insert("family", format.fontFamily());
+    if (format.hasProperty(QTextFormat::FontPointSize)) object.insert("size", format.fontPointSize());
+    if (format.hasProperty(QTextFormat::FontWeight)) object.insert("weight", format.fontWeight());
+    if (format.hasProperty(QTextFormat::FontItalic)) object.insert("italic", format.fontItalic());
+    if (format.hasProperty(QTextFormat::TextUnderlineStyle)) object.insert("underline", format.fontUnderline());
+    if (format.hasProperty(QTextFormat::FontStrikeOut)) object.insert("strikeOut", format.fontStrikeOut());
+    if (format.hasProperty(QTextFormat::ForegroundBrush)) object.insert("color", colorToJson(format.foreground().color()));
+    if (format.hasProperty(QTextFormat::BackgroundBrush)) object.insert("background", colorToJson(format.background().color()));
+    return object;
+}
+
+QTextCharFormat formatFromJson(const QJsonObject& object) {
+    QTextCharFormat format;
+    if (object.contains("family")) format.setFontFamily(object.value("family").toString());
+    if (object.contains("size")) format.setFontPointSize(object.value("size").toDouble());
+    if (object.contains("weight")) format.setFontWeight(object.value("weight").toInt());
+    if (object.contains("italic")) format.setFontItalic(object.value("italic").toBool());
+    if (object.contains("underline")) format.setFontUnderline(object.value("underline").toBool());
+    if (object.contains("strikeOut")) format.setFontStrikeOut(object.value("strikeOut").toBool());
+    if (object.contains("color")) format.setForeground(colorFromJson(object.value("color"), Qt::black));
+    if (object.contains("background")) format.setBackground(colorFromJson(object.value("background"), Qt::transparent));
+    return format;
+}
+
+QString idToJson(quint64 id) {
+    // 64位整数超出JSON数字（double）的精度，写成十六进制字符串
+    return QString("%1").arg(id, 16, 16, QChar('0'));
+}
+
+quint64 idFromJson(const QJsonValue& value) {
+    return value.toString().toULongLong(nullptr, 16);
+}
+
+} // namespace
+
+//=== 写入 ===//
+
+QJsonObject FlowJsonWriter::toJson(const ShapeRecord& record, int z) {
+    QJsonObject object;
+    object.insert("id", idToJson(record.id));
+    object.insert("type", typeName(record.type));
+    object.insert("bounds", QJsonArray{ record.rect.x(), record.rect.y(), record.rect.width(), record.rect.height() });
+    object.insert("rotation", record.rotation);
+    object.insert("rotationCenter", pointToJson(record.rotationCenter));
+    object.insert("z", z);
+
+    QJsonObject pen;
+    pen.insert("color", colorToJson(record.pen.color()));
+    pen.insert("width", record.pen.widthF());
+    pen.insert("style", styleToJson(int(record.pen.style()), PEN_STYLES));
+    object.insert("pen", pen);
+
+    QJsonObject brush;
+    brush.insert("color", colorToJson(record.brush.color()));
+    brush.insert("style", styleToJson(int(record.brush.style()), BRUSH_STYLES));
+    object.insert("brush", brush);
+
+    object.insert("text", record.label.text());
+    if (!record.label.runs().isEmpty()) {
+        QJsonArray runs;
+        for (const RichLabel::Run& run : record.label.runs()) {
+            QJsonObject item;
+            item.insert("start", run.start);
+            item.insert("length", run.length);
+            item.insert("format", formatToJson(RichLabel::format(run.format)));
+            runs.append(item);
+        }
+        object.insert("runs", runs);
+    }
+    object.insert("font", fontToJson(record.textFont));
+    object.insert("textColor", colorToJson(record.textColor));
+    return object;
+}
+
+bool FlowJsonWriter::write(const QByteArray& data) {
+    if (m_ok && m_device->write(data) != data.size()) {
+        m_ok = false;
+    }
+    return m_ok;
+}
+
+bool FlowJsonWriter::begin(const QSize& canvasSize, bool showGrid, quint64 selectedId,
+    int shapeCount, const QByteArray& thumbnail) {
+    QJsonObject canvas;
+    canvas.insert("width", canvasSize.width());
+    canvas.insert("height", canvasSize.height());
+    canvas.insert("showGrid", showGrid);
+
+    // 画布信息写在图形数组之前，读取时可以边读边用
+    QByteArray header = "{\"format\":\"flow\",\"version\":";
+    header += QByteArray::number(int(FlowDocument::VERSION));
+    header += ",\n\"canvas\":" + QJsonDocument(canvas).toJson(QJsonDocument::Compact);
+    header += ",\n\"selected\":\"" + idToJson(selectedId).toLatin1() + "\"";
+    if (shapeCount >= 0) {
+        header += ",\n\"shapeCount\":" + QByteArray::number(shapeCount);
+    }
+    if (!thumbnail.isEmpty()) {
+        header += ",\n\"thumbnail\":\"" + thumbnail.toBase64() + "\"";
+    }
+    header += ",\n\"shapes\":[";
+    m_count = 0;
+    return write(header);
+}
+
+bool FlowJsonWriter::writeShape(const ShapeRecord& record) {
+    QByteArray line = m_count > 0 ? ",\n" : "\n";
+    line += QJsonDocument(toJson(record, m_count)).toJson(QJsonDocument::Compact);
+    ++m_count;
+    return write(line);
+}
+
+bool FlowJsonWriter::finish(const QVector<GroupRecord>& groups) {
+    if (groups.isEmpty()) {
+        return write("\n]}\n");
+    }
+    QByteArray tail = "\n],\n\"groups\":[";
+    for (int i = 0; i < groups.size(); ++i) {
+        const GroupRecord& group = groups[i];
+        QJsonArray members;
+        for (quint64 id : group.shapeIds) {
+            members.append(idToJson(id));
+        }
+        QJsonObject object;
+        object.insert("id", idToJson(group.id));
+        if (group.parentId != 0) object.insert("parent", idToJson(group.parentId));
+        object.insert("shapes", members);
+        tail += i > 0 ? ",\n" : "\n";
+        tail += QJsonDocument(object).toJson(QJsonDocument::Compact);
+    }
+    tail += "\n]}\n";
+    return write(tail);
+}
+
+//=== 读取 ===//
+
+FlowJsonReader::FlowJsonReader(QIODevice* device)
+    : m_in(new CharStream(device)), m_reader(new JsonStreamReader(*m_in)) {}
+
+FlowJsonReader::~FlowJsonReader() {}
+
+bool FlowJsonReader::fail(const char* message) {
+    qWarning() << "Invalid flow JSON:" << message;
+    m_error = true;
+    m_inShapes = false;
+    return false;
+}
+
+bool FlowJsonReader::readHeader(FlowDocument* document) {
+    m_document = document;
+    if (m_reader->next() != JsonStreamReader::BeginObject) {
+        return fail("expected an object");
+    }
+    for (;;) {
+        const JsonStreamReader::Token token = m_reader->next();
+        if (token == JsonStreamReader::EndObject) return true; // 没有图形
+        if (token != JsonStreamReader::Key) return fail("expected a key");
+        const QString key = m_reader->text();
+        if (key == "shapes") {
+            if (m_reader->next() != JsonStreamReader::BeginArray) return fail("\"shapes\" must be an array");
+            m_inShapes = true;
+            return true;
+        }
+        if (!readMember(key)) return false;
+    }
+}
+
+bool FlowJsonReader::readMember(const QString& key) {
+    QJsonValue value;
+    if (!m_reader->readValue(m_reader->next(), &value)) return fail("malformed value");
+    if (key == "version") {
+        m_document->version = qint16(value.toInt(FlowDocument::VERSION));
+        if (m_document->version > FlowDocument::VERSION) return fail("unsupported version");
+    }
+    else if (key == "canvas") {
+        const QJsonObject canvas = value.toObject();
+        m_document->canvasSize = QSize(canvas.value("width").toInt(), canvas.value("height").toInt());
+        m_document->showGrid = canvas.value("showGrid").toBool(true);
+    }
+    else if (key == "selected") {
+        m_document->selectedId = idFromJson(value);
+    }
+    else if (key == "shapeCount") {
+        m_shapeCount = value.toInt(-1);
+    }
+    else if (key == "thumbnail") {
+        m_document->thumbnail = QByteArray::fromBase64(value.toString().toLatin1());
+    }
+    else if (key == "groups") {
+        m_document->groups.clear();
+        for (const QJsonValue& item : value.toArray()) {
+            const QJsonObject object = item.toObject();
+            GroupRecord group;
+            group.id = idFromJson(object.value("id"));
+            group.parentId = idFromJson(object.value("parent"));
+            for (const QJsonValue& member : object.value("shapes").toArray()) {
+                group.shapeIds.append(idFromJson(member));
+            }
+            m_document->groups.append(group);
+        }
+    }
+    return true; // 其他字段忽略
+}
+
+bool FlowJsonReader::readShape(ShapeRecord* record) {
+    while (m_inShapes) {
+        const JsonStreamReader::Token token = m_reader->next();
+        if (token == JsonStreamReader::EndArray) {
+            // 图形数组之后可能还有其他字段
+            m_inShapes = false;
+            for (;;) {
+                const JsonStreamReader::Token next = m_reader->next();
+                if (next == JsonStreamReader::EndObject) return false;
+                if (next != JsonStreamReader::Key) return fail("expected a key");
+                if (!readMember(m_reader->text())) return false;
+            }
+        }
+        QJsonValue value;
+        if (!m_reader->readValue(token, &value) || !value.isObject()) return fail("malformed shape");
+        const QJsonObject object = value.toObject();
+        if (fromJson(object, record)) {
+            // 没有 "z" 时按数组中的位置
+            m_z = object.value("z").toDouble(m_shapesRead);
+            ++m_shapesRead;
+            return true;
+        }
+        // 未知类型的图形跳过
+    }
+    return false;
+}
+
+bool FlowJsonReader::fromJson(const QJsonObject& object, ShapeRecord* record) {
+    record->id = idFromJson(object.value("id"));
+    record->type = typeFromJson(object.value("type"));
+    if (record->type != ShapeType_Rectangle && record->type != ShapeType_Ellipse) {
+        qWarning() << "Unknown shape type:" << object.value("type");
+        return false;
+    }
+
+    const QJsonArray bounds = object.value("bounds").toArray();
+    record->rect = QRectF(bounds.at(0).toDouble(), bounds.at(1).toDouble(),
+        bounds.at(2).toDouble(), bounds.at(3).toDouble());
+    record->rotation = object.value("rotation").toDouble();
+    const QJsonArray center = object.value("rotationCenter").toArray();
+    record->rotationCenter = QPointF(center.at(0).toDouble(), center.at(1).toDouble());
+
+    const QJsonObject pen = object.value("pen").toObject();
+    record->pen = QPen(colorFromJson(pen.value("color"), Qt::black), pen.value("width").toDouble(1),
+        static_cast<Qt::PenStyle>(styleFromJson(pen.value("style"), PEN_STYLES, Qt::SolidLine)));
+    const QJsonObject brush = object.value("brush").toObject();
+    record->brush = QBrush(colorFromJson(brush.value("color"), Qt::white),
+        static_cast<Qt::BrushStyle>(styleFromJson(brush.value("style"), BRUSH_STYLES, Qt::SolidPattern)));
+
+    QVector<RichLabel::Run> runs;
+    for (const QJsonValue& item : object.value("runs").toArray()) {
+        const QJsonObject run = item.toObject();
+        RichLabel::Run r;
+        r.start = run.value("start").toInt();
+        r.length = run.value("length").toInt();
+        r.format = RichLabel::internFormat(formatFromJson(run.value("format").toObject()));
+        runs.append(r);
+    }
+    record->label = RichLabel(object.value("text").toString(), runs);
+    record->textFont = fontFromJson(object.value("font").toObject());
+    record->textColor = colorFromJson(object.value("textColor"), Qt::black);
+    return true;
+}
@@ -0,0 +1,73 @@
+﻿#ifndef FLOWJSON_H
+#define FLOWJSON_H
+
+#include <QJsonObject>
+#include <QScopedPointer>
+#include "FlowDocument.h"
+
+class QIODevice;
+class CharStream;
+class JsonStreamReader;
+
+/**
+ * .flow 的JSON表示（*.flow.json），字段与二进制格式相同，供脚本工具读写
+ *   {"format": "flow", "version": 4,
+ *    "canvas": {"width": 800, "height": 600, "showGrid": true}, "selected": "<id>",
+ *    "shapeCount": 1, "thumbnail": "<PNG的base64>",
+ *    "shapes": [{"id": "<16位十六进制>", "type": "rectangle", "bounds": [x, y, w, h],
+ *                "rotation": 0, "rotationCenter": [x, y], "z": 0,
+ *                "pen": {"color": "#AARRGGBB", "width": 2.5, "style": "solid"},
+ *                "brush": {"color": "#AARRGGBB", "style": "solid"},
+ *                "text": "...", "runs": [{"start": 0, "length": 3, "format": {...}}],
+ *                "font": {"family": "Arial", "size": 12, ...}, "textColor": "#AARRGGBB"}, ...],
+ *    "groups": [{"id": "<id>", "parent": "<父组id>", "shapes": ["<图形id>", ...]}, ...]}
+ * 写入和读取都逐个图形进行，内存占用与图形数量无关；分组数组（版本6起）写在图形之后。
+ * 写入时 "z" 等于数组中的位置；读取整个文档时按 "z" 稳定排序，省略时按数组顺序。
+ */
+class FlowJsonWriter {
+public:
+    explicit FlowJsonWriter(QIODevice* device) : m_device(device) {}
+
+    bool begin(const QSize& canvasSize, bool showGrid, quint64 selectedId,
+        int shapeCount = -1, const QByteArray& thumbnail = QByteArray()); // 图形数和缩略图可省略
+    bool writeShape(const ShapeRecord& record);
+    bool finish(const QVector<GroupRecord>& groups = QVector<GroupRecord>());
+
+    static QJsonObject toJson(const ShapeRecord& record, int z);
+
+private:
+    bool write(const QByteArray& data);
+
+    QIODevice* m_device;
+    int m_count = 0;
+    bool m_ok = true;
+};
+
+class FlowJsonReader {
+public:
+    explicit FlowJsonReader(QIODevice* device);
+    ~FlowJsonReader();
+
+    bool readHeader(FlowDocument* document);  // 读到 "shapes" 数组开头为止
+    bool readShape(ShapeRecord* record);      // 读下一个图形，没有更多时返回false
+    bool hasError() const { return m_error; }
+    int shapeCount() const { return m_shapeCount; }  // 文件头中声明的图形数，没有时为-1
+    double z() const { return m_z; }                 // 最近读到的图形的 "z"（手工编辑的文件可能与数组顺序不同）
+
+    static bool fromJson(const QJsonObject& object, ShapeRecord* record);
+
+private:
+    bool readMember(const QString& key);      // 画布信息等非图形字段
+    bool fail(const char* message);
+
+    QScopedPointer<CharStream> m_in;
+    QScopedPointer<JsonStreamReader> m_reader;
+    FlowDocument* m_document = nullptr;
+    bool m_inShapes = false;
+    bool m_error = false;
+    int m_shapeCount = -1;
+    int m_shapesRead = 0;
+    double m_z = 0;
+};
+
+#endif // FLOWJSON_H
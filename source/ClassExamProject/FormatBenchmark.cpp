@@ -0,0 +1,88 @@
+﻿#include "FormatBenchmark.h"
+#include "FlowDocument.h"
+#include "FlowDiff.h"
+#include "shape.h"
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTemporaryFile>
+#include <QTextCharFormat>
+
+namespace {
+
+const int GRID = 320;        // 场景共 GRID×GRID（约10万）个图形
+const int CELL = 30;
+
+FlowDocument makeDocument() {
+    static const Qt::GlobalColor colors[] = { Qt::white, Qt::yellow, Qt::cyan, Qt::green };
+    QTextCharFormat bold;
+    bold.setFontWeight(QFont::Bold);
+    const int boldFormat = RichLabel::internFormat(bold);
+
+    FlowDocument document;
+    document.canvasSize = QSize(GRID * CELL, GRID * CELL);
+    document.shapes.reserve(GRID * GRID);
+    for (int i = 0; i < GRID * GRID; ++i) {
+        ShapeRecord record;
+        record.id = quint64(i + 1) << 20 | quint64(i * 7919 % 1000);
+        record.type = i % 3 == 0 ? ShapeType_Ellipse : ShapeType_Rectangle;
+        record.rect = QRectF(i % GRID * CELL + 2, i / GRID * CELL + 2, CELL - 4, CELL - 6);
+        record.rotation = i % 17 == 0 ? 30 : 0;
+        record.rotationCenter = record.rect.center();
+        record.pen = QPen(Qt::black, 1 + i % 3);
+        record.brush = QBrush(colors[i % 4]);
+        record.textFont = QFont("Arial", 8);
+        record.textColor = Qt::black;
+        if (i % 10 == 0) {
+            // 每十个图形带一个标签，其中一半有加粗区段
+            const QString text = QString("Node %1").arg(i);
+            QVector<RichLabel::Run> runs;
+            if (i % 20 == 0) runs.append(RichLabel::Run{ 0, 4, boldFormat });
+            record.label = RichLabel(text, runs);
+        }
+        document.shapes.append(record);
+    }
+    return document;
+}
+
+// 写入再读回，耗时以毫秒计
+QString runFormat(const QString& name, const FlowDocument& document, bool json) {
+    QTemporaryFile file;
+    if (!file.open()) {
+        return QString("%1: failed to create temporary file").arg(name);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool written = json ? document.writeJson(&file) : document.write(&file);
+    file.flush();
+    const double writeTime = timer.nsecsElapsed() / 1e6;
+    const qint64 size = file.size();
+
+    file.seek(0);
+    FlowDocument loaded;
+    timer.restart();
+    const bool read = json ? loaded.readJson(&file) : loaded.read(&file);
+    const double readTime = timer.nsecsElapsed() / 1e6;
+
+    if (!written || !read) {
+        return QString("%1: round trip failed").arg(name);
+    }
+    const FlowDiff diff = FlowDiff::compare(document, loaded);
+    return QString("%1: write %2 ms, read %3 ms, %4 KB%5")
+        .arg(name)
+        .arg(writeTime, 0, 'f', 1)
+        .arg(readTime, 0, 'f', 1)
+        .arg(size / 1024)
+        .arg(diff.isEmpty() ? QString() : QString(" (mismatch: %1)").arg(diff.summary()));
+}
+
+} // namespace
+
+QString FormatBenchmark::run() {
+    const FlowDocument document = makeDocument();
+    QStringList lines;
+    lines << QString("%1 shapes, one in ten labelled").arg(document.shapes.size());
+    lines << runFormat("Binary .flow", document, false);
+    lines << runFormat("JSON .flow.json", document, true);
+    return lines.join('\n');
+}
@@ -0,0 +1,16 @@
+﻿#ifndef FORMATBENCHMARK_H
+#define FORMATBENCHMARK_H
+
+#include <QString>
+
+/**
+ * 文件格式基准测试
+ * 合成场景分别以二进制 .flow 和 JSON 变体写入临时文件再读回，
+ * 对比两者的读写耗时和文件大小，并检查读回的内容一致。
+ */
+class FormatBenchmark {
+public:
+    static QString run();  // 运行测试，返回结果文本
+};
+
+#endif // FORMATBENCHMARK_H
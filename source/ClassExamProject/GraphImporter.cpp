@@ -0,0 +1,780 @@
+﻿#include "GraphImporter.h"
+#include "shape.h"
+#include "TraceRecorder.h"
+#include "JsonStreamReader.h"
+#include <QRunnable>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QSet>
+#include <QHash>
+
+namespace {
+
+const int BATCH_SIZE = 1024;        // 每批交给界面线程的图形数
+const qreal NODE_WIDTH = 120;       // 未指定大小的节点
+const qreal NODE_HEIGHT = 50;
+const int GRID_COLUMNS = 20;        // 未指定坐标的节点按网格排列
+const qreal GRID_SPACING_X = 160;
+const qreal GRID_SPACING_Y = 90;
+
+} // namespace
+
+// 解析出的节点
+struct GraphNode {
+    QString id;
+    QString label;
+    QString shape;
+    QString fill;
+    QString color;       // 边框颜色
+    QString fontColor;
+    bool hasPos = false;
+    bool centered = false; // 坐标是中心点（DOT）还是左上角
+    QPointF pos;
+    QSizeF size;
+};
+
+// 节点 -> ShapeRecord，凑满一批后发给界面线程
+class GraphSink {
+public:
+    GraphSink(GraphImporter* owner, QIODevice* device, ShapeType defaultType)
+        : m_owner(owner), m_device(device), m_defaultType(defaultType) {
+        m_batch.reserve(BATCH_SIZE);
+    }
+
+    bool cancelled() const { return m_owner->m_cancelled; }
+
+    void addNode(const GraphNode& node) {
+        ShapeRecord record;
+        record.type = m_defaultType;
+        const QString shape = node.shape.toLower();
+        if (shape.contains("ellipse") || shape.contains("circle") || shape.contains("oval")) {
+            record.type = ShapeType_Ellipse;
+        }
+        else if (shape.contains("box") || shape.contains("rect") || shape.contains("square")) {
+            record.type = ShapeType_Rectangle;
+        }
+
+        const QSizeF size(node.size.width() > 0 ? node.size.width() : NODE_WIDTH,
+            node.size.height() > 0 ? node.size.height() : NODE_HEIGHT);
+        QPointF topLeft;
+        if (node.hasPos) {
+            topLeft = node.centered ? node.pos - QPointF(size.width() / 2, size.height() / 2) : node.pos;
+        }
+        else {
+            topLeft = QPointF(20 + (m_gridIndex % GRID_COLUMNS) * GRID_SPACING_X,
+                20 + (m_gridIndex / GRID_COLUMNS) * GRID_SPACING_Y);
+            ++m_gridIndex;
+        }
+        record.rect = QRectF(topLeft, size);
+        record.rotationCenter = record.rect.center();
+        record.pen = QPen(colorOr(node.color, Qt::black), 2, Qt::SolidLine);
+        record.brush = QBrush(colorOr(node.fill, Qt::white));
+        record.label = RichLabel(node.label.isEmpty() ? node.id : node.label, QVector<RichLabel::Run>());
+        record.textFont = QFont("Arial", 12);
+        record.textColor = colorOr(node.fontColor, Qt::black);
+
+        m_bounds |= record.rect;
+        m_batch.append(record);
+        ++m_nodes;
+        if (m_batch.size() >= BATCH_SIZE) {
+            flush();
+        }
+    }
+
+    void addEdge() { ++m_edges; }
+
+    void flush() {
+        m_owner->post(m_batch, m_device->pos(), m_device->size()); // 界面线程积压时在此等待
+        m_batch.clear();
+        m_batch.reserve(BATCH_SIZE);
+    }
+
+    int nodes() const { return m_nodes; }
+    int edges() const { return m_edges; }
+    QRectF bounds() const { return m_bounds; }
+
+private:
+    static QColor colorOr(const QString& name, const QColor& fallback) {
+        if (name.isEmpty()) return fallback;
+        QColor color(name.trimmed());
+        return color.isValid() ? color : fallback;
+    }
+
+    GraphImporter* m_owner;
+    QIODevice* m_device;
+    ShapeType m_defaultType;
+    QVector<ShapeRecord> m_batch;
+    int m_gridIndex = 0;
+    int m_nodes = 0;
+    int m_edges = 0;
+    QRectF m_bounds;
+};
+
+namespace {
+
+//=== JSON ===//
+// 支持 {"nodes":[...],"edges":[...]}（任意层级）或顶层即节点数组
+class JsonGraphParser {
+public:
+    enum Role { OtherRole, NodesRole, EdgesRole, NodeItem, EdgeItem };
+
+    JsonGraphParser(CharStream& in, GraphSink& sink) : m_reader(in), m_sink(sink) {}
+
+    bool parse(QString* error) {
+        JsonStreamReader::Token token = m_reader.next();
+        if (token == JsonStreamReader::BeginArray) {
+            m_ok = parseValue(token, NodesRole); // 顶层数组即节点列表
+        }
+        else {
+            m_ok = parseValue(token, OtherRole);
+        }
+        if (!m_ok && error && error->isEmpty()) *error = "Invalid JSON";
+        return m_ok && !m_sink.cancelled();
+    }
+
+private:
+    static Role roleForKey(const QString& key) {
+        const QString k = key.toLower();
+        if (k == "nodes" || k == "vertices") return NodesRole;
+        if (k == "edges" || k == "links") return EdgesRole;
+        return OtherRole;
+    }
+
+    // 用显式栈代替递归，嵌套很深的文件不会耗尽工作线程的栈
+    bool parseValue(JsonStreamReader::Token token, Role role) {
+        struct Container {
+            bool object;
+            Role itemRole;  // 数组元素的角色（对象按键决定）
+        };
+        QVector<Container> stack;
+        for (;;) {
+            if (m_sink.cancelled()) return false;
+
+            // 1. 处理当前的值
+            if (token == JsonStreamReader::BeginObject) {
+                if (role == NodeItem) {
+                    if (!readNode()) return false;
+                }
+                else if (role == EdgeItem) {
+                    m_sink.addEdge();
+                    if (!m_reader.skipValue(token)) return false;
+                }
+                else {
+                    stack.append(Container{ true, OtherRole });
+                }
+            }
+            else if (token == JsonStreamReader::BeginArray) {
+                if (role == EdgeItem) {
+                    m_sink.addEdge(); // ["a", "b"] 形式的边
+                    if (!m_reader.skipValue(token)) return false;
+                }
+                else {
+                    const Role item = role == NodesRole ? NodeItem : role == EdgesRole ? EdgeItem : OtherRole;
+                    stack.append(Container{ false, item });
+                }
+            }
+            else if (token != JsonStreamReader::String && token != JsonStreamReader::Number
+                && token != JsonStreamReader::Literal) {
+                return false;
+            }
+
+            // 2. 读取下一个值，所在的容器结束时逐层弹出
+            for (;;) {
+                if (stack.isEmpty()) return true;
+                token = m_reader.next();
+                const Container& top = stack.last();
+                if (top.object) {
+                    if (token == JsonStreamReader::EndObject) {
+                        stack.removeLast();
+                        continue;
+                    }
+                    if (token != JsonStreamReader::Key) return false;
+                    role = roleForKey(m_reader.text());
+                    token = m_reader.next();
+                }
+                else {
+                    if (token == JsonStreamReader::EndArray) {
+                        stack.removeLast();
+                        continue;
+                    }
+                    if (token == JsonStreamReader::End || token == JsonStreamReader::Error) return false;
+                    role = top.itemRole;
+                }
+                break;
+            }
+        }
+    }
+
+    // 读取一个节点对象的标量字段，嵌套的 position/pos 对象取 x、y
+    bool readNode() {
+        GraphNode node;
+        qreal width = 0, height = 0;
+        bool hasX = false, hasY = false;
+        for (;;) {
+            JsonStreamReader::Token token = m_reader.next();
+            if (token == JsonStreamReader::EndObject) break;
+            if (token != JsonStreamReader::Key) return false;
+            const QString key = m_reader.text().toLower();
+            token = m_reader.next();
+            if (token == JsonStreamReader::BeginObject && (key == "position" || key == "pos")) {
+                for (;;) {
+                    token = m_reader.next();
+                    if (token == JsonStreamReader::EndObject) break;
+                    if (token != JsonStreamReader::Key) return false;
+                    const QString sub = m_reader.text().toLower();
+                    token = m_reader.next();
+                    if (token == JsonStreamReader::Number && sub == "x") { node.pos.setX(m_reader.number()); hasX = true; }
+                    else if (token == JsonStreamReader::Number && sub == "y") { node.pos.setY(m_reader.number()); hasY = true; }
+                    else if (!m_reader.skipValue(token)) return false;
+                }
+                continue;
+            }
+            if (token == JsonStreamReader::BeginObject || token == JsonStreamReader::BeginArray) {
+                if (!m_reader.skipValue(token)) return false;
+                continue;
+            }
+            if (token != JsonStreamReader::String && token != JsonStreamReader::Number) continue; // true/false/null
+            const QString value = m_reader.text();
+            if (key == "id") node.id = value;
+            else if (key == "label" || key == "text" || key == "name" || key == "title") node.label = value;
+            else if (key == "shape" || key == "type") node.shape = value;
+            else if (key == "fill" || key == "fillcolor" || key == "background") node.fill = value;
+            else if (key == "color" || key == "stroke") node.color = value;
+            else if (key == "fontcolor") node.fontColor = value;
+            else if (token == JsonStreamReader::Number) {
+                if (key == "x") { node.pos.setX(m_reader.number()); hasX = true; }
+                else if (key == "y") { node.pos.setY(m_reader.number()); hasY = true; }
+                else if (key == "width" || key == "w") width = m_reader.number();
+                else if (key == "height" || key == "h") height = m_reader.number();
+            }
+        }
+        node.hasPos = hasX && hasY;
+        node.size = QSizeF(width, height);
+        m_sink.addNode(node);
+        return true;
+    }
+
+    JsonStreamReader m_reader;
+    GraphSink& m_sink;
+    bool m_ok = true;
+};
+
+//=== Graphviz DOT ===//
+// 逐条语句解析；先在边里出现、之后才声明的节点以声明为准，
+// 只在边里出现的节点在文件末尾补上
+class DotParser {
+public:
+    enum Token { End, Id, LBrace, RBrace, LBracket, RBracket, Equals, Semicolon, Comma, Colon, EdgeOp, Error };
+
+    DotParser(CharStream& in, GraphSink& sink) : m_in(in), m_sink(sink) {}
+
+    bool parse(QString* error) {
+        Token token = next();
+        // [strict] (graph|digraph) [ID] {
+        while (token == Id) {
+            token = next();
+        }
+        if (token != LBrace) {
+            if (error) *error = "Invalid DOT: missing '{'";
+            return false;
+        }
+
+        int depth = 1;
+        token = next();
+        while (depth > 0 && !m_sink.cancelled()) {
+            if (token == End || token == Error) {
+                if (error) *error = "Invalid DOT: unexpected end of input";
+                return false;
+            }
+            if (token == RBrace) { --depth; token = next(); continue; }
+            if (token == LBrace) { ++depth; token = next(); continue; }
+            if (token == Semicolon || token == Comma) { token = next(); continue; }
+            if (token != Id) {
+                if (token == LBracket) skipAttributes();
+                token = next();
+                continue;
+            }
+            token = statement();
+        }
+
+        // 只在边里出现过的节点
+        for (const QString& id : m_implicit) {
+            if (m_sink.cancelled()) break;
+            if (!m_declared.contains(id)) {
+                GraphNode node = m_nodeDefaults;
+                node.id = id;
+                m_sink.addNode(node);
+            }
+        }
+        return !m_sink.cancelled();
+    }
+
+private:
+    typedef QHash<QString, QString> Attributes;
+
+    // 解析以ID开头的一条语句，返回语句之后的第一个记号
+    Token statement() {
+        const QString id = m_text;
+        const QString keyword = m_quoted ? QString() : id.toLower(); // 带引号的是普通ID
+        Token token = next();
+
+        if ((keyword == "node" || keyword == "edge" || keyword == "graph") && token == LBracket) {
+            Attributes attributes = readAttributes(&token);
+            if (keyword == "node") applyAttributes(m_nodeDefaults, attributes);
+            if (keyword == "graph") applyGraphAttributes(attributes);
+            return token;
+        }
+        if (keyword == "subgraph") {
+            if (token == Id) token = next();  // 子图名
+            return token;                      // 随后的 { 由主循环处理
+        }
+        if (token == Equals) {
+            // 图属性 a=b
+            token = next();
+            Attributes attributes;
+            attributes.insert(id.toLower(), m_text);
+            applyGraphAttributes(attributes);
+            return next();
+        }
+        token = skipPort(token);
+
+        if (token == EdgeOp) {
+            // 边：a -> b -> c [属性]，操作数也可以是 {a b}
+            mention(id);
+            while (token == EdgeOp) {
+                token = next();
+                if (token == LBrace) {
+                    token = next();
+                    while (token == Id || token == Comma || token == Semicolon) {
+                        if (token == Id) mention(m_text);
+                        token = next();
+                    }
+                    if (token != RBrace) return token;
+                    token = next();
+                }
+                else if (token == Id) {
+                    mention(m_text);
+                    token = skipPort(next());
+                }
+                else {
+                    return token;
+                }
+                m_sink.addEdge();
+            }
+            if (token == LBracket) readAttributes(&token);
+            return token;
+        }
+
+        // 节点语句
+        Attributes attributes;
+        if (token == LBracket) attributes = readAttributes(&token);
+        if (!m_declared.contains(id)) {
+            m_declared.insert(id);
+            GraphNode node = m_nodeDefaults;
+            node.id = id;
+            applyAttributes(node, attributes);
+            m_sink.addNode(node);
+        }
+        return token;
+    }
+
+    Token skipPort(Token token) {
+        while (token == Colon) {
+            token = next();
+            if (token == Id) token = next();
+        }
+        return token;
+    }
+
+    void mention(const QString& id) {
+        if (!m_declared.contains(id) && !m_implicitSet.contains(id)) {
+            m_implicitSet.insert(id);
+            m_implicit.append(id);
+        }
+    }
+
+    // 读取一个或多个 [a=b, c=d] 属性表，token 返回其后的记号
+    Attributes readAttributes(Token* token) {
+        Attributes attributes;
+        while (*token == LBracket) {
+            Token t = next();
+            while (t != RBracket && t != End && t != Error) {
+                if (t == Id) {
+                    const QString key = m_text.toLower();
+                    t = next();
+                    if (t == Equals) {
+                        t = next();
+                        if (t == Id) {
+                            attributes.insert(key, m_text);
+                            t = next();
+                        }
+                        continue;
+                    }
+                    continue;
+                }
+                t = next();
+            }
+            *token = next();
+        }
+        return attributes;
+    }
+
+    void skipAttributes() {
+        Token token = LBracket;
+        readAttributes(&token);
+    }
+
+    void applyAttributes(GraphNode& node, const Attributes& attributes) {
+        if (attributes.contains("label")) node.label = attributes.value("label");
+        if (attributes.contains("shape")) node.shape = attributes.value("shape");
+        if (attributes.contains("fillcolor")) node.fill = attributes.value("fillcolor");
+        if (attributes.contains("color")) node.color = attributes.value("color");
+        if (attributes.contains("fontcolor")) node.fontColor = attributes.value("fontcolor");
+        // 宽高单位为英寸，坐标单位为点（1/72英寸），y轴向上
+        bool ok;
+        qreal w = attributes.value("width").toDouble(&ok);
+        if (ok) node.size.setWidth(w * 96);
+        qreal h = attributes.value("height").toDouble(&ok);
+        if (ok) node.size.setHeight(h * 96);
+        const QStringList pos = attributes.value("pos").remove('!').split(',');
+        if (pos.size() >= 2) {
+            bool okX, okY;
+            const qreal x = pos[0].toDouble(&okX);
+            const qreal y = pos[1].toDouble(&okY);
+            if (okX && okY) {
+                node.pos = QPointF(x * 96 / 72, (m_graphHeight > 0 ? m_graphHeight - y : y) * 96 / 72);
+                node.hasPos = true;
+                node.centered = true;
+            }
+        }
+        if (node.label == "\\N") node.label.clear(); // \N 表示节点名
+    }
+
+    void applyGraphAttributes(const Attributes& attributes) {
+        // bb="x0,y0,x1,y1" 用于把y轴翻转为向下
+        const QStringList bb = attributes.value("bb").split(',');
+        if (bb.size() == 4) {
+            m_graphHeight = bb[3].toDouble();
+        }
+    }
+
+    Token next() {
+        for (;;) {
+            m_in.skipSpace();
+            const QChar c = m_in.get();
+            m_quoted = false;
+            if (c.isNull()) return End;
+            switch (c.unicode()) {
+            case '{': return LBrace;
+            case '}': return RBrace;
+            case '[': return LBracket;
+            case ']': return RBracket;
+            case '=': return Equals;
+            case ';': return Semicolon;
+            case ',': return Comma;
+            case ':': return Colon;
+            case '#':
+                skipLine();
+                continue;
+            case '/':
+                if (m_in.peek() == '/') { skipLine(); continue; }
+                if (m_in.peek() == '*') { skipBlockComment(); continue; }
+                return Error;
+            case '-':
+                if (m_in.peek() == '>' || m_in.peek() == '-') {
+                    m_in.get();
+                    return EdgeOp;
+                }
+                break;
+            case '"':
+                return readQuoted();
+            case '<':
+                return readHtml();
+            default:
+                break;
+            }
+            if (c.isLetterOrNumber() || c == '_' || c == '-' || c == '.' || c.unicode() >= 0x80) {
+                m_text = c;
+                while (!m_in.atEnd()) {
+                    const QChar p = m_in.peek();
+                    if (!(p.isLetterOrNumber() || p == '_' || p == '.' || p.unicode() >= 0x80)) break;
+                    m_text += m_in.get();
+                }
+                return Id;
+            }
+            return Error;
+        }
+    }
+
+    Token readQuoted() {
+        m_text.clear();
+        m_quoted = true;
+        while (!m_in.atEnd()) {
+            QChar c = m_in.get();
+            if (c == '"') {
+                // "a" + "b" 拼接
+                m_in.skipSpace();
+                if (m_in.peek() == '+') {
+                    m_in.get();
+                    m_in.skipSpace();
+                    if (m_in.get() == '"') continue;
+                }
+                return Id;
+            }
+            if (c == '\\') {
+                const QChar e = m_in.get();
+                if (e == '\n') continue;          // 续行
+                if (e == 'n' || e == 'l' || e == 'r') c = '\n';
+                else if (e == '"') c = '"';
+                else { m_text += c; c = e; }
+            }
+            m_text += c;
+        }
+        return Error;
+    }
+
+    Token readHtml() {
+        // HTML标签 <...>，去掉内部标记只留文字
+        m_text.clear();
+        m_quoted = true;
+        int depth = 1;
+        bool inTag = false;
+        while (!m_in.atEnd()) {
+            const QChar c = m_in.get();
+            if (c == '<') { ++depth; inTag = true; continue; }
+            if (c == '>') {
+                if (--depth == 0) return Id;
+                inTag = false;
+                continue;
+            }
+            if (!inTag) m_text += c;
+        }
+        return Error;
+    }
+
+    void skipLine() {
+        while (!m_in.atEnd() && m_in.get() != '\n') {}
+    }
+
+    void skipBlockComment() {
+        m_in.get();
+        QChar previous;
+        while (!m_in.atEnd()) {
+            const QChar c = m_in.get();
+            if (previous == '*' && c == '/') return;
+            previous = c;
+        }
+    }
+
+    CharStream& m_in;
+    GraphSink& m_sink;
+    QString m_text;
+    bool m_quoted = false;
+    GraphNode m_nodeDefaults;
+    qreal m_graphHeight = 0;
+    QSet<QString> m_declared;        // 已生成的节点
+    QSet<QString> m_implicitSet;     // 只在边里出现过的节点
+    QStringList m_implicit;
+};
+
+//=== CSV ===//
+// 带表头时按列名取字段；有 source/target（或 from/to）列时每行是一条边，
+// 节点在第一次出现时生成。无表头时各列依次为 label, shape, x, y, width, height
+class CsvParser {
+public:
+    CsvParser(CharStream& in, GraphSink& sink) : m_in(in), m_sink(sink) {}
+
+    bool parse(QString* error) {
+        Q_UNUSED(error);
+        QStringList fields;
+        if (!readRecord(&fields)) return true; // 空文件
+
+        static const QStringList known = { "id", "label", "text", "name", "shape", "type",
+            "x", "y", "width", "height", "fill", "color", "source", "target", "from", "to" };
+        QHash<QString, int> columns;
+        for (int i = 0; i < fields.size(); ++i) {
+            const QString name = fields[i].trimmed().toLower();
+            if (known.contains(name)) columns.insert(name, i);
+        }
+        const bool hasHeader = !columns.isEmpty();
+        if (!hasHeader) {
+            const QStringList defaults = { "label", "shape", "x", "y", "width", "height" };
+            for (int i = 0; i < defaults.size(); ++i) columns.insert(defaults[i], i);
+        }
+        const int sourceColumn = columns.value("source", columns.value("from", -1));
+        const int targetColumn = columns.value("target", columns.value("to", -1));
+        const bool edgeList = sourceColumn >= 0 && targetColumn >= 0;
+
+        bool first = !hasHeader;
+        while (!m_sink.cancelled()) {
+            if (!first && !readRecord(&fields)) break;
+            first = false;
+            if (fields.size() == 1 && fields[0].isEmpty()) continue; // 空行
+
+            if (edgeList) {
+                mention(fields.value(sourceColumn));
+                mention(fields.value(targetColumn));
+                m_sink.addEdge();
+                continue;
+            }
+
+            GraphNode node;
+            node.id = field(fields, columns, "id");
+            node.label = field(fields, columns, "label");
+            if (node.label.isEmpty()) node.label = field(fields, columns, "text");
+            if (node.label.isEmpty()) node.label = field(fields, columns, "name");
+            node.shape = field(fields, columns, "shape");
+            if (node.shape.isEmpty()) node.shape = field(fields, columns, "type");
+            node.fill = field(fields, columns, "fill");
+            node.color = field(fields, columns, "color");
+            bool okX, okY, okW, okH;
+            const qreal x = field(fields, columns, "x").toDouble(&okX);
+            const qreal y = field(fields, columns, "y").toDouble(&okY);
+            const qreal w = field(fields, columns, "width").toDouble(&okW);
+            const qreal h = field(fields, columns, "height").toDouble(&okH);
+            if (okX && okY) {
+                node.pos = QPointF(x, y);
+                node.hasPos = true;
+            }
+            if (okW && okH) node.size = QSizeF(w, h);
+            m_sink.addNode(node);
+        }
+        return !m_sink.cancelled();
+    }
+
+private:
+    static QString field(const QStringList& fields, const QHash<QString, int>& columns, const QString& name) {
+        const int column = columns.value(name, -1);
+        return column >= 0 ? fields.value(column).trimmed() : QString();
+    }
+
+    void mention(const QString& id) {
+        if (id.isEmpty() || m_seen.contains(id)) return;
+        m_seen.insert(id);
+        GraphNode node;
+        node.id = id;
+        m_sink.addNode(node);
+    }
+
+    // 读取一条记录，支持引号、"" 转义和引号内换行
+    bool readRecord(QStringList* fields) {
+        fields->clear();
+        if (m_in.atEnd()) return false;
+        QString current;
+        bool quoted = false;
+        while (!m_in.atEnd()) {
+            const QChar c = m_in.get();
+            if (quoted) {
+                if (c == '"') {
+                    if (m_in.peek() == '"') current += m_in.get();
+                    else quoted = false;
+                }
+                else {
+                    current += c;
+                }
+                continue;
+            }
+            if (c == '"') quoted = true;
+            else if (c == ',') { fields->append(current); current.clear(); }
+            else if (c == '\n') break;
+            else if (c != '\r') current += c;
+        }
+        fields->append(current);
+        return true;
+    }
+
+    CharStream& m_in;
+    GraphSink& m_sink;
+    QSet<QString> m_seen;
+};
+
+} // namespace
+
+class GraphImporter::DriverTask : public QRunnable {
+public:
+    explicit DriverTask(GraphImporter* owner) : m_owner(owner) {}
+    void run() override { m_owner->run(); }
+private:
+    GraphImporter* m_owner;
+};
+
+bool GraphImporter::formatForFile(const QString& fileName, Format* format) {
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "json") *format = JsonFormat;
+    else if (suffix == "dot" || suffix == "gv") *format = DotFormat;
+    else if (suffix == "csv") *format = CsvFormat;
+    else return false;
+    return true;
+}
+
+GraphImporter::GraphImporter(QObject* parent)
+    : QObject(parent), m_pendingSlots(MAX_PENDING_BATCHES), m_cancelled(false)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+GraphImporter::~GraphImporter() {
+    cancel();
+    m_pool.waitForDone();
+}
+
+void GraphImporter::start(const QString& fileName, Format format) {
+    m_fileName = fileName;
+    m_format = format;
+    m_cancelled = false;
+    m_pool.start(new DriverTask(this));
+}
+
+void GraphImporter::cancel() {
+    m_cancelled = true;
+}
+
+void GraphImporter::post(const QVector<ShapeRecord>& records, qint64 bytesRead, qint64 totalBytes) {
+    // 最多 MAX_PENDING_BATCHES 批在途，界面线程处理完一批才放行下一批，
+    // 解析再快内存占用也有上限；取消时不再等待
+    while (!m_pendingSlots.tryAcquire(1, 50)) {
+        if (m_cancelled) return;
+    }
+    // 回到界面线程发出信号；对象析构前会等待线程池结束
+    GraphImporter* owner = this;
+    QMetaObject::invokeMethod(this, [owner, records, bytesRead, totalBytes]() {
+        if (!records.isEmpty()) {
+            emit owner->shapesReady(records);
+        }
+        emit owner->progress(bytesRead, totalBytes);
+        owner->m_pendingSlots.release();
+    }, Qt::QueuedConnection);
+}
+
+void GraphImporter::run() {
+    TRACE_SCOPE_CAT("GraphImporter::run", "io");
+    QFile file(m_fileName);
+    bool ok = file.open(QIODevice::ReadOnly);
+    QString error = ok ? QString() : file.errorString();
+    int nodes = 0, edges = 0;
+    QRectF bounds;
+
+    if (ok) {
+        CharStream in(&file);
+        GraphSink sink(this, &file, m_format == DotFormat ? ShapeType_Ellipse : ShapeType_Rectangle);
+        switch (m_format) {
+        case JsonFormat: ok = JsonGraphParser(in, sink).parse(&error); break;
+        case DotFormat: ok = DotParser(in, sink).parse(&error); break;
+        case CsvFormat: ok = CsvParser(in, sink).parse(&error); break;
+        }
+        sink.flush(); // 出错前已解析的节点也保留
+        nodes = sink.nodes();
+        edges = sink.edges();
+        bounds = sink.bounds();
+        if (m_cancelled) {
+            ok = false;
+            error = "Import cancelled";
+        }
+    }
+
+    GraphImporter* owner = this;
+    QMetaObject::invokeMethod(this, [owner, ok, error, nodes, edges, bounds]() {
+        emit owner->finished(ok, error, nodes, edges, bounds);
+    }, Qt::QueuedConnection);
+}
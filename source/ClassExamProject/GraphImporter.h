@@ -0,0 +1,55 @@
+﻿#ifndef GRAPHIMPORTER_H
+#define GRAPHIMPORTER_H
+
+#include <QObject>
+#include <QVector>
+#include <QRectF>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <atomic>
+#include "FlowDocument.h"
+
+/**
+ * 图描述文件导入（JSON / Graphviz DOT / CSV）
+ * 在工作线程中边读边解析（不建立整份文件的DOM），节点转换为带文字标签的
+ * 矩形或椭圆，每凑满一批就交给界面线程。在途的批数有上限（界面线程处理完
+ * 一批才放行下一批），内存占用与文件大小无关。
+ * 画布没有连接线，边只计数；没有坐标的节点按网格排列。
+ */
+class GraphImporter : public QObject {
+    Q_OBJECT
+
+public:
+    enum Format { JsonFormat, DotFormat, CsvFormat };
+    static bool formatForFile(const QString& fileName, Format* format);  // 按扩展名判断
+
+    explicit GraphImporter(QObject* parent = nullptr);
+    ~GraphImporter();
+
+    void start(const QString& fileName, Format format);  // 在后台开始导入
+    void cancel();
+
+signals:
+    // 以下信号都在界面线程发出，且按顺序到达
+    void shapesReady(const QVector<ShapeRecord>& records);
+    void progress(qint64 bytesRead, qint64 totalBytes);
+    void finished(bool ok, const QString& error, int nodes, int edges, const QRectF& bounds);
+
+private:
+    class DriverTask;
+    friend class DriverTask;
+    friend class GraphSink;
+
+    void run();
+    void post(const QVector<ShapeRecord>& records, qint64 bytesRead, qint64 totalBytes);
+
+    static const int MAX_PENDING_BATCHES = 4;
+
+    QThreadPool m_pool;
+    QSemaphore m_pendingSlots;      // 在途批次的名额，界面线程处理完一批后释放
+    QString m_fileName;
+    Format m_format = JsonFormat;
+    std::atomic<bool> m_cancelled;
+};
+
+#endif // GRAPHIMPORTER_H
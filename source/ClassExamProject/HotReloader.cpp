@@ -0,0 +1,140 @@
+﻿#include "HotReloader.h"
+#include "CanvasWidget.h"
+#include "FlowDocument.h"
+#include "FlowDiff.h"
+#include "TraceRecorder.h"
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QFileInfo>
+#include <QDebug>
+
+struct HotReloader::Result {
+    quint64 generation = 0;
+    bool ok = false;
+    FlowDocument base;       // 共同祖先：上次加载或保存时的文件内容
+    FlowDocument ours;       // 开始解析时的画布快照（含未保存的编辑）
+    FlowDocument theirs;     // 文件中的新版本
+    FlowDocument merged;     // 合并结果，画布将更新为它
+    QStringList conflicts;
+    FlowDiff diff;           // ours -> merged
+};
+
+class HotReloader::ParseTask : public QRunnable {
+public:
+    ParseTask(HotReloader* owner, const QString& fileName, const QSharedPointer<Result>& result)
+        : m_owner(owner), m_fileName(fileName), m_result(result) {}
+
+    void run() override {
+        TRACE_SCOPE_CAT("HotReloader::parse", "io");
+        Result& r = *m_result;
+        r.ok = r.theirs.load(m_fileName);
+        if (r.ok) {
+            FlowDiff::merge(r.base, r.ours, r.theirs, &r.merged, &r.conflicts);
+            r.diff = FlowDiff::compare(r.ours, r.merged);
+        }
+        // 回到界面线程应用；对象析构前会等待线程池结束
+        HotReloader* owner = m_owner;
+        QSharedPointer<Result> result = m_result;
+        QMetaObject::invokeMethod(owner, [owner, result]() {
+            owner->finishParse(result);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    HotReloader* m_owner;
+    QString m_fileName;
+    QSharedPointer<Result> m_result;
+};
+
+HotReloader::HotReloader(CanvasWidget* canvas, QObject* parent)
+    : QObject(parent), m_canvas(canvas)
+{
+    m_pool.setMaxThreadCount(1);
+    m_debounce.setSingleShot(true);
+    m_debounce.setInterval(DEBOUNCE_MS);
+    connect(&m_debounce, &QTimer::timeout, this, &HotReloader::startParse);
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &HotReloader::fileChanged);
+}
+
+HotReloader::~HotReloader() {
+    m_pool.waitForDone();
+}
+
+void HotReloader::watch(const QString& fileName) {
+    const QString path = fileName.isEmpty() ? QString() : QFileInfo(fileName).absoluteFilePath();
+    m_debounce.stop();
+    ++m_generation; // 丢弃尚未完成的解析，它的祖先已过时
+
+    if (path != m_fileName) {
+        if (!m_watcher.files().isEmpty()) {
+            m_watcher.removePaths(m_watcher.files());
+        }
+        m_fileName = path;
+        if (!m_fileName.isEmpty()) {
+            m_watcher.addPath(m_fileName);
+        }
+    }
+
+    // 刚加载或保存完，画布与文件一致
+    if (m_fileName.isEmpty()) {
+        m_base = FlowDocument();
+        m_stampTime = QDateTime();
+        m_stampSize = -1;
+        return;
+    }
+    m_base = m_canvas->toDocument();
+    const QFileInfo info(m_fileName);
+    m_stampTime = info.lastModified();
+    m_stampSize = info.size();
+}
+
+void HotReloader::setEnabled(bool enabled) {
+    m_enabled = enabled;
+    if (!enabled) {
+        m_debounce.stop();
+        ++m_generation;
+    }
+}
+
+void HotReloader::fileChanged() {
+    if (m_enabled) {
+        m_debounce.start();
+    }
+}
+
+void HotReloader::startParse() {
+    // 以“写临时文件再改名”方式生成的文件会从监视列表中消失，重新加入
+    if (!m_watcher.files().contains(m_fileName) && QFileInfo::exists(m_fileName)) {
+        m_watcher.addPath(m_fileName);
+    }
+    if (!m_enabled || m_fileName.isEmpty()) return;
+
+    // 自己保存引起的通知：修改时间和大小都没变
+    const QFileInfo info(m_fileName);
+    if (info.lastModified() == m_stampTime && info.size() == m_stampSize) return;
+
+    QSharedPointer<Result> result(new Result);
+    result->generation = ++m_generation;
+    result->base = m_base;
+    result->ours = m_canvas->toDocument();
+    m_pool.start(new ParseTask(this, m_fileName, result));
+}
+
+void HotReloader::finishParse(const QSharedPointer<Result>& result) {
+    if (result->generation != m_generation || !result->ok) return;
+
+    TRACE_SCOPE("HotReloader::apply");
+    // 文件的新版本成为下一次合并的祖先
+    m_base = result->theirs;
+    const QFileInfo info(m_fileName);
+    m_stampTime = info.lastModified();
+    m_stampSize = info.size();
+
+    for (const QString& conflict : result->conflicts) {
+        qWarning() << "Reload conflict:" << conflict;
+    }
+    const int changed = m_canvas->applyDelta(result->ours, result->merged, result->diff);
+    if (changed > 0 || !result->conflicts.isEmpty()) {
+        emit reloaded(changed, result->conflicts.size());
+    }
+}
@@ -0,0 +1,62 @@
+﻿#ifndef HOTRELOADER_H
+#define HOTRELOADER_H
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QFileSystemWatcher>
+#include <QDateTime>
+#include "FlowDocument.h"
+
+class CanvasWidget;
+
+/**
+ * 外部修改后的热重载
+ * 监视当前打开的 .flow 文件，记住最近一次加载或保存时的文件内容作为共同祖先。
+ * 文件变化后在工作线程中解析新版本，与画布快照做三方合并（未保存的编辑保留，
+ * 两边改了同一处时以画布为准），再回到界面线程只更新有变化的图形。
+ * 缩放、平移和选中状态保持不变；解析失败（文件写到一半）时等待下一次变化；
+ * 修改时间和大小与自己保存时相同的通知直接忽略。
+ */
+class HotReloader : public QObject {
+    Q_OBJECT
+
+public:
+    explicit HotReloader(CanvasWidget* canvas, QObject* parent = nullptr);
+    ~HotReloader();
+
+    // 加载或保存后调用：开始监视（空字符串表示停止），当前画布内容即文件内容
+    void watch(const QString& fileName);
+    QString fileName() const { return m_fileName; }
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled; }
+
+signals:
+    void reloaded(int changedShapes, int conflicts);
+
+private:
+    class ParseTask;
+    struct Result;
+    friend class ParseTask;
+
+    void fileChanged();
+    void startParse();
+    void finishParse(const QSharedPointer<Result>& result);
+
+    CanvasWidget* m_canvas;
+    QFileSystemWatcher m_watcher;
+    QTimer m_debounce;          // 合并连续的写入通知
+    QThreadPool m_pool;         // 单线程，解析按顺序进行
+    QString m_fileName;
+    FlowDocument m_base;        // 最近一次加载或保存时的文件内容（合并的共同祖先）
+    QDateTime m_stampTime;      // 最近一次加载或保存后文件的修改时间和大小
+    qint64 m_stampSize = -1;
+    quint64 m_generation = 0;   // 只应用最新一次解析的结果
+    bool m_enabled = true;
+
+    static const int DEBOUNCE_MS = 200;
+};
+
+#endif // HOTRELOADER_H
@@ -0,0 +1,126 @@
+﻿#include "JsonStreamReader.h"
+#include <QJsonObject>
+#include <QJsonArray>
+
+JsonStreamReader::Token JsonStreamReader::next() {
+    for (;;) {
+        m_in.skipSpace();
+        const QChar c = m_in.get();
+        if (c.isNull()) return End;
+        switch (c.unicode()) {
+        case '{': return BeginObject;
+        case '}': return EndObject;
+        case '[': return BeginArray;
+        case ']': return EndArray;
+        case ',': case ':': continue;
+        case '"': {
+            if (!readString()) return Error;
+            m_in.skipSpace();
+            if (m_in.peek() == ':') {
+                m_in.get();
+                return Key;
+            }
+            return String;
+        }
+        default:
+            if (c == '-' || c.isDigit()) {
+                m_text = c;
+                while (!m_in.atEnd() && (m_in.peek().isDigit() || QString(".eE+-").contains(m_in.peek()))) {
+                    m_text += m_in.get();
+                }
+                bool ok;
+                m_number = m_text.toDouble(&ok);
+                return ok ? Number : Error;
+            }
+            if (c.isLetter()) {
+                m_text = c;
+                while (!m_in.atEnd() && m_in.peek().isLetter()) m_text += m_in.get();
+                return Literal; // true / false / null
+            }
+            return Error;
+        }
+    }
+}
+
+bool JsonStreamReader::skipValue(Token token) {
+    int depth = 0;
+    for (;;) {
+        if (token == BeginObject || token == BeginArray) ++depth;
+        else if (token == EndObject || token == EndArray) --depth;
+        else if (token == Error || token == End) return false;
+        if (depth <= 0) return true;
+        token = next();
+    }
+}
+
+bool JsonStreamReader::readValue(Token token, QJsonValue* value) {
+    switch (token) {
+    case String:
+        *value = m_text;
+        return true;
+    case Number:
+        *value = m_number;
+        return true;
+    case Literal:
+        if (m_text == "true") *value = true;
+        else if (m_text == "false") *value = false;
+        else if (m_text == "null") *value = QJsonValue();
+        else return false;
+        return true;
+    case BeginObject: {
+        QJsonObject object;
+        for (;;) {
+            token = next();
+            if (token == EndObject) break;
+            if (token != Key) return false;
+            const QString key = m_text;
+            QJsonValue child;
+            if (!readValue(next(), &child)) return false;
+            object.insert(key, child);
+        }
+        *value = object;
+        return true;
+    }
+    case BeginArray: {
+        QJsonArray array;
+        for (;;) {
+            token = next();
+            if (token == EndArray) break;
+            QJsonValue child;
+            if (!readValue(token, &child)) return false;
+            array.append(child);
+        }
+        *value = array;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+bool JsonStreamReader::readString() {
+    m_text.clear();
+    for (;;) {
+        if (m_in.atEnd()) return false;
+        QChar c = m_in.get();
+        if (c == '"') return true;
+        if (c == '\\') {
+            const QChar e = m_in.get();
+            switch (e.unicode()) {
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            case 'r': c = '\r'; break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'u': {
+                QString hex;
+                for (int i = 0; i < 4; ++i) hex += m_in.get();
+                c = QChar(ushort(hex.toUShort(nullptr, 16)));
+                break;
+            }
+            default: c = e; break;
+            }
+        }
+        m_text += c;
+    }
+}
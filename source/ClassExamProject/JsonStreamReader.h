@@ -0,0 +1,66 @@
+﻿#ifndef JSONSTREAMREADER_H
+#define JSONSTREAMREADER_H
+
+#include <QString>
+#include <QTextStream>
+#include <QJsonValue>
+
+class QIODevice;
+
+/**
+ * 按块解码的字符流，只保留当前一块（64K字符）
+ */
+class CharStream {
+public:
+    explicit CharStream(QIODevice* device) : m_stream(device) {
+        m_stream.setCodec("UTF-8");
+    }
+    QChar peek() { fill(); return m_pos < m_buffer.size() ? m_buffer[m_pos] : QChar(); }
+    QChar get() { fill(); return m_pos < m_buffer.size() ? m_buffer[m_pos++] : QChar(); }
+    bool atEnd() { fill(); return m_pos >= m_buffer.size(); }
+    void skipSpace() {
+        while (!atEnd() && peek().isSpace()) ++m_pos;
+    }
+
+private:
+    void fill() {
+        if (m_pos >= m_buffer.size() && !m_stream.atEnd()) {
+            m_buffer = m_stream.read(READ_CHUNK);
+            m_pos = 0;
+        }
+    }
+
+    static const int READ_CHUNK = 64 * 1024;
+
+    QTextStream m_stream;
+    QString m_buffer;
+    int m_pos = 0;
+};
+
+/**
+ * 拉取式JSON分词
+ * 对象的键和值分开返回，调用方按需逐个处理，整份文件不建立DOM；
+ * 需要时可用 readValue 把单个（小的）子树读成 QJsonValue。
+ */
+class JsonStreamReader {
+public:
+    enum Token { End, BeginObject, EndObject, BeginArray, EndArray, Key, String, Number, Literal, Error };
+
+    explicit JsonStreamReader(CharStream& in) : m_in(in) {}
+
+    Token next();
+    bool skipValue(Token token);                    // 跳过一个值（对象/数组整体跳过）
+    bool readValue(Token token, QJsonValue* value); // 读取一个值（含子树）
+
+    const QString& text() const { return m_text; }  // 键、字符串、数字或字面量的原文
+    double number() const { return m_number; }
+
+private:
+    bool readString();
+
+    CharStream& m_in;
+    QString m_text;
+    double m_number = 0;
+};
+
+#endif // JSONSTREAMREADER_H
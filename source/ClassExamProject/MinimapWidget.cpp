@@ -0,0 +1,186 @@
+﻿#include "MinimapWidget.h"
+#include "CanvasWidget.h"
+#include "SceneRenderer.h"
+#include "TraceRecorder.h"
+#include <QScrollArea>
+#include <QScrollBar>
+#include <QPainter>
+#include <QMouseEvent>
+
+namespace {
+
+// 小地图只画填充和细线边框
+RenderOptions minimapOptions() {
+    RenderOptions options;
+    options.labels = false;
+    options.antialiasing = false;
+    options.hairlines = true;
+    options.controlHandles = false;
+    return options;
+}
+
+} // namespace
+
+MinimapWidget::MinimapWidget(CanvasWidget* canvas, QScrollArea* view, QWidget* parent)
+    : QWidget(parent), m_canvas(canvas), m_view(view)
+{
+    setMinimumSize(120, 90);
+    setCursor(Qt::PointingHandCursor);
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(FLUSH_MS);
+    connect(&m_flushTimer, &QTimer::timeout, this, &MinimapWidget::flush);
+    connect(m_canvas, &CanvasWidget::contentChanged, this, &MinimapWidget::invalidate);
+
+    // 滚动或视图改变大小时只需重画视口框
+    for (QScrollBar* bar : { m_view->horizontalScrollBar(), m_view->verticalScrollBar() }) {
+        connect(bar, &QScrollBar::valueChanged, this, [this]() { update(); });
+        connect(bar, &QScrollBar::rangeChanged, this, [this]() { update(); });
+    }
+}
+
+void MinimapWidget::invalidate(const QRectF& dirty)
+{
+    if (!isVisible()) {
+        m_fullDirty = true; // 显示时整体重画
+        m_dirty = QRegion();
+        return;
+    }
+    if (dirty.isNull()) {
+        m_fullDirty = true;
+    }
+    else if (!m_fullDirty) {
+        // 转为缓存坐标，向外取整并留出1像素
+        const QRectF scaled(dirty.topLeft() * m_scale, dirty.size() * m_scale);
+        m_dirty += scaled.toAlignedRect().adjusted(-1, -1, 1, 1);
+    }
+    // 节流而不是防抖：拖动时每帧最多更新一次
+    if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
+}
+
+void MinimapWidget::resizeEvent(QResizeEvent* event)
+{
+    QWidget::resizeEvent(event);
+    m_fullDirty = true;
+    m_flushTimer.start();
+}
+
+void MinimapWidget::showEvent(QShowEvent* event)
+{
+    QWidget::showEvent(event);
+    if (m_fullDirty) {
+        m_flushTimer.start();
+    }
+}
+
+void MinimapWidget::rebuild()
+{
+    TRACE_SCOPE("MinimapWidget::rebuild");
+    const QSize scene = m_canvas->size();
+    if (scene.isEmpty() || width() <= 0 || height() <= 0) {
+        m_cache = QImage();
+        return;
+    }
+    m_scale = qMin(qreal(width()) / scene.width(), qreal(height()) / scene.height());
+    const QSize size = (QSizeF(scene) * m_scale).toSize().expandedTo(QSize(1, 1));
+    m_cache = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    m_cache.fill(m_canvas->canvasColor());
+
+    QPainter painter(&m_cache);
+    painter.scale(m_scale, m_scale);
+    SceneRenderer::drawShapesBatched(painter, m_canvas->shapeList(), minimapOptions());
+}
+
+void MinimapWidget::flush()
+{
+    if (!isVisible()) {
+        m_fullDirty = true;
+        m_dirty = QRegion();
+        return;
+    }
+    if (m_fullDirty || m_cache.isNull()) {
+        m_fullDirty = false;
+        m_dirty = QRegion();
+        rebuild();
+        update();
+        return;
+    }
+    const QRegion dirty = m_dirty.intersected(m_cache.rect());
+    m_dirty = QRegion();
+    if (dirty.isEmpty()) return;
+
+    TRACE_SCOPE("MinimapWidget::flush");
+    // 从画布的空间索引取出与变化区域相交的图形，按z顺序在裁剪区域内重画
+    const QRectF bounds = dirty.boundingRect();
+    const QRectF sceneBounds(bounds.topLeft() / m_scale, bounds.size() / m_scale);
+    QList<Shape*> affected;
+    for (Shape* shape : m_canvas->shapesIn(sceneBounds)) {
+        const QRectF shapeBounds = shape->paintBounds();
+        if (!shapeBounds.intersects(sceneBounds)) continue;
+        const QRectF scaled(shapeBounds.topLeft() * m_scale, shapeBounds.size() * m_scale);
+        if (dirty.intersects(scaled.toAlignedRect())) {
+            affected.append(shape);
+        }
+    }
+
+    QPainter painter(&m_cache);
+    painter.setClipRegion(dirty);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(bounds, m_canvas->canvasColor());
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter.scale(m_scale, m_scale);
+    SceneRenderer::drawShapesBatched(painter, affected, minimapOptions());
+    painter.end();
+
+    update(dirty.boundingRect().translated(imageRect().topLeft()));
+}
+
+QRect MinimapWidget::imageRect() const
+{
+    return QRect(QPoint((width() - m_cache.width()) / 2, (height() - m_cache.height()) / 2), m_cache.size());
+}
+
+void MinimapWidget::paintEvent(QPaintEvent* event)
+{
+    Q_UNUSED(event);
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().window());
+    if (m_cache.isNull()) return;
+
+    const QRect target = imageRect();
+    painter.drawImage(target.topLeft(), m_cache);
+    painter.setPen(Qt::gray);
+    painter.drawRect(target.adjusted(0, 0, -1, -1));
+
+    // 当前视口（画布中可见的部分）
+    const QRect visible = m_canvas->visibleRegion().boundingRect();
+    if (!visible.isEmpty()) {
+        const QRectF frame(target.topLeft() + QPointF(visible.topLeft()) * m_scale, QSizeF(visible.size()) * m_scale);
+        painter.setPen(QPen(QColor(220, 50, 50), 2));
+        painter.setBrush(QColor(220, 50, 50, 30));
+        painter.drawRect(frame);
+    }
+}
+
+void MinimapWidget::mousePressEvent(QMouseEvent* event)
+{
+    if (event->button() == Qt::LeftButton) {
+        jumpTo(event->pos());
+    }
+}
+
+void MinimapWidget::mouseMoveEvent(QMouseEvent* event)
+{
+    if (event->buttons() & Qt::LeftButton) {
+        jumpTo(event->pos());
+    }
+}
+
+void MinimapWidget::jumpTo(const QPoint& pos)
+{
+    if (m_cache.isNull()) return;
+    const QPointF scenePos = QPointF(pos - imageRect().topLeft()) / m_scale;
+    m_canvas->ensureVisible(QRectF(scenePos, QSizeF(0, 0)));
+    update();
+}
@@ -0,0 +1,51 @@
+﻿#ifndef MINIMAPWIDGET_H
+#define MINIMAPWIDGET_H
+
+#include <QWidget>
+#include <QImage>
+#include <QRegion>
+#include <QTimer>
+
+class CanvasWidget;
+class QScrollArea;
+
+/**
+ * 小地图：整个场景的缩小图和当前视口框，点击或拖动跳转
+ * 缩小图缓存在低分辨率图像中，画布报告图形内容变化的区域后只重绘这些区域
+ * （每帧最多一次，合并期间的所有变化），受影响的图形从画布的空间索引中取，
+ * 不遍历全部图形；只有画布尺寸、颜色变化或小地图本身改变大小时才整体重画。
+ * 隐藏时不做任何绘制，再次显示时整体重画一次。
+ */
+class MinimapWidget : public QWidget {
+    Q_OBJECT
+
+public:
+    MinimapWidget(CanvasWidget* canvas, QScrollArea* view, QWidget* parent = nullptr);
+    QSize sizeHint() const override { return QSize(240, 180); }
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void showEvent(QShowEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+
+private:
+    void invalidate(const QRectF& dirty);    // 场景坐标，空矩形表示全部
+    void flush();                            // 把积累的变化画到缓存中
+    void rebuild();                          // 整体重画
+    QRect imageRect() const;                 // 缓存图像在控件中的位置（居中）
+    void jumpTo(const QPoint& pos);
+
+    CanvasWidget* m_canvas;
+    QScrollArea* m_view;
+    QImage m_cache;            // 低分辨率场景
+    qreal m_scale = 1;         // 场景 -> 缓存
+    QRegion m_dirty;           // 待重绘的区域（缓存坐标）
+    bool m_fullDirty = true;
+    QTimer m_flushTimer;       // 合并连续的变化
+
+    static const int FLUSH_MS = 33;
+};
+
+#endif // MINIMAPWIDGET_H
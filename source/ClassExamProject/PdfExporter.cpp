@@ -0,0 +1,166 @@
+﻿#include "PdfExporter.h"
+#include "shape.h"
+#include "TraceRecorder.h"
+#include <QPdfWriter>
+#include <QPainter>
+#include <QPicture>
+#include <QRunnable>
+#include <QFile>
+#include <QtMath>
+
+// 画布坐标按96dpi像素处理
+static const qreal SCENE_DPI = 96.0;
+
+class PdfExporter::DriverTask : public QRunnable {
+public:
+    explicit DriverTask(PdfExporter* owner) : m_owner(owner) {}
+    void run() override { m_owner->run(); }
+private:
+    PdfExporter* m_owner;
+};
+
+class PdfExporter::PageTask : public QRunnable {
+public:
+    PageTask(const PdfExporter* owner, int page, QPicture* picture)
+        : m_owner(owner), m_page(page), m_picture(picture) {}
+    void run() override { m_owner->recordPage(m_page, m_picture); }
+private:
+    const PdfExporter* m_owner;
+    int m_page;
+    QPicture* m_picture;
+};
+
+PdfExporter::PdfExporter(const QList<Shape*>& shapes, const QSize& canvasSize,
+    const QColor& background, const Options& options, QObject* parent)
+    : QObject(parent),
+    m_canvasSize(canvasSize),
+    m_background(background),
+    m_options(options),
+    m_cancelled(false)
+{
+    // 复制图形快照，导出期间界面可以继续编辑
+    m_snapshot.reserve(shapes.size());
+    for (const Shape* shape : shapes) {
+        Shape* copy = shape->clone();
+        copy->setSelected(false);
+        copy->worldTransform(); // 预先建立变换缓存，工作线程只读
+        copy->prepareLabel();   // 预先排版标签，跨页的图形可能被两个页面任务同时绘制
+        m_snapshot.append(copy);
+    }
+
+    // 计算每页覆盖的画布区域
+    const qreal margin = m_options.marginMm;
+    QPageLayout layout(m_options.pageSize, m_options.orientation,
+        QMarginsF(margin, margin, margin, margin), QPageLayout::Millimeter);
+    m_tileSize = layout.paintRectPixels(int(SCENE_DPI)).size();
+    const qreal overlap = m_options.overlapMm * SCENE_DPI / 25.4;
+    m_tileStep = QSizeF(qMax<qreal>(1.0, m_tileSize.width() - overlap),
+        qMax<qreal>(1.0, m_tileSize.height() - overlap));
+
+    const qreal w = m_canvasSize.width();
+    const qreal h = m_canvasSize.height();
+    m_columns = w <= m_tileSize.width() ? 1 : 1 + qCeil((w - m_tileSize.width()) / m_tileStep.width());
+    m_rows = h <= m_tileSize.height() ? 1 : 1 + qCeil((h - m_tileSize.height()) / m_tileStep.height());
+
+    // 按图形的外包矩形（含超出外框的标签）分桶到页面，避免每页遍历所有图形
+    m_pageShapes.resize(m_columns * m_rows);
+    for (int i = 0; i < m_snapshot.size(); ++i) {
+        const Shape* shape = m_snapshot[i];
+        const QRectF bounds = shape->contentBounds();
+
+        int c0 = qMax(0, qFloor((bounds.left() - m_tileSize.width()) / m_tileStep.width()) + 1);
+        int c1 = qMin(m_columns - 1, qCeil(bounds.right() / m_tileStep.width()) - 1);
+        int r0 = qMax(0, qFloor((bounds.top() - m_tileSize.height()) / m_tileStep.height()) + 1);
+        int r1 = qMin(m_rows - 1, qCeil(bounds.bottom() / m_tileStep.height()) - 1);
+        for (int r = r0; r <= r1; ++r) {
+            for (int c = c0; c <= c1; ++c) {
+                m_pageShapes[r * m_columns + c].append(i);
+            }
+        }
+    }
+
+    m_driverPool.setMaxThreadCount(1);
+}
+
+PdfExporter::~PdfExporter() {
+    cancel();
+    m_driverPool.waitForDone();
+    m_pagePool.waitForDone();
+    qDeleteAll(m_snapshot);
+}
+
+void PdfExporter::start(const QString& fileName) {
+    m_fileName = fileName;
+    m_cancelled = false;
+    m_driverPool.start(new DriverTask(this));
+}
+
+void PdfExporter::cancel() {
+    m_cancelled = true;
+}
+
+void PdfExporter::recordPage(int page, QPicture* picture) const {
+    TRACE_SCOPE_CAT("PdfExporter::recordPage", "export");
+
+    const int col = page % m_columns;
+    const int row = page / m_columns;
+    const QRectF tile(QPointF(col * m_tileStep.width(), row * m_tileStep.height()), m_tileSize);
+
+    QPainter painter(picture);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setClipRect(QRectF(QPointF(0, 0), m_tileSize));
+    painter.translate(-tile.topLeft());
+    painter.fillRect(tile.intersected(QRectF(QPointF(0, 0), m_canvasSize)), m_background);
+
+    for (int index : m_pageShapes[page]) {
+        if (m_cancelled) break;
+        m_snapshot[index]->draw(&painter);
+    }
+    painter.end();
+}
+
+void PdfExporter::run() {
+    TRACE_SCOPE_CAT("PdfExporter::run", "export");
+
+    QPdfWriter writer(m_fileName);
+    writer.setCreator("Flowchart Painter");
+    writer.setPageSize(m_options.pageSize);
+    writer.setPageOrientation(m_options.orientation);
+    const qreal margin = m_options.marginMm;
+    writer.setPageMargins(QMarginsF(margin, margin, margin, margin), QPageLayout::Millimeter);
+    writer.setResolution(int(SCENE_DPI)); // 与画布像素一一对应
+
+    QPainter painter;
+    if (!painter.begin(&writer)) {
+        emit finished(false, "Failed to open PDF file for writing");
+        return;
+    }
+
+    // 分批并行录制，再按页序写入；每批最多缓存 2×线程数 页
+    const int pageCount = m_columns * m_rows;
+    const int window = qMax(1, m_pagePool.maxThreadCount() * 2);
+    for (int first = 0; first < pageCount && !m_cancelled; first += window) {
+        const int count = qMin(window, pageCount - first);
+        QVector<QPicture> pictures(count);
+        for (int k = 0; k < count; ++k) {
+            m_pagePool.start(new PageTask(this, first + k, pictures.data() + k));
+        }
+        m_pagePool.waitForDone();
+
+        for (int k = 0; k < count && !m_cancelled; ++k) {
+            if (first + k > 0) {
+                writer.newPage();
+            }
+            painter.drawPicture(0, 0, pictures[k]);
+            emit progress(first + k + 1, pageCount);
+        }
+    }
+    painter.end();
+
+    if (m_cancelled) {
+        QFile::remove(m_fileName);
+        emit finished(false, "Export cancelled");
+        return;
+    }
+    emit finished(true, QString());
+}
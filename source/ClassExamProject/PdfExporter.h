@@ -0,0 +1,72 @@
+﻿#ifndef PDFEXPORTER_H
+#define PDFEXPORTER_H
+
+#include <QObject>
+#include <QList>
+#include <QVector>
+#include <QSize>
+#include <QColor>
+#include <QPageSize>
+#include <QPageLayout>
+#include <QThreadPool>
+#include <atomic>
+
+class Shape;
+class QPicture;
+
+/**
+ * 多页矢量PDF导出
+ * 画布按页面大小平铺（可设置重叠），每页只绘制与之相交的图形。
+ * 页面内容在工作线程中录制为QPicture，再按顺序写入QPdfWriter，
+ * 整个过程不阻塞界面线程。
+ */
+class PdfExporter : public QObject {
+    Q_OBJECT
+
+public:
+    struct Options {
+        QPageSize pageSize{ QPageSize::A4 };
+        QPageLayout::Orientation orientation = QPageLayout::Portrait;
+        qreal marginMm = 10;   // 页边距
+        qreal overlapMm = 10;  // 相邻页面的重叠宽度
+    };
+
+    PdfExporter(const QList<Shape*>& shapes, const QSize& canvasSize,
+        const QColor& background, const Options& options, QObject* parent = nullptr);
+    ~PdfExporter();
+
+    void start(const QString& fileName);  // 在后台开始导出
+    void cancel();
+
+signals:
+    void progress(int pagesDone, int pageCount);
+    void finished(bool ok, const QString& error);
+
+private:
+    class DriverTask;
+    class PageTask;
+    friend class DriverTask;
+    friend class PageTask;
+
+    void run();                              // 后台主流程
+    void recordPage(int page, QPicture* picture) const;
+
+    QList<Shape*> m_snapshot;                // 导出时的图形快照（独立副本）
+    QSize m_canvasSize;
+    QColor m_background;
+    Options m_options;
+    QString m_fileName;
+
+    // 分页信息
+    int m_columns = 0;
+    int m_rows = 0;
+    QSizeF m_tileSize;                       // 每页覆盖的画布区域
+    QSizeF m_tileStep;                       // 相邻页起点间距（扣除重叠）
+    QVector<QVector<int>> m_pageShapes;      // 每页相交的图形（按z顺序）
+
+    QThreadPool m_driverPool;                // 运行主流程
+    QThreadPool m_pagePool;                  // 并行录制页面
+    std::atomic<bool> m_cancelled;
+};
+
+#endif // PDFEXPORTER_H
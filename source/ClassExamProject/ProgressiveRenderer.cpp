@@ -0,0 +1,98 @@
+﻿#include "ProgressiveRenderer.h"
+#include "SceneRenderer.h"
+#include "shape.h"
+#include "TraceRecorder.h"
+#include <QElapsedTimer>
+#include <QPainter>
+
+ProgressiveRenderer::ProgressiveRenderer(QObject* parent)
+    : QObject(parent)
+{
+    // 0ms定时器：先处理完已排队的输入和绘制事件再继续
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(0);
+    connect(&m_timer, &QTimer::timeout, this, &ProgressiveRenderer::step);
+}
+
+void ProgressiveRenderer::restart(const QList<Shape*>& shapes, const QSize& size,
+    const QColor& background, bool showGrid, const RenderOptions& options) {
+    cancel();
+    m_shapes = shapes;
+    m_options = options;
+    m_background = background;
+    m_showGrid = showGrid;
+    if (m_back.size() != size) {
+        m_back = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    }
+    // 保留上一轮完成的画面，直到新一轮的外框级别完成后再替换，避免闪烁
+    m_level = BoundsLevel;
+    beginLevel();
+
+    if (!runSlice()) {
+        m_timer.start();
+    }
+}
+
+void ProgressiveRenderer::cancel() {
+    m_timer.stop();
+    m_shapes.clear();
+}
+
+void ProgressiveRenderer::beginLevel() {
+    m_index = 0;
+    m_back.fill(m_background);
+    if (m_showGrid) {
+        QPainter painter(&m_back);
+        SceneRenderer::drawGrid(painter, m_back.size());
+    }
+}
+
+void ProgressiveRenderer::step() {
+    if (!runSlice()) {
+        m_timer.start();
+    }
+    emit frameUpdated();
+}
+
+bool ProgressiveRenderer::runSlice() {
+    TRACE_SCOPE("ProgressiveRenderer::runSlice");
+    QElapsedTimer clock;
+    clock.start();
+
+    while (true) {
+        const int count = m_shapes.size();
+        {
+            QPainter painter(&m_back);
+            RenderOptions options = m_options;
+            options.labels = m_options.labels && m_level == FullLevel;
+            while (m_index < count) {
+                const int end = qMin(count, m_index + CHUNK);
+                const QList<Shape*> chunk = m_shapes.mid(m_index, end - m_index);
+                if (m_level == BoundsLevel) {
+                    SceneRenderer::drawBounds(painter, chunk);
+                }
+                else {
+                    SceneRenderer::drawShapesBatched(painter, chunk, options);
+                }
+                m_index = end;
+                if (clock.elapsed() >= m_budgetMs) break;
+            }
+        }
+        if (m_index < count) {
+            return false; // 时间片用完
+        }
+
+        // 当前级别完成，作为可显示的画面
+        m_front = m_back;
+        m_hasFront = true;
+        if (m_level + 1 >= LevelCount) {
+            m_shapes.clear();
+            return true;
+        }
+        ++m_level;
+        beginLevel();
+        if (clock.elapsed() >= m_budgetMs) {
+            return false;
+        }
+    }
+}
@@ -0,0 +1,69 @@
+﻿#ifndef PROGRESSIVERENDERER_H
+#define PROGRESSIVERENDERER_H
+
+#include <QObject>
+#include <QImage>
+#include <QList>
+#include <QColor>
+#include <QTimer>
+#include "SceneRenderer.h"
+
+class Shape;
+
+/**
+ * 渐进式分时渲染
+ * 每轮依次绘制：外框 -> 填充和边框 -> 完整画面（含文字），
+ * 每个时间片只绘制一部分图形，剩余部分在下一次事件循环中继续，
+ * 期间显示上一级已完成的画面（新一轮第一级完成前沿用上一轮的画面）。
+ * 场景或视图变化时调用 cancel() 中止。
+ */
+class ProgressiveRenderer : public QObject {
+    Q_OBJECT
+
+public:
+    enum Level {
+        BoundsLevel,  // 只画外框
+        BodyLevel,    // 填充和边框，不含文字
+        FullLevel,    // 完整画面
+        LevelCount
+    };
+
+    explicit ProgressiveRenderer(QObject* parent = nullptr);
+
+    // 开始新一轮渲染并立即执行第一个时间片；图形在 cancel() 之前必须保持有效
+    void restart(const QList<Shape*>& shapes, const QSize& size, const QColor& background, bool showGrid,
+        const RenderOptions& options);
+    void cancel();
+    bool isRefining() const { return m_timer.isActive(); }
+    QImage frame() const { return m_hasFront ? m_front : m_back; } // 当前可显示的画面
+
+    void setBudgetMs(int ms) { m_budgetMs = qMax(1, ms); }
+    int budgetMs() const { return m_budgetMs; }
+
+signals:
+    void frameUpdated();
+
+private slots:
+    void step();
+
+private:
+    bool runSlice();       // 执行一个时间片，返回本轮是否结束
+    void beginLevel();     // 清空后台图像，准备绘制当前级别
+
+    static const int CHUNK = 64; // 每次检查时间前绘制的图形数
+
+    QList<Shape*> m_shapes;
+    QColor m_background;
+    bool m_showGrid = true;
+    RenderOptions m_options;   // 完整级别使用的绘制选项
+    int m_budgetMs = 8;
+
+    QImage m_back;          // 正在绘制的级别
+    QImage m_front;         // 最近完成的级别（跨轮保留）
+    bool m_hasFront = false;
+    int m_level = BoundsLevel;
+    int m_index = 0;        // 当前级别下一个要绘制的图形
+    QTimer m_timer;
+};
+
+#endif // PROGRESSIVERENDERER_H
@@ -0,0 +1,175 @@
+﻿#include "RenderBenchmark.h"
+#include "SceneRenderer.h"
+#include "RenderThread.h"
+#include "ShapeGroup.h"
+#include "shape.h"
+#include <QElapsedTimer>
+#include <QImage>
+#include <QPainter>
+#include <QSemaphore>
+#include <QStringList>
+
+namespace {
+
+const int GRID = 100;        // 每个场景 GRID×GRID 个图形
+const int CELL = 20;         // 网格间距
+const int FRAMES = 5;        // 每种模式绘制的帧数
+
+// 生成网格排列的图形；styles 为交替使用的样式数（1表示全部相同）
+QList<Shape*> makeScene(ShapeType type, int styles) {
+    static const Qt::GlobalColor colors[] = { Qt::white, Qt::yellow, Qt::cyan, Qt::green };
+    QList<Shape*> scene;
+    scene.reserve(GRID * GRID);
+    for (int row = 0; row < GRID; ++row) {
+        for (int col = 0; col < GRID; ++col) {
+            QRectF rect(col * CELL + 2, row * CELL + 2, CELL - 6, CELL - 8);
+            Shape* shape = type == ShapeType_Rectangle
+                ? static_cast<Shape*>(new Rectangle(rect))
+                : static_cast<Shape*>(new Ellipse(rect));
+            const int style = (row * GRID + col) % styles;
+            shape->setBrush(QBrush(colors[style % 4]));
+            shape->setPen(QPen(Qt::black, 1 + style / 4));
+            scene.append(shape);
+        }
+    }
+    return scene;
+}
+
+// 返回每帧平均耗时（毫秒）
+double timeScene(const QList<Shape*>& scene, bool batched) {
+    QImage image(GRID * CELL, GRID * CELL, QImage::Format_ARGB32_Premultiplied);
+    QElapsedTimer timer;
+    timer.start();
+    for (int frame = 0; frame < FRAMES; ++frame) {
+        image.fill(Qt::white);
+        QPainter painter(&image);
+        if (batched) {
+            SceneRenderer::drawShapesBatched(painter, scene);
+        }
+        else {
+            SceneRenderer::drawShapes(painter, scene);
+        }
+    }
+    return timer.nsecsElapsed() / 1e6 / FRAMES;
+}
+
+// 网格排列、带单行纯文本标签的图形
+QList<Shape*> makeLabelScene() {
+    QList<Shape*> scene;
+    const int grid = GRID / 2;
+    const int cell = CELL * 2;
+    scene.reserve(grid * grid);
+    for (int row = 0; row < grid; ++row) {
+        for (int col = 0; col < grid; ++col) {
+            Shape* shape = new Rectangle(QRectF(col * cell + 2, row * cell + 2, cell - 4, cell - 4));
+            shape->setText(QString("<p>%1</p>").arg(row * grid + col), QFont("Arial", 8), Qt::black);
+            scene.append(shape);
+        }
+    }
+    return scene;
+}
+
+// 带单行纯文本标签的场景：对比 QTextDocument 与 QStaticText 路径
+QString runLabelScene() {
+    QList<Shape*> scene = makeLabelScene();
+    const int count = scene.size();
+    Shape::setPlainLabelFastPath(false);
+    timeScene(scene, true); // 预热
+    const double document = timeScene(scene, true);
+    Shape::setPlainLabelFastPath(true);
+    timeScene(scene, true); // 建立缓存
+    const double staticText = timeScene(scene, true);
+    qDeleteAll(scene);
+
+    return QString("Plain labels (%1 shapes): %2 ms -> %3 ms (x%4)")
+        .arg(count)
+        .arg(document, 0, 'f', 1)
+        .arg(staticText, 0, 'f', 1)
+        .arg(staticText > 0 ? document / staticText : 0.0, 0, 'f', 2);
+}
+
+// 经后台渲染线程出一帧的平均耗时（毫秒，含界面线程复制图形）
+// sharedCopies 为false时每帧重新复制，副本都要自己排版标签；为true时沿用同一批副本
+double timeThreaded(const QList<Shape*>& scene, bool sharedCopies) {
+    RenderThread thread;
+    QSemaphore done;
+    QObject::connect(&thread, &RenderThread::frameReady, [&done]() { done.release(); });
+
+    QVector<QSharedPointer<Shape> > copies;
+    GroupTree groups;
+    auto submitFrame = [&](quint64 revision) {
+        RenderScene* snapshot = new RenderScene;
+        snapshot->revision = revision;
+        snapshot->size = QSize(GRID * CELL, GRID * CELL);
+        snapshot->background = Qt::white;
+        snapshot->showGrid = false;
+        if (!sharedCopies || copies.isEmpty()) {
+            copies.clear();
+            for (const Shape* shape : scene) {
+                QSharedPointer<Shape> copy(shape->clone());
+                copy->worldTransform();
+                copies.append(copy);
+            }
+        }
+        snapshot->owners = copies;
+        for (const QSharedPointer<Shape>& copy : copies) {
+            snapshot->shapes.append(copy.data());
+        }
+        snapshot->groups = groups.snapshot(snapshot->shapes);
+        thread.submit(snapshot);
+        done.acquire();
+    };
+
+    submitFrame(0); // 预热
+    QElapsedTimer timer;
+    timer.start();
+    for (int frame = 1; frame <= FRAMES; ++frame) {
+        submitFrame(frame);
+    }
+    return timer.nsecsElapsed() / 1e6 / FRAMES;
+}
+
+// 后台渲染路径上的标签：每帧新副本各自排版 -> 副本共享已排好的标签
+QString runThreadedLabelScene() {
+    QList<Shape*> scene = makeLabelScene();
+    const double fresh = timeThreaded(scene, false);
+    const double shared = timeThreaded(scene, true);
+    const int count = scene.size();
+    qDeleteAll(scene);
+
+    return QString("Render thread (%1 shapes): %2 ms -> %3 ms (x%4)")
+        .arg(count)
+        .arg(fresh, 0, 'f', 1)
+        .arg(shared, 0, 'f', 1)
+        .arg(shared > 0 ? fresh / shared : 0.0, 0, 'f', 2);
+}
+
+QString runScene(const QString& name, ShapeType type, int styles) {
+    QList<Shape*> scene = makeScene(type, styles);
+    timeScene(scene, true); // 预热
+    const double single = timeScene(scene, false);
+    const double batched = timeScene(scene, true);
+    qDeleteAll(scene);
+    return QString("%1: %2 ms -> %3 ms (x%4)")
+        .arg(name)
+        .arg(single, 0, 'f', 1)
+        .arg(batched, 0, 'f', 1)
+        .arg(batched > 0 ? single / batched : 0.0, 0, 'f', 2);
+}
+
+} // namespace
+
+QString RenderBenchmark::run() {
+    QStringList lines;
+    lines << QString("%1 shapes per scene, average of %2 frames (unbatched -> batched)")
+        .arg(GRID * GRID).arg(FRAMES);
+    lines << runScene("Identical rectangles", ShapeType_Rectangle, 1);
+    lines << runScene("Identical ellipses", ShapeType_Ellipse, 1);
+    lines << runScene("Rectangles, 8 interleaved styles", ShapeType_Rectangle, 8);
+    lines << QString();
+    lines << "Labels, QTextDocument -> cached QStaticText:";
+    lines << runLabelScene();
+    lines << "Labels, new copies per frame -> copies sharing prepared labels:";
+    lines << runThreadedLabelScene();
+    return lines.join('\n');
+}
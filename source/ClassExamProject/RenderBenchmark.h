@@ -0,0 +1,17 @@
+﻿#ifndef RENDERBENCHMARK_H
+#define RENDERBENCHMARK_H
+
+#include <QString>
+
+/**
+ * 渲染基准测试
+ * 在离屏图像上绘制合成场景，对比逐个绘制与批量绘制、
+ * 以及文字标签 QTextDocument 与 QStaticText 两种路径的耗时；
+ * 另经后台渲染线程对比每帧重新排版与副本共享已排好标签的耗时。
+ */
+class RenderBenchmark {
+public:
+    static QString run();  // 运行全部场景，返回结果文本
+};
+
+#endif // RENDERBENCHMARK_H
@@ -0,0 +1,173 @@
+﻿#include "RenderThread.h"
+#include "SceneRenderer.h"
+#include "shape.h"
+#include "TraceRecorder.h"
+#include <QPainter>
+#include <QRunnable>
+#include <algorithm>
+
+class RenderThread::BandTask : public QRunnable {
+public:
+    BandTask(const RenderScene* scene, uchar* bits, int bytesPerLine, const QRect& band, Layer layer)
+        : m_scene(scene), m_bits(bits), m_bytesPerLine(bytesPerLine), m_band(band), m_layer(layer) {}
+    void run() override { RenderThread::renderBand(*m_scene, m_bits, m_bytesPerLine, m_band, m_layer); }
+private:
+    const RenderScene* m_scene;
+    uchar* m_bits;
+    int m_bytesPerLine;
+    QRect m_band;
+    Layer m_layer;
+};
+
+class RenderThread::LabelTask : public QRunnable {
+public:
+    LabelTask(const RenderScene* scene, int begin, int end)
+        : m_scene(scene), m_begin(begin), m_end(end) {}
+    void run() override {
+        for (int i = m_begin; i < m_end; ++i) {
+            m_scene->shapes[i]->prepareLabel();
+        }
+    }
+private:
+    const RenderScene* m_scene;
+    int m_begin;
+    int m_end;
+};
+
+RenderThread::RenderThread(QObject* parent)
+    : QThread(parent),
+    m_mailbox(nullptr),
+    m_stopping(false)
+{
+}
+
+RenderThread::~RenderThread() {
+    m_stopping = true;
+    m_wake.release();
+    wait();
+    delete m_mailbox.exchange(nullptr);
+}
+
+void RenderThread::submit(RenderScene* scene) {
+    // 替换信箱中的快照；旧快照尚未被取走，说明渲染跟不上，直接丢弃
+    delete m_mailbox.exchange(scene, std::memory_order_acq_rel);
+    m_wake.release();
+    if (!isRunning()) {
+        start();
+    }
+}
+
+QImage RenderThread::latestFrame(quint64* revision) const {
+    QMutexLocker lock(&m_frontLock);
+    if (revision) {
+        *revision = m_frontRevision;
+    }
+    return m_front;
+}
+
+bool RenderThread::latestLayers(quint64 minRevision, QImage* below, QImage* above) const {
+    QMutexLocker lock(&m_frontLock);
+    if (m_layerBelow.isNull() || m_layerRevision < minRevision) return false;
+    *below = m_layerBelow;
+    *above = m_layerAbove;
+    return true;
+}
+
+void RenderThread::run() {
+    while (true) {
+        m_wake.acquire();
+        if (m_stopping) break;
+
+        RenderScene* scene = m_mailbox.exchange(nullptr, std::memory_order_acq_rel);
+        if (!scene) continue; // 多次唤醒对应同一份快照
+        render(*scene);
+        delete scene;
+    }
+}
+
+void RenderThread::render(const RenderScene& scene) {
+    TRACE_SCOPE_CAT("RenderThread::render", "render");
+    if (scene.size.isEmpty()) return;
+    prepareLabels(scene);
+
+    if (scene.liveIndex >= 0) {
+        // 拖动开始：被拖动图形之下和之上的内容各渲染一层，界面线程只画被拖动的图形
+        renderImage(scene, m_backBelow, BelowLive);
+        renderImage(scene, m_backAbove, AboveLive);
+        QMutexLocker lock(&m_frontLock);
+        qSwap(m_layerBelow, m_backBelow);
+        qSwap(m_layerAbove, m_backAbove);
+        m_layerRevision = scene.revision;
+    }
+    else {
+        renderImage(scene, m_back, WholeScene);
+        QMutexLocker lock(&m_frontLock);
+        qSwap(m_front, m_back);
+        m_frontRevision = scene.revision;
+    }
+    emit frameReady();
+}
+
+void RenderThread::prepareLabels(const RenderScene& scene) {
+    // 各条带按标签的实际范围裁剪，须先排版；副本在快照之间复用，只有新副本需要排版
+    TRACE_SCOPE_CAT("RenderThread::prepareLabels", "render");
+    const int count = scene.shapes.size();
+    const int chunk = qMax(256, (count + m_bandPool.maxThreadCount() - 1) / qMax(1, m_bandPool.maxThreadCount()));
+    for (int begin = 0; begin < count; begin += chunk) {
+        m_bandPool.start(new LabelTask(&scene, begin, qMin(count, begin + chunk)));
+    }
+    m_bandPool.waitForDone();
+}
+
+void RenderThread::renderImage(const RenderScene& scene, QImage& target, Layer layer) {
+    if (target.size() != scene.size) {
+        target = QImage(scene.size, QImage::Format_ARGB32_Premultiplied);
+    }
+    uchar* bits = target.bits(); // 与界面线程持有的旧帧分离，之后各条带直接写入
+    const int bytesPerLine = target.bytesPerLine();
+
+    const int height = scene.size.height();
+    const int bandCount = qBound(1, m_bandPool.maxThreadCount(), height / MIN_BAND_HEIGHT);
+    const int bandHeight = (height + bandCount - 1) / bandCount;
+    for (int top = 0; top < height; top += bandHeight) {
+        QRect band(0, top, scene.size.width(), qMin(bandHeight, height - top));
+        m_bandPool.start(new BandTask(&scene, bits + top * bytesPerLine, bytesPerLine, band, layer));
+    }
+    m_bandPool.waitForDone();
+}
+
+void RenderThread::renderBand(const RenderScene& scene, uchar* bits, int bytesPerLine, const QRect& band, Layer layer) {
+    TRACE_SCOPE_CAT("RenderThread::renderBand", "render");
+    QImage image(bits, band.width(), band.height(), bytesPerLine, QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&image);
+    painter.translate(0, -band.top());
+    painter.setClipRect(band);
+    if (layer == AboveLive) {
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.fillRect(band, Qt::transparent);
+        painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    }
+    else {
+        painter.fillRect(band, scene.background);
+        if (scene.showGrid) {
+            SceneRenderer::drawGrid(painter, scene.size);
+        }
+    }
+
+    // 只绘制与本条带相交的图形：外框不相交的组整组跳过，其余逐个检查
+    // （标签按排版后的实际范围，选中的图形含控制点）
+    QVector<int> candidates;
+    scene.groups.collect(band, &candidates);
+    std::sort(candidates.begin(), candidates.end()); // 恢复z顺序
+    QList<Shape*> visible;
+    visible.reserve(candidates.size());
+    for (int index : candidates) {
+        if (layer == BelowLive && index >= scene.liveIndex) break;
+        if (layer == AboveLive && index <= scene.liveIndex) continue;
+        Shape* shape = scene.shapes[index];
+        if (shape->visualBounds().intersects(band)) {
+            visible.append(shape);
+        }
+    }
+    SceneRenderer::drawShapesBatched(painter, visible, scene.options);
+}
@@ -0,0 +1,85 @@
+﻿#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include <QThread>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QMutex>
+#include <QImage>
+#include <QList>
+#include <QColor>
+#include <QSharedPointer>
+#include <atomic>
+#include "SceneRenderer.h"
+#include "ShapeGroup.h"
+
+class Shape;
+
+/**
+ * 不可变的场景快照，由界面线程创建、渲染线程销毁
+ * 图形为独立副本，未变化的图形在相邻快照之间共用同一个副本（提交后不再修改）
+ */
+struct RenderScene {
+    quint64 revision = 0;
+    QSize size;
+    QColor background;
+    bool showGrid = true;
+    RenderOptions options;
+    QList<Shape*> shapes;  // 按z顺序
+    QVector<QSharedPointer<Shape> > owners;  // 持有 shapes 中的副本
+    GroupSnapshot groups;  // 分组外框，条带按它跳过整组
+    int liveIndex = -1;    // >=0 时只渲染拖动用的分层：该图形之下（含背景）和之上（透明）
+};
+
+/**
+ * 后台渲染线程
+ * 界面线程通过单槽无锁信箱提交最新快照（未开始的旧快照直接丢弃），
+ * 渲染线程将快照按水平条带分配给线程池绘制到后台缓冲，
+ * 完成后与前台缓冲交换并发出 frameReady()；paintEvent 只需贴图。
+ */
+class RenderThread : public QThread {
+    Q_OBJECT
+
+public:
+    explicit RenderThread(QObject* parent = nullptr);
+    ~RenderThread();
+
+    void submit(RenderScene* scene);                        // 接管快照所有权
+    QImage latestFrame(quint64* revision = nullptr) const;  // 最近完成的一帧
+    // 最近完成的分层（版本不低于 minRevision 时返回true）
+    bool latestLayers(quint64 minRevision, QImage* below, QImage* above) const;
+
+signals:
+    void frameReady();
+
+protected:
+    void run() override;
+
+private:
+    class BandTask;
+    class LabelTask;
+    enum Layer { WholeScene, BelowLive, AboveLive };
+    void render(const RenderScene& scene);
+    void prepareLabels(const RenderScene& scene);
+    void renderImage(const RenderScene& scene, QImage& target, Layer layer);
+    static void renderBand(const RenderScene& scene, uchar* bits, int bytesPerLine, const QRect& band, Layer layer);
+
+    static const int MIN_BAND_HEIGHT = 64;
+
+    std::atomic<RenderScene*> m_mailbox;  // 待渲染的最新快照
+    std::atomic<bool> m_stopping;
+    QSemaphore m_wake;
+    QThreadPool m_bandPool;
+
+    QImage m_back;                         // 仅渲染线程访问
+    QImage m_backBelow;
+    QImage m_backAbove;
+    mutable QMutex m_frontLock;
+    QImage m_front;
+    quint64 m_frontRevision = 0;
+    QImage m_layerBelow;                   // 拖动用的分层
+    QImage m_layerAbove;
+    quint64 m_layerRevision = 0;
+};
+
+#endif // RENDERTHREAD_H
@@ -0,0 +1,161 @@
+﻿#include "RichLabel.h"
+#include <QTextDocument>
+#include <QTextCursor>
+#include <QTextBlock>
+#include <QDataStream>
+#include <QHash>
+#include <QMutex>
+
+namespace {
+
+// 全局格式表：按序列化内容去重
+struct FormatTable {
+    QMutex mutex;
+    QVector<QTextCharFormat> formats;
+    QHash<QByteArray, int> index;
+};
+
+FormatTable& formatTable() {
+    static FormatTable table;
+    return table;
+}
+
+} // namespace
+
+int RichLabel::internFormat(const QTextCharFormat& format) {
+    QByteArray key;
+    {
+        QDataStream out(&key, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_15);
+        out << static_cast<const QTextFormat&>(format);
+    }
+
+    FormatTable& table = formatTable();
+    QMutexLocker lock(&table.mutex);
+    QHash<QByteArray, int>::const_iterator it = table.index.constFind(key);
+    if (it != table.index.constEnd())
+        return it.value();
+
+    const int index = table.formats.size();
+    table.formats.append(format);
+    table.index.insert(key, index);
+    return index;
+}
+
+QTextCharFormat RichLabel::format(int index) {
+    FormatTable& table = formatTable();
+    QMutexLocker lock(&table.mutex);
+    return index >= 0 && index < table.formats.size() ? table.formats[index] : QTextCharFormat();
+}
+
+int RichLabel::formatCount() {
+    FormatTable& table = formatTable();
+    QMutexLocker lock(&table.mutex);
+    return table.formats.size();
+}
+
+RichLabel::RichLabel(const QString& text, const QVector<Run>& runs)
+    : m_text(text)
+{
+    // 丢弃越界或重叠的区段（例如损坏的文件）
+    int end = 0;
+    for (const Run& run : runs) {
+        if (run.start < end || run.length <= 0 || run.start + run.length > m_text.size()
+            || run.format < 0 || run.format >= formatCount()) {
+            continue;
+        }
+        m_runs.append(run);
+        end = run.start + run.length;
+    }
+}
+
+void RichLabel::appendRun(int start, int length, int format) {
+    // 与上一区段格式相同且紧邻，或中间只隔一个段落分隔符，则合并
+    // （隔着其他无格式字符时不能合并，否则那些字符会带上格式）
+    if (!m_runs.isEmpty()) {
+        Run& last = m_runs.last();
+        const int end = last.start + last.length;
+        const bool adjacent = end >= start
+            || (end == start - 1 && m_text.at(start - 1) == QLatin1Char('\n'));
+        if (last.format == format && adjacent) {
+            last.length = start + length - last.start;
+            return;
+        }
+    }
+    Run run = { start, length, format };
+    m_runs.append(run);
+}
+
+RichLabel RichLabel::fromDocument(const QTextDocument* document) {
+    RichLabel label;
+    for (QTextBlock block = document->begin(); block.isValid(); block = block.next()) {
+        if (block != document->begin()) {
+            label.m_text += QLatin1Char('\n');
+        }
+        for (QTextBlock::iterator it = block.begin(); !it.atEnd(); ++it) {
+            const QTextFragment fragment = it.fragment();
+            const int start = label.m_text.size();
+            label.m_text += fragment.text();
+
+            const QTextCharFormat format = fragment.charFormat();
+            if (!format.properties().isEmpty()) {
+                label.appendRun(start, fragment.length(), internFormat(format));
+            }
+        }
+    }
+
+    // 只有空段落的文档视为无标签
+    if (label.m_text.trimmed().isEmpty()) {
+        return RichLabel();
+    }
+    return label;
+}
+
+RichLabel RichLabel::fromHtml(const QString& html) {
+    if (html.isEmpty()) return RichLabel();
+    QTextDocument document;
+    document.setHtml(html);
+    return fromDocument(&document);
+}
+
+void RichLabel::toDocument(QTextDocument* document) const {
+    QTextCursor cursor(document);
+    cursor.movePosition(QTextCursor::End);
+
+    // insertText 会把 '\n' 转换为新段落
+    int pos = 0;
+    for (const Run& run : m_runs) {
+        if (run.start > pos) {
+            cursor.insertText(m_text.mid(pos, run.start - pos), QTextCharFormat());
+        }
+        cursor.insertText(m_text.mid(run.start, run.length), format(run.format));
+        pos = run.start + run.length;
+    }
+    if (pos < m_text.size()) {
+        cursor.insertText(m_text.mid(pos), QTextCharFormat());
+    }
+}
+
+QString RichLabel::cacheKey() const {
+    QString key = m_text;
+    for (const Run& run : m_runs) {
+        key += QString("\x1f%1,%2,%3").arg(run.start).arg(run.length).arg(run.format);
+    }
+    return key;
+}
+
+int RichLabel::memoryBytes() const {
+    return int(sizeof(RichLabel)) + m_text.size() * int(sizeof(QChar)) + m_runs.size() * int(sizeof(Run));
+}
+
+bool RichLabel::operator==(const RichLabel& other) const {
+    if (m_text != other.m_text || m_runs.size() != other.m_runs.size())
+        return false;
+    for (int i = 0; i < m_runs.size(); ++i) {
+        const Run& a = m_runs[i];
+        const Run& b = other.m_runs[i];
+        if (a.start != b.start || a.length != b.length || a.format != b.format)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+﻿#ifndef RICHLABEL_H
+#define RICHLABEL_H
+
+#include <QString>
+#include <QVector>
+#include <QTextCharFormat>
+
+class QTextDocument;
+
+/**
+ * 紧凑的富文本标签：纯文本 + 格式区段
+ * 区段引用全局共享的格式表，相同的字符格式在整个程序中只保存一份，
+ * 不再为每个图形保存完整的HTML。段落之间以 '\n' 分隔，
+ * 未被区段覆盖的文字使用默认格式（图形的字体和颜色）。
+ */
+class RichLabel {
+public:
+    struct Run {
+        qint32 start;
+        qint32 length;
+        qint32 format;  // 共享格式表中的下标
+    };
+
+    RichLabel() {}
+    RichLabel(const QString& text, const QVector<Run>& runs);
+
+    static RichLabel fromDocument(const QTextDocument* document);
+    static RichLabel fromHtml(const QString& html);   // 迁移旧版本的HTML标签
+    void toDocument(QTextDocument* document) const;   // 追加到文档末尾（通常为空文档）
+
+    bool isEmpty() const { return m_text.isEmpty(); }
+    const QString& text() const { return m_text; }
+    const QVector<Run>& runs() const { return m_runs; }
+    QString cacheKey() const;                         // 内容相同则键相同
+    int memoryBytes() const;                          // 估计占用的内存（不含共享格式）
+
+    bool operator==(const RichLabel& other) const;
+    bool operator!=(const RichLabel& other) const { return !(*this == other); }
+
+    // 共享格式表（线程安全，只增不减）
+    static int internFormat(const QTextCharFormat& format);
+    static QTextCharFormat format(int index);
+    static int formatCount();
+
+private:
+    void appendRun(int start, int length, int format);
+
+    QString m_text;
+    QVector<Run> m_runs;  // 按起点排序，互不重叠
+};
+
+#endif // RICHLABEL_H
@@ -0,0 +1,210 @@
+﻿#include "SceneRenderer.h"
+#include "shape.h"
+#include "TraceRecorder.h"
+#include <QPainter>
+#include <QPainterPath>
+
+void SceneRenderer::drawShapes(QPainter& painter, const QList<Shape*>& shapes,
+    const RenderOptions& options) {
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing, options.antialiasing);
+    for (Shape* shape : shapes) {
+        drawShape(painter, shape, options);
+    }
+    painter.restore();
+}
+
+void SceneRenderer::drawGrid(QPainter& painter, const QSize& size) {
+    painter.setPen(QPen(Qt::lightGray, 1, Qt::DotLine));
+    for (int x = 0; x < size.width(); x += GRID_SIZE) {
+        painter.drawLine(x, 0, x, size.height());
+    }
+    for (int y = 0; y < size.height(); y += GRID_SIZE) {
+        painter.drawLine(0, y, size.width(), y);
+    }
+}
+
+bool SceneRenderer::isBatchable(const Shape* shape) {
+    // 选中的图形要画控制点，旋转的图形需要单独的变换
+    return !shape->isSelected() && qFuzzyIsNull(shape->getRotation());
+}
+
+bool SceneRenderer::isCompatible(const Shape* first, const Shape* shape, const RenderOptions& options) {
+    return shape->type == first->type
+        && isBatchable(shape)
+        && strokePen(shape, options) == strokePen(first, options)
+        && shape->brush() == first->brush();
+}
+
+QPen SceneRenderer::strokePen(const Shape* shape, const RenderOptions& options) {
+    QPen pen = shape->pen();
+    if (options.hairlines && pen.style() != Qt::NoPen) {
+        return QPen(pen.color(), 0, Qt::SolidLine); // 宽度0为1像素细线
+    }
+    return pen;
+}
+
+void SceneRenderer::drawLabelPlaceholder(QPainter& painter, const Shape* shape) {
+    if (!shape->hasText()) return;
+
+    // 按字号估计一行文字的高度，画一条半透明色块
+    const QFont font = shape->textFont();
+    const qreal lineHeight = font.pixelSize() > 0 ? font.pixelSize() : font.pointSizeF() * 96 / 72;
+    const QRectF& rect = shape->boundingRect;
+    QRectF bar(0, 0, rect.width() * 0.6, qMin(lineHeight, rect.height() * 0.8));
+    bar.moveCenter(rect.center());
+
+    QColor color = shape->textColor();
+    color.setAlpha(80);
+    painter.save();
+    painter.setWorldTransform(shape->worldTransform(), true);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(color);
+    painter.drawRect(bar);
+    painter.restore();
+}
+
+void SceneRenderer::drawBounds(QPainter& painter, const QList<Shape*>& shapes) {
+    painter.save();
+    painter.setPen(QPen(Qt::gray, 0)); // 细线
+    painter.setBrush(Qt::NoBrush);
+    for (const Shape* shape : shapes) {
+        painter.drawPolygon(shape->worldTransform().map(QPolygonF(shape->boundingRect)));
+    }
+    painter.restore();
+}
+
+void SceneRenderer::drawShape(QPainter& painter, Shape* shape, const RenderOptions& options) {
+    if (options.labels && !options.hairlines && !options.placeholderText) {
+        shape->draw(&painter);
+        return;
+    }
+
+    if (options.hairlines) {
+        // 填充和细线边框一次画完
+        painter.save();
+        painter.setWorldTransform(shape->worldTransform(), true);
+        painter.setPen(strokePen(shape, options));
+        painter.setBrush(shape->brush());
+        shape->drawOutline(&painter);
+        painter.restore();
+    }
+    else {
+        shape->drawBody(&painter);
+    }
+    if (options.controlHandles && shape->isSelected()) {
+        shape->drawControlHandles(&painter);
+    }
+    if (options.labels) {
+        if (options.placeholderText) {
+            drawLabelPlaceholder(painter, shape);
+        }
+        else {
+            shape->drawLabel(&painter);
+        }
+    }
+}
+
+void SceneRenderer::drawShapesBatched(QPainter& painter, const QList<Shape*>& shapes,
+    const RenderOptions& options) {
+    TRACE_SCOPE("SceneRenderer::drawShapesBatched");
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing, options.antialiasing);
+    QVector<QRectF> bounds;  // 当前批内各图形的外包矩形
+    QVector<QRectF> rects;   // drawRects 用的缓冲，跨批复用
+    bounds.reserve(MAX_BATCH);
+
+    const int count = shapes.size();
+    int begin = 0;
+    while (begin < count) {
+        const Shape* first = shapes[begin];
+        int end = begin + 1;
+        if (isBatchable(first) && !(options.labels && first->hasText())) {
+            QRectF covered = first->paintBounds();
+            bounds.clear();
+            bounds.append(covered);
+
+            while (end < count && end - begin < MAX_BATCH) {
+                const Shape* shape = shapes[end];
+                if (!isCompatible(first, shape, options)) break;
+
+                // 与批内图形重叠时，合并绘制会改变填充和边框的先后关系
+                const QRectF b = shape->paintBounds();
+                bool overlaps = false;
+                if (covered.intersects(b)) {
+                    for (const QRectF& other : bounds) {
+                        if (other.intersects(b)) {
+                            overlaps = true;
+                            break;
+                        }
+                    }
+                }
+                if (overlaps) break;
+
+                covered |= b;
+                bounds.append(b);
+                ++end;
+                // 文字画在批次最后，之后的图形不能再并入
+                if (options.labels && shape->hasText()) break;
+            }
+        }
+
+        drawBatch(painter, shapes, begin, end, options, rects);
+        begin = end;
+    }
+    painter.restore();
+}
+
+void SceneRenderer::drawBatch(QPainter& painter, const QList<Shape*>& shapes, int begin, int end,
+    const RenderOptions& options, QVector<QRectF>& rects) {
+    if (end - begin == 1) {
+        drawShape(painter, shapes[begin], options);
+        return;
+    }
+
+    const Shape* first = shapes[begin];
+    const QPen pen = strokePen(first, options);
+    painter.save();
+
+    if (first->type == ShapeType_Rectangle) {
+        rects.clear();
+        for (int i = begin; i < end; ++i) {
+            rects.append(shapes[i]->boundingRect);
+        }
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(first->brush());
+        painter.drawRects(rects.constData(), rects.size());
+        if (pen.style() != Qt::NoPen) {
+            painter.setPen(pen);
+            painter.setBrush(Qt::NoBrush);
+            painter.drawRects(rects.constData(), rects.size());
+        }
+    }
+    else {
+        QPainterPath path;
+        path.setFillRule(Qt::WindingFill);
+        for (int i = begin; i < end; ++i) {
+            shapes[i]->addOutline(path);
+        }
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(first->brush());
+        painter.drawPath(path);
+        if (pen.style() != Qt::NoPen) {
+            painter.setPen(pen);
+            painter.setBrush(Qt::NoBrush);
+            painter.drawPath(path);
+        }
+    }
+
+    painter.restore();
+
+    // 只有批次最后一个图形可能带文字
+    if (options.labels) {
+        if (options.placeholderText) {
+            drawLabelPlaceholder(painter, shapes[end - 1]);
+        }
+        else {
+            shapes[end - 1]->drawLabel(&painter);
+        }
+    }
+}
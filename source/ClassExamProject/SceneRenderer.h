@@ -0,0 +1,52 @@
+﻿#ifndef SCENERENDERER_H
+#define SCENERENDERER_H
+
+#include <QList>
+#include <QVector>
+#include <QRectF>
+#include <QSize>
+
+class Shape;
+class QPainter;
+
+/**
+ * 绘制选项（默认为完整质量）
+ */
+struct RenderOptions {
+    bool labels = true;            // 是否绘制文字标签
+    bool antialiasing = true;      // 抗锯齿
+    bool hairlines = false;        // 边框一律画成1像素实线
+    bool placeholderText = false;  // 文字用占位色块代替（不排版）
+    bool controlHandles = true;    // 画出选中图形的控制点（缩略图、小地图不需要）
+};
+
+/**
+ * 图形列表绘制
+ * 批量模式下，按z顺序相邻、类型/画笔/画刷相同且未旋转的图形
+ * 合并为一次 drawRects / drawPath 调用，减少QPainter状态切换。
+ * 批内图形互不重叠，因此先统一填充再统一描边与逐个绘制结果一致。
+ */
+class SceneRenderer {
+public:
+    static void drawShapes(QPainter& painter, const QList<Shape*>& shapes,
+        const RenderOptions& options = RenderOptions());                           // 逐个绘制
+    static void drawShapesBatched(QPainter& painter, const QList<Shape*>& shapes,
+        const RenderOptions& options = RenderOptions());                           // 批量绘制
+    static void drawBounds(QPainter& painter, const QList<Shape*>& shapes);        // 只画外框（粗略预览）
+    static void drawGrid(QPainter& painter, const QSize& size);                    // 背景网格
+
+    static const int GRID_SIZE = 20;  // 网格间距（吸附网格时使用同一间距）
+
+private:
+    static bool isBatchable(const Shape* shape);
+    static bool isCompatible(const Shape* first, const Shape* shape, const RenderOptions& options);
+    static QPen strokePen(const Shape* shape, const RenderOptions& options);
+    static void drawLabelPlaceholder(QPainter& painter, const Shape* shape);
+    static void drawShape(QPainter& painter, Shape* shape, const RenderOptions& options);
+    static void drawBatch(QPainter& painter, const QList<Shape*>& shapes, int begin, int end,
+        const RenderOptions& options, QVector<QRectF>& rects);
+
+    static const int MAX_BATCH = 512; // 限制重叠检测的开销
+};
+
+#endif // SCENERENDERER_H
@@ -0,0 +1,64 @@
+﻿#include "SearchBenchmark.h"
+#include "TextIndex.h"
+#include "shape.h"
+#include <QElapsedTimer>
+#include <QStringList>
+
+namespace {
+
+const int SHAPES = 100000;
+const int QUERIES = 200;     // 每种查询重复的次数
+
+// 查询的平均耗时（毫秒）和命中数
+QString timeQuery(const TextIndex& index, const QString& name, const QString& text) {
+    int hits = index.find(text).size(); // 预热
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < QUERIES; ++i) {
+        hits = index.find(text).size();
+    }
+    return QString("  %1 \"%2\": %3 ms, %4 hits")
+        .arg(name)
+        .arg(text)
+        .arg(timer.nsecsElapsed() / 1e6 / QUERIES, 0, 'f', 3)
+        .arg(hits);
+}
+
+} // namespace
+
+QString SearchBenchmark::run() {
+    static const char* const steps[] = { "approval", "review", "draft", "archive" };
+    QList<Shape*> shapes;
+    shapes.reserve(SHAPES);
+    for (int i = 0; i < SHAPES; ++i) {
+        Shape* shape = new Rectangle(QRectF(i % 300 * 30, i / 300 * 30, 26, 24));
+        const QString text = QString("%1 step %2").arg(QLatin1String(steps[i % 4])).arg(i);
+        shape->setLabel(RichLabel(text, QVector<RichLabel::Run>()), QFont("Arial", 8), Qt::black);
+        shapes.append(shape);
+    }
+
+    TextIndex index;
+    QElapsedTimer timer;
+    timer.start();
+    for (Shape* shape : shapes) {
+        index.insert(shape);
+    }
+    const double build = timer.nsecsElapsed() / 1e6;
+
+    QStringList lines;
+    lines << QString("%1 labelled shapes, %2 distinct words, index built in %3 ms")
+        .arg(index.shapeCount()).arg(index.tokenCount()).arg(build, 0, 'f', 1);
+    lines << QString("Average query time over %1 runs:").arg(QUERIES);
+    lines << timeQuery(index, "Exact", "approval step 4711 ");
+    lines << timeQuery(index, "Prefix", "approval step 471");
+    lines << timeQuery(index, "Common words", "step ");
+    lines << timeQuery(index, "No words", "-");
+
+    timer.restart();
+    for (Shape* shape : shapes) {
+        index.remove(shape);
+    }
+    lines << QString("Removed all shapes in %1 ms").arg(timer.nsecsElapsed() / 1e6, 0, 'f', 1);
+    qDeleteAll(shapes);
+    return lines.join('\n');
+}
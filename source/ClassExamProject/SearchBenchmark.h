@@ -0,0 +1,16 @@
+﻿#ifndef SEARCHBENCHMARK_H
+#define SEARCHBENCHMARK_H
+
+#include <QString>
+
+/**
+ * 标签查找基准测试
+ * 为约10万个带标签的图形建立倒排索引，测量建立、查询（精确词、
+ * 多词、前缀、无词可查）和逐个删除的耗时。
+ */
+class SearchBenchmark {
+public:
+    static QString run();  // 运行测试，返回结果文本
+};
+
+#endif // SEARCHBENCHMARK_H
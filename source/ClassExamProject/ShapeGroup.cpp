@@ -0,0 +1,429 @@
+﻿#include "ShapeGroup.h"
+#include "shape.h"
+#include <QRandomGenerator>
+#include <QDebug>
+#include <QtMath>
+#include <algorithm>
+
+GroupTree::~GroupTree() {
+    clear();
+}
+
+void GroupTree::clear() {
+    ++m_revision;
+    qDeleteAll(m_groups);
+    m_groups.clear();
+    m_shapeGroup.clear();
+    m_loose.clear();
+    m_cells.clear();
+    m_largeLoose.clear();
+}
+
+void GroupTree::addShape(Shape* shape) {
+    ++m_revision;
+    if (!m_shapeGroup.contains(shape) && !m_loose.contains(shape)) {
+        insertLoose(shape);
+    }
+}
+
+ShapeGroup* GroupTree::create(const QVector<Shape*>& shapes, const QVector<ShapeGroup*>& groups, quint64 id) {
+    ++m_revision;
+    if (shapes.size() + groups.size() < 2) return nullptr;
+
+    ShapeGroup* group = new ShapeGroup;
+    group->id = id;
+    while (group->id == 0 || m_groups.contains(group->id)) {
+        group->id = QRandomGenerator::global()->generate64();
+    }
+    m_groups.insert(group->id, group);
+
+    // 新组放在成员原来所在的层级下（成员须在同一层级，通常是顶层）
+    ShapeGroup* parent = !shapes.isEmpty() ? groupOf(shapes.first()) : groups.first()->parent;
+    for (Shape* shape : shapes) {
+        if (ShapeGroup* old = groupOf(shape)) {
+            old->shapes.removeOne(shape);
+            invalidate(old);
+        }
+        else {
+            removeLoose(shape);
+        }
+        m_shapeGroup.insert(shape, group);
+        group->shapes.append(shape);
+    }
+    for (ShapeGroup* child : groups) {
+        detach(child);
+        child->parent = group;
+        group->groups.append(child);
+    }
+    if (parent) {
+        group->parent = parent;
+        parent->groups.append(group);
+        invalidate(parent);
+    }
+    return group;
+}
+
+void GroupTree::dissolve(ShapeGroup* group) {
+    ++m_revision;
+    ShapeGroup* parent = group->parent;
+    for (Shape* shape : group->shapes) {
+        if (parent) {
+            m_shapeGroup.insert(shape, parent);
+            parent->shapes.append(shape);
+        }
+        else {
+            m_shapeGroup.remove(shape);
+            insertLoose(shape);
+        }
+    }
+    for (ShapeGroup* child : group->groups) {
+        child->parent = parent;
+        if (parent) {
+            parent->groups.append(child);
+        }
+    }
+    group->shapes.clear();
+    group->groups.clear();
+    destroy(group);
+}
+
+void GroupTree::removeShape(Shape* shape) {
+    ++m_revision;
+    removeLoose(shape);
+    ShapeGroup* group = m_shapeGroup.take(shape);
+    if (!group) return;
+    group->shapes.removeOne(shape);
+    invalidate(group);
+
+    // 删空的组逐级删除（只剩一个成员的组保留）
+    while (group && group->shapes.isEmpty() && group->groups.isEmpty()) {
+        ShapeGroup* parent = group->parent;
+        destroy(group);
+        group = parent;
+    }
+}
+
+ShapeGroup* GroupTree::rootOf(const Shape* shape) const {
+    ShapeGroup* group = groupOf(shape);
+    while (group && group->parent) {
+        group = group->parent;
+    }
+    return group;
+}
+
+void GroupTree::collectShapes(const ShapeGroup* group, QList<Shape*>* shapes) {
+    for (Shape* shape : group->shapes) {
+        shapes->append(shape);
+    }
+    for (const ShapeGroup* child : group->groups) {
+        collectShapes(child, shapes);
+    }
+}
+
+QRectF GroupTree::bounds(const ShapeGroup* group) const {
+    if (!group->boundsValid) {
+        QRectF bounds;
+        for (const Shape* shape : group->shapes) {
+            bounds |= shape->contentBounds();
+        }
+        for (const ShapeGroup* child : group->groups) {
+            bounds |= this->bounds(child);
+        }
+        group->bounds = bounds;
+        group->boundsValid = true;
+    }
+    return group->bounds;
+}
+
+void GroupTree::shapeChanged(const Shape* shape) {
+    if (ShapeGroup* group = groupOf(shape)) {
+        invalidate(group);
+    }
+    else {
+        relocateLoose(const_cast<Shape*>(shape)); // 只用作表中的键
+    }
+}
+
+void GroupTree::invalidateAll() {
+    for (ShapeGroup* group : m_groups) {
+        group->boundsValid = false;
+    }
+    const QList<Shape*> loose = m_loose.keys();
+    for (Shape* shape : loose) {
+        relocateLoose(shape);
+    }
+}
+
+QRectF GroupTree::indexBounds(const Shape* shape) {
+    // 未分组图形的控制点即使未选中也能命中（半径10），一并计入
+    QRectF bounds = shape->contentBounds();
+    for (const Shape::ControlHandle& handle : shape->getControlHandles()) {
+        bounds |= QRectF(handle.pos - QPointF(10, 10), QSizeF(20, 20));
+    }
+    return bounds;
+}
+
+QRect GroupTree::cellsOf(const QRectF& bounds) {
+    return QRect(QPoint(qFloor(bounds.left() / CELL_SIZE), qFloor(bounds.top() / CELL_SIZE)),
+        QPoint(qFloor(bounds.right() / CELL_SIZE), qFloor(bounds.bottom() / CELL_SIZE)));
+}
+
+void GroupTree::insertLoose(Shape* shape) {
+    LooseEntry entry;
+    entry.bounds = indexBounds(shape);
+    entry.cells = cellsOf(entry.bounds);
+    if (qint64(entry.cells.width()) * entry.cells.height() > MAX_CELLS) {
+        entry.cells = QRect();
+        m_largeLoose.insert(shape);
+    }
+    else {
+        for (int y = entry.cells.top(); y <= entry.cells.bottom(); ++y) {
+            for (int x = entry.cells.left(); x <= entry.cells.right(); ++x) {
+                m_cells[cellKey(x, y)].append(shape);
+            }
+        }
+    }
+    m_loose.insert(shape, entry);
+}
+
+void GroupTree::removeLoose(Shape* shape) {
+    const auto it = m_loose.find(shape);
+    if (it == m_loose.end()) return;
+    const QRect cells = it->cells;
+    m_loose.erase(it);
+    if (!cells.isValid()) {
+        m_largeLoose.remove(shape);
+        return;
+    }
+    for (int y = cells.top(); y <= cells.bottom(); ++y) {
+        for (int x = cells.left(); x <= cells.right(); ++x) {
+            const auto cell = m_cells.find(cellKey(x, y));
+            if (cell == m_cells.end()) continue;
+            cell->removeOne(shape);
+            if (cell->isEmpty()) {
+                m_cells.erase(cell);
+            }
+        }
+    }
+}
+
+void GroupTree::relocateLoose(Shape* shape) {
+    const auto it = m_loose.find(shape);
+    if (it == m_loose.end()) return;
+    const QRectF bounds = indexBounds(shape);
+    const QRect cells = cellsOf(bounds);
+    if (it->cells.isValid() && cells == it->cells) {
+        it->bounds = bounds; // 仍在原来的格子里（拖动时的常见情况）
+        return;
+    }
+    removeLoose(shape);
+    insertLoose(shape);
+}
+
+void GroupTree::query(const QRectF& area, QList<Shape*>* shapes) const {
+    queryLoose(area, shapes);
+    queryGroups(area, shapes);
+}
+
+void GroupTree::queryLoose(const QRectF& area, QList<Shape*>* shapes) const {
+    for (Shape* shape : m_largeLoose) {
+        if (m_loose.value(shape).bounds.intersects(area)) {
+            shapes->append(shape);
+        }
+    }
+    const QRect range = cellsOf(area);
+    if (qint64(range.width()) * range.height() > m_cells.size()) {
+        // 区域覆盖的格子比有图形的格子还多（如整体重绘），直接逐个检查
+        for (auto it = m_loose.cbegin(); it != m_loose.cend(); ++it) {
+            if (it->cells.isValid() && it->bounds.intersects(area)) {
+                shapes->append(it.key());
+            }
+        }
+        return;
+    }
+    for (int y = range.top(); y <= range.bottom(); ++y) {
+        for (int x = range.left(); x <= range.right(); ++x) {
+            const auto cell = m_cells.constFind(cellKey(x, y));
+            if (cell == m_cells.cend()) continue;
+            for (Shape* shape : *cell) {
+                // 跨越多个格子的图形只在与查询范围重叠的第一个格子里报告
+                const LooseEntry& entry = *m_loose.constFind(shape);
+                if (qMax(entry.cells.left(), range.left()) != x || qMax(entry.cells.top(), range.top()) != y) continue;
+                if (entry.bounds.intersects(area)) {
+                    shapes->append(shape);
+                }
+            }
+        }
+    }
+}
+
+void GroupTree::invalidate(ShapeGroup* group) {
+    // 只有先算出子组才能算出父组，所以失效的组其祖先必然已失效，可以提前停止
+    for (; group && group->boundsValid; group = group->parent) {
+        group->boundsValid = false;
+    }
+}
+
+void GroupTree::queryGroups(const QRectF& area, QList<Shape*>* shapes) const {
+    for (const ShapeGroup* group : m_groups) {
+        if (!group->parent) {
+            queryGroup(group, area, shapes);
+        }
+    }
+}
+
+void GroupTree::queryGroup(const ShapeGroup* group, const QRectF& area, QList<Shape*>* shapes) const {
+    if (!bounds(group).intersects(area)) return; // 整棵子树跳过
+    for (Shape* shape : group->shapes) {
+        if (shape->contentBounds().intersects(area)) {
+            shapes->append(shape);
+        }
+    }
+    for (const ShapeGroup* child : group->groups) {
+        queryGroup(child, area, shapes);
+    }
+}
+
+GroupSnapshot GroupTree::snapshot(const QList<Shape*>& order) const {
+    GroupSnapshot snapshot;
+    if (m_groups.isEmpty()) {
+        snapshot.looseShapes.reserve(order.size());
+        for (int i = 0; i < order.size(); ++i) {
+            snapshot.looseShapes.append(i);
+        }
+        return snapshot;
+    }
+
+    QHash<const ShapeGroup*, int> nodeOf;
+    nodeOf.reserve(m_groups.size());
+    snapshot.nodes.resize(m_groups.size());
+    for (const ShapeGroup* group : m_groups) {
+        const int node = nodeOf.size();
+        nodeOf.insert(group, node);
+        snapshot.nodes[node].bounds = bounds(group);
+    }
+    for (const ShapeGroup* group : m_groups) {
+        const int node = nodeOf.value(group);
+        if (group->parent) {
+            snapshot.nodes[nodeOf.value(group->parent)].children.append(node);
+        }
+        else {
+            snapshot.roots.append(node);
+        }
+    }
+    // 不在树中的图形（如正在绘制的图形）按未分组处理
+    for (int i = 0; i < order.size(); ++i) {
+        const ShapeGroup* group = groupOf(order[i]);
+        if (group) {
+            snapshot.nodes[nodeOf.value(group)].shapes.append(i);
+        }
+        else {
+            snapshot.looseShapes.append(i);
+        }
+    }
+    return snapshot;
+}
+
+void GroupTree::updateSnapshotBounds(GroupSnapshot* snapshot) const {
+    // 与 snapshot() 相同的遍历顺序（结构未变时 m_groups 的顺序也不变）
+    int node = 0;
+    for (const ShapeGroup* group : m_groups) {
+        snapshot->nodes[node++].bounds = bounds(group);
+    }
+}
+
+void GroupSnapshot::collect(const QRectF& area, QVector<int>* shapes) const {
+    *shapes += looseShapes;
+    for (int root : roots) {
+        collect(root, area, shapes);
+    }
+}
+
+void GroupSnapshot::collect(int node, const QRectF& area, QVector<int>* shapes) const {
+    const Node& n = nodes[node];
+    if (!n.bounds.intersects(area)) return;
+    *shapes += n.shapes;
+    for (int child : n.children) {
+        collect(child, area, shapes);
+    }
+}
+
+void GroupTree::detach(ShapeGroup* group) {
+    if (!group->parent) return;
+    group->parent->groups.removeOne(group);
+    invalidate(group->parent);
+    group->parent = nullptr;
+}
+
+void GroupTree::destroy(ShapeGroup* group) {
+    detach(group);
+    m_groups.remove(group->id);
+    delete group;
+}
+
+QVector<GroupRecord> GroupTree::toRecords() const {
+    // 顶层组按ID排序，保存结果与哈希表顺序无关；先序遍历保证父组在前
+    QVector<ShapeGroup*> pending;
+    for (ShapeGroup* group : m_groups) {
+        if (!group->parent) pending.append(group);
+    }
+    std::sort(pending.begin(), pending.end(), [](const ShapeGroup* a, const ShapeGroup* b) { return a->id > b->id; });
+
+    QVector<GroupRecord> records;
+    records.reserve(m_groups.size());
+    while (!pending.isEmpty()) {
+        const ShapeGroup* group = pending.takeLast();
+        GroupRecord record;
+        record.id = group->id;
+        record.parentId = group->parent ? group->parent->id : 0;
+        record.shapeIds.reserve(group->shapes.size());
+        for (const Shape* shape : group->shapes) {
+            record.shapeIds.append(shape->id());
+        }
+        records.append(record);
+        for (int i = group->groups.size() - 1; i >= 0; --i) {
+            pending.append(group->groups[i]);
+        }
+    }
+    return records;
+}
+
+void GroupTree::fromRecords(const QVector<GroupRecord>& records, const QHash<quint64, Shape*>& shapes) {
+    ++m_revision;
+    clear();
+    QVector<ShapeGroup*> created;
+    created.reserve(records.size());
+    for (const GroupRecord& record : records) {
+        if (record.id == 0 || m_groups.contains(record.id)) {
+            qWarning() << "Duplicate group id:" << record.id;
+            continue;
+        }
+        ShapeGroup* group = new ShapeGroup;
+        group->id = record.id;
+        group->parent = m_groups.value(record.parentId, nullptr); // 父组在前，找不到时作为顶层组
+        if (group->parent) {
+            group->parent->groups.append(group);
+        }
+        m_groups.insert(group->id, group);
+        for (quint64 shapeId : record.shapeIds) {
+            Shape* shape = shapes.value(shapeId, nullptr);
+            if (shape && !m_shapeGroup.contains(shape)) {
+                m_shapeGroup.insert(shape, group);
+                group->shapes.append(shape);
+            }
+        }
+        created.append(group);
+    }
+    for (Shape* shape : shapes) {
+        if (!m_shapeGroup.contains(shape)) {
+            insertLoose(shape);
+        }
+    }
+
+    // 图形已不存在的空组从下往上删除
+    for (int i = created.size() - 1; i >= 0; --i) {
+        if (created[i]->shapes.isEmpty() && created[i]->groups.isEmpty()) {
+            destroy(created[i]);
+        }
+    }
+}
@@ -0,0 +1,122 @@
+﻿#ifndef SHAPEGROUP_H
+#define SHAPEGROUP_H
+
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QVector>
+#include <QRectF>
+#include "FlowDocument.h"
+
+class Shape;
+
+/**
+ * 图形分组节点：直接成员图形 + 子组，外框为所有后代的合并外框（缓存）
+ */
+struct ShapeGroup {
+    quint64 id = 0;
+    ShapeGroup* parent = nullptr;     // 为空表示顶层组
+    QVector<ShapeGroup*> groups;      // 子组
+    QVector<Shape*> shapes;           // 直接成员
+    mutable QRectF bounds;
+    mutable bool boundsValid = false;
+};
+
+/**
+ * 分组树的扁平副本（图形用z顺序列表中的下标表示），随渲染快照交给渲染线程
+ */
+struct GroupSnapshot {
+    struct Node {
+        QRectF bounds;
+        QVector<int> shapes;    // 直接成员
+        QVector<int> children;  // 子组（nodes 中的下标）
+    };
+    QVector<Node> nodes;
+    QVector<int> roots;         // 顶层组
+    QVector<int> looseShapes;   // 未分组的图形
+
+    // 可能与区域相交的图形下标（未排序）：未分组的全部列出，外框不相交的组整棵跳过
+    void collect(const QRectF& area, QVector<int>* shapes) const;
+
+private:
+    void collect(int node, const QRectF& area, QVector<int>* shapes) const;
+};
+
+/**
+ * 分组树（可任意嵌套）
+ * 图形本身仍按z顺序平铺在 ZOrderIndex 中，分组是叠加在上面的一棵树，
+ * 未分组的图形是树根下的散点。每个组缓存合并外框，整体构成包围盒层次：
+ * 命中测试和按区域绘制时从顶层组往下遍历，外框不相交的组连同全部后代
+ * 一次跳过，不再逐个访问组内图形。未分组的图形登记在均匀网格中，按区域
+ * 查询时只访问覆盖到的格子。
+ * 图形移动或改变边框后调用 shapeChanged：组内图形沿父链使缓存失效，下次
+ * 访问时重算；未分组的图形移到新的格子。
+ */
+class GroupTree {
+public:
+    GroupTree() {}
+    ~GroupTree();
+
+    void clear();
+    bool isEmpty() const { return m_groups.isEmpty(); }
+    int groupCount() const { return m_groups.size(); }
+
+    // 把若干顶层图形和顶层组合成新组（成员不足两个时返回nullptr）
+    ShapeGroup* create(const QVector<Shape*>& shapes, const QVector<ShapeGroup*>& groups, quint64 id = 0);
+    void dissolve(ShapeGroup* group);      // 解散一层，成员交给上一级
+    void addShape(Shape* shape);           // 新图形（未分组）
+    void removeShape(Shape* shape);        // 图形删除时调用，删空的组一并删除
+
+    ShapeGroup* groupOf(const Shape* shape) const { return m_shapeGroup.value(shape, nullptr); } // 直接所属组
+    ShapeGroup* rootOf(const Shape* shape) const;      // 最外层组，未分组时为nullptr
+    static void collectShapes(const ShapeGroup* group, QList<Shape*>* shapes); // 所有后代图形
+
+    QRectF bounds(const ShapeGroup* group) const;       // 合并外框（含边框、标签和命中容差）
+    void shapeChanged(const Shape* shape);              // 图形外框变化
+    void invalidateAll();                               // 批量修改后重算所有外框和网格
+
+    // 可能与区域相交的图形（未排序）= queryLoose + queryGroups
+    void query(const QRectF& area, QList<Shape*>* shapes) const;
+    // 外框（含控制点的命中范围）与区域相交的未分组图形，只查覆盖到的格子
+    void queryLoose(const QRectF& area, QList<Shape*>* shapes) const;
+    // 外框与区域相交的组内图形（未排序），外框不相交的组连同全部后代一次跳过
+    void queryGroups(const QRectF& area, QList<Shape*>* shapes) const;
+    GroupSnapshot snapshot(const QList<Shape*>& order) const;  // order 为快照中的图形顺序
+    // 版本未变时（分组结构和图形顺序都没变）只刷新已有快照中各组的外框
+    void updateSnapshotBounds(GroupSnapshot* snapshot) const;
+    quint64 revision() const { return m_revision; }     // 分组结构的版本，组或成员变化时递增
+
+    QVector<GroupRecord> toRecords() const;             // 父组在子组之前
+    void fromRecords(const QVector<GroupRecord>& records, const QHash<quint64, Shape*>& shapes);
+
+private:
+    Q_DISABLE_COPY(GroupTree)
+
+    void detach(ShapeGroup* group);                     // 从父组中摘下
+    void destroy(ShapeGroup* group);                    // 从树中删除（不处理成员）
+    static void invalidate(ShapeGroup* group);
+    void queryGroup(const ShapeGroup* group, const QRectF& area, QList<Shape*>* shapes) const;
+
+    struct LooseEntry {
+        QRectF bounds;   // 外框，含控制点的命中范围
+        QRect cells;     // 登记的格子范围，无效表示跨越的格子太多（放在 m_largeLoose 中）
+    };
+    static QRectF indexBounds(const Shape* shape);
+    static QRect cellsOf(const QRectF& bounds);
+    static quint64 cellKey(int x, int y) { return (quint64(quint32(x)) << 32) | quint32(y); }
+    void insertLoose(Shape* shape);
+    void removeLoose(Shape* shape);
+    void relocateLoose(Shape* shape);                   // 外框变化后移到新的格子
+
+    static const int CELL_SIZE = 128;   // 网格边长（场景坐标）
+    static const int MAX_CELLS = 64;    // 超过这么多格子的图形不登记，每次查询都检查
+
+    QHash<const Shape*, ShapeGroup*> m_shapeGroup;      // 图形 -> 直接所属组
+    QHash<quint64, ShapeGroup*> m_groups;               // 所有组（拥有）
+    QHash<Shape*, LooseEntry> m_loose;                  // 未分组的图形
+    QHash<quint64, QVector<Shape*>> m_cells;            // 格子 -> 未分组的图形
+    QSet<Shape*> m_largeLoose;                          // 跨越格子太多的未分组图形
+    quint64 m_revision = 0;
+};
+
+#endif // SHAPEGROUP_H
@@ -0,0 +1,341 @@
+﻿#include "SnapIndex.h"
+#include "shape.h"
+#include "TraceRecorder.h"
+#include <QVarLengthArray>
+#include <algorithm>
+
+namespace {
+
+// 按方向取坐标：axis 0 为x，1 为y
+qreal lo(const QRectF& r, int axis) { return axis == 0 ? r.left() : r.top(); }
+qreal hi(const QRectF& r, int axis) { return axis == 0 ? r.right() : r.bottom(); }
+qreal mid(const QRectF& r, int axis) { return axis == 0 ? r.center().x() : r.center().y(); }
+qreal extent(const QRectF& r, int axis) { return axis == 0 ? r.width() : r.height(); }
+
+// 在另一方向上是否重叠
+bool overlapsAcross(const QRectF& a, const QRectF& b, int axis) {
+    const int other = 1 - axis;
+    return lo(a, other) < hi(b, other) && lo(b, other) < hi(a, other);
+}
+
+// 沿 axis 方向的参考线：axis 0 为竖线 x=at，1 为横线 y=at
+QLineF guideLine(int axis, qreal at, qreal from, qreal to) {
+    return axis == 0 ? QLineF(at, from, at, to) : QLineF(from, at, to, at);
+}
+
+// 两个图形之间的间距标记，画在两者重叠部分的中间
+QLineF gapLine(int axis, const QRectF& first, const QRectF& second) {
+    const int other = 1 - axis;
+    const qreal across = (qMax(lo(first, other), lo(second, other)) + qMin(hi(first, other), hi(second, other))) / 2;
+    return axis == 0 ? QLineF(hi(first, axis), across, lo(second, axis), across)
+                     : QLineF(across, hi(first, axis), across, lo(second, axis));
+}
+
+// 被拖动图形参与吸附的坐标：移动时三条线都参与，拉伸时只有移动的边
+QVarLengthArray<qreal, 3> movingValues(int axis, const QRectF& rect, Qt::Edges edges, bool move) {
+    QVarLengthArray<qreal, 3> values;
+    if (move) {
+        values.append(lo(rect, axis));
+        values.append(mid(rect, axis));
+        values.append(hi(rect, axis));
+        return values;
+    }
+    if (edges & (axis == 0 ? Qt::LeftEdge : Qt::TopEdge)) values.append(lo(rect, axis));
+    if (edges & (axis == 0 ? Qt::RightEdge : Qt::BottomEdge)) values.append(hi(rect, axis));
+    return values;
+}
+
+} // namespace
+
+QRectF SnapIndex::sceneBounds(const Shape* shape) {
+    return shape->worldTransform().mapRect(shape->boundingRect).normalized();
+}
+
+void SnapIndex::clear() {
+    m_rects.clear();
+    m_shapes.clear();
+    m_indexOf.clear();
+    m_edges[0].clear();
+    m_edges[1].clear();
+}
+
+void SnapIndex::rebuild(const QList<Shape*>& shapes) {
+    TRACE_SCOPE("SnapIndex::rebuild");
+    clear();
+    m_rects.reserve(shapes.size());
+    m_shapes.reserve(shapes.size());
+    m_indexOf.reserve(shapes.size());
+    for (int axis = 0; axis < 2; ++axis) {
+        m_edges[axis].reserve(shapes.size() * 3);
+    }
+    for (const Shape* shape : shapes) {
+        const QRectF bounds = sceneBounds(shape);
+        const int index = m_rects.size();
+        m_rects.append(bounds);
+        m_shapes.append(shape);
+        m_indexOf.insert(shape, index);
+        for (int axis = 0; axis < 2; ++axis) {
+            m_edges[axis].append({ lo(bounds, axis), index, Min });
+            m_edges[axis].append({ mid(bounds, axis), index, Center });
+            m_edges[axis].append({ hi(bounds, axis), index, Max });
+        }
+    }
+    for (int axis = 0; axis < 2; ++axis) {
+        std::sort(m_edges[axis].begin(), m_edges[axis].end());
+    }
+}
+
+int SnapIndex::findEdge(int axis, qreal value, int index, Kind kind) const {
+    const QVector<Edge>& edges = m_edges[axis];
+    const Edge key = { value, index, kind };
+    for (auto it = std::lower_bound(edges.cbegin(), edges.cend(), key); it != edges.cend() && it->value == value; ++it) {
+        if (it->index == index && it->kind == kind) return int(it - edges.cbegin());
+    }
+    return -1;
+}
+
+void SnapIndex::insertEdge(int axis, qreal value, int index, Kind kind) {
+    QVector<Edge>& edges = m_edges[axis];
+    const Edge edge = { value, index, kind };
+    edges.insert(int(std::upper_bound(edges.cbegin(), edges.cend(), edge) - edges.cbegin()), edge);
+}
+
+void SnapIndex::moveEdge(int axis, qreal from, qreal to, int index, Kind kind) {
+    const int pos = findEdge(axis, from, index, kind);
+    if (pos < 0 || from == to) return;
+    // 只轮转原位置与新位置之间的项，拖动距离短时几乎不移动数据
+    Edge* edges = m_edges[axis].data();
+    Edge* const end = edges + m_edges[axis].size();
+    edges[pos].value = to;
+    if (to > from) {
+        std::rotate(edges + pos, edges + pos + 1, std::upper_bound(edges + pos + 1, end, edges[pos]));
+    }
+    else {
+        std::rotate(std::upper_bound(edges, edges + pos, edges[pos]), edges + pos, edges + pos + 1);
+    }
+}
+
+void SnapIndex::update(const Shape* shape) {
+    const QRectF bounds = sceneBounds(shape);
+    const auto it = m_indexOf.constFind(shape);
+    if (it == m_indexOf.cend()) {
+        const int index = m_rects.size();
+        m_rects.append(bounds);
+        m_shapes.append(shape);
+        m_indexOf.insert(shape, index);
+        for (int axis = 0; axis < 2; ++axis) {
+            insertEdge(axis, lo(bounds, axis), index, Min);
+            insertEdge(axis, mid(bounds, axis), index, Center);
+            insertEdge(axis, hi(bounds, axis), index, Max);
+        }
+        return;
+    }
+
+    const int index = it.value();
+    const QRectF old = m_rects[index];
+    if (old == bounds) return;
+    for (int axis = 0; axis < 2; ++axis) {
+        moveEdge(axis, lo(old, axis), lo(bounds, axis), index, Min);
+        moveEdge(axis, mid(old, axis), mid(bounds, axis), index, Center);
+        moveEdge(axis, hi(old, axis), hi(bounds, axis), index, Max);
+    }
+    m_rects[index] = bounds;
+}
+
+void SnapIndex::remove(const Shape* shape) {
+    const auto it = m_indexOf.find(shape);
+    if (it == m_indexOf.end()) return;
+    const int index = it.value();
+    m_indexOf.erase(it);
+    const QRectF& r = m_rects[index];
+    for (int axis = 0; axis < 2; ++axis) {
+        const Kind kinds[] = { Min, Center, Max };
+        const qreal values[] = { lo(r, axis), mid(r, axis), hi(r, axis) };
+        for (int i = 0; i < 3; ++i) {
+            const int pos = findEdge(axis, values[i], index, kinds[i]);
+            if (pos >= 0) m_edges[axis].remove(pos);
+        }
+    }
+    m_shapes[index] = nullptr;
+}
+
+SnapIndex::Result SnapIndex::snapMove(const QRectF& rect, const Shape* exclude, const SnapOptions& options) const {
+    return snap(rect, Qt::LeftEdge | Qt::TopEdge | Qt::RightEdge | Qt::BottomEdge, true, exclude, options);
+}
+
+SnapIndex::Result SnapIndex::snapResize(const QRectF& rect, Qt::Edges edges, const Shape* exclude,
+    const SnapOptions& options) const {
+    return snap(rect, edges, false, exclude, options);
+}
+
+SnapIndex::Result SnapIndex::snap(const QRectF& rect, Qt::Edges edges, bool move, const Shape* exclude,
+    const SnapOptions& options) const {
+    const Candidate x = snapAxis(0, rect, edges, move, exclude, options);
+    const Candidate y = snapAxis(1, rect, edges, move, exclude, options);
+
+    Result result;
+    result.offset = QPointF(x.delta, y.delta);
+
+    // 吸附后的位置（拉伸时只移动拖动的边）
+    QRectF snapped = rect;
+    if (move) {
+        snapped.translate(result.offset);
+    }
+    else {
+        if (edges & Qt::LeftEdge) snapped.setLeft(rect.left() + x.delta);
+        if (edges & Qt::RightEdge) snapped.setRight(rect.right() + x.delta);
+        if (edges & Qt::TopEdge) snapped.setTop(rect.top() + y.delta);
+        if (edges & Qt::BottomEdge) snapped.setBottom(rect.bottom() + y.delta);
+    }
+
+    const Candidate* chosen[2] = { &x, &y };
+    for (int axis = 0; axis < 2; ++axis) {
+        const Candidate& c = *chosen[axis];
+        if (c.type == SpacingSnap) {
+            // 两段相等的间距
+            QRectF chain[3];
+            for (int i = 0; i < 3; ++i) {
+                chain[i] = c.chain[i] < 0 ? snapped : m_rects[c.chain[i]];
+            }
+            result.guides.append(gapLine(axis, chain[0], chain[1]));
+            result.guides.append(gapLine(axis, chain[1], chain[2]));
+        }
+        if (c.type != NoSnap && options.shapes) {
+            addAlignGuides(axis, snapped, edges, move, exclude, &result.guides);
+        }
+    }
+    return result;
+}
+
+SnapIndex::Candidate SnapIndex::spacing(qreal delta, int first, int second, int third) {
+    Candidate candidate;
+    candidate.type = SpacingSnap;
+    candidate.delta = delta;
+    candidate.chain[0] = first;
+    candidate.chain[1] = second;
+    candidate.chain[2] = third;
+    return candidate;
+}
+
+SnapIndex::Candidate SnapIndex::snapAxis(int axis, const QRectF& rect, Qt::Edges edges, bool move,
+    const Shape* exclude, const SnapOptions& options) const {
+    const qreal tol = options.tolerance;
+    Candidate best;
+    qreal bestDistance = tol;
+    auto consider = [&](const Candidate& candidate) {
+        // 距离相同时先考虑的优先：对齐 > 等间距 > 网格
+        const qreal distance = qAbs(candidate.delta);
+        if (distance > bestDistance || (best.type != NoSnap && distance == bestDistance)) return;
+        bestDistance = distance;
+        best = candidate;
+    };
+    auto simple = [](CandidateType type, qreal delta) {
+        Candidate candidate;
+        candidate.type = type;
+        candidate.delta = delta;
+        return candidate;
+    };
+
+    const QVarLengthArray<qreal, 3> values = movingValues(axis, rect, edges, move);
+    const QVector<Edge>& edgeList = m_edges[axis];
+
+    if (options.shapes) {
+        // 1. 其他图形的边和中线：二分定位到 [v - tol, v + tol]
+        for (qreal v : values) {
+            const Edge probe = { v - tol, -1, Min };
+            for (auto it = std::lower_bound(edgeList.begin(), edgeList.end(), probe); it != edgeList.end(); ++it) {
+                if (it->value - v > bestDistance) break;
+                if (m_shapes[it->index] == exclude) continue;
+                consider(simple(AlignSnap, it->value - v));
+            }
+        }
+
+        // 2. 等间距（只在移动时）
+        if (move) {
+            const int before = nearestBefore(axis, lo(rect, axis) + tol, rect, exclude);
+            const int after = nearestAfter(axis, hi(rect, axis) - tol, rect, exclude);
+            if (before >= 0 && after >= 0) {
+                // 在两个图形之间居中
+                const QRectF& a = m_rects[before];
+                const QRectF& b = m_rects[after];
+                const qreal gap = (lo(b, axis) - hi(a, axis) - extent(rect, axis)) / 2;
+                if (gap >= 0) {
+                    consider(spacing(hi(a, axis) + gap - lo(rect, axis), before, -1, after));
+                }
+            }
+            if (before >= 0) {
+                // 延续前面两个图形的间距
+                const QRectF& a = m_rects[before];
+                const int previous = nearestBefore(axis, lo(a, axis), a, exclude);
+                if (previous >= 0) {
+                    const qreal gap = lo(a, axis) - hi(m_rects[previous], axis);
+                    consider(spacing(hi(a, axis) + gap - lo(rect, axis), previous, before, -1));
+                }
+            }
+            if (after >= 0) {
+                // 延续后面两个图形的间距
+                const QRectF& b = m_rects[after];
+                const int next = nearestAfter(axis, hi(b, axis), b, exclude);
+                if (next >= 0) {
+                    const qreal gap = lo(m_rects[next], axis) - hi(b, axis);
+                    consider(spacing(lo(b, axis) - gap - hi(rect, axis), -1, after, next));
+                }
+            }
+        }
+    }
+
+    // 3. 网格：移动时吸附左上角，拉伸时吸附移动的边
+    if (options.gridSize > 0 && !values.isEmpty()) {
+        const qreal v = values.first();
+        consider(simple(GridSnap, qRound(v / options.gridSize) * options.gridSize - v));
+    }
+    return best;
+}
+
+void SnapIndex::addAlignGuides(int axis, const QRectF& rect, Qt::Edges edges, bool move, const Shape* exclude,
+    QVector<QLineF>* guides) const {
+    const QRectF moving = rect.normalized();
+    const int other = 1 - axis;
+    const QVector<Edge>& edgeList = m_edges[axis];
+    for (qreal v : movingValues(axis, rect, edges, move)) {
+        // 与该坐标重合的所有图形，参考线贯穿它们
+        qreal from = lo(moving, other);
+        qreal to = hi(moving, other);
+        int matches = 0;
+        const Edge probe = { v - 0.5, -1, Min };
+        for (auto it = std::lower_bound(edgeList.begin(), edgeList.end(), probe);
+            it != edgeList.end() && it->value <= v + 0.5 && matches < MAX_GUIDE_MATCHES; ++it) {
+            if (m_shapes[it->index] == exclude) continue;
+            const QRectF& r = m_rects[it->index];
+            from = qMin(from, lo(r, other));
+            to = qMax(to, hi(r, other));
+            ++matches;
+        }
+        if (matches > 0) {
+            guides->append(guideLine(axis, v, from, to));
+        }
+    }
+}
+
+int SnapIndex::nearestBefore(int axis, qreal limit, const QRectF& across, const Shape* exclude) const {
+    const QVector<Edge>& edgeList = m_edges[axis];
+    const Edge probe = { limit, -1, Min };
+    auto it = std::upper_bound(edgeList.begin(), edgeList.end(), probe);
+    for (int scanned = 0; it != edgeList.begin() && scanned < MAX_SCAN; ++scanned) {
+        --it;
+        if (it->kind != Max || m_shapes[it->index] == exclude) continue;
+        if (overlapsAcross(m_rects[it->index], across, axis)) return it->index;
+    }
+    return -1;
+}
+
+int SnapIndex::nearestAfter(int axis, qreal limit, const QRectF& across, const Shape* exclude) const {
+    const QVector<Edge>& edgeList = m_edges[axis];
+    const Edge probe = { limit, -1, Min };
+    auto it = std::lower_bound(edgeList.begin(), edgeList.end(), probe);
+    for (int scanned = 0; it != edgeList.end() && scanned < MAX_SCAN; ++it, ++scanned) {
+        if (it->kind != Min || m_shapes[it->index] == exclude) continue;
+        if (overlapsAcross(m_rects[it->index], across, axis)) return it->index;
+    }
+    return -1;
+}
@@ -0,0 +1,85 @@
+﻿#ifndef SNAPINDEX_H
+#define SNAPINDEX_H
+
+#include <QList>
+#include <QVector>
+#include <QHash>
+#include <QRectF>
+#include <QLineF>
+
+class Shape;
+
+/**
+ * 吸附选项
+ */
+struct SnapOptions {
+    qreal tolerance = 6;   // 吸附距离（像素）
+    qreal gridSize = 0;    // 网格间距，0表示不吸附网格
+    bool shapes = true;    // 吸附其他图形的边、中线和等间距
+};
+
+/**
+ * 对齐吸附索引
+ * 所有图形外框的左/中/右、上/中/下坐标分别按x、y排成有序数组，
+ * 查询时二分定位到容差范围内的候选，每次拖动只需 O(log n + k)，与图形总数无关。
+ * 等间距吸附从有序数组向两侧查找最近的相邻图形（最多检查 MAX_SCAN 项）。
+ * 被拖动的图形在查询时跳过，因此拖动过程中不必更新索引；松开后 update
+ * 只把该图形的六个坐标移到新位置（在有序数组中轮转到位），新增、删除单个
+ * 图形同样局部更新，只有批量变化才整体重建。
+ */
+class SnapIndex {
+public:
+    struct Result {
+        QPointF offset;          // 吸附修正量（加到未吸附的位置上）
+        QVector<QLineF> guides;  // 参考线（场景坐标）
+    };
+
+    void rebuild(const QList<Shape*>& shapes);
+    void clear();
+    void update(const Shape* shape);    // 图形移动、改变大小或新增后局部更新
+    void remove(const Shape* shape);
+    int size() const { return m_indexOf.size(); }
+
+    Result snapMove(const QRectF& rect, const Shape* exclude, const SnapOptions& options) const;   // 整体移动
+    Result snapResize(const QRectF& rect, Qt::Edges edges, const Shape* exclude,
+        const SnapOptions& options) const;                                                      // 拉伸，只吸附移动的边
+
+    static QRectF sceneBounds(const Shape* shape);  // 图形在场景中的外框（含旋转）
+
+private:
+    enum Kind { Min, Center, Max };
+    struct Edge {
+        qreal value;
+        int index;   // m_rects 下标
+        Kind kind;
+        bool operator<(const Edge& other) const { return value < other.value; }
+    };
+    enum CandidateType { NoSnap, AlignSnap, GridSnap, SpacingSnap };
+    struct Candidate {
+        CandidateType type = NoSnap;
+        qreal delta = 0;
+        int chain[3] = { -1, -1, -1 };  // 等间距：依次排列的三个图形（-1表示被拖动的图形）
+    };
+
+    Result snap(const QRectF& rect, Qt::Edges edges, bool move, const Shape* exclude, const SnapOptions& options) const;
+    static Candidate spacing(qreal delta, int first, int second, int third);
+    Candidate snapAxis(int axis, const QRectF& rect, Qt::Edges edges, bool move, const Shape* exclude,
+        const SnapOptions& options) const;
+    void addAlignGuides(int axis, const QRectF& rect, Qt::Edges edges, bool move, const Shape* exclude,
+        QVector<QLineF>* guides) const;
+    int nearestBefore(int axis, qreal limit, const QRectF& across, const Shape* exclude) const; // 前方最近且在另一方向重叠的图形
+    int nearestAfter(int axis, qreal limit, const QRectF& across, const Shape* exclude) const;
+    int findEdge(int axis, qreal value, int index, Kind kind) const;
+    void insertEdge(int axis, qreal value, int index, Kind kind);
+    void moveEdge(int axis, qreal from, qreal to, int index, Kind kind);
+
+    QVector<QRectF> m_rects;
+    QVector<const Shape*> m_shapes;     // 删除的图形留空位（nullptr），重建时回收
+    QHash<const Shape*, int> m_indexOf; // 图形 -> m_rects 下标
+    QVector<Edge> m_edges[2];   // 0: x方向，1: y方向
+
+    static const int MAX_SCAN = 64;
+    static const int MAX_GUIDE_MATCHES = 32;
+};
+
+#endif // SNAPINDEX_H
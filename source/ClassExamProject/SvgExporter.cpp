@@ -0,0 +1,352 @@
+﻿#include "SvgExporter.h"
+#include "shape.h"
+#include "TraceRecorder.h"
+#include <QFile>
+#include <QXmlStreamWriter>
+#include <QTextDocument>
+#include <QTextCursor>
+#include <QTextBlock>
+#include <QTextLayout>
+#include <QDebug>
+
+// 坐标数值格式：保留足够精度，去掉多余的零
+static QString num(qreal v) {
+    return QString::number(v, 'g', 7);
+}
+
+// Qt画笔虚线样式对应的SVG dasharray（以线宽为单位）
+static QString dashArray(Qt::PenStyle style, qreal width) {
+    qreal w = qMax<qreal>(width, 1.0);
+    switch (style) {
+    case Qt::DashLine:       return QString("%1,%2").arg(num(4 * w), num(2 * w));
+    case Qt::DotLine:        return QString("%1,%2").arg(num(w), num(2 * w));
+    case Qt::DashDotLine:    return QString("%1,%2,%3,%2").arg(num(4 * w), num(2 * w), num(w));
+    case Qt::DashDotDotLine: return QString("%1,%2,%3,%2,%3,%2").arg(num(4 * w), num(2 * w), num(w));
+    default:                 return QString();
+    }
+}
+
+static QString shapeCss(const Shape* shape) {
+    QString css;
+    const QBrush brush = shape->brush();
+    if (brush.style() == Qt::NoBrush) {
+        css += "fill:none";
+    }
+    else {
+        css += "fill:" + brush.color().name();
+        if (brush.color().alpha() < 255)
+            css += ";fill-opacity:" + num(brush.color().alphaF());
+    }
+
+    const QPen pen = shape->pen();
+    if (pen.style() == Qt::NoPen) {
+        css += ";stroke:none";
+    }
+    else {
+        css += ";stroke:" + pen.color().name();
+        css += ";stroke-width:" + num(pen.widthF());
+        if (pen.color().alpha() < 255)
+            css += ";stroke-opacity:" + num(pen.color().alphaF());
+        QString dash = dashArray(pen.style(), pen.widthF());
+        if (!dash.isEmpty())
+            css += ";stroke-dasharray:" + dash;
+    }
+    return css;
+}
+
+static QString textCss(const QFont& font, const QColor& color) {
+    // 与QImage默认96dpi一致：磅值换算为像素
+    qreal px = font.pixelSize() > 0 ? font.pixelSize() : font.pointSizeF() * 96.0 / 72.0;
+    QString css = QString("font-family:'%1';font-size:%2px").arg(font.family(), num(px));
+    if (font.bold())
+        css += ";font-weight:bold";
+    if (font.italic())
+        css += ";font-style:italic";
+    if (font.underline())
+        css += ";text-decoration:underline";
+    css += ";fill:" + color.name() + ";text-anchor:middle";
+    return css;
+}
+
+SvgExporter::SvgExporter(const QList<Shape*>& shapes, const QSize& canvasSize, const QColor& background)
+    : m_shapes(shapes), m_canvasSize(canvasSize), m_background(background)
+{
+}
+
+int SvgExporter::styleIndex(const QString& css) {
+    QHash<QString, int>::const_iterator it = m_styleIndex.constFind(css);
+    if (it != m_styleIndex.constEnd())
+        return it.value();
+    int index = m_styles.size();
+    m_styles.append(css);
+    m_styleIndex.insert(css, index);
+    return index;
+}
+
+QString SvgExporter::symbolKey(const Shape* shape, int style) const {
+    return QString("%1:%2x%3:%4")
+        .arg(int(shape->type))
+        .arg(shape->boundingRect.width(), 0, 'f', 2)
+        .arg(shape->boundingRect.height(), 0, 'f', 2)
+        .arg(style);
+}
+
+void SvgExporter::collect() {
+    m_shapeStyle.reserve(m_shapes.size());
+    for (const Shape* shape : m_shapes) {
+        int style = styleIndex(shapeCss(shape));
+        m_shapeStyle.append(style);
+        ++m_symbolUses[symbolKey(shape, style)];
+        if (shape->hasText()) {
+            labelLayout(shape); // 预先排版，登记文字样式
+        }
+    }
+
+    // 出现两次以上的图形才值得写成symbol
+    for (int i = 0; i < m_shapes.size(); ++i) {
+        QString key = symbolKey(m_shapes[i], m_shapeStyle[i]);
+        if (m_symbolUses.value(key) >= 2 && !m_symbolIndex.contains(key)) {
+            m_symbolIndex.insert(key, m_symbolTemplates.size());
+            m_symbolTemplates.append(i);
+        }
+    }
+}
+
+const SvgExporter::LabelLayout& SvgExporter::labelLayout(const Shape* shape) {
+    const QString key = shape->label().cacheKey() + QChar(0x1f) + shape->textFont().toString()
+        + QChar(0x1f) + QString::number(shape->boundingRect.width(), 'f', 2)
+        + QChar(0x1f) + shape->textColor().name(QColor::HexArgb); // 默认文字颜色影响样式
+    QHash<QString, LabelLayout>::const_iterator cached = m_labelCache.constFind(key);
+    if (cached != m_labelCache.constEnd())
+        return cached.value();
+
+    // 与Shape::draw相同的排版参数
+    QTextDocument doc;
+    doc.setDefaultFont(shape->textFont());
+    shape->label().toDocument(&doc);
+    doc.setTextWidth(shape->boundingRect.width() * 0.9);
+    QTextCursor cursor(&doc);
+    QTextBlockFormat fmt;
+    fmt.setAlignment(Qt::AlignCenter);
+    cursor.select(QTextCursor::Document);
+    cursor.mergeBlockFormat(fmt);
+    const qreal halfHeight = doc.size().height() / 2;
+
+    LabelLayout layout;
+    for (QTextBlock block = doc.begin(); block.isValid(); block = block.next()) {
+        QTextLayout* textLayout = block.layout();
+        const qreal blockTop = textLayout->position().y();
+        for (int i = 0; i < textLayout->lineCount(); ++i) {
+            QTextLine line = textLayout->lineAt(i);
+            const int lineStart = block.position() + line.textStart();
+            const int lineEnd = lineStart + line.textLength();
+
+            TextLine out;
+            out.baseline = blockTop + line.y() + line.ascent() - halfHeight;
+            for (QTextBlock::iterator it = block.begin(); !it.atEnd(); ++it) {
+                QTextFragment frag = it.fragment();
+                int start = qMax(frag.position(), lineStart);
+                int end = qMin(frag.position() + frag.length(), lineEnd);
+                if (start >= end) continue;
+
+                QString text = frag.text().mid(start - frag.position(), end - start);
+                text.remove(QChar::LineSeparator);
+                if (text.isEmpty()) continue;
+
+                QTextCharFormat charFormat = frag.charFormat();
+                QFont font = charFormat.font().resolve(doc.defaultFont());
+                // 没有前景色的文字用标签颜色（与Shape::drawLabel一致）
+                QColor color = charFormat.foreground().style() == Qt::NoBrush ?
+                    shape->textColor() : charFormat.foreground().color();
+                int style = styleIndex(textCss(font, color));
+
+                // 相邻同样式片段合并
+                if (!out.spans.isEmpty() && out.spans.last().styleIndex == style) {
+                    out.spans.last().text += text;
+                }
+                else {
+                    TextSpan span;
+                    span.text = text;
+                    span.styleIndex = style;
+                    out.spans.append(span);
+                }
+            }
+            if (!out.spans.isEmpty())
+                layout.append(out);
+        }
+    }
+    return m_labelCache.insert(key, layout).value();
+}
+
+bool SvgExporter::exportToFile(const QString& fileName) {
+    TRACE_SCOPE_CAT("SvgExporter::exportToFile", "io");
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        m_error = file.errorString();
+        qWarning() << "Failed to open file for writing:" << fileName
+            << "Error:" << m_error;
+        return false;
+    }
+
+    collect();
+
+    QXmlStreamWriter xml(&file);
+    xml.writeStartDocument();
+    xml.writeStartElement("svg");
+    xml.writeDefaultNamespace("http://www.w3.org/2000/svg");
+    xml.writeNamespace("http://www.w3.org/1999/xlink", "xlink");
+    xml.writeAttribute("version", "1.1");
+    xml.writeAttribute("width", QString::number(m_canvasSize.width()));
+    xml.writeAttribute("height", QString::number(m_canvasSize.height()));
+    xml.writeAttribute("viewBox", QString("0 0 %1 %2").arg(m_canvasSize.width()).arg(m_canvasSize.height()));
+
+    writeStyles(xml);
+    writeSymbols(xml);
+
+    // 背景
+    xml.writeEmptyElement("rect");
+    xml.writeAttribute("width", "100%");
+    xml.writeAttribute("height", "100%");
+    xml.writeAttribute("fill", m_background.name());
+
+    // 按z顺序逐个写出
+    for (int i = 0; i < m_shapes.size(); ++i) {
+        writeShape(xml, m_shapes[i], m_shapeStyle[i]);
+    }
+
+    xml.writeEndElement(); // svg
+    xml.writeEndDocument();
+
+    if (xml.hasError() || file.error() != QFileDevice::NoError) {
+        m_error = file.errorString();
+        qWarning() << "Error during writing";
+        file.remove();
+        return false;
+    }
+    file.close();
+    return true;
+}
+
+void SvgExporter::writeStyles(QXmlStreamWriter& xml) {
+    QString css;
+    for (int i = 0; i < m_styles.size(); ++i) {
+        css += QString(".s%1{%2}").arg(i).arg(m_styles[i]);
+    }
+    xml.writeStartElement("style");
+    xml.writeAttribute("type", "text/css");
+    xml.writeCharacters(css);
+    xml.writeEndElement();
+}
+
+void SvgExporter::writeSymbols(QXmlStreamWriter& xml) {
+    if (m_symbolTemplates.isEmpty()) return;
+
+    xml.writeStartElement("defs");
+    for (int i = 0; i < m_symbolTemplates.size(); ++i) {
+        int shapeIndex = m_symbolTemplates[i];
+        xml.writeStartElement("symbol");
+        xml.writeAttribute("id", QString("y%1").arg(i));
+        xml.writeAttribute("overflow", "visible"); // 线宽可能超出边界
+        writeGeometry(xml, m_shapes[shapeIndex], m_shapeStyle[shapeIndex], true);
+        xml.writeEndElement();
+    }
+    xml.writeEndElement();
+}
+
+void SvgExporter::writeShape(QXmlStreamWriter& xml, const Shape* shape, int style) {
+    const QRectF& rect = shape->boundingRect;
+    const qreal degrees = qRadiansToDegrees(shape->getRotation());
+    const bool rotated = !qFuzzyIsNull(degrees);
+
+    // 旋转时图形和文字共用一个分组变换（绕中心旋转）
+    if (rotated) {
+        xml.writeStartElement("g");
+        xml.writeAttribute("transform", QString("rotate(%1 %2 %3)")
+            .arg(num(degrees), num(rect.center().x()), num(rect.center().y())));
+    }
+
+    QHash<QString, int>::const_iterator symbol = m_symbolIndex.constFind(symbolKey(shape, style));
+    if (symbol != m_symbolIndex.constEnd()) {
+        xml.writeEmptyElement("use");
+        xml.writeAttribute("xlink:href", QString("#y%1").arg(symbol.value()));
+        xml.writeAttribute("x", num(rect.left()));
+        xml.writeAttribute("y", num(rect.top()));
+    }
+    else {
+        writeGeometry(xml, shape, style, false);
+    }
+
+    if (shape->hasText()) {
+        writeLabel(xml, shape);
+    }
+
+    if (rotated) {
+        xml.writeEndElement();
+    }
+}
+
+void SvgExporter::writeGeometry(QXmlStreamWriter& xml, const Shape* shape, int style, bool local) {
+    const QRectF& rect = shape->boundingRect;
+    const QPointF origin = local ? QPointF(0, 0) : rect.topLeft();
+
+    switch (shape->type) {
+    case ShapeType_Rectangle:
+        xml.writeEmptyElement("rect");
+        xml.writeAttribute("x", num(origin.x()));
+        xml.writeAttribute("y", num(origin.y()));
+        xml.writeAttribute("width", num(rect.width()));
+        xml.writeAttribute("height", num(rect.height()));
+        break;
+    case ShapeType_Ellipse:
+        xml.writeEmptyElement("ellipse");
+        xml.writeAttribute("cx", num(origin.x() + rect.width() / 2));
+        xml.writeAttribute("cy", num(origin.y() + rect.height() / 2));
+        xml.writeAttribute("rx", num(rect.width() / 2));
+        xml.writeAttribute("ry", num(rect.height() / 2));
+        break;
+    }
+    xml.writeAttribute("class", QString("s%1").arg(style));
+}
+
+void SvgExporter::writeLabel(QXmlStreamWriter& xml, const Shape* shape) {
+    const LabelLayout& layout = labelLayout(shape);
+    if (layout.isEmpty()) return;
+
+    const QPointF c = shape->boundingRect.center();
+    const QString x = num(c.x());
+
+    // 单行单样式：一个 <text> 元素即可
+    if (layout.size() == 1 && layout[0].spans.size() == 1) {
+        xml.writeStartElement("text");
+        xml.writeAttribute("class", QString("s%1").arg(layout[0].spans[0].styleIndex));
+        xml.writeAttribute("x", x);
+        xml.writeAttribute("y", num(c.y() + layout[0].baseline));
+        xml.writeCharacters(layout[0].spans[0].text);
+        xml.writeEndElement();
+        return;
+    }
+
+    xml.writeStartElement("text");
+    for (const TextLine& line : layout) {
+        xml.writeStartElement("tspan");
+        xml.writeAttribute("x", x);
+        xml.writeAttribute("y", num(c.y() + line.baseline));
+        if (line.spans.size() == 1) {
+            xml.writeAttribute("class", QString("s%1").arg(line.spans[0].styleIndex));
+            xml.writeCharacters(line.spans[0].text);
+        }
+        else {
+            // 行内多种样式：按片段嵌套tspan，整行仍以中心对齐
+            xml.writeAttribute("class", QString("s%1").arg(line.spans[0].styleIndex));
+            for (const TextSpan& span : line.spans) {
+                xml.writeStartElement("tspan");
+                xml.writeAttribute("class", QString("s%1").arg(span.styleIndex));
+                xml.writeCharacters(span.text);
+                xml.writeEndElement();
+            }
+        }
+        xml.writeEndElement();
+    }
+    xml.writeEndElement();
+}
@@ -0,0 +1,65 @@
+﻿#ifndef SVGEXPORTER_H
+#define SVGEXPORTER_H
+
+#include <QList>
+#include <QHash>
+#include <QVector>
+#include <QSize>
+#include <QColor>
+#include <QString>
+
+class Shape;
+class QXmlStreamWriter;
+
+/**
+ * 矢量SVG导出
+ * 直接流式写入文件，不构建DOM：
+ *  - 相同的样式合并为CSS类
+ *  - 尺寸和样式都相同的图形写成 <symbol> + <use>
+ *  - 富文本标签按排版结果转换为紧凑的 <text>/<tspan>
+ */
+class SvgExporter {
+public:
+    SvgExporter(const QList<Shape*>& shapes, const QSize& canvasSize, const QColor& background);
+
+    bool exportToFile(const QString& fileName);
+    QString errorString() const { return m_error; }
+
+private:
+    // 标签排版结果（按行拆分，每行若干样式片段）
+    struct TextSpan {
+        QString text;
+        int styleIndex;
+    };
+    struct TextLine {
+        qreal baseline;            // 相对图形中心的基线位置
+        QVector<TextSpan> spans;
+    };
+    typedef QVector<TextLine> LabelLayout;
+
+    void collect();                                   // 第一遍：收集样式表和可复用图形
+    int styleIndex(const QString& css);
+    QString symbolKey(const Shape* shape, int style) const;
+    const LabelLayout& labelLayout(const Shape* shape);
+
+    void writeStyles(QXmlStreamWriter& xml);
+    void writeSymbols(QXmlStreamWriter& xml);
+    void writeShape(QXmlStreamWriter& xml, const Shape* shape, int style);
+    void writeGeometry(QXmlStreamWriter& xml, const Shape* shape, int style, bool local);
+    void writeLabel(QXmlStreamWriter& xml, const Shape* shape);
+
+    const QList<Shape*>& m_shapes;
+    QSize m_canvasSize;
+    QColor m_background;
+    QString m_error;
+
+    QHash<QString, int> m_styleIndex;         // CSS -> 类编号
+    QVector<QString> m_styles;
+    QVector<int> m_shapeStyle;                // 每个图形的样式类
+    QHash<QString, int> m_symbolUses;         // 图形键 -> 出现次数
+    QHash<QString, int> m_symbolIndex;        // 图形键 -> symbol编号
+    QVector<int> m_symbolTemplates;           // 每个symbol的模板图形下标
+    QHash<QString, LabelLayout> m_labelCache; // 相同标签只排版一次
+};
+
+#endif // SVGEXPORTER_H
@@ -4,80 +4,58 @@
 TextEditDialog::TextEditDialog(QWidget* parent)
     : QDialog(parent), textColor(Qt::black) {
 
-    // ı༭
+    // 主文本编辑框
     textEdit = new QTextEdit(this);
 
-    // 
+    // 工具栏
     toolbar = new QToolBar(this);
 
-    // Ӵְť
+    // 加粗按钮
     QAction* boldAction = toolbar->addAction("B");
     boldAction->setCheckable(true);
     boldAction->setShortcut(QKeySequence::Bold);
     connect(boldAction, &QAction::triggered, this, &TextEditDialog::onBoldClicked);
 
-    // б尴ť
+    // 斜体按钮
     QAction* italicAction = toolbar->addAction("I");
     italicAction->setCheckable(true);
     italicAction->setShortcut(QKeySequence::Italic);
     connect(italicAction, &QAction::triggered, this, &TextEditDialog::onItalicClicked);
 
-    // ɫť
+    // 颜色按钮
     QAction* colorAction = toolbar->addAction("Color");
     connect(colorAction, &QAction::triggered, this, &TextEditDialog::onColorClicked);
 
-    // ѡ
+    // 字体选择
     fontCombo = new QFontComboBox(this);
     toolbar->addWidget(fontCombo);
     connect(fontCombo, &QFontComboBox::currentFontChanged, this, &TextEditDialog::updateFormat);
 
-    // ֺѡ
+    // 字号选择
     sizeCombo = new QComboBox(this);
     sizeCombo->addItems({ "8", "10", "12", "14", "18", "24", "36" });
     toolbar->addWidget(sizeCombo);
     connect(sizeCombo, &QComboBox::currentTextChanged, this, &TextEditDialog::updateFormat);
 
-    // 
+    // 布局
     QVBoxLayout* layout = new QVBoxLayout(this);
     layout->addWidget(toolbar);
     layout->addWidget(textEdit);
 
-    // Իť
+    // 对话框按钮
     QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
     layout->addWidget(buttons);
     connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
     connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
 }
 
-void TextEditDialog::setText(const QString& text) {
-    textEdit->setHtml(text);
+void TextEditDialog::setLabel(const RichLabel& label) {
+    textEdit->clear();
+    label.toDocument(textEdit->document());
 }
 
-QString TextEditDialog::getText() const {
-    QString html = textEdit->toHtml();
-
-    // ƳDOCTYPE<html>ǰ
-    html.remove(QRegularExpression("^.*?<html[^>]*>", QRegularExpression::DotMatchesEverythingOption));
-
-    // Ƴ<head>
-    html.remove(QRegularExpression("<head[^>]*>.*?</head>", QRegularExpression::DotMatchesEverythingOption));
-
-    // ȡ<body>е
-    int bodyStart = html.indexOf("<body");
-    bodyStart = html.indexOf(">", bodyStart) + 1;
-    int bodyEnd = html.lastIndexOf("</body>");
-    html = html.mid(bodyStart, bodyEnd - bodyStart).trimmed();
-
-    // Ƴʽclassע
-    html.replace(QRegularExpression("style=\"((?!color:)[^\"])*\""), ""); //  color
-    html.remove(QRegularExpression("class=\"[^\"]*\""));
-    html.remove(QRegularExpression("<!--.*?-->", QRegularExpression::DotMatchesEverythingOption));
-
-    // 򻯿ձǩ
-    html.replace("<p></p>", "<br>");
-    html.replace("<span></span>", "");
-
-    return html;
+RichLabel TextEditDialog::getLabel() const {
+    return RichLabel::fromDocument(textEdit->document());
 }
 
 void TextEditDialog::onBoldClicked() {
@@ -102,7 +80,7 @@ void TextEditDialog::updateFormat() {
     format.setFontPointSize(sizeCombo->currentText().toInt());
     format.setForeground(QBrush(textColor));
 
-    // ּӴ/б״̬
+    // 保持加粗/斜体状态
     format.setFontWeight(textEdit->fontWeight());
     format.setFontItalic(textEdit->fontItalic());
 
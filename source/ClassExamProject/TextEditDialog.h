@@ -5,13 +5,14 @@
 #include <QComboBox>
 #include <QColorDialog>
 #include <QTextBrowser>
+#include "RichLabel.h"
 
 class TextEditDialog : public QDialog {
     Q_OBJECT
 public:
     explicit TextEditDialog(QWidget* parent = nullptr);
-    void setText(const QString& text);
-    QString getText() const;
+    void setLabel(const RichLabel& label);  // 载入到编辑器
+    RichLabel getLabel() const;             // 从编辑器内容生成紧凑标签
     QFont getFont() const;
     QColor getColor() const;
 
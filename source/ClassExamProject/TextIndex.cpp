@@ -0,0 +1,191 @@
+﻿#include "TextIndex.h"
+#include "shape.h"
+#include "TraceRecorder.h"
+#include <QSet>
+
+namespace {
+
+// 汉字、假名没有词间分隔，逐字成词
+bool isIdeograph(QChar c) {
+    const QChar::Script script = c.script();
+    return script == QChar::Script_Han || script == QChar::Script_Hiragana || script == QChar::Script_Katakana;
+}
+
+bool isWordChar(QChar c) {
+    return c.isLetterOrNumber() || c.isMark();
+}
+
+} // namespace
+
+QStringList TextIndex::tokenize(const QString& text) {
+    QStringList tokens;
+    const QString folded = text.toCaseFolded();
+    int start = -1;
+    for (int i = 0; i <= folded.size(); ++i) {
+        const QChar c = i < folded.size() ? folded[i] : QChar();
+        const bool ideograph = !c.isNull() && isIdeograph(c);
+        if (!c.isNull() && isWordChar(c) && !ideograph) {
+            if (start < 0) start = i;
+            continue;
+        }
+        if (start >= 0) {
+            tokens.append(folded.mid(start, i - start));
+            start = -1;
+        }
+        if (ideograph) {
+            tokens.append(QString(c));
+        }
+    }
+    return tokens;
+}
+
+bool TextIndex::endsInWord(const QString& text) {
+    if (text.isEmpty()) return false;
+    const QChar last = text[text.size() - 1];
+    return isWordChar(last) && !isIdeograph(last);
+}
+
+int TextIndex::indexIn(const QString& label, const QString& text, int from, Qt::CaseSensitivity cs) {
+    if (text.isEmpty()) return -1;
+    const bool wordStart = isWordChar(text[0]) && !isIdeograph(text[0]);
+    for (int pos = label.indexOf(text, from, cs); pos >= 0; pos = label.indexOf(text, pos + 1, cs)) {
+        // 匹配必须从词首开始（前一个字符不是同一个词的一部分）
+        if (!wordStart || pos == 0) return pos;
+        const QChar before = label[pos - 1];
+        if (!isWordChar(before) || isIdeograph(before)) return pos;
+    }
+    return -1;
+}
+
+void TextIndex::insert(Shape* shape) {
+    remove(shape);
+    if (!shape->hasText()) return;
+
+    QStringList tokens = tokenize(shape->label().text());
+    tokens.removeDuplicates();
+    QVector<TokenRef> refs;
+    refs.reserve(tokens.size());
+    for (const QString& token : tokens) {
+        PostingList& postings = m_postings[token];
+        refs.append(TokenRef{ token, postings.size() });
+        postings.append(Posting{ shape, refs.size() - 1 });
+    }
+    m_shapeTokens.insert(shape, refs);
+}
+
+void TextIndex::remove(Shape* shape) {
+    auto it = m_shapeTokens.find(shape);
+    if (it == m_shapeTokens.end()) return;
+    for (const TokenRef& ref : it.value()) {
+        auto posting = m_postings.find(ref.token);
+        if (posting == m_postings.end()) continue;
+        PostingList& postings = posting.value();
+        // 末尾的项移到被删的位置，并更新它所属图形记下的位置
+        const Posting moved = postings.last();
+        postings.removeLast();
+        if (ref.index < postings.size()) {
+            postings[ref.index] = moved;
+            m_shapeTokens[moved.shape][moved.slot].index = ref.index;
+        }
+        if (postings.isEmpty()) {
+            m_postings.erase(posting);
+        }
+    }
+    m_shapeTokens.erase(it);
+}
+
+void TextIndex::clear() {
+    m_postings.clear();
+    m_shapeTokens.clear();
+}
+
+const TextIndex::PostingList* TextIndex::exact(const QString& token) const {
+    auto it = m_postings.constFind(token);
+    return it == m_postings.constEnd() ? nullptr : &it.value();
+}
+
+int TextIndex::prefixCount(const QString& prefix, int limit) const {
+    int count = 0;
+    for (auto it = m_postings.lowerBound(prefix); it != m_postings.constEnd() && it.key().startsWith(prefix); ++it) {
+        count += it.value().size();
+        if (count > limit) break;
+    }
+    return count;
+}
+
+bool TextIndex::hasTokens(Shape* shape, const QStringList& required, const QString& prefix) const {
+    const QVector<TokenRef> refs = m_shapeTokens.value(shape);
+    for (const QString& token : required) {
+        bool found = false;
+        for (const TokenRef& ref : refs) {
+            if (ref.token == token) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) return false;
+    }
+    if (prefix.isEmpty()) return true;
+    for (const TokenRef& ref : refs) {
+        if (ref.token.startsWith(prefix)) return true;
+    }
+    return false;
+}
+
+QVector<Shape*> TextIndex::find(const QString& text, Qt::CaseSensitivity cs) const {
+    TRACE_SCOPE("TextIndex::find");
+    QVector<Shape*> result;
+    const QStringList tokens = tokenize(text);
+    auto matches = [&](Shape* shape) {
+        return indexIn(shape->label().text(), text, 0, cs) >= 0;
+    };
+
+    if (tokens.isEmpty()) {
+        // 只有标点、空格时无词可查，逐个核对
+        if (text.isEmpty()) return result;
+        for (auto it = m_shapeTokens.constBegin(); it != m_shapeTokens.constEnd(); ++it) {
+            if (matches(it.key())) result.append(it.key());
+        }
+        return result;
+    }
+
+    const bool lastIsPrefix = endsInWord(text);
+    const int exactCount = lastIsPrefix ? tokens.size() - 1 : tokens.size();
+    QStringList required = tokens.mid(0, exactCount);
+    required.removeDuplicates();
+    const QString prefix = lastIsPrefix ? tokens.last() : QString();
+
+    // 找出最少的精确词表
+    const PostingList* smallest = nullptr;
+    for (const QString& token : required) {
+        // 匹配从词首开始，后面跟着分隔符的词必须在标签中完整出现
+        const PostingList* posting = exact(token);
+        if (!posting) return result;
+        if (!smallest || posting->size() < smallest->size()) smallest = posting;
+    }
+
+    if (lastIsPrefix && (!smallest || prefixCount(prefix, smallest->size()) <= smallest->size())) {
+        // 前缀范围更小：合并范围内的图形作为候选，与精确词求交集后再核对原文
+        QSet<Shape*> seen;
+        for (auto it = m_postings.lowerBound(prefix); it != m_postings.constEnd() && it.key().startsWith(prefix); ++it) {
+            for (const Posting& posting : it.value()) {
+                if (seen.contains(posting.shape)) continue;
+                seen.insert(posting.shape);
+                if (hasTokens(posting.shape, required, QString()) && matches(posting.shape)) {
+                    result.append(posting.shape);
+                }
+            }
+        }
+        return result;
+    }
+
+    if (smallest) {
+        // 最少的词表与其余各词（及末尾前缀）求交集，剩下的才核对原文
+        for (const Posting& posting : *smallest) {
+            if (hasTokens(posting.shape, required, prefix) && matches(posting.shape)) {
+                result.append(posting.shape);
+            }
+        }
+    }
+    return result;
+}
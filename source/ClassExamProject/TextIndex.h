@@ -0,0 +1,55 @@
+﻿#ifndef TEXTINDEX_H
+#define TEXTINDEX_H
+
+#include <QHash>
+#include <QMap>
+#include <QStringList>
+#include <QVector>
+
+class Shape;
+
+/**
+ * 标签文字的倒排索引（查找/替换用）
+ * 标签纯文本按词切分（字母数字连续为一个词，汉字、假名逐字成词），
+ * 词统一转为小写折叠形式，按有序表保存到图形列表的映射。
+ * 查询匹配“从词首开始的子串”：除最后一个词外逐词精确查表，最后一个
+ * 词按前缀查表，取候选最少的词得到候选图形，先用图形自己的词表与其余
+ * 各词求交集，剩下的才在标签原文上核对。
+ * 每个图形记下自己在各词表中的位置，删除时与末尾交换，O(词数)。
+ * 查询开销只与候选数有关，与图形总数无关。只在界面线程使用。
+ */
+class TextIndex {
+public:
+    void insert(Shape* shape);     // 加入或重新索引（标签修改后调用）
+    void remove(Shape* shape);
+    void clear();
+    bool contains(Shape* shape) const { return m_shapeTokens.contains(shape); }
+    int shapeCount() const { return m_shapeTokens.size(); }
+    int tokenCount() const { return m_postings.size(); }
+
+    QVector<Shape*> find(const QString& text, Qt::CaseSensitivity cs = Qt::CaseInsensitive) const; // 无序
+    static int indexIn(const QString& label, const QString& text, int from, Qt::CaseSensitivity cs); // 下一个词首匹配位置，-1为无
+    static QStringList tokenize(const QString& text);
+    static bool endsInWord(const QString& text);  // 查询末尾不是分隔符时，最后一个词可能还没输完，按前缀查
+
+private:
+    struct Posting {
+        Shape* shape;
+        int slot;       // 该词在图形词表（m_shapeTokens）中的下标
+    };
+    struct TokenRef {
+        QString token;
+        int index;      // 图形在该词的词表中的位置
+    };
+    typedef QVector<Posting> PostingList;
+
+    const PostingList* exact(const QString& token) const;
+    int prefixCount(const QString& prefix, int limit) const;    // 前缀范围内的图形数（超过limit即停止）
+    // 图形的词包含全部 required，且有词以 prefix 开头（prefix 为空时不要求）
+    bool hasTokens(Shape* shape, const QStringList& required, const QString& prefix) const;
+
+    QMap<QString, PostingList> m_postings;        // 词 -> 含该词的图形
+    QHash<Shape*, QVector<TokenRef>> m_shapeTokens; // 图形 -> 它的词（去重）及在词表中的位置
+};
+
+#endif // TEXTINDEX_H
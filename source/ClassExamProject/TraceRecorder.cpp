@@ -0,0 +1,158 @@
+﻿#include "TraceRecorder.h"
+#include <QFile>
+#include <QTextStream>
+#include <QCoreApplication>
+#include <QDebug>
+#include <ctime>
+#ifdef Q_OS_WIN
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+TraceRecorder& TraceRecorder::instance() {
+    static TraceRecorder recorder;
+    return recorder;
+}
+
+TraceRecorder::TraceRecorder()
+    : m_slots(new Slot[CAPACITY]), m_next(0), m_firstTicket(0), m_epochNs(0), m_enabled(false)
+{
+    for (int i = 0; i < CAPACITY; ++i) {
+        m_slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+    m_clock.start();
+}
+
+quint32 TraceRecorder::currentThreadIndex() {
+    static std::atomic<quint32> counter(0);
+    static thread_local quint32 index = ++counter;
+    return index;
+}
+
+qint64 TraceRecorder::processCpuTimeUs() {
+#ifdef Q_OS_WIN
+    // MSVC的clock()返回的是墙钟时间，这里取内核+用户态时间
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return 0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return qint64((k.QuadPart + u.QuadPart) / 10); // 100ns -> us
+#else
+    return qint64(std::clock()) * 1000000 / CLOCKS_PER_SEC;
+#endif
+}
+
+void TraceRecorder::start() {
+    // 不清零票号、不重启时钟（其他线程可能正在写入或读取时间），只记下本次录制的起点
+    m_enabled.store(false);
+    m_firstTicket.store(m_next.load());
+    m_epochNs.store(now());
+    m_enabled.store(true);
+}
+
+void TraceRecorder::stop() {
+    m_enabled.store(false);
+}
+
+TraceRecorder::Event* TraceRecorder::beginWrite(quint64* ticket) {
+    // 写满后覆盖最旧的事件；先标记为正在写入，导出时跳过
+    *ticket = m_next.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = m_slots[int(*ticket & (CAPACITY - 1))];
+    slot.sequence.store(*ticket * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return &slot.event;
+}
+
+void TraceRecorder::endWrite(quint64 ticket) {
+    m_slots[int(ticket & (CAPACITY - 1))].sequence.store(ticket * 2 + 2, std::memory_order_release);
+}
+
+void TraceRecorder::record(const char* name, const char* category, qint64 startNs, qint64 durationNs) {
+    if (!isEnabled()) return;
+
+    quint64 ticket;
+    Event* e = beginWrite(&ticket);
+    e->name = name;
+    e->category = category;
+    e->startNs = startNs;
+    e->durationNs = durationNs;
+    e->threadId = currentThreadIndex();
+    e->phase = 'X';
+    e->value = 0;
+    endWrite(ticket);
+}
+
+void TraceRecorder::recordCounter(const char* name, qint64 value) {
+    if (!isEnabled()) return;
+
+    quint64 ticket;
+    Event* e = beginWrite(&ticket);
+    e->name = name;
+    e->category = "counter";
+    e->startNs = now();
+    e->durationNs = 0;
+    e->threadId = currentThreadIndex();
+    e->phase = 'C';
+    e->value = value;
+    endWrite(ticket);
+}
+
+bool TraceRecorder::saveToFile(const QString& fileName) const {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "Failed to open trace file:" << fileName
+            << "Error:" << file.errorString();
+        return false;
+    }
+
+    const quint64 total = m_next.load();
+    const quint64 first = qMax(m_firstTicket.load(), total > quint64(CAPACITY) ? total - CAPACITY : 0);
+    const qint64 epoch = m_epochNs.load();
+
+    // 逐条写出，不在内存中拼接整个JSON
+    QTextStream out(&file);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\""
+        << QCoreApplication::applicationName() << "\"}}";
+    for (quint64 i = first; i < total; ++i) {
+        // 复制前后序号都等于“该票号已写完”才使用，否则是未写完或已被覆盖的槽位
+        const Slot& slot = m_slots[int(i & (CAPACITY - 1))];
+        const quint64 done = i * 2 + 2;
+        if (slot.sequence.load(std::memory_order_acquire) != done) continue;
+        const Event e = slot.event;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != done) continue;
+        if (!e.name || e.startNs < epoch) continue; // 开始于本次录制之前的区间
+
+        out << ",\n{\"name\":\"" << e.name
+            << "\",\"cat\":\"" << e.category
+            << "\",\"ph\":\"" << e.phase << "\",\"pid\":1,\"tid\":" << e.threadId
+            << ",\"ts\":" << QString::number((e.startNs - epoch) / 1000.0, 'f', 3);
+        if (e.phase == 'C') {
+            out << ",\"args\":{\"value\":" << e.value << "}}";
+        }
+        else {
+            out << ",\"dur\":" << QString::number(e.durationNs / 1000.0, 'f', 3) << "}";
+        }
+    }
+    out << "\n]}\n";
+    out.flush();
+
+    if (file.error() != QFileDevice::NoError) {
+        qWarning() << "Error during writing trace";
+        return false;
+    }
+    return true;
+}
+
+void TraceRecorder::initFromEnvironment() {
+    m_envOutput = qEnvironmentVariable("FLOW_TRACE");
+    if (!m_envOutput.isEmpty()) {
+        start();
+    }
+}
@@ -0,0 +1,100 @@
+﻿#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QScopedArrayPointer>
+#include <atomic>
+
+/**
+ * 编辑器活动追踪
+ * 将耗时区间写入固定容量的环形缓冲区（无锁、无堆分配），
+ * 停止后可导出为 Chrome / Perfetto 可读取的 trace JSON。
+ * 时钟在构造时启动后不再重置，各线程可随时读取；每个槽位带序号，
+ * 写完后以 release 发布，导出时只取序号完整且未被改写的事件，
+ * 录制或导出期间其他线程继续写入也不会读到写了一半的事件。
+ */
+class TraceRecorder {
+public:
+    struct Event {
+        const char* name = nullptr;      // 区间名称（必须是静态字符串）
+        const char* category = nullptr;  // 分类
+        qint64 startNs = 0;              // 开始时间（相对固定的时钟起点，导出时减去录制起点）
+        qint64 durationNs = 0;           // 持续时间
+        quint32 threadId = 0;            // 线程编号（从1开始）
+        char phase = 'X';                // 'X'为区间，'C'为计数器
+        qint64 value = 0;                // 计数器取值
+    };
+
+    static TraceRecorder& instance();
+
+    void start();                        // 清空缓冲区并开始录制
+    void stop();                         // 停止录制（保留数据以便导出）
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    qint64 now() const { return m_clock.nsecsElapsed(); }
+    static qint64 processCpuTimeUs();    // 进程CPU时间（微秒）
+
+    void record(const char* name, const char* category, qint64 startNs, qint64 durationNs);
+    void recordCounter(const char* name, qint64 value);  // 计数器（如延迟、CPU占用）
+    bool saveToFile(const QString& fileName) const;  // 导出为trace JSON
+
+    // 环境变量 FLOW_TRACE=<文件路径>：启动即录制，退出时自动导出
+    void initFromEnvironment();
+    QString environmentOutput() const { return m_envOutput; }
+
+private:
+    TraceRecorder();
+    static quint32 currentThreadIndex();
+    // 槽位：sequence 为 2×票号+1 表示正在写入，2×票号+2 表示写完
+    struct Slot {
+        std::atomic<quint64> sequence;
+        Event event;
+    };
+    Event* beginWrite(quint64* ticket);
+    void endWrite(quint64 ticket);
+
+    static const int CAPACITY = 1 << 16; // 必须为2的幂
+    QScopedArrayPointer<Slot> m_slots;
+    std::atomic<quint64> m_next;         // 下一个票号，单调递增，不随 start() 清零
+    std::atomic<quint64> m_firstTicket;  // 本次录制的第一个票号
+    std::atomic<qint64> m_epochNs;       // 本次录制开始时的时钟读数
+    std::atomic<bool> m_enabled;
+    QElapsedTimer m_clock;               // 构造时启动，之后只读
+    QString m_envOutput;
+};
+
+/**
+ * RAII 追踪区间：构造时记录开始时间，析构时写入缓冲区
+ * 未开启录制时只有一次原子读取的开销
+ */
+class TraceScope {
+public:
+    explicit TraceScope(const char* name, const char* category = "editor")
+        : m_name(name), m_category(category), m_start(-1) {
+        TraceRecorder& recorder = TraceRecorder::instance();
+        if (recorder.isEnabled()) {
+            m_start = recorder.now();
+        }
+    }
+    ~TraceScope() {
+        if (m_start >= 0) {
+            TraceRecorder& recorder = TraceRecorder::instance();
+            recorder.record(m_name, m_category, m_start, recorder.now() - m_start);
+        }
+    }
+
+private:
+    TraceScope(const TraceScope&);
+    TraceScope& operator=(const TraceScope&);
+
+    const char* m_name;
+    const char* m_category;
+    qint64 m_start;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#define TRACE_SCOPE_CAT(name, category) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name, category)
+
+#endif // TRACERECORDER_H
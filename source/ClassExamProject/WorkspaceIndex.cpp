@@ -0,0 +1,329 @@
+﻿#include "WorkspaceIndex.h"
+#include "FlowDocument.h"
+#include "TextIndex.h"
+#include "TraceRecorder.h"
+#include <QRunnable>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QHash>
+#include <QSet>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <algorithm>
+
+static qint64 hitKey(int file, int label) {
+    return qint64(file) << 32 | qint64(label);
+}
+
+// 供 QVector<WorkspaceFile> 序列化（需在全局命名空间中才能被找到）
+static QDataStream& operator<<(QDataStream& out, const WorkspaceFile& file) {
+    return out << file.path << file.modified << file.size << file.canvasSize
+        << qint32(file.shapeCount) << file.ids << file.labels;
+}
+
+static QDataStream& operator>>(QDataStream& in, WorkspaceFile& file) {
+    qint32 shapeCount;
+    in >> file.path >> file.modified >> file.size >> file.canvasSize
+        >> shapeCount >> file.ids >> file.labels;
+    file.shapeCount = shapeCount;
+    return in;
+}
+
+void WorkspaceIndex::Snapshot::build() {
+    TRACE_SCOPE("WorkspaceIndex::build");
+    postings.clear();
+    labelCount = 0;
+    for (int f = 0; f < files.size(); ++f) {
+        const QStringList& labels = files[f].labels;
+        for (int l = 0; l < labels.size(); ++l) {
+            QStringList tokens = TextIndex::tokenize(labels[l]);
+            tokens.removeDuplicates();
+            for (const QString& token : tokens) {
+                postings[token].append(hitKey(f, l));
+            }
+        }
+        labelCount += labels.size();
+    }
+}
+
+//=== 后台扫描 ===//
+
+class WorkspaceIndex::ScanTask : public QRunnable {
+public:
+    ScanTask(WorkspaceIndex* owner, int generation, const QString& root,
+        const QVector<WorkspaceFile>& previous, bool loadSaved)
+        : m_owner(owner), m_generation(generation), m_root(root), m_previous(previous), m_loadSaved(loadSaved) {}
+
+    void run() override {
+        TRACE_SCOPE_CAT("WorkspaceIndex::scan", "io");
+        const QString indexFile = indexFileName(m_root);
+
+        // 1. 先载入上次保存的索引，马上可以搜索
+        if (m_loadSaved && loadIndex(indexFile, m_root, &m_previous)) {
+            QSharedPointer<Snapshot> saved(new Snapshot);
+            saved->files = m_previous;
+            saved->build();
+            post(saved);
+        }
+        QHash<QString, WorkspaceFile> previous;
+        for (const WorkspaceFile& file : m_previous) {
+            previous.insert(file.path, file);
+        }
+
+        // 2. 列出目录下的文件
+        QStringList paths;
+        QDirIterator it(m_root, QStringList() << "*.flow" << "*.flow.json", QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            paths.append(it.next());
+            if (cancelled()) return;
+        }
+        std::sort(paths.begin(), paths.end());
+
+        // 3. 只解析修改时间或大小变化的文件
+        const QDir root(m_root);
+        QVector<WorkspaceFile> files;
+        files.reserve(paths.size());
+        int parsed = 0;
+        bool changed = paths.size() != previous.size();
+        for (int i = 0; i < paths.size(); ++i) {
+            if (cancelled()) return;
+            const QFileInfo info(paths[i]);
+            WorkspaceFile file;
+            file.path = root.relativeFilePath(paths[i]);
+            file.modified = info.lastModified().toMSecsSinceEpoch();
+            file.size = info.size();
+
+            auto old = previous.constFind(file.path);
+            if (old != previous.constEnd() && old->modified == file.modified && old->size == file.size) {
+                files.append(*old);
+            }
+            else {
+                // 解析失败（不是流程图文件、写到一半）也记录下来，文件不变就不再重试
+                FlowSummary summary;
+                if (FlowDocument::scan(paths[i], &summary)) {
+                    file.canvasSize = summary.canvasSize;
+                    file.shapeCount = summary.shapeCount;
+                    file.ids = summary.ids;
+                    file.labels = summary.labels;
+                }
+                files.append(file);
+                ++parsed;
+                changed = true;
+            }
+            if (i % 64 == 0) {
+                postProgress(i, paths.size());
+            }
+        }
+
+        // 4. 有变化时重建倒排表并保存
+        if (changed || !m_loadSaved) {
+            QSharedPointer<Snapshot> snapshot(new Snapshot);
+            snapshot->files = files;
+            snapshot->build();
+            post(snapshot);
+        }
+        if (changed) {
+            saveIndex(indexFile, m_root, files);
+        }
+
+        WorkspaceIndex* owner = m_owner;
+        const int generation = m_generation;
+        const int count = files.size();
+        QMetaObject::invokeMethod(owner, [owner, generation, count, parsed]() {
+            owner->finishScan(generation, count, parsed);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    bool cancelled() const {
+        return m_owner->m_generation.loadAcquire() != m_generation;
+    }
+
+    // 回到界面线程；对象析构前会等待线程池结束
+    void post(const QSharedPointer<Snapshot>& snapshot) {
+        WorkspaceIndex* owner = m_owner;
+        const int generation = m_generation;
+        QSharedPointer<const Snapshot> result = snapshot;
+        QMetaObject::invokeMethod(owner, [owner, generation, result]() {
+            owner->applySnapshot(generation, result);
+        }, Qt::QueuedConnection);
+    }
+
+    void postProgress(int scanned, int total) {
+        WorkspaceIndex* owner = m_owner;
+        const int generation = m_generation;
+        QMetaObject::invokeMethod(owner, [owner, generation, scanned, total]() {
+            if (generation == owner->m_generation.loadAcquire()) {
+                emit owner->progress(scanned, total);
+            }
+        }, Qt::QueuedConnection);
+    }
+
+    WorkspaceIndex* m_owner;
+    int m_generation;
+    QString m_root;
+    QVector<WorkspaceFile> m_previous;
+    bool m_loadSaved;
+};
+
+WorkspaceIndex::WorkspaceIndex(QObject* parent)
+    : QObject(parent), m_snapshot(new Snapshot)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+WorkspaceIndex::~WorkspaceIndex() {
+    m_generation.fetchAndAddOrdered(1); // 中止正在进行的扫描
+    m_pool.waitForDone();
+}
+
+void WorkspaceIndex::setRoot(const QString& directory) {
+    const QString root = QDir(directory).absolutePath();
+    if (root == m_root) {
+        rescan();
+        return;
+    }
+    m_root = root;
+    m_snapshot = QSharedPointer<const Snapshot>(new Snapshot);
+    emit updated();
+
+    const int generation = m_generation.fetchAndAddOrdered(1) + 1;
+    m_scanning = true;
+    m_pool.start(new ScanTask(this, generation, m_root, QVector<WorkspaceFile>(), true));
+}
+
+void WorkspaceIndex::rescan() {
+    if (m_root.isEmpty() || m_scanning) return;
+    const int generation = m_generation.fetchAndAddOrdered(1) + 1;
+    m_scanning = true;
+    m_pool.start(new ScanTask(this, generation, m_root, m_snapshot->files, false));
+}
+
+void WorkspaceIndex::applySnapshot(int generation, const QSharedPointer<const Snapshot>& snapshot) {
+    if (generation != m_generation.loadAcquire()) return;
+    m_snapshot = snapshot;
+    emit updated();
+}
+
+void WorkspaceIndex::finishScan(int generation, int files, int parsed) {
+    if (generation != m_generation.loadAcquire()) return;
+    m_scanning = false;
+    emit scanFinished(files, parsed);
+}
+
+int WorkspaceIndex::fileCount() const {
+    return m_snapshot->files.size();
+}
+
+int WorkspaceIndex::labelCount() const {
+    return m_snapshot->labelCount;
+}
+
+QVector<WorkspaceHit> WorkspaceIndex::search(const QString& text, Qt::CaseSensitivity cs, int limit) const {
+    TRACE_SCOPE("WorkspaceIndex::search");
+    QVector<WorkspaceHit> hits;
+    const Snapshot& snapshot = *m_snapshot;
+    const QStringList tokens = TextIndex::tokenize(text);
+    if (tokens.isEmpty()) return hits;
+
+    // 与 TextIndex::find 相同：完整的词精确查表，末尾未结束的词按前缀查表，取候选最少的一项
+    const bool lastIsPrefix = TextIndex::endsInWord(text);
+    const int exactCount = lastIsPrefix ? tokens.size() - 1 : tokens.size();
+
+    const QVector<qint64>* smallest = nullptr;
+    for (int i = 0; i < exactCount; ++i) {
+        auto it = snapshot.postings.constFind(tokens[i]);
+        if (it == snapshot.postings.constEnd()) return hits;
+        if (!smallest || it->size() < smallest->size()) smallest = &it.value();
+    }
+
+    QVector<qint64> candidates;
+    bool fromPrefix = false;
+    if (lastIsPrefix) {
+        int count = 0;
+        const QString& prefix = tokens.last();
+        auto begin = snapshot.postings.lowerBound(prefix);
+        for (auto it = begin; it != snapshot.postings.constEnd() && it.key().startsWith(prefix); ++it) {
+            count += it->size();
+            if (smallest && count > smallest->size()) break;
+        }
+        if (!smallest || count <= smallest->size()) {
+            fromPrefix = true;
+            for (auto it = begin; it != snapshot.postings.constEnd() && it.key().startsWith(prefix); ++it) {
+                candidates += it.value();
+            }
+            // 同一标签可能有多个词以该前缀开头
+            std::sort(candidates.begin(), candidates.end());
+            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        }
+    }
+    if (!fromPrefix && smallest) {
+        candidates = *smallest;
+        std::sort(candidates.begin(), candidates.end());
+    }
+
+    // 候选按（文件，标签）有序，在原文上核对
+    for (qint64 key : candidates) {
+        const WorkspaceFile& file = snapshot.files[int(key >> 32)];
+        const int label = int(key & 0xffffffff);
+        if (TextIndex::indexIn(file.labels[label], text, 0, cs) < 0) continue;
+        WorkspaceHit hit;
+        hit.fileName = QDir(m_root).filePath(file.path);
+        hit.shapeId = file.ids.value(label);
+        hit.label = file.labels[label];
+        hits.append(hit);
+        if (hits.size() >= limit) break;
+    }
+    return hits;
+}
+
+//=== 索引文件 ===//
+
+QString WorkspaceIndex::indexFileName(const QString& root) {
+    // 共享目录可能只读，索引保存在本机数据目录中，按工作区路径区分
+    const QString directory = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/workspaces";
+    QDir().mkpath(directory);
+    const QByteArray hash = QCryptographicHash::hash(root.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return directory + "/" + QString::fromLatin1(hash) + ".idx";
+}
+
+bool WorkspaceIndex::loadIndex(const QString& fileName, const QString& root, QVector<WorkspaceFile>* files) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_15);
+    quint32 magic;
+    qint16 version;
+    QString savedRoot;
+    in >> magic >> version >> savedRoot;
+    if (magic != INDEX_MAGIC || version != INDEX_VERSION || savedRoot != root) {
+        return false; // 旧版本的索引直接重建
+    }
+    QVector<WorkspaceFile> loaded;
+    in >> loaded;
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "Corrupt workspace index:" << fileName;
+        return false;
+    }
+    *files = loaded;
+    return true;
+}
+
+bool WorkspaceIndex::saveIndex(const QString& fileName, const QString& root, const QVector<WorkspaceFile>& files) {
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write workspace index:" << fileName << file.errorString();
+        return false;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << quint32(INDEX_MAGIC) << qint16(INDEX_VERSION) << root << files;
+    return out.status() == QDataStream::Ok && file.commit();
+}
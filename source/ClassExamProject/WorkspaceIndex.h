@@ -0,0 +1,87 @@
+﻿#ifndef WORKSPACEINDEX_H
+#define WORKSPACEINDEX_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QMap>
+#include <QSize>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+/**
+ * 工作区中一个 .flow 文件的索引信息
+ */
+struct WorkspaceFile {
+    QString path;               // 相对工作区根目录
+    qint64 modified = 0;        // 修改时间（毫秒），与大小一起判断是否需要重新解析
+    qint64 size = 0;
+    QSize canvasSize;
+    int shapeCount = 0;
+    QVector<quint64> ids;       // 有标签的图形
+    QStringList labels;
+};
+
+struct WorkspaceHit {
+    QString fileName;           // 绝对路径
+    quint64 shapeId;
+    QString label;
+};
+
+/**
+ * 工作区搜索索引
+ * 后台线程扫描目录下的 .flow/.flow.json 文件，只解析修改时间或大小变化的文件
+ * （FlowDocument::scan，只读标签文字），在工作线程中建好倒排表后整体交给界面线程。
+ * 索引保存在本地数据目录中，下次打开同一工作区时先载入旧索引，搜索立即可用，
+ * 再在后台增量更新。查询语义与画布内查找相同（TextIndex）。
+ */
+class WorkspaceIndex : public QObject {
+    Q_OBJECT
+
+public:
+    explicit WorkspaceIndex(QObject* parent = nullptr);
+    ~WorkspaceIndex();
+
+    void setRoot(const QString& directory);   // 切换工作区：载入保存的索引并开始扫描
+    QString root() const { return m_root; }
+    void rescan();                            // 增量更新
+    bool isScanning() const { return m_scanning; }
+    int fileCount() const;
+    int labelCount() const;
+
+    QVector<WorkspaceHit> search(const QString& text, Qt::CaseSensitivity cs = Qt::CaseInsensitive,
+        int limit = 1000) const;              // 按文件路径排序
+
+signals:
+    void progress(int scanned, int total);
+    void updated();                           // 索引内容已更新
+    void scanFinished(int files, int parsed); // parsed 为本次重新解析的文件数
+
+private:
+    struct Snapshot {
+        QVector<WorkspaceFile> files;         // 按路径排序
+        QMap<QString, QVector<qint64>> postings; // 词 -> (文件下标 << 32 | 标签下标)
+        int labelCount = 0;
+        void build();
+    };
+    class ScanTask;
+    friend class ScanTask;
+
+    void applySnapshot(int generation, const QSharedPointer<const Snapshot>& snapshot);
+    void finishScan(int generation, int files, int parsed);
+    static QString indexFileName(const QString& root);
+    static bool loadIndex(const QString& fileName, const QString& root, QVector<WorkspaceFile>* files);
+    static bool saveIndex(const QString& fileName, const QString& root, const QVector<WorkspaceFile>& files);
+
+    QString m_root;
+    QSharedPointer<const Snapshot> m_snapshot;
+    QThreadPool m_pool;         // 单线程，扫描按顺序进行
+    QAtomicInt m_generation;    // 切换工作区或析构时递增，旧扫描据此中止
+    bool m_scanning = false;
+
+    enum { INDEX_MAGIC = 0x46494458, INDEX_VERSION = 1 }; // "FIDX"
+};
+
+#endif // WORKSPACEINDEX_H
@@ -0,0 +1,113 @@
+﻿#include "WorkspaceSearchDialog.h"
+#include <QLineEdit>
+#include <QLabel>
+#include <QListWidget>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QElapsedTimer>
+
+WorkspaceSearchDialog::WorkspaceSearchDialog(WorkspaceIndex* index, QWidget* parent)
+    : QDialog(parent), m_index(index)
+{
+    setWindowTitle("Search Workspace");
+    resize(560, 420);
+
+    m_rootLabel = new QLabel(this);
+    QPushButton* folderButton = new QPushButton("Choose Folder...", this);
+    QPushButton* rescanButton = new QPushButton("Rescan", this);
+    m_searchEdit = new QLineEdit(this);
+    m_searchEdit->setPlaceholderText("Label text");
+    m_results = new QListWidget(this);
+    m_status = new QLabel(this);
+
+    QHBoxLayout* rootRow = new QHBoxLayout;
+    rootRow->addWidget(m_rootLabel, 1);
+    rootRow->addWidget(folderButton);
+    rootRow->addWidget(rescanButton);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addLayout(rootRow);
+    layout->addWidget(m_searchEdit);
+    layout->addWidget(m_results, 1);
+    layout->addWidget(m_status);
+
+    connect(folderButton, &QPushButton::clicked, this, &WorkspaceSearchDialog::chooseFolder);
+    connect(rescanButton, &QPushButton::clicked, m_index, &WorkspaceIndex::rescan);
+    connect(m_searchEdit, &QLineEdit::textChanged, this, &WorkspaceSearchDialog::search);
+    connect(m_results, &QListWidget::itemActivated, this, &WorkspaceSearchDialog::openItem);
+
+    // 索引更新后重新查询，扫描过程中结果逐步补全
+    connect(m_index, &WorkspaceIndex::updated, this, &WorkspaceSearchDialog::search);
+    connect(m_index, &WorkspaceIndex::progress, this, [this](int scanned, int total) {
+        m_progress = QString("Scanning %1/%2 files...").arg(scanned).arg(total);
+        updateStatus();
+        });
+    connect(m_index, &WorkspaceIndex::scanFinished, this, [this](int files, int parsed) {
+        m_progress = QString("%1 files, %2 updated").arg(files).arg(parsed);
+        updateStatus();
+        });
+}
+
+void WorkspaceSearchDialog::showSearch()
+{
+    show();
+    raise();
+    activateWindow();
+    if (m_index->root().isEmpty()) {
+        chooseFolder();
+    }
+    else {
+        m_index->rescan(); // 只解析上次之后修改过的文件
+    }
+    m_searchEdit->setFocus();
+    m_searchEdit->selectAll();
+}
+
+void WorkspaceSearchDialog::chooseFolder()
+{
+    const QString directory = QFileDialog::getExistingDirectory(this, "Choose Workspace Folder", m_index->root());
+    if (directory.isEmpty()) return;
+    m_rootLabel->setText(directory);
+    m_progress = "Scanning...";
+    m_index->setRoot(directory);
+    updateStatus();
+}
+
+void WorkspaceSearchDialog::search()
+{
+    QElapsedTimer timer;
+    timer.start();
+    m_hits = m_index->search(m_searchEdit->text());
+    m_lastQueryMs = timer.nsecsElapsed() / 1e6;
+
+    m_results->clear();
+    for (const WorkspaceHit& hit : m_hits) {
+        const QString label = hit.label.simplified();
+        m_results->addItem(QString("%1 — %2").arg(QFileInfo(hit.fileName).fileName(), label));
+        m_results->item(m_results->count() - 1)->setToolTip(hit.fileName);
+    }
+    updateStatus();
+}
+
+void WorkspaceSearchDialog::openItem(QListWidgetItem* item)
+{
+    const int row = m_results->row(item);
+    if (row < 0 || row >= m_hits.size()) return;
+    const WorkspaceHit& hit = m_hits[row];
+    emit openRequested(hit.fileName, hit.shapeId, hit.label);
+}
+
+void WorkspaceSearchDialog::updateStatus()
+{
+    QString text = QString("%1 labels indexed").arg(m_index->labelCount());
+    if (!m_searchEdit->text().isEmpty()) {
+        text = QString("%1 matches (%2 ms), ").arg(m_hits.size()).arg(m_lastQueryMs, 0, 'f', 2) + text;
+    }
+    if (!m_progress.isEmpty()) {
+        text += " | " + m_progress;
+    }
+    m_status->setText(text);
+}
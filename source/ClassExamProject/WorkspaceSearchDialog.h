@@ -0,0 +1,45 @@
+﻿#ifndef WORKSPACESEARCHDIALOG_H
+#define WORKSPACESEARCHDIALOG_H
+
+#include <QDialog>
+#include <QVector>
+#include "WorkspaceIndex.h"
+
+class QLineEdit;
+class QLabel;
+class QListWidget;
+class QListWidgetItem;
+
+/**
+ * 工作区搜索对话框（非模态）
+ * 输入即在索引中查找，双击结果打开文件并定位到对应图形。
+ */
+class WorkspaceSearchDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit WorkspaceSearchDialog(WorkspaceIndex* index, QWidget* parent = nullptr);
+    void showSearch();             // 显示；尚未选择工作区时先选择目录
+
+signals:
+    void openRequested(const QString& fileName, quint64 shapeId, const QString& label);
+
+private slots:
+    void chooseFolder();
+    void search();
+    void openItem(QListWidgetItem* item);
+    void updateStatus();
+
+private:
+    WorkspaceIndex* m_index;
+    QLabel* m_rootLabel;
+    QLineEdit* m_searchEdit;
+    QListWidget* m_results;
+    QLabel* m_status;
+    QVector<WorkspaceHit> m_hits;
+    double m_lastQueryMs = 0;
+    QString m_progress;            // 扫描进度
+};
+
+#endif // WORKSPACESEARCHDIALOG_H
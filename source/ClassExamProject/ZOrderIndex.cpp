@@ -0,0 +1,197 @@
+﻿#include "ZOrderIndex.h"
+#include "shape.h"
+#include <algorithm>
+#include <iterator>
+
+void ZOrderIndex::clear() {
+    m_order.clear();
+    m_list.clear();
+    m_listValid = true;
+}
+
+void ZOrderIndex::place(Shape* shape, quint64 key) {
+    shape->setZKey(key);
+    m_order[key] = shape;
+}
+
+int ZOrderIndex::listIndex(quint64 key) const {
+    const QList<Shape*>::const_iterator it = std::lower_bound(m_list.cbegin(), m_list.cend(), key,
+        [](const Shape* shape, quint64 value) { return shape->zKey() < value; });
+    return int(it - m_list.cbegin());
+}
+
+quint64 ZOrderIndex::keyAboveTop() {
+    if (m_order.empty()) return BASE;
+    if (m_order.rbegin()->first > ~quint64(0) - GAP) {
+        renumber();
+    }
+    return m_order.rbegin()->first + GAP;
+}
+
+quint64 ZOrderIndex::keyBelowBottom() {
+    if (m_order.empty()) return BASE;
+    if (m_order.begin()->first < GAP) {
+        renumber();
+    }
+    return m_order.begin()->first - GAP;
+}
+
+void ZOrderIndex::append(Shape* shape) {
+    place(shape, keyAboveTop()); // 重新分配键不改变顺序，列表仍然有效
+    if (m_listValid) {
+        m_list.append(shape);
+    }
+}
+
+void ZOrderIndex::append(const QList<Shape*>& shapes) {
+    if (shapes.isEmpty()) return;
+    // 一次检查键空间，之后带位置提示插入末尾（均摊 O(1)）
+    const quint64 span = GAP * quint64(shapes.size() + 1);
+    if (!m_order.empty() && m_order.rbegin()->first > ~quint64(0) - span) {
+        renumber();
+    }
+    quint64 key = m_order.empty() ? BASE : m_order.rbegin()->first + GAP;
+    for (Shape* shape : shapes) {
+        shape->setZKey(key);
+        m_order.insert(m_order.end(), std::make_pair(key, shape));
+        key += GAP;
+    }
+    if (m_listValid) {
+        m_list += shapes; // 列表仍然有序，直接追加
+    }
+}
+
+void ZOrderIndex::prepend(Shape* shape) {
+    place(shape, keyBelowBottom());
+    if (m_listValid) {
+        m_list.prepend(shape); // QList 头部留有空间，均摊 O(1)
+    }
+}
+
+void ZOrderIndex::remove(Shape* shape) {
+    std::map<quint64, Shape*>::iterator it = m_order.find(shape->zKey());
+    if (it != m_order.end() && it->second == shape) {
+        if (m_listValid && !m_list.isEmpty() && m_list.last() == shape) {
+            m_list.removeLast(); // 撤销添加等最常见的情况
+        }
+        else {
+            m_listValid = false; // 中间删除留到下次读取时重建
+        }
+        m_order.erase(it);
+    }
+}
+
+bool ZOrderIndex::contains(const Shape* shape) const {
+    const_iterator it = m_order.find(shape->zKey());
+    return it != m_order.end() && it->second == shape;
+}
+
+void ZOrderIndex::swapWith(std::map<quint64, Shape*>::iterator it, std::map<quint64, Shape*>::iterator other) {
+    // 交换两个图形的键，树结构不变；两者在列表中也相邻，原地交换
+    if (m_listValid) {
+        m_list.swapItemsAt(listIndex(it->first), listIndex(other->first));
+    }
+    std::swap(it->second, other->second);
+    it->second->setZKey(it->first);
+    other->second->setZKey(other->first);
+}
+
+bool ZOrderIndex::raise(Shape* shape) {
+    std::map<quint64, Shape*>::iterator it = m_order.find(shape->zKey());
+    if (it == m_order.end()) return false;
+    std::map<quint64, Shape*>::iterator next = std::next(it);
+    if (next == m_order.end()) return false;
+    swapWith(it, next);
+    return true;
+}
+
+bool ZOrderIndex::lower(Shape* shape) {
+    std::map<quint64, Shape*>::iterator it = m_order.find(shape->zKey());
+    if (it == m_order.end() || it == m_order.begin()) return false;
+    swapWith(it, std::prev(it));
+    return true;
+}
+
+bool ZOrderIndex::moveToTop(Shape* shape) {
+    if (!contains(shape) || topmost() == shape) return false;
+    remove(shape);
+    append(shape);
+    return true;
+}
+
+bool ZOrderIndex::moveToBottom(Shape* shape) {
+    if (!contains(shape) || m_order.begin()->second == shape) return false;
+    remove(shape);
+    prepend(shape);
+    return true;
+}
+
+QList<Shape*> ZOrderIndex::sortedByKey(const QList<Shape*>& selection) const {
+    QList<Shape*> sorted;
+    for (Shape* shape : selection) {
+        if (contains(shape)) sorted.append(shape);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Shape* a, const Shape* b) {
+        return a->zKey() < b->zKey();
+    });
+    return sorted;
+}
+
+void ZOrderIndex::moveToTop(const QList<Shape*>& selection) {
+    // O(k log n)：按原顺序依次放到顶端；列表留到下次读取时重建
+    const QList<Shape*> sorted = sortedByKey(selection);
+    if (sorted.isEmpty()) return;
+    m_listValid = false;
+    for (Shape* shape : sorted) {
+        m_order.erase(shape->zKey());
+        place(shape, keyAboveTop());
+    }
+}
+
+void ZOrderIndex::moveToBottom(const QList<Shape*>& selection) {
+    const QList<Shape*> sorted = sortedByKey(selection);
+    if (sorted.isEmpty()) return;
+    m_listValid = false;
+    for (int i = sorted.size() - 1; i >= 0; --i) {
+        m_order.erase(sorted[i]->zKey());
+        place(sorted[i], keyBelowBottom());
+    }
+}
+
+const QList<Shape*>& ZOrderIndex::list() const {
+    if (!m_listValid) {
+        m_list.clear();
+        m_list.reserve(int(m_order.size()));
+        for (const_iterator it = m_order.begin(); it != m_order.end(); ++it) {
+            m_list.append(it->second);
+        }
+        m_listValid = true;
+    }
+    return m_list;
+}
+
+QList<Shape*> ZOrderIndex::shapesBelow(const Shape* shape) const {
+    const QList<Shape*>& shapes = list(); // 先确保列表有效，再二分查找
+    return shapes.mid(0, listIndex(shape->zKey()));
+}
+
+QList<Shape*> ZOrderIndex::shapesAbove(const Shape* shape) const {
+    const QList<Shape*>& shapes = list();
+    const QList<Shape*>::const_iterator it = std::upper_bound(shapes.cbegin(), shapes.cend(), shape->zKey(),
+        [](quint64 value, const Shape* other) { return value < other->zKey(); });
+    return shapes.mid(int(it - shapes.cbegin()));
+}
+
+bool ZOrderIndex::isAbove(const Shape* a, const Shape* b) {
+    return a->zKey() > b->zKey();
+}
+
+void ZOrderIndex::renumber() {
+    std::map<quint64, Shape*> renumbered;
+    quint64 key = BASE - quint64(m_order.size() / 2) * GAP;
+    for (const_iterator it = m_order.begin(); it != m_order.end(); ++it, key += GAP) {
+        it->second->setZKey(key);
+        renumbered.insert(renumbered.end(), std::make_pair(key, it->second));
+    }
+    m_order.swap(renumbered);
+}
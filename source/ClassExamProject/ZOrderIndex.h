@@ -0,0 +1,64 @@
+﻿#ifndef ZORDERINDEX_H
+#define ZORDERINDEX_H
+
+#include <QList>
+#include <map>
+
+class Shape;
+
+/**
+ * 图层顺序维护
+ * 每个图形持有一个稀疏的64位z键（相邻键之间留有间隙），键到图形的映射
+ * 保存在有序树中：上移/下移/置顶/置底在树中都只需 O(log n)，不再重写
+ * 所有图形的z值。间隙用尽时整体重新分配一次键（极少发生）。
+ * 按z顺序排列的列表供渲染和导出遍历：追加、置底和上移/下移时就地更新
+ * （O(1) 或 O(log n)），删除和多选置顶/置底只标记失效，在之后第一次读取时
+ * 按树的顺序 O(n) 重建一次，连续多次修改只重建一次。
+ */
+class ZOrderIndex {
+public:
+    typedef std::map<quint64, Shape*>::const_iterator const_iterator;
+
+    void clear();
+    void append(Shape* shape);     // 放到最上层
+    void append(const QList<Shape*>& shapes);  // 按顺序批量放到最上层
+    void prepend(Shape* shape);    // 放到最下层
+    void remove(Shape* shape);
+    bool contains(const Shape* shape) const;
+    int size() const { return int(m_order.size()); }
+    bool isEmpty() const { return m_order.empty(); }
+
+    bool raise(Shape* shape);      // 与上一层交换
+    bool lower(Shape* shape);      // 与下一层交换
+    bool moveToTop(Shape* shape);
+    bool moveToBottom(Shape* shape);
+    void moveToTop(const QList<Shape*>& selection);    // 保持选中图形之间的相对顺序
+    void moveToBottom(const QList<Shape*>& selection);
+
+    Shape* topmost() const { return m_order.empty() ? nullptr : m_order.rbegin()->second; }
+    QList<Shape*> shapesBelow(const Shape* shape) const;  // 按z顺序，O(n)
+    QList<Shape*> shapesAbove(const Shape* shape) const;
+    static bool isAbove(const Shape* a, const Shape* b);  // 直接比较z键
+
+    const QList<Shape*>& list() const;  // 全部图形，按z从小到大（失效后第一次读取时重建）
+    const_iterator begin() const { return m_order.begin(); }
+    const_iterator end() const { return m_order.end(); }
+
+private:
+    static const quint64 BASE = quint64(1) << 62;  // 初始键，上下都留有空间
+    static const quint64 GAP = quint64(1) << 20;   // 相邻键的间隙
+
+    void place(Shape* shape, quint64 key);
+    int listIndex(quint64 key) const;   // 列表中第一个z键不小于 key 的位置（二分查找，列表须有效）
+    void swapWith(std::map<quint64, Shape*>::iterator it, std::map<quint64, Shape*>::iterator other);
+    void renumber();                    // 重新均匀分配所有键
+    quint64 keyAboveTop();
+    quint64 keyBelowBottom();
+    QList<Shape*> sortedByKey(const QList<Shape*>& selection) const;
+
+    std::map<quint64, Shape*> m_order;
+    mutable QList<Shape*> m_list;       // 与 m_order 同序（m_listValid 为 true 时）
+    mutable bool m_listValid = true;
+};
+
+#endif // ZORDERINDEX_H
@@ -12,15 +12,15 @@ CanvasSetupDialog::CanvasSetupDialog(QWidget* parent)
     : QDialog(parent), m_canvasSize(1050, 1500), m_canvasColor(Qt::white)
 {
     setWindowTitle("Canvas Setup");
-    resize(600, 500); // ԻС
+    resize(600, 500); // 调整对话框大小
 
     QVBoxLayout* mainLayout = new QVBoxLayout(this);
 
-    // 
+    // 主内容区域
     QHBoxLayout* contentLayout = new QHBoxLayout;
     contentLayout->setSpacing(30);
 
-    //  - ֽųߴѡ (2x2)
+    // 左侧 - 纸张尺寸选择 (2x2网格)
     QWidget* sizeWidget = new QWidget;
     QGridLayout* sizeLayout = new QGridLayout(sizeWidget);
     sizeLayout->setSpacing(20);
@@ -28,7 +28,7 @@ CanvasSetupDialog::CanvasSetupDialog(QWidget* parent)
 
     m_sizeGroup = new QButtonGroup(this);
 
-    // ֽųߴ綨 ()
+    // 纸张尺寸定义 (像素)
     QList<QPair<QString, QSize>> paperSizes = {
         {"A3 (1500*2100px)", QSize(1500, 2100)},
         {"A4 (1050*1500px)", QSize(1050, 1500)},
@@ -38,30 +38,30 @@ CanvasSetupDialog::CanvasSetupDialog(QWidget* parent)
 
     for (int i = 0; i < paperSizes.size(); ++i) {
         QPushButton* btn = new QPushButton;
-        btn->setFixedSize(150, 150); // ͳһťС
+        btn->setFixedSize(150, 150); // 统一按钮大小
 
         QVBoxLayout* btnLayout = new QVBoxLayout(btn);
         btnLayout->setAlignment(Qt::AlignCenter);
         btnLayout->setSpacing(5);
 
-        // Ԥͼ
+        // 添加预览图
         QLabel* previewLabel = new QLabel;
         previewLabel->setFixedSize(100, 100);
         paintPaperPreview(previewLabel, paperSizes[i].second, i == 3);
         btnLayout->addWidget(previewLabel);
 
-        // ˵
+        // 添加文字说明
         QLabel* textLabel = new QLabel(paperSizes[i].first);
         textLabel->setAlignment(Qt::AlignCenter);
         btnLayout->addWidget(textLabel);
 
         m_sizeGroup->addButton(btn, i);
-        sizeLayout->addWidget(btn, i / 2, i % 2); // 2x2񲼾
+        sizeLayout->addWidget(btn, i / 2, i % 2); // 2x2网格布局
     }
 
     contentLayout->addWidget(sizeWidget);
 
-    // Ҳ - ɫѡ
+    // 右侧 - 颜色选择
     QWidget* colorWidget = new QWidget;
     QGridLayout* colorLayout = new QGridLayout(colorWidget);
     colorLayout->setSpacing(15);
@@ -74,7 +74,7 @@ CanvasSetupDialog::CanvasSetupDialog(QWidget* parent)
         Qt::green, Qt::magenta, Qt::blue, Qt::black
     };
 
-    // 7ɫť + 1"..."ť
+    // 7个颜色按钮 + 1个"..."按钮
     for (int i = 0; i < 7; ++i) {
         QPushButton* colorBtn = new QPushButton;
         colorBtn->setFixedSize(50, 50);
@@ -88,7 +88,7 @@ CanvasSetupDialog::CanvasSetupDialog(QWidget* parent)
         });
     }
 
-    // "..."ť
+    // 添加"..."按钮
     QPushButton* moreColorBtn = new QPushButton("...");
     moreColorBtn->setFixedSize(50, 50);
     moreColorBtn->setStyleSheet("font-size: 20px;");
@@ -98,13 +98,13 @@ CanvasSetupDialog::CanvasSetupDialog(QWidget* parent)
     contentLayout->addWidget(colorWidget);
     mainLayout->addLayout(contentLayout);
 
-    // ȷ/ȡť
+    // 添加确认/取消按钮
     QDialogButtonBox* buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
     connect(buttonBox, &QDialogButtonBox::accepted, this, &QDialog::accept);
     connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
     mainLayout->addWidget(buttonBox);
 
-    // źŲ
+    // 连接信号槽
     connect(m_sizeGroup, &QButtonGroup::idClicked,
         this, &CanvasSetupDialog::onSizeButtonClicked);
 }
@@ -117,23 +117,23 @@ CanvasSetupDialog::CanvasSetupDialog(QWidget* parent)
         QPainter painter(&pixmap);
         painter.setRenderHint(QPainter::Antialiasing);
 
-        // ֽӰЧ
+        // 绘制纸张阴影效果
         painter.setPen(Qt::NoPen);
         painter.setBrush(QColor(200, 200, 200, 150));
         painter.drawRoundedRect(5, 5, pixmap.width() - 5, pixmap.height() - 5, 5, 5);
 
-        // ֽ
+        // 绘制纸张
         painter.setBrush(Qt::white);
         painter.setPen(QPen(Qt::black, 1));
         painter.drawRoundedRect(0, 0, pixmap.width() - 5, pixmap.height() - 5, 5, 5);
 
         if (isCustom) {
-            // ԶֽŻʺ
+            // 自定义纸张绘制问号
             painter.setFont(QFont("Arial", 24, QFont::Bold));
             painter.drawText(pixmap.rect(), Qt::AlignCenter, "?");
         }
         else {
-            // Ʊŵֽ
+            // 绘制比例缩放的纸张
             QRect paperRect(15, 15, pixmap.width() - 30, pixmap.height() - 30);
             if (size.width() > size.height()) {
                 paperRect.setHeight(paperRect.width() * size.height() / size.width());
@@ -158,7 +158,7 @@ void CanvasSetupDialog::onSizeButtonClicked(int id)
     case 1: m_canvasSize = QSize(1050, 1500); break;  // A4
     case 2: m_canvasSize = QSize(750, 1050); break;   // A5
     case 3: {
-        // Զߴ
+        // 自定义尺寸
         bool ok;
         int width = QInputDialog::getInt(this, "Custom Size", "Width (px):",
             1050, 100, 5000, 10, &ok);
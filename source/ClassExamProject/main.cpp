@@ -1,10 +1,61 @@
 ﻿#include "mainwindow.h"
+#include "TraceRecorder.h"
+#include "FlowDiff.h"
 #include <QApplication>
+#include <QGuiApplication>
+#include <cstdio>
+#ifdef Q_OS_WIN
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#ifdef Q_OS_WIN
+// 程序是窗口子系统，没有控制台；输出未被重定向时连接到启动它的控制台（没有则新建一个）
+static void attachConsole()
+{
+    const HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (output != nullptr && output != INVALID_HANDLE_VALUE) return; // 已重定向到文件或管道
+    if (!AttachConsole(ATTACH_PARENT_PROCESS) && !AllocConsole()) return;
+    FILE* stream = nullptr;
+    freopen_s(&stream, "CONOUT$", "w", stdout);
+    freopen_s(&stream, "CONOUT$", "w", stderr);
+}
+#endif
 
 int main(int argc, char* argv[])
 {
+    // 命令行比较/合并 .flow 文件（可配置为git的合并驱动）：在创建窗口程序之前判断，
+    // 不创建窗口，用 offscreen 平台运行，没有显示器的机器上也能使用（缩略图仍需要字体和绘图）
+    QStringList arguments;
+    for (int i = 0; i < argc; ++i) {
+        arguments.append(QString::fromLocal8Bit(argv[i]));
+    }
+    if (FlowDiff::isCommandLine(arguments)) {
+#ifdef Q_OS_WIN
+        attachConsole(); // Windows 总有桌面，沿用默认平台（发布目录中不一定带 offscreen 插件）
+#else
+        if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+#endif
+        QGuiApplication app(argc, argv);
+        return FlowDiff::runCommandLine(app.arguments());
+    }
+
     QApplication a(argc, argv);
+
+    // FLOW_TRACE=<文件路径> 时从启动开始录制，退出时导出
+    TraceRecorder::instance().initFromEnvironment();
+
     MainWindow w;
     w.show();
-    return a.exec();
+    int ret = a.exec();
+
+    TraceRecorder& recorder = TraceRecorder::instance();
+    if (!recorder.environmentOutput().isEmpty() && recorder.isEnabled()) {
+        recorder.stop();
+        recorder.saveToFile(recorder.environmentOutput());
+    }
+    return ret;
 }
\ No newline at end of file
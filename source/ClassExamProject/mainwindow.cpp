@@ -1,5 +1,23 @@
 ﻿#include "mainwindow.h"
 #include "canvassetupdialog.h"
+#include "TraceRecorder.h"
+#include "SvgExporter.h"
+#include "PdfExporter.h"
+#include "RenderBenchmark.h"
+#include "FormatBenchmark.h"
+#include "SearchBenchmark.h"
+#include "FlowDiff.h"
+#include "GraphImporter.h"
+#include "FindDialog.h"
+#include "WorkspaceSearchDialog.h"
+#include "FileBrowserDialog.h"
+#include "MinimapWidget.h"
+#include <QDoubleSpinBox>
+#include <QApplication>
+#include <QActionGroup>
+#include <QTextDocument>
+#include <QDataStream>
+#include <QSet>
 #include <QMenu>
 #include <QMenuBar>
 #include <QFileDialog>
@@ -14,17 +32,45 @@
 #include <QColor>
 #include <QColorDialog>
 #include <QCheckBox>
+#include <QScrollArea>
+#include <QDockWidget>
+#include <QDir>
+#include <QProgressDialog>
+#include <QElapsedTimer>
+#include <QSharedPointer>
 
 MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent),
-    canvasWidget(new CanvasWidget(this))
+    canvasWidget(new CanvasWidget(this)),
+    m_reloader(new HotReloader(canvasWidget, this)),
+    m_findDialog(new FindDialog(canvasWidget, this)),
+    m_workspaceIndex(new WorkspaceIndex(this)),
+    m_workspaceDialog(new WorkspaceSearchDialog(m_workspaceIndex, this))
 {
     setWindowTitle("Flowchart Painter");
     resize(800, 600);
-    setCentralWidget(canvasWidget);
+    // 画布大小固定，超出窗口时滚动查看
+    QScrollArea* scrollArea = new QScrollArea(this);
+    scrollArea->setWidget(canvasWidget);
+    scrollArea->setAlignment(Qt::AlignCenter);
+    setCentralWidget(scrollArea);
+    m_minimapDock = new QDockWidget("Overview", this);
+    m_minimapDock->setObjectName("minimapDock");
+    m_minimapDock->setWidget(new MinimapWidget(canvasWidget, scrollArea, m_minimapDock));
+    addDockWidget(Qt::RightDockWidgetArea, m_minimapDock);
+    connect(m_reloader, &HotReloader::reloaded, this, [this](int changedShapes, int conflicts) {
+        QString message = QString("Reloaded external changes (%1 shapes)").arg(changedShapes);
+        if (conflicts > 0) {
+            message += QString(", kept local edits in %1 conflicts").arg(conflicts);
+        }
+        statusBar()->showMessage(message, 4000);
+    });
+    connect(m_workspaceDialog, &WorkspaceSearchDialog::openRequested, this, &MainWindow::openSearchHit);
     setupMenu();
+    setupEditMenu();
     setupSettingsMenu();  // 初始化设置菜单
     setupSelectMenu();  // 显式调用新增的菜单初始化
+    setupToolsMenu();
 }
 
 void MainWindow::setupMenu()
@@ -34,12 +80,64 @@ void MainWindow::setupMenu()
     QAction* newAction = fileMenu->addAction("New");
     QAction* saveAction = fileMenu->addAction("Save");
     QAction* loadAction = fileMenu->addAction("Load");
+    QAction* browseAction = fileMenu->addAction("Browse...");
     QAction* savePngAction = fileMenu->addAction("Save as PNG");  // 新增
+    QAction* exportSvgAction = fileMenu->addAction("Export as SVG");
+    QAction* exportPdfAction = fileMenu->addAction("Export as PDF");
+    QAction* importGraphAction = fileMenu->addAction("Import Graph...");
 
     connect(newAction, &QAction::triggered, this, &MainWindow::newCanvasWithSetup);
     connect(saveAction, &QAction::triggered, this, &MainWindow::saveCanvas);
     connect(loadAction, &QAction::triggered, this, &MainWindow::loadCanvas);
+    connect(browseAction, &QAction::triggered, this, &MainWindow::browseFiles);
     connect(savePngAction, &QAction::triggered, this, &MainWindow::saveAsPng);  // 新增
+    connect(exportSvgAction, &QAction::triggered, this, &MainWindow::exportSvg);
+    connect(exportPdfAction, &QAction::triggered, this, &MainWindow::exportPdf);
+    connect(importGraphAction, &QAction::triggered, this, &MainWindow::importGraph);
+}
+
+void MainWindow::setupEditMenu() {
+    QMenu* editMenu = menuBar()->addMenu("Edit");
+    QAction* findAction = editMenu->addAction("Find...");
+    QAction* findNextAction = editMenu->addAction("Find Next");
+    QAction* findPreviousAction = editMenu->addAction("Find Previous");
+    QAction* replaceAction = editMenu->addAction("Replace...");
+    editMenu->addSeparator();
+    QAction* groupAction = editMenu->addAction("Group");
+    QAction* ungroupAction = editMenu->addAction("Ungroup");
+    groupAction->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_G));
+    ungroupAction->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_G));
+    connect(groupAction, &QAction::triggered, canvasWidget, &CanvasWidget::groupSelection);
+    connect(ungroupAction, &QAction::triggered, canvasWidget, &CanvasWidget::ungroupSelection);
+    editMenu->addSeparator();
+    QAction* workspaceAction = editMenu->addAction("Search Workspace...");
+    workspaceAction->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_F));
+    connect(workspaceAction, &QAction::triggered, m_workspaceDialog, &WorkspaceSearchDialog::showSearch);
+    findAction->setShortcut(QKeySequence::Find);
+    findNextAction->setShortcut(QKeySequence::FindNext);
+    findPreviousAction->setShortcut(QKeySequence::FindPrevious);
+    replaceAction->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_H));
+
+    connect(findAction, &QAction::triggered, this, [this]() { m_findDialog->showFind(false); });
+    connect(replaceAction, &QAction::triggered, this, [this]() { m_findDialog->showFind(true); });
+    connect(findNextAction, &QAction::triggered, m_findDialog, &FindDialog::findNext);
+    connect(findPreviousAction, &QAction::triggered, m_findDialog, &FindDialog::findPrevious);
+}
+
+void MainWindow::openSearchHit(const QString& fileName, quint64 shapeId, const QString& label) {
+    if (m_reloader->fileName() != QFileInfo(fileName).absoluteFilePath() && !openFile(fileName)) {
+        return;
+    }
+
+    // 旧版本文件没有持久ID，打开时重新分配，按标签文字定位
+    if (shapeId != 0 && canvasWidget->revealShape(shapeId)) return;
+    for (Shape* shape : canvasWidget->shapeList()) {
+        if (shape->label().text() == label) {
+            canvasWidget->revealShape(shape->id());
+            return;
+        }
+    }
+    statusBar()->showMessage("The shape is no longer in the file", 2000);
 }
 
 void MainWindow::setupInsertMenu() {
@@ -58,6 +156,148 @@ void MainWindow::setupSelectMenu() {
     connect(selectAction, &QAction::triggered, this, &MainWindow::setSelectMode);
 }
 
+void MainWindow::setupToolsMenu() {
+    QMenu* toolsMenu = menuBar()->addMenu("Tools");
+
+    traceAction = toolsMenu->addAction("Record Trace");
+    traceAction->setCheckable(true);
+    traceAction->setChecked(TraceRecorder::instance().isEnabled()); // 可能已由FLOW_TRACE开启
+    connect(traceAction, &QAction::toggled, this, &MainWindow::toggleTracing);
+
+    QAction* benchmarkAction = toolsMenu->addAction("Rendering Benchmark");
+    connect(benchmarkAction, &QAction::triggered, this, &MainWindow::runRenderBenchmark);
+
+    QAction* formatBenchmarkAction = toolsMenu->addAction("File Format Benchmark");
+    connect(formatBenchmarkAction, &QAction::triggered, this, &MainWindow::runFormatBenchmark);
+
+    QAction* searchBenchmarkAction = toolsMenu->addAction("Search Benchmark");
+    connect(searchBenchmarkAction, &QAction::triggered, this, &MainWindow::runSearchBenchmark);
+
+    QAction* labelStatsAction = toolsMenu->addAction("Label Storage Statistics");
+    connect(labelStatsAction, &QAction::triggered, this, &MainWindow::showLabelStorageStats);
+
+    QAction* compareAction = toolsMenu->addAction("Compare With File...");
+    connect(compareAction, &QAction::triggered, this, &MainWindow::compareWithFile);
+}
+
+void MainWindow::compareWithFile() {
+    QString fileName = QFileDialog::getOpenFileName(this, "Compare With File", "",
+        "Flow Files (*.flow *.flow.json)");
+    if (fileName.isEmpty()) return;
+
+    FlowDocument other;
+    if (!other.load(fileName)) {
+        QMessageBox::warning(this, "Error", "Failed to load file");
+        return;
+    }
+
+    // 文件为旧版本，当前画布为新版本
+    const FlowDocument current = canvasWidget->toDocument();
+    const FlowDiff diff = FlowDiff::compare(other, current);
+    QMessageBox box(QMessageBox::Information, "Compare With File",
+        diff.isEmpty() ? QString("No differences") : diff.summary(), QMessageBox::Ok, this);
+    if (!diff.isEmpty()) {
+        box.setDetailedText(diff.report(other, current));
+    }
+    box.exec();
+}
+
+void MainWindow::showLabelStorageStats() {
+    // 对比紧凑格式与之前保存的HTML（<body>内容）在内存和文件中的大小
+    int labels = 0;
+    qint64 htmlMemory = 0, compactMemory = 0;
+    qint64 htmlFile = 0, compactFile = 0;
+    QSet<int> formats;
+    for (const Shape* shape : canvasWidget->shapeList()) {
+        const RichLabel& label = shape->label();
+        if (label.isEmpty()) continue;
+        ++labels;
+
+        QTextDocument doc;
+        doc.setDefaultFont(shape->textFont());
+        label.toDocument(&doc);
+        QString html = doc.toHtml();
+        const int bodyStart = html.indexOf('>', html.indexOf("<body")) + 1;
+        html = html.mid(bodyStart, html.lastIndexOf("</body>") - bodyStart).trimmed();
+
+        htmlMemory += int(sizeof(QString)) + html.size() * int(sizeof(QChar));
+        compactMemory += label.memoryBytes();
+        htmlFile += 4 + html.size() * 2;                                  // QString
+        compactFile += 4 + label.text().size() * 2 + 4 + label.runs().size() * 12; // 文本 + 区段
+        for (const RichLabel::Run& run : label.runs()) {
+            formats.insert(run.format);
+        }
+    }
+
+    // 格式表在文件中只写一次
+    QByteArray table;
+    {
+        QDataStream out(&table, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_15);
+        for (int format : formats) {
+            out << static_cast<const QTextFormat&>(RichLabel::format(format));
+        }
+    }
+    compactFile += 4 + table.size();
+
+    QMessageBox::information(this, "Label Storage Statistics",
+        QString("%1 labels, %2 shared formats\n\n"
+            "Memory: %3 bytes as HTML -> %4 bytes compact\n"
+            "File: %5 bytes as HTML -> %6 bytes compact")
+        .arg(labels).arg(formats.size())
+        .arg(htmlMemory).arg(compactMemory)
+        .arg(htmlFile).arg(compactFile));
+}
+
+void MainWindow::runRenderBenchmark() {
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QString report = RenderBenchmark::run();
+    QApplication::restoreOverrideCursor();
+    QMessageBox::information(this, "Rendering Benchmark", report);
+}
+
+void MainWindow::runFormatBenchmark() {
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QString report = FormatBenchmark::run();
+    QApplication::restoreOverrideCursor();
+    QMessageBox::information(this, "File Format Benchmark", report);
+}
+
+void MainWindow::runSearchBenchmark() {
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QString report = SearchBenchmark::run();
+    QApplication::restoreOverrideCursor();
+    QMessageBox::information(this, "Search Benchmark", report);
+}
+
+void MainWindow::toggleTracing(bool enabled) {
+    TraceRecorder& recorder = TraceRecorder::instance();
+    if (enabled) {
+        recorder.start();
+        statusBar()->showMessage("Trace recording started", 2000);
+        return;
+    }
+
+    recorder.stop();
+    QString fileName = QFileDialog::getSaveFileName(
+        this,
+        "Save Trace",
+        "",
+        "Chrome Trace Files (*.json)"
+    );
+    if (fileName.isEmpty()) return;
+    if (!fileName.endsWith(".json", Qt::CaseInsensitive)) {
+        fileName += ".json";
+    }
+
+    if (recorder.saveToFile(fileName)) {
+        statusBar()->showMessage("Trace saved successfully", 2000);
+    }
+    else {
+        QMessageBox::warning(this, "Error", "Failed to save trace file");
+    }
+}
+
 void MainWindow::insertEllipse() {
     canvasWidget->setCurrentShapeType(ShapeType_Ellipse);  // 修改
 }
@@ -77,6 +317,46 @@ void MainWindow::setupSettingsMenu()
     settingsMenu->addAction(gridAction);
     connect(gridAction, &QAction::toggled, this, &MainWindow::toggleGrid);
 
+    QAction* reloadAction = settingsMenu->addAction("Reload On External Change");
+    reloadAction->setCheckable(true);
+    reloadAction->setChecked(m_reloader->isEnabled());
+    connect(reloadAction, &QAction::toggled, m_reloader, &HotReloader::setEnabled);
+
+    // 拖动时吸附（按住Alt临时关闭）
+    QMenu* snapMenu = settingsMenu->addMenu("Snapping");
+    QAction* snapGridAction = snapMenu->addAction("Snap To Grid");
+    snapGridAction->setCheckable(true);
+    snapGridAction->setChecked(canvasWidget->snapToGrid());
+    connect(snapGridAction, &QAction::toggled, canvasWidget, &CanvasWidget::setSnapToGrid);
+    QAction* snapShapesAction = snapMenu->addAction("Snap To Shapes");
+    snapShapesAction->setCheckable(true);
+    snapShapesAction->setChecked(canvasWidget->snapToShapes());
+    connect(snapShapesAction, &QAction::toggled, canvasWidget, &CanvasWidget::setSnapToShapes);
+
+    QAction* minimapAction = m_minimapDock->toggleViewAction();
+    minimapAction->setText("Show Minimap");
+    settingsMenu->addAction(minimapAction);
+
+    // 渲染方式（单选）
+    QMenu* renderMenu = settingsMenu->addMenu("Rendering");
+    renderModeGroup = new QActionGroup(this);
+    QAction* directAction = renderMenu->addAction("Direct");
+    directAction->setData(static_cast<int>(DirectRender));
+    QAction* threadedAction = renderMenu->addAction("Background Thread");
+    threadedAction->setData(static_cast<int>(ThreadedRender));
+    QAction* progressiveAction = renderMenu->addAction("Progressive");
+    progressiveAction->setData(static_cast<int>(ProgressiveRender));
+    for (QAction* action : { directAction, threadedAction, progressiveAction }) {
+        action->setCheckable(true);
+        renderModeGroup->addAction(action);
+    }
+    connect(renderModeGroup, &QActionGroup::triggered, this, &MainWindow::changeRenderMode);
+    threadedAction->setChecked(true);
+    canvasWidget->setRenderMode(ThreadedRender);
+    renderMenu->addSeparator();
+    QAction* qualityAction = renderMenu->addAction("Interaction Quality...");
+    connect(qualityAction, &QAction::triggered, this, &MainWindow::editInteractionQuality);
+
     // 2. 新增初始化图形属性子菜单
     QMenu* initPropsMenu = settingsMenu->addMenu("Initialize Shape Properties");
     QAction* lineAction = initPropsMenu->addAction("Line Settings");
@@ -205,6 +485,62 @@ void MainWindow::toggleGrid(bool show)
     canvasWidget->setGridVisible(show);
 }
 
+void MainWindow::changeRenderMode(QAction* action)
+{
+    canvasWidget->setRenderMode(static_cast<RenderMode>(action->data().toInt()));
+}
+
+void MainWindow::editInteractionQuality()
+{
+    InteractionQuality quality = canvasWidget->interactionQuality();
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("Interaction Quality");
+    QFormLayout layout(&dialog);
+
+    QCheckBox enabledCheck("Lower quality while panning, zooming or dragging");
+    enabledCheck.setChecked(quality.enabled);
+
+    // 阈值
+    QSpinBox idleSpin;
+    idleSpin.setRange(0, 5000);
+    idleSpin.setSuffix(" ms");
+    idleSpin.setValue(quality.idleMs);
+    QSpinBox minShapesSpin;
+    minShapesSpin.setRange(0, 1000000);
+    minShapesSpin.setValue(quality.minShapes);
+
+    // 降级项
+    QCheckBox antialiasCheck("Disable antialiasing");
+    antialiasCheck.setChecked(quality.disableAntialiasing);
+    QCheckBox hairlineCheck("Draw borders as solid hairlines");
+    hairlineCheck.setChecked(quality.hairlines);
+    QCheckBox placeholderCheck("Draw text as placeholders");
+    placeholderCheck.setChecked(quality.placeholderText);
+
+    QDialogButtonBox buttons(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    layout.addRow(&enabledCheck);
+    layout.addRow("Refine after idle:", &idleSpin);
+    layout.addRow("Minimum shapes:", &minShapesSpin);
+    layout.addRow(&antialiasCheck);
+    layout.addRow(&hairlineCheck);
+    layout.addRow(&placeholderCheck);
+    layout.addRow(&buttons);
+
+    connect(&buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(&buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+    if (dialog.exec() == QDialog::Accepted) {
+        quality.enabled = enabledCheck.isChecked();
+        quality.idleMs = idleSpin.value();
+        quality.minShapes = minShapesSpin.value();
+        quality.disableAntialiasing = antialiasCheck.isChecked();
+        quality.hairlines = hairlineCheck.isChecked();
+        quality.placeholderText = placeholderCheck.isChecked();
+        canvasWidget->setInteractionQuality(quality);
+    }
+}
+
 void MainWindow::newCanvas()
 {
     bool ok;
@@ -215,6 +551,7 @@ void MainWindow::newCanvas()
     if (!ok) return;
 
     canvasWidget->createNewCanvas(width, height);
+    m_reloader->watch(QString()); // 新画布不再对应原文件
 }
 
 void MainWindow::saveCanvas()
@@ -223,12 +560,12 @@ void MainWindow::saveCanvas()
         this,
         "Save Flowchart",
         "",
-        "Flowchart Files (*.flow)"
+        "Flowchart Files (*.flow);;Flowchart JSON (*.flow.json)"
     );
 
     if (!fileName.isEmpty()) {
         // 确保文件扩展名正确
-        if (!fileName.endsWith(".flow", Qt::CaseInsensitive)) {
+        if (!fileName.endsWith(".flow", Qt::CaseInsensitive) && !FlowDocument::isJsonFileName(fileName)) {
             fileName += ".flow";
         }
 
@@ -240,6 +577,7 @@ void MainWindow::saveCanvas()
         }
 
         if (canvasWidget->saveToFile(fileName)) {
+            m_reloader->watch(fileName);
             statusBar()->showMessage("File saved successfully", 2000);
         }
         else {
@@ -255,11 +593,31 @@ void MainWindow::saveCanvas()
 
 void MainWindow::loadCanvas()
 {
-    QString fileName = QFileDialog::getOpenFileName(this, "Load Flowchart", "", "Flowchart Files (*.flow)");
+    QString fileName = QFileDialog::getOpenFileName(this, "Load Flowchart", "",
+        "Flowchart Files (*.flow *.flow.json)");
     if (!fileName.isEmpty()) {
-        if (!canvasWidget->loadFromFile(fileName)) {
-            QMessageBox::warning(this, "Error", "Failed to load file");
-        }
+        openFile(fileName);
+    }
+}
+
+bool MainWindow::openFile(const QString& fileName)
+{
+    if (!canvasWidget->loadFromFile(fileName)) {
+        QMessageBox::warning(this, "Error", "Failed to load file");
+        return false;
+    }
+    m_reloader->watch(fileName);
+    return true;
+}
+
+void MainWindow::browseFiles()
+{
+    // 从当前文件所在目录开始浏览
+    const QString current = m_reloader->fileName();
+    FileBrowserDialog dialog(this);
+    dialog.setDirectory(current.isEmpty() ? QDir::currentPath() : QFileInfo(current).absolutePath());
+    if (dialog.exec() == QDialog::Accepted && !dialog.selectedFile().isEmpty()) {
+        openFile(dialog.selectedFile());
     }
 }
 
@@ -309,6 +667,164 @@ void MainWindow::saveAsPng() {
     }
 }
 
+void MainWindow::exportSvg() {
+    QString fileName = QFileDialog::getSaveFileName(
+        this,
+        "Export Flowchart as SVG",
+        "",
+        "SVG Images (*.svg)"
+    );
+    if (fileName.isEmpty()) return;
+
+    // 确保文件扩展名正确
+    if (!fileName.endsWith(".svg", Qt::CaseInsensitive)) {
+        fileName += ".svg";
+    }
+
+    SvgExporter exporter(canvasWidget->shapeList(), canvasWidget->size(), canvasWidget->canvasColor());
+    if (exporter.exportToFile(fileName)) {
+        statusBar()->showMessage("SVG exported successfully", 2000);
+    }
+    else {
+        QMessageBox::warning(this, "Error",
+            "Failed to export SVG file.\n" + exporter.errorString());
+    }
+}
+
+void MainWindow::importGraph() {
+    QString fileName = QFileDialog::getOpenFileName(this, "Import Graph", "",
+        "Graph Files (*.json *.dot *.gv *.csv)");
+    if (fileName.isEmpty()) return;
+
+    GraphImporter::Format format;
+    if (!GraphImporter::formatForFile(fileName, &format)) {
+        QMessageBox::warning(this, "Error", "Unsupported file type");
+        return;
+    }
+
+    // 后台解析，每批节点解析完就加到画布上；整个导入期间保持一个批量修改，
+    // 每隔一段时间提交一次，重绘次数与文件大小无关
+    const qint64 commitIntervalMs = 250;
+    GraphImporter* importer = new GraphImporter(this);
+    QProgressDialog* progress = new QProgressDialog("Importing graph...", "Cancel", 0, 100, this);
+    progress->setMinimumDuration(500);
+    QSharedPointer<QElapsedTimer> sinceCommit(new QElapsedTimer);
+    sinceCommit->start();
+    canvasWidget->beginBatch();
+
+    connect(importer, &GraphImporter::shapesReady, this, [this, sinceCommit, commitIntervalMs](const QVector<ShapeRecord>& records) {
+        canvasWidget->addShapes(records);
+        if (sinceCommit->elapsed() >= commitIntervalMs) {
+            canvasWidget->commitBatch(); // 显示已导入的部分
+            canvasWidget->beginBatch();
+            sinceCommit->restart();
+        }
+        });
+    connect(importer, &GraphImporter::progress, progress, [progress](qint64 bytesRead, qint64 totalBytes) {
+        progress->setValue(totalBytes > 0 ? int(bytesRead * 100 / totalBytes) : 0);
+        });
+    connect(progress, &QProgressDialog::canceled, importer, &GraphImporter::cancel);
+    connect(importer, &GraphImporter::finished, this,
+        [this, importer, progress](bool ok, const QString& error, int nodes, int edges, const QRectF& bounds) {
+        canvasWidget->commitBatch();
+        const bool cancelled = progress->wasCanceled();
+        progress->deleteLater();
+        canvasWidget->growToFit(bounds);
+        if (ok) {
+            statusBar()->showMessage(QString("Imported %1 nodes (%2 edges skipped)").arg(nodes).arg(edges), 4000);
+        }
+        else if (cancelled) {
+            statusBar()->showMessage(QString("Import cancelled, %1 nodes were imported").arg(nodes), 4000);
+        }
+        else {
+            statusBar()->clearMessage();
+            QMessageBox::warning(this, "Error", QString("Failed to import graph.\n%1\n%2 nodes were imported.")
+                .arg(error).arg(nodes));
+        }
+        importer->deleteLater();
+        });
+    importer->start(fileName, format);
+}
+
+void MainWindow::exportPdf() {
+    QDialog dialog(this);
+    dialog.setWindowTitle("Export as PDF");
+    QFormLayout layout(&dialog);
+
+    // 纸张大小
+    QComboBox sizeCombo;
+    sizeCombo.addItem("A4", static_cast<int>(QPageSize::A4));
+    sizeCombo.addItem("A3", static_cast<int>(QPageSize::A3));
+    sizeCombo.addItem("Letter", static_cast<int>(QPageSize::Letter));
+
+    // 纸张方向
+    QComboBox orientationCombo;
+    orientationCombo.addItem("Portrait", static_cast<int>(QPageLayout::Portrait));
+    orientationCombo.addItem("Landscape", static_cast<int>(QPageLayout::Landscape));
+
+    // 相邻页面重叠宽度
+    QDoubleSpinBox overlapSpin;
+    overlapSpin.setRange(0, 50);
+    overlapSpin.setSuffix(" mm");
+    overlapSpin.setValue(10);
+
+    QDialogButtonBox btnBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    layout.addRow("Page size:", &sizeCombo);
+    layout.addRow("Orientation:", &orientationCombo);
+    layout.addRow("Overlap:", &overlapSpin);
+    layout.addRow(&btnBox);
+    connect(&btnBox, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(&btnBox, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    QString fileName = QFileDialog::getSaveFileName(
+        this,
+        "Export Flowchart as PDF",
+        "",
+        "PDF Files (*.pdf)"
+    );
+    if (fileName.isEmpty()) return;
+
+    // 确保文件扩展名正确
+    if (!fileName.endsWith(".pdf", Qt::CaseInsensitive)) {
+        fileName += ".pdf";
+    }
+
+    PdfExporter::Options options;
+    options.pageSize = QPageSize(static_cast<QPageSize::PageSizeId>(sizeCombo.currentData().toInt()));
+    options.orientation = static_cast<QPageLayout::Orientation>(orientationCombo.currentData().toInt());
+    options.overlapMm = overlapSpin.value();
+
+    // 后台导出，界面只显示进度，可以随时取消
+    PdfExporter* exporter = new PdfExporter(canvasWidget->shapeList(), canvasWidget->size(),
+        canvasWidget->canvasColor(), options, this);
+    QProgressDialog* progress = new QProgressDialog("Exporting PDF...", "Cancel", 0, 0, this);
+    progress->setMinimumDuration(500);
+    connect(exporter, &PdfExporter::progress, progress, [this, progress](int done, int total) {
+        progress->setMaximum(total);
+        progress->setValue(done);
+        statusBar()->showMessage(QString("Exporting PDF: page %1 of %2").arg(done).arg(total));
+        });
+    connect(progress, &QProgressDialog::canceled, exporter, &PdfExporter::cancel);
+    connect(exporter, &PdfExporter::finished, this, [this, exporter, progress](bool ok, const QString& error) {
+        const bool cancelled = progress->wasCanceled();
+        progress->deleteLater();
+        if (ok) {
+            statusBar()->showMessage("PDF exported successfully", 2000);
+        }
+        else if (cancelled) {
+            statusBar()->showMessage("PDF export cancelled", 2000);
+        }
+        else {
+            statusBar()->clearMessage();
+            QMessageBox::warning(this, "Error", "Failed to export PDF file.\n" + error);
+        }
+        exporter->deleteLater();
+        });
+    exporter->start(fileName);
+}
+
 void MainWindow::newCanvasWithSetup()
 {
     CanvasSetupDialog dialog(this);
@@ -318,5 +834,6 @@ void MainWindow::newCanvasWithSetup()
             dialog.getCanvasSize().height());
         // 设置画布背景色
         canvasWidget->setCanvasColor(dialog.getCanvasColor());
+        m_reloader->watch(QString()); // 新画布不再对应原文件
     }
 }
\ No newline at end of file
@@ -4,6 +4,12 @@
 #include <QMainWindow>
 #include <QMenu>
 #include "canvaswidget.h"
+#include "HotReloader.h"
+
+class FindDialog;
+class WorkspaceIndex;
+class WorkspaceSearchDialog;
+class QDockWidget;
 
 class MainWindow : public QMainWindow
 {
@@ -18,7 +24,11 @@ private slots:
     void newCanvas();
     void saveCanvas();
     void saveAsPng();  // 新增：保存为PNG
+    void exportSvg();  // 导出为矢量SVG
+    void exportPdf();  // 导出为多页矢量PDF
+    void importGraph();  // 导入JSON/DOT/CSV图描述
     void loadCanvas();
+    void browseFiles();  // 带缩略图预览的打开对话框
     void toggleGrid(bool show);  // 新增：切换网格显示
 
     void insertRectangle();
@@ -27,14 +37,33 @@ private slots:
     void editInitialLineProperties();  // 初始化线条属性
     void editInitialFillProperties();  // 初始化填充属性
     void newCanvasWithSetup();  // 替换原来的newCanvas
+    void toggleTracing(bool enabled);  // 开始/停止录制trace
+    void runRenderBenchmark();  // 渲染基准测试
+    void runFormatBenchmark();  // 文件格式基准测试
+    void runSearchBenchmark();  // 标签查找基准测试
+    void showLabelStorageStats();  // 标签存储占用统计
+    void compareWithFile();  // 与.flow文件做结构化比较
+    void openSearchHit(const QString& fileName, quint64 shapeId, const QString& label);  // 打开工作区搜索结果
+    void changeRenderMode(QAction* action);  // 切换渲染方式
+    void editInteractionQuality();  // 交互画质设置
 
 private:
     void setupMenu();
     void setupSettingsMenu();  // 新增：设置菜单
+    void setupEditMenu();      // 查找/替换
+    bool openFile(const QString& fileName);  // 加载文件并开始监视外部修改
     void setupSelectMenu();
     CanvasWidget* canvasWidget;
+    HotReloader* m_reloader;  // 外部修改当前文件后自动重载
+    FindDialog* m_findDialog; // 查找/替换（非模态）
+    WorkspaceIndex* m_workspaceIndex;  // 工作区搜索索引（后台扫描）
+    WorkspaceSearchDialog* m_workspaceDialog;
+    QDockWidget* m_minimapDock;     // 小地图
     QAction* gridAction;  // 新增：网格动作
+    QAction* traceAction; // 追踪录制开关
+    QActionGroup* renderModeGroup; // 渲染方式（单选）
     void setupInsertMenu();  // 新增插入菜单
+    void setupToolsMenu();   // 工具菜单（性能追踪等）
     QPen m_initialPen{ Qt::black, 2, Qt::SolidLine };  // 默认初始线条：黑色、宽度2
     QBrush m_initialBrush{ Qt::white };                // 默认初始填充：白色
 };
@@ -2,9 +2,10 @@
 #include <QtMath>
 #include <QApplication>
 #include <QPainterPath>
-#include <QPainterPathStroker>
 #include <QTextDocument>
 #include <QTextCursor>
+#include <QAbstractTextDocumentLayout>
+#include "TraceRecorder.h"
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
@@ -23,23 +24,23 @@ void Shape::drawControlHandles(QPainter* painter) const {
 
     painter->save();
 
-    // Ӧת
-    QPointF center = boundingRect.center();
-    painter->translate(center);
-    painter->rotate(qRadiansToDegrees(m_rotation));
-    painter->translate(-center);
+    // 应用旋转
+    painter->setWorldTransform(worldTransform(), true);
 
-    // ת߽߱
+    // 绘制旋转后的虚线边界框
     painter->setPen(QPen(QColor(0, 0, 255, 150), 1, Qt::DashLine));
     painter->drawRect(boundingRect);
 
     painter->restore();
 
-    // ƿƵ㣨ͨgetControlHandles()ת꣩
-    QVector<ControlHandle> handles = getControlHandles();
+    // 绘制控制点（已通过getControlHandles()返回旋转后坐标）
+    static const QPen handlePen(Qt::white, 2);
+    static const QBrush rotateBrush(Qt::green);
+    static const QBrush scaleBrush(Qt::red);
+    const HandleArray handles = getControlHandles();
+    painter->setPen(handlePen);
     for (const ControlHandle& h : handles) {
-        painter->setPen(QPen(Qt::white, 2));
-        painter->setBrush(h.type == Rotate ? Qt::green : Qt::red);
+        painter->setBrush(h.type == Rotate ? rotateBrush : scaleBrush);
         painter->drawEllipse(h.pos, 6, 6);
     }
 }
@@ -51,154 +52,308 @@ void Shape::setPosition(const QPointF& pos) {
     boundingRect.moveTo(pos);
 }
 
-// ʵ
+// 矩形实现
 Rectangle::Rectangle(const QRectF& rect) : Shape(ShapeType_Rectangle, rect) {}
 
-void Shape::setText(const QString& text, const QFont& font, const QColor& color) {
-    m_text = text;
+void Shape::setLabel(const RichLabel& label, const QFont& font, const QColor& color) {
+    m_label = label;
     m_textFont = font;
     m_textColor = color;
+    analyzeLabel();
     markDirty();
 }
 
-void Rectangle::draw(QPainter* painter) {
-    painter->save();
+void Shape::setText(const QString& html, const QFont& font, const QColor& color) {
+    setLabel(RichLabel::fromHtml(html), font, color);
+}
+
+static bool s_plainLabelFastPath = true;
+
+void Shape::setPlainLabelFastPath(bool enabled) {
+    s_plainLabelFastPath = enabled;
+}
+
+void Shape::analyzeLabel() {
+    m_plainLabel = false;
+    m_plainText.clear();
+    m_labelLayout.reset();
+    if (m_label.isEmpty()) return;
+
+    // 整段文字只有一种字符格式：没有区段，或唯一的区段覆盖全部文字
+    const QString& plain = m_label.text();
+    const QVector<RichLabel::Run>& runs = m_label.runs();
+    if (runs.size() > 1) return;
+    if (runs.size() == 1 && (runs[0].start != 0 || runs[0].length != plain.size())) return;
+    if (plain.contains(QLatin1Char('\n')) || plain.contains(QChar::LineSeparator)
+        || plain.contains(QChar::ObjectReplacementCharacter)) {
+        return;
+    }
+
+    const QTextCharFormat format = runs.isEmpty() ? QTextCharFormat() : RichLabel::format(runs[0].format);
+    if (format.isAnchor() || format.isImageFormat()
+        || format.hasProperty(QTextFormat::BackgroundBrush)
+        || format.verticalAlignment() != QTextCharFormat::AlignNormal) {
+        return;
+    }
+
+    m_plainText = plain;
+    m_plainFont = format.font().resolve(m_textFont);
+    m_plainColor = format.hasProperty(QTextFormat::ForegroundBrush)
+        ? format.foreground().color() : m_textColor;
+    m_plainLabel = true;
+}
+
+qreal Shape::plainLabelWidth() const {
+    // 与QTextDocument路径一致：宽度为90%，扣除文档四周4像素边距
+    return qMax<qreal>(1, boundingRect.width() * 0.9 - 8);
+}
+
+void Shape::layoutDocument(QTextDocument* doc) const {
+    TRACE_SCOPE("QTextDocument layout");
+    doc->setDefaultFont(textFont());
+    m_label.toDocument(doc);
+    doc->setTextWidth(boundingRect.width() * 0.9); // 留边距
+
+    // 居中对齐段落
+    QTextCursor cursor(doc);
+    QTextBlockFormat fmt;
+    fmt.setAlignment(Qt::AlignCenter);
+    cursor.select(QTextCursor::Document);
+    cursor.mergeBlockFormat(fmt);
+}
+
+void Shape::prepareLabel() const {
+    if (m_label.isEmpty()) return;
+    const bool plain = m_plainLabel && s_plainLabelFastPath;
+    if (m_labelLayout && m_labelLayout->boxWidth == boundingRect.width() && m_labelLayout->plain == plain
+        && (!plain || m_labelLayout->rotation == m_rotation)) {
+        return;
+    }
+
+    LabelLayout* layout = new LabelLayout;
+    layout->boxWidth = boundingRect.width();
+    layout->rotation = m_rotation;
+    layout->plain = plain;
+    if (plain) {
+        // 按绘制时的旋转预先排好字形，之后每次绘制都不再重排
+        layout->text = QStaticText(m_plainText);
+        layout->text.setTextFormat(Qt::PlainText);
+        layout->text.setTextWidth(plainLabelWidth());
+        layout->text.setTextOption(QTextOption(Qt::AlignHCenter));
+        layout->text.prepare(QTransform().rotate(qRadiansToDegrees(m_rotation)), m_plainFont);
+        layout->size = layout->text.size();
+    }
+    else {
+        QTextDocument doc;
+        layoutDocument(&doc);
+        layout->size = doc.size();
+    }
+    m_labelLayout.reset(layout);
+}
+
+QRectF Shape::labelBounds() const {
+    if (m_label.isEmpty()) return QRectF();
+    prepareLabel();
+    // 标签绕外框中心居中并随图形旋转
+    QRectF rect(QPointF(), m_labelLayout->size);
+    rect.moveCenter(boundingRect.center());
+    return worldTransform().mapRect(rect).adjusted(-1, -1, 1, 1);
+}
+
+QRectF Shape::contentBounds() const {
+    QRectF bounds = paintBounds();
+    if (hasText()) {
+        bounds |= labelBounds();
+    }
+    return bounds;
+}
+
+QRectF Shape::visualBounds() const {
+    QRectF bounds = contentBounds();
+    if (m_selected) {
+        for (const ControlHandle& handle : getControlHandles()) {
+            bounds |= QRectF(handle.pos - QPointF(8, 8), QSizeF(16, 16));
+        }
+    }
+    return bounds;
+}
+
+bool Shape::rendersSameAs(const Shape& other) const {
+    return type == other.type
+        && boundingRect == other.boundingRect
+        && m_rotation == other.m_rotation
+        && m_selected == other.m_selected
+        && m_pen == other.m_pen
+        && m_brush == other.m_brush
+        && m_textColor == other.m_textColor
+        && m_textFont == other.m_textFont
+        && m_label == other.m_label;
+}
+
+void Shape::drawPlainLabel(QPainter* painter) const {
+    prepareLabel(); // 渲染副本通常已与原图形共享排版
+    const QSharedPointer<const LabelLayout> layout = m_labelLayout;
 
-    // Ӧת
-    QPointF center = boundingRect.center();
-    painter->translate(center);
+    painter->save();
+    painter->setFont(m_plainFont);
+    painter->setPen(m_plainColor);
+    painter->translate(boundingRect.center());
     painter->rotate(qRadiansToDegrees(getRotation()));
-    painter->translate(-center);
+    const QSizeF size = layout->size;
+    {
+        QMutexLocker lock(&layout->drawLock);
+        painter->drawStaticText(QPointF(-size.width() / 2, -size.height() / 2), layout->text);
+    }
+    painter->restore();
+}
+
+// 通用绘制流程：主体（填充+边框） -> 控制点 -> 文字
+void Shape::draw(QPainter* painter) {
+    TRACE_SCOPE("Shape::draw");
+    drawBody(painter);
+
+    // 绘制控制点（选中时）
+    if (isSelected()) {
+        drawControlHandles(painter);
+    }
+    drawLabel(painter);
+}
+
+void Shape::drawBody(QPainter* painter) const {
+    painter->save();
+
+    // 应用旋转
+    painter->setWorldTransform(worldTransform(), true);
 
-    // Ȼ䣨ߣ
+    // 先绘制填充（覆盖网格线）
     painter->setBrush(brush());
-    painter->setPen(Qt::NoPen); // ʱҪ߿
-    painter->drawRect(boundingRect);
+    painter->setPen(Qt::NoPen); // 填充时不需要边框
+    drawOutline(painter);
 
-    // ٻƱ߿У
+    // 再绘制边框（如果有）
     if (pen().style() != Qt::NoPen) {
         painter->setPen(pen());
         painter->setBrush(Qt::NoBrush);
-        painter->drawRect(boundingRect);
+        drawOutline(painter);
     }
 
     painter->restore();
+}
 
-    // ƿƵ㣨ѡʱ
-    if (isSelected()) {
-        drawControlHandles(painter);
+void Shape::drawLabel(QPainter* painter) const {
+    if (m_label.isEmpty()) return;
+    if (m_plainLabel && s_plainLabelFastPath) {
+        drawPlainLabel(painter);
+        return;
     }
-    if (!text().isEmpty()) {
-        painter->save();
-        painter->setFont(textFont());
-        painter->setPen(textColor());
 
-        QTextDocument doc;
-        doc.setHtml(text());
-        doc.setDefaultFont(textFont());
-        doc.setTextWidth(boundingRect.width() * 0.9); // ߾
+    painter->save();
 
-        // ж
-        QTextCursor cursor(&doc);
-        QTextBlockFormat fmt;
-        fmt.setAlignment(Qt::AlignCenter);
-        cursor.select(QTextCursor::Document);
-        cursor.mergeBlockFormat(fmt);
+    QTextDocument doc;
+    layoutDocument(&doc);
+    const QSizeF docSize = doc.size();
 
-        QSizeF docSize = doc.size();
+    painter->translate(boundingRect.center());
+    painter->rotate(qRadiansToDegrees(getRotation()));
 
-        painter->translate(boundingRect.center());
-        painter->rotate(qRadiansToDegrees(getRotation()));
+    qreal xOffset = -docSize.width() / 2;
+    qreal yOffset = -docSize.height() / 2;
+    painter->translate(xOffset, yOffset);
 
-        qreal xOffset = -docSize.width() / 2;
-        qreal yOffset = -docSize.height() / 2;
-        painter->translate(xOffset, yOffset);
+    // drawContents 用调色板的文字颜色而不是画笔，没有前景色的文字须按标签颜色绘制，
+    // 与纯文本快速路径一致
+    QAbstractTextDocumentLayout::PaintContext context;
+    context.palette.setColor(QPalette::Text, textColor());
+    doc.documentLayout()->draw(painter, context);
 
-        doc.drawContents(painter);
+    painter->restore();
+}
 
-        painter->restore();
-    }
+void Rectangle::drawOutline(QPainter* painter) const {
+    painter->drawRect(boundingRect);
 }
 
-// Բʵ
+void Rectangle::addOutline(QPainterPath& path) const {
+    path.addRect(boundingRect);
+}
+
+// 椭圆实现
 Ellipse::Ellipse(const QRectF& rect) : Shape(ShapeType_Ellipse, rect) {}
 
 
 Shape::TransformState Shape::getTransformState() const {
     TransformState state;
     state.bounds = boundingRect;
-    state.rotation = 0; // ״ʼת
+    state.rotation = 0; // 基础形状初始无旋转
     return state;
 }
 
-QVector<Shape::ControlHandle> Shape::getControlHandles() const {
-    QVector<ControlHandle> handles;
+Shape::HandleArray Shape::getControlHandles() const {
     const QRectF& rect = boundingRect;
-
-    // Ƶ㣨δתʱλã
-    QVector<QPointF> basePoints = {
-        rect.topLeft(),     rect.topRight(),
-        rect.bottomRight(), rect.bottomLeft(),
-        QPointF(rect.center().x(), rect.top()),
-        QPointF(rect.right(), rect.center().y()),
-        QPointF(rect.center().x(), rect.bottom()),
-        QPointF(rect.left(), rect.center().y()),
-        QPointF(rect.center().x(), rect.top() - 20) // תƵ
+    const QPointF c = rect.center();
+    const QTransform& transform = worldTransform(); // 应用当前旋转
+
+    // 基本控制点（未旋转时的位置）
+    const QPointF basePoints[HANDLE_COUNT] = {
+        rect.topLeft(),      // 0: 左上角
+        rect.topRight(),     // 1: 右上角
+        rect.bottomRight(),  // 2: 右下角
+        rect.bottomLeft(),   // 3: 左下角
+        QPointF(c.x(), rect.top()),    // 4: 上边中点
+        QPointF(rect.right(), c.y()),  // 5: 右边中点
+        QPointF(c.x(), rect.bottom()), // 6: 下边中点
+        QPointF(rect.left(), c.y()),   // 7: 左边中点
+        QPointF(c.x(), rect.top() - rotateHandleOffset()) // 8: 旋转控制点
     };
 
-    // Ӧõǰת
-    QTransform transform;
-    transform.translate(rect.center().x(), rect.center().y());
-    transform.rotate(qRadiansToDegrees(m_rotation));
-    transform.translate(-rect.center().x(), -rect.center().y());
-
-    for (int i = 0; i < basePoints.size(); ++i) {
-        handles.append({
-            transform.map(basePoints[i]),  // ת
-            (i == 8) ? Rotate : Scale,    // 9תƵ
-            i
-            });
+    HandleArray handles;
+    for (int i = 0; i < HANDLE_COUNT; ++i) {
+        handles[i].pos = transform.map(basePoints[i]); // 旋转后的坐标
+        handles[i].type = (i == 8) ? Rotate : Scale;   // 第9个点是旋转控制点
+        handles[i].index = i;
     }
     return handles;
 }
 
-QVector<Shape::ControlHandle> Rectangle::getControlHandles() const {
-    QVector<Shape::ControlHandle> handles;
-    const QRectF& rect = boundingRect;
+const QTransform& Shape::worldTransform() const {
+    updateTransformCache();
+    return m_worldTransform;
+}
 
-    // Ƶ㣨δתʱλã
-    QVector<QPointF> basePoints = {
-        rect.topLeft(),      // 0: Ͻ
-        rect.topRight(),     // 1: Ͻ
-        rect.bottomRight(),  // 2: ½
-        rect.bottomLeft(),   // 3: ½
-        QPointF(rect.center().x(), rect.top()),    // 4: ϱе
-        QPointF(rect.right(), rect.center().y()),  // 5: ұе
-        QPointF(rect.center().x(), rect.bottom()), // 6: ±е
-        QPointF(rect.left(), rect.center().y()),   // 7: е
-        QPointF(rect.center().x(), rect.top() - 20) // 8: תƵ
-    };
+QRectF Shape::paintBounds() const {
+    const qreal pad = m_pen.widthF() / 2 + 1;
+    return worldTransform().mapRect(boundingRect).adjusted(-pad, -pad, pad, pad);
+}
+
+const QTransform& Shape::inverseTransform() const {
+    updateTransformCache();
+    return m_inverseTransform;
+}
 
-    // Ӧõǰת
-    QTransform transform;
-    transform.translate(rect.center().x(), rect.center().y());
-    transform.rotate(qRadiansToDegrees(getRotation()));
-    transform.translate(-rect.center().x(), -rect.center().y());
-
-    // תĿƵ
-    for (int i = 0; i < basePoints.size(); ++i) {
-        handles.append({
-            transform.map(basePoints[i]),  // Ӧת
-            (i == 8) ? Rotate : Scale,    // 9תƵ
-            i                            // Ƶ
-            });
+void Shape::updateTransformCache() const {
+    if (m_transformValid && m_cachedBounds == boundingRect && m_cachedRotation == m_rotation) {
+        return;
     }
-    return handles;
+
+    // 绕中心旋转；逆变换直接按反向角度构造，避免求逆
+    const QPointF c = boundingRect.center();
+    const qreal degrees = qRadiansToDegrees(m_rotation);
+    m_worldTransform = QTransform::fromTranslate(c.x(), c.y());
+    m_worldTransform.rotate(degrees);
+    m_worldTransform.translate(-c.x(), -c.y());
+
+    m_inverseTransform = QTransform::fromTranslate(c.x(), c.y());
+    m_inverseTransform.rotate(-degrees);
+    m_inverseTransform.translate(-c.x(), -c.y());
+
+    m_cachedBounds = boundingRect;
+    m_cachedRotation = m_rotation;
+    m_transformValid = true;
 }
 
 // ellipse.cpp
 void Ellipse::setSize(const QPointF& fixedCorner, const QPointF& movingPos) {
-    // ±߽򣨱Բԣ
+    // 计算新边界框（保持椭圆参数方程特性）
     qreal left = qMin(fixedCorner.x(), movingPos.x());
     qreal right = qMax(fixedCorner.x(), movingPos.x());
     qreal top = qMin(fixedCorner.y(), movingPos.y());
@@ -208,115 +363,32 @@ void Ellipse::setSize(const QPointF& fixedCorner, const QPointF& movingPos) {
         QSizeF(right - left, bottom - top));
 }
 
-QVector<Shape::ControlHandle> Ellipse::getControlHandles() const {
-    QVector<Shape::ControlHandle> handles;
-    const QRectF& rect = boundingRect;
-
-    // ԲʹͬĿƵ㲼֣Զ壩
-    QVector<QPointF> basePoints = {
-        rect.topLeft(),      // 0: Ͻ
-        rect.topRight(),     // 1: Ͻ
-        rect.bottomRight(),  // 2: ½
-        rect.bottomLeft(),   // 3: ½
-        QPointF(rect.center().x(), rect.top()),    // 4: ϱе
-        QPointF(rect.right(), rect.center().y()),  // 5: ұе
-        QPointF(rect.center().x(), rect.bottom()), // 6: ±е
-        QPointF(rect.left(), rect.center().y()),   // 7: е
-        QPointF(rect.center().x(), rect.top() - 30) // 8: תƵ㣨Զ
-    };
-
-    // Ӧתͬ߼
-    QTransform transform;
-    transform.translate(rect.center().x(), rect.center().y());
-    transform.rotate(qRadiansToDegrees(getRotation()));
-    transform.translate(-rect.center().x(), -rect.center().y());
-
-    for (int i = 0; i < basePoints.size(); ++i) {
-        handles.append({
-            transform.map(basePoints[i]),
-            (i == 8) ? Rotate : Scale,
-            i
-            });
-    }
-    return handles;
-}
-
 // ellipse.cpp
-void Ellipse::draw(QPainter* painter) {
-    painter->save();
-
-    // Ӧת
-    QPointF center = boundingRect.center();
-    painter->translate(center);
-    painter->rotate(qRadiansToDegrees(getRotation()));
-    painter->translate(-center);
-
-    // Ȼ䣨ߣ
-    painter->setBrush(brush());
-    painter->setPen(Qt::NoPen); // ʱҪ߿
+void Ellipse::drawOutline(QPainter* painter) const {
     painter->drawEllipse(boundingRect);
+}
 
-    // ٻƱ߿У
-    if (pen().style() != Qt::NoPen) {
-        painter->setPen(pen());
-        painter->setBrush(Qt::NoBrush);
-        painter->drawEllipse(boundingRect);
-    }
-
-    painter->restore();
-
-    // ƿƵ㣨ѡʱ
-    if (isSelected()) {
-        drawControlHandles(painter);
-    }
-    if (!text().isEmpty()) {
-        painter->save();
-        painter->setFont(textFont());
-        painter->setPen(textColor());
-
-        QTextDocument doc;
-        doc.setHtml(text());
-        doc.setDefaultFont(textFont());
-        doc.setTextWidth(boundingRect.width() * 0.9); // ߾
-
-        // ж
-        QTextCursor cursor(&doc);
-        QTextBlockFormat fmt;
-        fmt.setAlignment(Qt::AlignCenter);
-        cursor.select(QTextCursor::Document);
-        cursor.mergeBlockFormat(fmt);
-
-        QSizeF docSize = doc.size();
-
-        painter->translate(boundingRect.center());
-        painter->rotate(qRadiansToDegrees(getRotation()));
-
-        qreal xOffset = -docSize.width() / 2;
-        qreal yOffset = -docSize.height() / 2;
-        painter->translate(xOffset, yOffset);
-
-        doc.drawContents(painter);
-
-        painter->restore();
-    }
+void Ellipse::addOutline(QPainterPath& path) const {
+    path.addEllipse(boundingRect);
 }
 
 
-//ֱûʵɾ
+//直接用基类实现所以删除
 //void Ellipse::drawControlHandles(QPainter* painter) const {
-//    // ...ԭпƵ...
+//    // ...原有控制点绘制...
 //
-//    // תߣɫߣ
+//    // 添加旋转控制线（绿色虚线）
 //    painter->setPen(QPen(Qt::green, 1, Qt::DashLine));
 //    painter->drawLine(boundingRect.center(),
 //        QPointF(boundingRect.center().x(),
-//            boundingRect.top() - 15)); // 15رص
+//            boundingRect.top() - 15)); // 短15像素避免重叠
 //}
 
 bool Shape::checkHandleHit(const QPointF& pos, int& outHandleIndex) const {
-    auto handles = getControlHandles(); // ȡתĿƵ
-    for (int i = 0; i < handles.size(); ++i) {
-        if (QLineF(pos, handles[i].pos).length() < 10) { // 10а뾶
+    const HandleArray handles = getControlHandles(); // 获取旋转后的控制点
+    for (int i = 0; i < HANDLE_COUNT; ++i) {
+        QPointF d = pos - handles[i].pos;
+        if (QPointF::dotProduct(d, d) < 10 * 10) { // 10像素命中半径
             outHandleIndex = i;
             return true;
         }
@@ -325,36 +397,119 @@ bool Shape::checkHandleHit(const QPointF& pos, int& outHandleIndex) const {
 }
 
 void Shape::applyTransform(const QTransform& matrix) {
-    // 任߽
+    // 纯平移（拖动）直接移动边界框，不构造多边形
+    if (matrix.type() <= QTransform::TxTranslate) {
+        boundingRect.translate(matrix.dx(), matrix.dy());
+        return;
+    }
+
+    // 变换边界框
     QPolygonF poly = matrix.map(QPolygonF(boundingRect));
     boundingRect = poly.boundingRect();
 
-    // תǶȣֽͨȡת
+    // 更新旋转角度（通过矩阵分解获取旋转分量）
     qreal dx = matrix.m11();
     qreal dy = matrix.m22();
     qreal shear = matrix.m12();
     m_rotation += qAtan2(shear, dx);
 }
 
+// 描边宽度：0 为装饰画笔，按 1 像素计（与 QPainterPathStroker 一致）
+static qreal strokeWidth(const QPen& pen) {
+    return pen.widthF() > 0 ? pen.widthF() : 1.0;
+}
+
+// 沿轮廓距离起点 distance 处是否落在虚线的线段上（实线总是落在线段上）。
+// 虚线模式以线宽为单位；非平头线帽使线段两端各延长半个线宽。
+// 只按轮廓长度判断，不处理线帽在拐角处的形状
+static bool onDash(const QPen& pen, qreal distance) {
+    if (pen.style() == Qt::SolidLine) return true;
+    const QVector<qreal> pattern = pen.dashPattern(); // 与画笔共享数据，不分配内存
+    if (pattern.size() < 2) return true;
+
+    const qreal w = strokeWidth(pen);
+    qreal period = 0;
+    for (qreal length : pattern) period += length * w;
+    if (period <= 0) return true;
+
+    qreal pos = std::fmod(distance + pen.dashOffset() * w, period);
+    if (pos < 0) pos += period;
+    const qreal cap = pen.capStyle() == Qt::FlatCap ? 0 : w / 2;
+
+    qreal start = 0;
+    for (int i = 0; i + 1 < pattern.size(); i += 2) {
+        const qreal end = start + pattern[i] * w;
+        // 首尾线段的线帽可能跨过周期边界
+        for (qreal p : { pos, pos - period, pos + period }) {
+            if (p >= start - cap && p <= end + cap) return true;
+        }
+        start = end + pattern[i + 1] * w;
+    }
+    return false;
+}
+
 // Rectangle.cpp
 bool Rectangle::strokeContains(const QPointF& point) const {
-    QPainterPath path;
-    path.addRect(boundingRect);
-    QPainterPathStroker stroker(pen());
-    return stroker.createStroke(path).contains(point);
+    // 解析判断：位于外扩矩形内且不在内缩矩形内（不构造QPainterPath）
+    const QPen stroke = pen();
+    const qreal half = strokeWidth(stroke) / 2;
+    QRectF outer = boundingRect.adjusted(-half, -half, half, half);
+    QRectF inner = boundingRect.adjusted(half, half, -half, -half);
+    if (!outer.contains(point) || (inner.isValid() && inner.contains(point))) return false;
+    if (stroke.style() == Qt::SolidLine) return true;
+
+    // 虚线：按最近的边求沿轮廓的距离（与 addRect 相同，从左上角顺时针）
+    const QRectF& r = boundingRect;
+    const qreal w = r.width();
+    const qreal h = r.height();
+    const qreal dTop = qAbs(point.y() - r.top());
+    const qreal dRight = qAbs(point.x() - r.right());
+    const qreal dBottom = qAbs(point.y() - r.bottom());
+    const qreal dLeft = qAbs(point.x() - r.left());
+    const qreal nearest = qMin(qMin(dTop, dRight), qMin(dBottom, dLeft));
+    qreal distance;
+    if (nearest == dTop) distance = qBound<qreal>(0, point.x() - r.left(), w);
+    else if (nearest == dRight) distance = w + qBound<qreal>(0, point.y() - r.top(), h);
+    else if (nearest == dBottom) distance = w + h + qBound<qreal>(0, r.right() - point.x(), w);
+    else distance = 2 * w + h + qBound<qreal>(0, r.bottom() - point.y(), h);
+    return onDash(stroke, distance);
 }
 
 // Ellipse.cpp 
 bool Ellipse::strokeContains(const QPointF& point) const {
-    QPainterPath path;
-    path.addEllipse(boundingRect);
-    QPainterPathStroker stroker(pen());
-    return stroker.createStroke(path).contains(point);
+    // 解析判断：位于外扩椭圆内且不在内缩椭圆内（不构造QPainterPath）
+    const QPen stroke = pen();
+    const qreal half = strokeWidth(stroke) / 2;
+    const QPointF d = point - boundingRect.center();
+    const qreal a = boundingRect.width() / 2;
+    const qreal b = boundingRect.height() / 2;
+
+    auto inside = [&d](qreal rx, qreal ry) {
+        if (rx <= 0 || ry <= 0) return false;
+        qreal nx = d.x() / rx;
+        qreal ny = d.y() / ry;
+        return nx * nx + ny * ny <= 1.0;
+    };
+    if (!inside(a + half, b + half) || inside(a - half, b - half)) return false;
+    if (stroke.style() == Qt::SolidLine || a <= 0 || b <= 0) return true;
+
+    // 虚线：与 addEllipse 相同，从三点钟方向开始、屏幕上逆时针；
+    // 用参数角近似投影点，弧长分段数值积分
+    qreal theta = qAtan2(-d.y() / b, d.x() / a);
+    if (theta < 0) theta += 2 * M_PI;
+    const int STEPS = 32;
+    const qreal step = theta / STEPS;
+    qreal distance = 0;
+    for (int i = 0; i < STEPS; ++i) {
+        const qreal t = (i + 0.5) * step;
+        distance += qSqrt(a * a * qSin(t) * qSin(t) + b * b * qCos(t) * qCos(t)) * step;
+    }
+    return onDash(stroke, distance);
 }
 
 // Rectangle.cpp
 Shape* Rectangle::clone() const {
-    Rectangle* newRect = new Rectangle(*this); // ÿ캯
+    Rectangle* newRect = new Rectangle(*this); // 调用拷贝构造函数
     newRect->boundingRect = this->boundingRect;
     newRect->setPen(this->pen());
     newRect->setBrush(this->brush());
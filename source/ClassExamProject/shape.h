@@ -2,13 +2,21 @@
 #define SHAPE_H
 
 #include <QPainter>
+#include <QPainterPath>
+#include <QStaticText>
+#include <QSharedPointer>
+#include <QMutex>
+#include "RichLabel.h"
 #include <QVector>
 #include <QTransform>
 #include <QtMath>
+#include <array>
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
+class QTextDocument;
+
 enum ShapeType {
     ShapeType_Rectangle,
     ShapeType_Ellipse
@@ -29,46 +37,63 @@ public:
     struct TransformState {
         QRectF bounds;
         qreal rotation = 0;
-        QPointF rotationCenter; // ת
+        QPointF rotationCenter; // 旋转中心
     };
     struct ControlHandle {
         QPointF pos;
         HandleType type;
         int index;
     };
-    virtual void draw(QPainter* painter) = 0;
+    enum { HANDLE_COUNT = 9 };  // 8个缩放点 + 1个旋转点
+    typedef std::array<ControlHandle, HANDLE_COUNT> HandleArray; // 定长数组，不分配堆内存
+
+    virtual void draw(QPainter* painter);
+    void drawBody(QPainter* painter) const;                 // 绘制填充和边框（不含控制点、文字）
+    void drawLabel(QPainter* painter) const;                // 绘制文字标签
+    virtual void drawOutline(QPainter* painter) const = 0;  // 用当前画笔/画刷绘制轮廓（局部坐标）
+    virtual void addOutline(QPainterPath& path) const = 0;  // 将轮廓追加到路径（未旋转）
     bool contains(const QPointF& point) const {
-        // תֲϵת
-        QTransform transform;
-        transform.translate(boundingRect.center().x(), boundingRect.center().y());
-        transform.rotate(-qRadiansToDegrees(m_rotation)); // ת
-        transform.translate(-boundingRect.center().x(), -boundingRect.center().y());
-        QPointF localPoint = transform.map(point);
-
-        // ھֲϵм;
-        if (m_brush != Qt::NoBrush && boundingRect.contains(localPoint)) {
+        // 将点转换到局部坐标系（使用缓存的逆变换）
+        QPointF localPoint = inverseTransform().map(point);
+
+        // 在局部坐标系中检测;
+        if (m_brush.style() != Qt::NoBrush && boundingRect.contains(localPoint)) {
             return true;
         }
         return strokeContains(localPoint);
     }
-    virtual QVector<ControlHandle> getControlHandles() const = 0;
+    HandleArray getControlHandles() const;
     virtual bool checkHandleHit(const QPointF& pos, int& outHandleIndex) const;
+
+    // 局部坐标 -> 世界坐标（绕中心旋转），按边界和角度缓存
+    const QTransform& worldTransform() const;
+    const QTransform& inverseTransform() const;
+    // 绘制占据的世界坐标区域：旋转后的外框加半个线宽和1像素（抗锯齿）
+    QRectF paintBounds() const;
+    QRectF labelBounds() const;    // 标签排版后实际占据的区域（可能超出外框），无标签时为空
+    QRectF contentBounds() const;  // 外框和标签
+    QRectF visualBounds() const;   // 外框和标签，选中时含控制点
+    // 按当前宽度排版标签并缓存尺寸，复制图形时共享（排版结果不可变）；
+    // 渲染线程中的副本须在并行绘制之前调用
+    void prepareLabel() const;
+    // 绘制结果是否相同（几何、样式、标签、选中状态），用于复用渲染副本
+    bool rendersSameAs(const Shape& other) const;
     virtual void applyTransform(const QTransform& matrix);
     virtual TransformState getTransformState() const;
 
-    // ͨ
+    // 通用属性
     void setSelected(bool selected);
     bool isSelected() const;
     virtual void drawControlHandles(QPainter* painter) const;
 
-    // 任
+    // 变换控制
     void setPosition(const QPointF& pos);
-    // 1ͨʵ֣Ƽ
+    // 方案1：通用实现（推荐）
     virtual void setSize(const QSizeF& size) {
         boundingRect.setSize(size);
     }
 
-    // 2̶İ汾Բ߼
+    // 方案2：带固定点的版本（如需椭圆特殊逻辑）
     virtual void setSize(const QPointF& fixedCorner, const QPointF& movingPos) {
         QRectF newRect(fixedCorner, movingPos);
         boundingRect = newRect.normalized();
@@ -84,16 +109,16 @@ public:
     int borderWidth = 1;
     Qt::PenStyle borderStyle = Qt::SolidLine;
     qreal opacity = 1.0;
-    //ǶȽӿ
+    //角度接口
     qreal getRotation() const { return m_rotation; }
     void setRotation(qreal angle) { m_rotation = angle; }
     void setRotationCenter(const QPointF& center) { m_rotationCenter = center; }
     QPointF getRotationCenter() const { return m_rotationCenter; }
-    //ӿڣıͬʱı˽б
+    //线条接口，改变线条后同时改变私有变量
     void setPen(const QPen& pen) {
         if (m_pen != pen) {
             m_pen = pen;
-            markDirty();  // Ҫm_needsUpdate = true;
+            markDirty();  // 标记需要更新m_needsUpdate = true;
         }
     }
     void markDirty() { m_needsUpdate = true; }
@@ -102,57 +127,99 @@ public:
     void setBrush(const QBrush& brush) {
         if (m_brush != brush) {
             m_brush = brush;
-            markDirty();  // Ҫm_needsUpdate = true;
+            markDirty();  // 标记需要更新m_needsUpdate = true;
         }
     }
     QPen pen() const { return m_pen; }
     QBrush brush() const { return m_brush; }
     QRectF boundingRect;
 
-    //ͼ˳
-    int zValue() const { return m_zValue; }
-    void setZValue(int z) { m_zValue = z; }
+    //唯一标识（保存在文件中，0表示尚未分配）
+    quint64 id() const { return m_id; }
+    void setId(quint64 id) { m_id = id; }
 
-    virtual Shape* clone() const = 0;  // 麯
-    QString text() const { return m_text; }
-    bool hasText() const { return !m_text.isEmpty(); }
-    void setText(const QString& text, const QFont& font = QFont(), const QColor& color = Qt::black);
+    //图层顺序相关
+    quint64 zKey() const { return m_zKey; }     // 图层顺序键（由 ZOrderIndex 分配）
+    void setZKey(quint64 key) { m_zKey = key; }
+
+    virtual Shape* clone() const = 0;  // 纯虚函数声明
+    const RichLabel& label() const { return m_label; }
+    bool hasText() const { return !m_label.isEmpty(); }
+    void setLabel(const RichLabel& label, const QFont& font = QFont(), const QColor& color = Qt::black);
+    void setText(const QString& html, const QFont& font = QFont(), const QColor& color = Qt::black); // 从HTML转换（旧文件迁移）
     QFont textFont() const { return m_textFont; }
     QColor textColor() const { return m_textColor; }
-    // Shape·
+    // 在Shape类中添加以下方法
     /*qreal getRotation() const { return m_rotation; }
     QPointF getRotationCenter() const { return m_rotationCenter; }*/
-    // ޸÷
+    // 修改设置方法
     void setTextFormat(const QFont& font, const QColor& color) {
         m_textFont = font;
         m_textColor = color;
+        analyzeLabel();
         markDirty();
     }
+    bool isPlainLabel() const { return m_plainLabel; }  // 单一字体和颜色、单行的标签
+    static void setPlainLabelFastPath(bool enabled);    // 纯文本标签是否走QStaticText（默认开启，供基准测试对比）
 protected:
     bool m_selected = false;
     static const int HANDLE_SIZE = 6;
-    QPointF m_rotationCenter; // תĵ
+    QPointF m_rotationCenter; // 旋转中心点
     virtual bool strokeContains(const QPointF& point) const = 0;
+    virtual qreal rotateHandleOffset() const { return 20; } // 旋转控制点到上边的距离
 private:
-    qreal m_rotation = 0; // 洢תǶ
-    QPen m_pen{ Qt::black, 2, Qt::SolidLine }; // ĬϺɫʵ
-    QBrush m_brush{ Qt::white };              // Ĭ
+    void updateTransformCache() const;
+    void analyzeLabel();                          // 判断标签能否走纯文本快速路径
+    void drawPlainLabel(QPainter* painter) const;
+    qreal plainLabelWidth() const;
+    void layoutDocument(QTextDocument* doc) const;  // 富文本标签的排版（与绘制一致）
+
+    // 排好的标签，建立后不再修改，复制图形时共享（渲染副本直接沿用原图形的排版）
+    struct LabelLayout {
+        qreal boxWidth = -1;  // 排版时的外框宽度
+        qreal rotation = 0;   // 排版时的角度（纯文本按最终变换预先排好字形）
+        bool plain = false;   // 是否走纯文本快速路径
+        QSizeF size;          // 排版后的尺寸
+        QStaticText text;     // 纯文本标签预先排好的文字
+        // drawStaticText 在变换与排版时不同时会重排共享的内部数据，
+        // 多个线程同时绘制同一标签时须串行
+        mutable QMutex drawLock;
+    };
+    mutable QSharedPointer<const LabelLayout> m_labelLayout;
+
+    // 变换缓存：边界或角度与缓存时不同则视为失效
+    mutable QTransform m_worldTransform;
+    mutable QTransform m_inverseTransform;
+    mutable QRectF m_cachedBounds;
+    mutable qreal m_cachedRotation = 0;
+    mutable bool m_transformValid = false;
+
+    qreal m_rotation = 0; // 存储旋转角度
+    QPen m_pen{ Qt::black, 2, Qt::SolidLine }; // 默认黑色实线
+    QBrush m_brush{ Qt::white };              // 默认无填充
     bool m_needsUpdate = false;
-    int m_zValue = 0; // ͼ˳ֵ
-    QString m_text;
-    QFont m_textFont{ "Arial", 12 }; // Ĭ
-    QColor m_textColor{ Qt::black }; // ĬϺɫ
+    quint64 m_id = 0;   // 唯一标识
+    quint64 m_zKey = 0; // 图层顺序键
+    RichLabel m_label;               // 文字标签（纯文本+格式区段）
+    QFont m_textFont{ "Arial", 12 }; // 默认字体
+    QColor m_textColor{ Qt::black }; // 默认黑色
+
+    // 纯文本快速路径（设置标签时判断一次，之后只读）
+    bool m_plainLabel = false;
+    QString m_plainText;
+    QFont m_plainFont;
+    QColor m_plainColor;
 };
 
 class Rectangle : public Shape {
 public:
     Rectangle(const QRectF& rect);
-    void draw(QPainter* painter) override;
-    QVector<ControlHandle> getControlHandles() const override;
+    void drawOutline(QPainter* painter) const override;
+    void addOutline(QPainterPath& path) const override;
     //bool contains(const QPointF& point) const override {
-    //    return Shape::contains(point); // ֱʹû߼
+    //    return Shape::contains(point); // 直接使用基类逻辑
     //}
-    Shape* clone() const override;  // ȷʹoverride
+    Shape* clone() const override;  // 明确使用override
 protected:
     bool strokeContains(const QPointF& point) const override;
 };
@@ -160,16 +227,17 @@ protected:
 class Ellipse : public Shape {
 public:
     Ellipse(const QRectF& rect);
-    void draw(QPainter* painter) override;
-    QVector<ControlHandle> getControlHandles() const override;
-    // ʽsetSize
-    void setSize(const QPointF& fixedCorner, const QPointF& movingPos) override; // 2
+    void drawOutline(QPainter* painter) const override;
+    void addOutline(QPainterPath& path) const override;
+    // 显式声明setSize
+    void setSize(const QPointF& fixedCorner, const QPointF& movingPos) override; // 方案2
     //bool contains(const QPointF& point) const override {
-    //    return Shape::contains(point); // ֱʹû߼
+    //    return Shape::contains(point); // 直接使用基类逻辑
     //}
-    Shape* clone() const override;  // ȷʹoverride
+    Shape* clone() const override;  // 明确使用override
 protected:
     bool strokeContains(const QPointF& point) const override;
+    qreal rotateHandleOffset() const override { return 30; } // 椭圆旋转点更远
 };
 
 #endif // SHAPE_H
\ No newline at end of file
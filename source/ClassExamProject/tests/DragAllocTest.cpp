@@ -0,0 +1,95 @@
+﻿#include "shape.h"
+#include <QGuiApplication>
+#include <QTransform>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// 统计拖动过程中的堆分配：替换全局 operator new，只在测量区间内计数
+static std::atomic<bool> s_counting(false);
+static std::atomic<long> s_allocations(0);
+
+void* operator new(std::size_t size) {
+    if (s_counting.load(std::memory_order_relaxed)) {
+        s_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// 模拟一次拖动中每个鼠标移动事件对图形做的操作
+static int dragStep(Shape& shape, const QPointF& cursor) {
+    int hits = 0;
+    shape.applyTransform(QTransform::fromTranslate(0.5, 0.25));
+    hits += shape.worldTransform().isIdentity() ? 0 : 1;
+    hits += shape.inverseTransform().isIdentity() ? 0 : 1;
+    const Shape::HandleArray handles = shape.getControlHandles();
+    int handleIndex = -1;
+    hits += shape.checkHandleHit(handles[0].pos, handleIndex) ? 1 : 0;
+    hits += shape.contains(cursor) ? 1 : 0;
+    hits += shape.contains(shape.worldTransform().map(shape.boundingRect.topLeft())) ? 1 : 0;
+    return hits;
+}
+
+int main(int argc, char* argv[]) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+
+    Rectangle rect(QRectF(0, 0, 120, 80));
+    Ellipse ellipse(QRectF(200, 0, 160, 90));
+    Rectangle dashed(QRectF(0, 200, 100, 100));
+    Ellipse rotated(QRectF(200, 200, 100, 60));
+    dashed.setPen(QPen(Qt::blue, 3, Qt::DashLine));
+    rotated.setPen(QPen(Qt::red, 0, Qt::DashDotLine));
+    rotated.setRotation(30);
+    Shape* shapes[] = { &rect, &ellipse, &dashed, &rotated };
+
+    // 预热：建立变换缓存和虚线模式等惰性数据
+    int hits = 0;
+    for (Shape* shape : shapes) {
+        hits += dragStep(*shape, QPointF(50, 50));
+    }
+
+    const int STEPS = 1000;
+    s_allocations = 0;
+    s_counting = true;
+    for (int i = 0; i < STEPS; ++i) {
+        const QPointF cursor(i % 400, (i * 7) % 400);
+        for (Shape* shape : shapes) {
+            hits += dragStep(*shape, cursor);
+        }
+    }
+    s_counting = false;
+
+    const long allocations = s_allocations.load();
+    std::printf("drag steps: %d, hits: %d, allocations: %ld\n", STEPS, hits, allocations);
+    if (allocations != 0) {
+        std::fprintf(stderr, "FAIL: drag allocated %ld times\n", allocations);
+        return 1;
+    }
+    std::printf("PASS\n");
+    return 0;
+}